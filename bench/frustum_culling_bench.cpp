@@ -0,0 +1,84 @@
+/*
+Culls 1M random boxes against a camera frustum with the FrustumCullingSystem
+and reports the time per cull (target: under 1 ms on a desktop CPU).
+The scalar reference checks that the SIMD kernels keep the same boxes.
+*/
+#include "Core/ThreadPool.hpp"
+#include "Systems/frustum_culling_system.hpp"
+
+//libs
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+// std
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using namespace hyd;
+
+static constexpr uint32_t BOX_COUNT = 1000000;
+static constexpr int ITERATIONS = 200;
+
+static bool intersects(const Frustum& frustum, const AABB& box){
+    glm::vec3 center = box.center();
+    glm::vec3 extent = box.extent();
+    for (const auto& plane : frustum.planes){
+        glm::vec3 normal{plane};
+        if (glm::dot(normal, center) + plane.w + glm::dot(glm::abs(normal), extent) < 0.f)
+            return false;
+    }
+    return true;
+}
+
+int main(){
+    ThreadPool threadPool{};
+    FrustumCullingSystem culling{threadPool};
+
+    // boxes spread in a 200m cube around the camera
+    std::mt19937 rng{42};
+    std::uniform_real_distribution<float> position{-100.f, 100.f};
+    std::uniform_real_distribution<float> size{0.25f, 2.f};
+
+    std::vector<AABB> boxes(BOX_COUNT);
+    culling.resize(BOX_COUNT);
+    for (uint32_t i = 0; i < BOX_COUNT; i++){
+        glm::vec3 center{position(rng), position(rng), position(rng)};
+        glm::vec3 halfSize{size(rng), size(rng), size(rng)};
+        boxes[i] = AABB{center - halfSize, center + halfSize};
+        culling.setBounds(i, boxes[i]);
+    }
+
+    glm::mat4 projection = glm::perspective(glm::radians(50.f), 16.f / 9.f, 0.1f, 100.f);
+    glm::mat4 view = glm::lookAt(glm::vec3{0.f, 0.f, -5.f}, glm::vec3{0.f}, glm::vec3{0.f, 1.f, 0.f});
+    Frustum frustum = Frustum::fromMatrix(projection * view);
+
+    std::vector<uint32_t> visible;
+    culling.cull(frustum, visible); // warm up the workers and the caches
+
+    double best = 1e9;
+    double total = 0.0;
+    for (int i = 0; i < ITERATIONS; i++){
+        auto start = std::chrono::high_resolution_clock::now();
+        culling.cull(frustum, visible);
+        auto stop = std::chrono::high_resolution_clock::now();
+        double ms = std::chrono::duration<double, std::milli>(stop - start).count();
+        best = std::min(best, ms);
+        total += ms;
+    }
+
+    std::vector<uint32_t> expected;
+    for (uint32_t i = 0; i < BOX_COUNT; i++){
+        if (intersects(frustum, boxes[i]))
+            expected.push_back(i);
+    }
+
+    std::printf("frustum culling: %u boxes, %u threads (+ caller)\n", BOX_COUNT, threadPool.getThreadCount());
+    std::printf("  visible: %zu (reference %zu) %s\n", visible.size(), expected.size(), visible == expected ? "match" : "MISMATCH");
+    std::printf("  best %.3f ms, average %.3f ms over %d runs\n", best, total / ITERATIONS, ITERATIONS);
+    return visible == expected ? 0 : 1;
+}
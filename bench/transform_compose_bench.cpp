@@ -0,0 +1,85 @@
+/*
+Composes the model and normal matrices of 128k random transforms, one by one
+with TransformComponent::mat4 and normalMatrix, then with the SoA kernel of
+composeInstances, and reports the time of both.
+The results of the kernel are checked against the glm ones.
+*/
+#include "Components/Transform.hpp"
+#include "Systems/transform_kernel.hpp"
+
+//libs
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+// std
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using namespace hyd;
+
+static constexpr uint32_t TRANSFORM_COUNT = 128 * 1024 + 3; // a tail the SIMD kernels finish one by one
+static constexpr int ITERATIONS = 100;
+
+template<typename F>
+static void measure(const char* name, F&& compose){
+    compose(); // warm up the caches
+
+    double best = 1e9;
+    double total = 0.0;
+    for (int i = 0; i < ITERATIONS; i++){
+        auto start = std::chrono::high_resolution_clock::now();
+        compose();
+        auto stop = std::chrono::high_resolution_clock::now();
+        double ms = std::chrono::duration<double, std::milli>(stop - start).count();
+        best = std::min(best, ms);
+        total += ms;
+    }
+    std::printf("  %-10s best %.3f ms, average %.3f ms over %d runs\n", name, best, total / ITERATIONS, ITERATIONS);
+}
+
+int main(){
+    std::mt19937 rng{42};
+    std::uniform_real_distribution<float> position{-100.f, 100.f};
+    std::uniform_real_distribution<float> size{0.25f, 4.f};
+    std::normal_distribution<float> axis{0.f, 1.f};
+
+    std::vector<TransformComponent> transforms(TRANSFORM_COUNT);
+    TransformsSoA soa;
+    soa.resize(TRANSFORM_COUNT);
+    for (uint32_t i = 0; i < TRANSFORM_COUNT; i++){
+        auto& transform = transforms[i];
+        transform.translation = {position(rng), position(rng), position(rng)};
+        transform.scale = {size(rng), size(rng), size(rng)};
+        transform.orientation = glm::normalize(glm::quat{axis(rng), axis(rng), axis(rng), axis(rng)});
+        soa.set(i, transform);
+    }
+
+    std::vector<InstanceData> reference(TRANSFORM_COUNT);
+    std::vector<InstanceData> instances(TRANSFORM_COUNT);
+
+    std::printf("transform composition: %u transforms\n", TRANSFORM_COUNT);
+    measure("glm", [&](){
+        for (uint32_t i = 0; i < TRANSFORM_COUNT; i++)
+            reference[i] = {transforms[i].mat4(), glm::mat4(transforms[i].normalMatrix())};
+    });
+    measure("kernel", [&](){
+        composeInstances(soa, 0, TRANSFORM_COUNT, instances.data());
+    });
+
+    // relative to the magnitude of the values, the translations reach a few hundreds
+    float maxError = 0.f;
+    for (uint32_t i = 0; i < TRANSFORM_COUNT; i++){
+        const float* expected = &reference[i].modelMatrix[0][0];
+        const float* actual = &instances[i].modelMatrix[0][0];
+        for (int f = 0; f < 32; f++)
+            maxError = std::max(maxError, std::abs(expected[f] - actual[f]) / std::max(1.f, std::abs(expected[f])));
+    }
+    const bool match = maxError < 1e-4f;
+    std::printf("  max relative error %g %s\n", maxError, match ? "match" : "MISMATCH");
+    return match ? 0 : 1;
+}
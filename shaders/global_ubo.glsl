@@ -0,0 +1,13 @@
+// per-view data of the frame, bound with a dynamic offset in the frame data ring
+// must match src/Renderer/GlobalUbo.hpp, every member is 16 bytes aligned
+layout(set = 0, binding = 0) uniform GlobalUbo {
+  mat4 projection;
+  mat4 view;
+
+  mat4 lightMVP;
+  vec4 directionalLight; // xyz is the direction
+  vec4 ambientLightColor; // w is intensity
+
+  vec4 lightPosition;
+  vec4 lightColor; // w is intensity
+} global_ubo;
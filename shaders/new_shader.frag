@@ -1,4 +1,5 @@
 #version 450
+#extension GL_GOOGLE_include_directive : require
 
 layout (location = 0) in vec3 fragColor;
 layout (location = 1) in vec3 fragPosWorld;
@@ -8,27 +9,12 @@ layout (location = 4) in vec4 inShadowCoord;
 
 layout (location = 0) out vec4 outColor;
 
-layout(set = 0, binding = 0) uniform GlobalUbo {
-  mat4 projection;
-  mat4 view;
-  
-  mat4 lightMVP;
-  vec3 directionalLightDirection; 
-  vec4 ambientLightColor; // w is intensity
-  
-  vec3 lightPosition;
-  vec4 lightColor; // w is intensity
-} global_ubo;
+#include "global_ubo.glsl"
 
 layout (set = 0, binding = 1) uniform sampler2D shadowMap;
 
 layout(set = 1, binding = 0) uniform sampler2D texSampler;
 
-layout (push_constant) uniform Push {
-    mat4 modelMatrix;
-    mat4 normalMatrix;
-} push;
-
 const int enablePCF = 0;
 
 float textureProj(vec4 shadowCoord, vec2 off)
@@ -72,7 +58,7 @@ void main(){
 
     float shadow = (enablePCF == 1) ? filterPCF(inShadowCoord / inShadowCoord.w) : textureProj(inShadowCoord / inShadowCoord.w, vec2(0.0));
 
-    vec3 directionToLight = global_ubo.lightPosition - fragPosWorld;
+    vec3 directionToLight = global_ubo.lightPosition.xyz - fragPosWorld;
     float attenuation = 1.0 / dot(directionToLight, directionToLight); // distance squared
 
     // ambiant
@@ -83,8 +69,8 @@ void main(){
     // vec3 diffuseLight = lightColor * max(dot(normalize(fragNormalWorld), normalize(directionToLight)), 0);
 
     vec3 directionalLightColor = {1.0, 1.0, 1.0};
-    vec3 normalWorldSpace = normalize(mat3(push.normalMatrix)*fragNormalWorld);
-    vec3 diffuseLight = directionalLightColor * max(dot(normalWorldSpace, -global_ubo.directionalLightDirection), 0);
+    vec3 normalWorldSpace = normalize(fragNormalWorld); // already in world space (vertex stage)
+    vec3 diffuseLight = directionalLightColor * max(dot(normalWorldSpace, -global_ubo.directionalLight.xyz), 0);
 
     vec2 uv_reversed = vec2( uv.x, 1.0- uv.y);
     vec4 color = texture(texSampler, uv_reversed)*vec4((diffuseLight + ambientLight), 1.0);
@@ -1,8 +1,9 @@
 #version 450
+#extension GL_GOOGLE_include_directive : require
 
-layout (location = 0) in vec3 inPos;
-layout (location = 1) in vec3 color;
-layout (location = 2) in vec3 normal;
+layout (location = 0) in vec4 inPos;
+layout (location = 1) in vec4 color;
+layout (location = 2) in vec2 normal;
 layout (location = 3) in vec2 uv;
 
 layout (location = 0) out vec3 fragColor;
@@ -12,26 +13,31 @@ layout (location = 3) out vec2 uv_out;
 
 layout (location = 4) out vec4 outShadowCoord;
 
-layout(set = 0, binding = 0) uniform GlobalUbo {
-  mat4 projection;
-  mat4 view;
-
-  mat4 lightMVP;
-  vec3 directionalLightDirection; 
-  vec4 ambientLightColor; // w is intensity
-  
-  vec3 lightPosition;
-  vec4 lightColor; // w is intensity
-} global_ubo;
+#include "global_ubo.glsl"
 
 // layout(set = 1, binding = 0) uniform MaterialUbo {
 //     vec3 color;
 // } object_ubo;
 
-layout (push_constant) uniform Push {
+struct InstanceData {
     mat4 modelMatrix;
     mat4 normalMatrix;
-} push;
+};
+
+layout(std430, set = 2, binding = 0) readonly buffer InstanceBuffer {
+    InstanceData instances[];
+} instance_buffer;
+
+// instances that passed the culling, gl_InstanceIndex starts at the batch's firstInstance
+layout(std430, set = 2, binding = 1) readonly buffer VisibleBuffer {
+    uint ids[];
+} visible_ids;
+
+// dequantization of the positions, stored as snorm16 in the bounds of the model
+layout(push_constant) uniform PositionDecode {
+    vec4 offset;
+    vec4 scale;
+} position_decode;
 
 
 const mat4 biasMat = mat4( 
@@ -40,14 +46,24 @@ const mat4 biasMat = mat4(
 	0.0, 0.0, 1.0, 0.0,
 	0.5, 0.5, 0.0, 1.0 );
 
+// octahedral normal, the lower hemisphere is folded over the diagonals
+vec3 octDecode(vec2 e) {
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.xy += mix(vec2(t), vec2(-t), greaterThanEqual(n.xy, vec2(0.0)));
+    return normalize(n);
+}
+
 void main() {
-    vec4 positionWorld = push.modelMatrix * vec4(inPos, 1.0);
+    InstanceData instance = instance_buffer.instances[visible_ids.ids[gl_InstanceIndex]];
+    vec3 position = position_decode.offset.xyz + inPos.xyz * position_decode.scale.xyz;
+    vec4 positionWorld = instance.modelMatrix * vec4(position, 1.0);
     gl_Position = global_ubo.projection * global_ubo.view * positionWorld;
 
-    fragNormalWorld = normalize(mat3(push.normalMatrix)*normal);
+    fragNormalWorld = normalize(mat3(instance.normalMatrix)*octDecode(normal));
     fragPosWorld = positionWorld.xyz;
-    fragColor = color;
+    fragColor = color.rgb;
     uv_out = uv;
 
-    outShadowCoord = ( biasMat * global_ubo.lightMVP * push.modelMatrix ) * vec4(inPos, 1.0);	
+    outShadowCoord = ( biasMat * global_ubo.lightMVP ) * positionWorld;
 }
\ No newline at end of file
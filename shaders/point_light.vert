@@ -1,4 +1,5 @@
 #version 450
+#extension GL_GOOGLE_include_directive : require
 
 const vec2 OFFSETS[6] = vec2[](
   vec2(-1.0, -1.0),
@@ -11,24 +12,18 @@ const vec2 OFFSETS[6] = vec2[](
 
 layout (location = 0) out vec2 fragOffset;
 
-layout(set = 0, binding = 0) uniform GlobalUbo {
-  mat4 projection;
-  mat4 view;
-  vec4 ambientLightColor; // w is intensity
-  vec3 lightPosition;
-  vec4 lightColor;
-} ubo;
+#include "global_ubo.glsl"
 
 const float LIGHT_RADIUS = 0.05;
 
 void main() {
   fragOffset = OFFSETS[gl_VertexIndex];
-  vec3 cameraRightWorld = {ubo.view[0][0], ubo.view[1][0], ubo.view[2][0]};
-  vec3 cameraUpWorld = {ubo.view[0][1], ubo.view[1][1], ubo.view[2][1]};
+  vec3 cameraRightWorld = {global_ubo.view[0][0], global_ubo.view[1][0], global_ubo.view[2][0]};
+  vec3 cameraUpWorld = {global_ubo.view[0][1], global_ubo.view[1][1], global_ubo.view[2][1]};
 
-  vec3 positionWorld = ubo.lightPosition.xyz
+  vec3 positionWorld = global_ubo.lightPosition.xyz
     + LIGHT_RADIUS * fragOffset.x * cameraRightWorld
     + LIGHT_RADIUS * fragOffset.y * cameraUpWorld;
 
-  gl_Position = ubo.projection * ubo.view * vec4(positionWorld, 1.0);
+  gl_Position = global_ubo.projection * global_ubo.view * vec4(positionWorld, 1.0);
 } 
\ No newline at end of file
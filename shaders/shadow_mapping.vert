@@ -1,32 +1,40 @@
 #version 450
+#extension GL_GOOGLE_include_directive : require
 
-layout (location = 0) in vec3 inPos;
+layout (location = 0) in vec4 inPos;
 
 out gl_PerVertex 
 {
     vec4 gl_Position;   
 };
 
-layout(set = 0, binding = 0) uniform GlobalUbo {
-  mat4 projection;
-  mat4 view;
+#include "global_ubo.glsl"
 
-  vec3 directionalLightDirection; 
-  vec4 ambientLightColor; // w is intensity
-  
-  vec3 lightPosition;
-  vec4 lightColor; // w is intensity
-} global_ubo;
-
-layout (push_constant) uniform Push {
+struct InstanceData {
     mat4 modelMatrix;
     mat4 normalMatrix;
-} push;
+};
+
+layout(std430, set = 1, binding = 0) readonly buffer InstanceBuffer {
+    InstanceData instances[];
+} instance_buffer;
+
+// instances that passed the culling, gl_InstanceIndex starts at the batch's firstInstance
+layout(std430, set = 1, binding = 1) readonly buffer VisibleBuffer {
+    uint ids[];
+} visible_ids;
+
+// dequantization of the positions, stored as snorm16 in the bounds of the model
+layout(push_constant) uniform PositionDecode {
+    vec4 offset;
+    vec4 scale;
+} position_decode;
 
 
 void main()
 {
 	// mat4 depthMVP = push.modelMatrix * global_ubo.view * global_ubo.projection;
-	mat4 depthMVP = global_ubo.projection * global_ubo.view * push.modelMatrix;
-	gl_Position = depthMVP * vec4(inPos, 1.0);
+	mat4 depthMVP = global_ubo.projection * global_ubo.view * instance_buffer.instances[visible_ids.ids[gl_InstanceIndex]].modelMatrix;
+	vec3 position = position_decode.offset.xyz + inPos.xyz * position_decode.scale.xyz;
+	gl_Position = depthMVP * vec4(position, 1.0);
 }
\ No newline at end of file
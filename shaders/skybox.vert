@@ -1,30 +1,31 @@
 #version 450
+#extension GL_GOOGLE_include_directive : require
 
-layout (location = 0) in vec3 inPos;
-layout (location = 1) in vec3 color;
-layout (location = 2) in vec3 normal;
+layout (location = 0) in vec4 inPos;
+layout (location = 1) in vec4 color;
+layout (location = 2) in vec2 normal;
 layout (location = 3) in vec2 uv;
 
-layout(set = 0, binding = 0) uniform GlobalUbo {
-  mat4 projection;
-  mat4 view;
+#include "global_ubo.glsl"
 
-  vec4 ambientLightColor; // w is intensity
-  vec3 lightPosition;
-  vec4 lightColor; // w is intensity
-} ubo;
+// dequantization of the positions, stored as snorm16 in the bounds of the model
+layout(push_constant) uniform PositionDecode {
+    vec4 offset;
+    vec4 scale;
+} position_decode;
 
 layout (location = 0) out vec3 TexCoords;
 
 void main() 
 {
-	TexCoords = inPos;
+	vec3 position = position_decode.offset.xyz + inPos.xyz * position_decode.scale.xyz;
+	TexCoords = position;
 
   
-  mat4 viewMat = ubo.view;
+  mat4 viewMat = global_ubo.view;
   viewMat[3] = vec4(0.0, 0.0, 0.0, 1.0);
-	// vec4 pos = ubo.projection * ubo.view * vec4(position.xyz, 1.0);
-  vec4 pos = (ubo.projection * viewMat * vec4(inPos.xyz, 0.0));
+	// vec4 pos = global_ubo.projection * global_ubo.view * vec4(position.xyz, 1.0);
+  vec4 pos = (global_ubo.projection * viewMat * vec4(position, 0.0));
   gl_Position = pos.xyzz;
 }
 
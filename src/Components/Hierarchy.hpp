@@ -0,0 +1,29 @@
+/*
+The hierarchy component attaches an entity to a parent, its transform is then
+relative to the parent's world transform. The children of an entity are linked
+through their siblings, the depth is the number of ancestors.
+The links are only edited through TransformSystem::setParent and destroyed with
+TransformSystem::destroy, which keep them and the depths consistent.
+*/
+#pragma once
+
+// libs
+#include <entt/entt.hpp>
+
+// std
+#include <cstdint>
+
+namespace hyd
+{
+
+struct HierarchyComponent
+{
+    entt::entity parent{entt::null};
+    entt::entity firstChild{entt::null};
+    entt::entity previousSibling{entt::null};
+    entt::entity nextSibling{entt::null};
+    // 0 for the roots
+    uint32_t depth{0};
+};
+
+} // namespace hyd
@@ -15,11 +15,16 @@ The transform component gives an object a position and orientation in space!
 namespace hyd
 {
     
+// the model can still be loading, the entity is drawn once it is resident
 struct RenderableComponent
 {
    std::shared_ptr<Model> model {nullptr};
    std::shared_ptr<Material> material {nullptr};
 };
 
+// tag of the renderables that never move once created, their draws are recorded once and reused
+// between frames until the static set changes
+struct StaticComponent {};
+
 } // namespace hyd
 
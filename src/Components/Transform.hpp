@@ -1,8 +1,13 @@
 /*
 The transform component gives an object a position and orientation in space!
+It is local to the parent of the entity when it has one (see Hierarchy.hpp), the
+world transform component caches the resulting world matrices, computed by the
+transform system once per frame.
 */
 #pragma once
 
+#include "Renderer/Bounds.hpp"
+
 // libs
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
@@ -11,8 +16,31 @@ The transform component gives an object a position and orientation in space!
 #include <glm/gtc/quaternion.hpp>
 #include <glm/gtx/quaternion.hpp>
 
+// std
+#include <cstdint>
+
 namespace hyd
 {
+
+class TransformSystem;
+
+// world matrices of the entity, only written by the transform system
+struct WorldTransformComponent
+{
+    glm::mat4 matrix{1.f};
+    glm::mat4 normalMatrix{1.f};
+    // update of the transform system that last computed the matrices, changes with them
+    uint64_t version{0};
+
+private:
+    friend class TransformSystem;
+
+    // local transform the matrices were computed from
+    bool m_valid{false};
+    glm::vec3 m_translation{0.f};
+    glm::vec3 m_scale{1.f};
+    glm::quat m_orientation{};
+};
     
 struct TransformComponent
 {
@@ -21,7 +49,7 @@ struct TransformComponent
     glm::quat orientation;
 
     // matrix corresponds to translate * rotate* scale transformation
-    glm::mat4 mat4(){
+    glm::mat4 mat4() const {
 
         glm::mat4 transform = glm::toMat4(orientation);
         transform = glm::scale(transform, scale);
@@ -29,7 +57,7 @@ struct TransformComponent
         return transform;
     }
     
-    glm::mat3 normalMatrix(){
+    glm::mat3 normalMatrix() const {
         glm::vec3 inv_scale = 1.0f / scale;
         glm::mat3 normalMatrix{1.f};
         normalMatrix[0][0] = inv_scale.x;
@@ -38,6 +66,33 @@ struct TransformComponent
         normalMatrix = normalMatrix*glm::toMat3(orientation);
         return normalMatrix;
     }
+
+    // world space bounds of the entity's model, see updateWorldBounds
+    AABB worldAABB{};
+    BoundingSphere worldBoundingSphere{};
+
+    // recomputes the world bounds only if the world matrix or the local bounds changed since the last call
+    void updateWorldBounds(const WorldTransformComponent& world, const AABB& localAABB, const BoundingSphere& localSphere){
+        if (m_boundsValid && m_boundsWorldVersion == world.version &&
+            m_boundsLocalAABB.min == localAABB.min && m_boundsLocalAABB.max == localAABB.max &&
+            m_boundsLocalSphere.center == localSphere.center && m_boundsLocalSphere.radius == localSphere.radius)
+            return;
+
+        worldAABB = localAABB.transformed(world.matrix);
+        worldBoundingSphere = localSphere.transformed(world.matrix);
+
+        m_boundsValid = true;
+        m_boundsWorldVersion = world.version;
+        m_boundsLocalAABB = localAABB;
+        m_boundsLocalSphere = localSphere;
+    }
+
+private:
+    // state the world bounds were computed from
+    bool m_boundsValid{false};
+    uint64_t m_boundsWorldVersion{0};
+    AABB m_boundsLocalAABB{};
+    BoundingSphere m_boundsLocalSphere{};
 };
 
 } // namespace hyd
@@ -0,0 +1,92 @@
+#include "MappedFile.hpp"
+
+// std
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace hyd
+{
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const std::string& filepath){
+    HANDLE file = CreateFileA(filepath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        throw std::runtime_error("failed to open file: " + filepath);
+    m_file = file;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size)){
+        CloseHandle(file);
+        throw std::runtime_error("failed to read the size of file: " + filepath);
+    }
+    m_size = static_cast<size_t>(size.QuadPart);
+    if (m_size == 0)
+        return;
+
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    void* view = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    if (view == nullptr){
+        if (mapping)
+            CloseHandle(mapping);
+        CloseHandle(file);
+        throw std::runtime_error("failed to map file: " + filepath);
+    }
+    m_mapping = mapping;
+    m_data = static_cast<const unsigned char*>(view);
+}
+
+MappedFile::~MappedFile(){
+    if (m_data)
+        UnmapViewOfFile(m_data);
+    if (m_mapping)
+        CloseHandle(m_mapping);
+    CloseHandle(m_file);
+}
+
+#else
+
+MappedFile::MappedFile(const std::string& filepath){
+    m_file = open(filepath.c_str(), O_RDONLY);
+    if (m_file < 0)
+        throw std::runtime_error("failed to open file: " + filepath);
+
+    struct stat status;
+    if (fstat(m_file, &status) != 0){
+        close(m_file);
+        throw std::runtime_error("failed to read the size of file: " + filepath);
+    }
+    m_size = static_cast<size_t>(status.st_size);
+    if (m_size == 0)
+        return;
+
+    void* view = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, m_file, 0);
+    if (view == MAP_FAILED){
+        close(m_file);
+        throw std::runtime_error("failed to map file: " + filepath);
+    }
+    // read front to back by the loaders
+    madvise(view, m_size, MADV_SEQUENTIAL);
+    m_data = static_cast<const unsigned char*>(view);
+}
+
+MappedFile::~MappedFile(){
+    if (m_data)
+        munmap(const_cast<unsigned char*>(m_data), m_size);
+    close(m_file);
+}
+
+#endif
+
+} // namespace hyd
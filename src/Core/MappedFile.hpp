@@ -0,0 +1,38 @@
+/*
+Read only memory mapping of a whole file, the pages are loaded by the OS on
+first access instead of being copied through a read buffer.
+*/
+#pragma once
+
+// std
+#include <cstddef>
+#include <string>
+
+namespace hyd
+{
+
+class MappedFile
+{
+public:
+    explicit MappedFile(const std::string& filepath);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile &operator=(const MappedFile&) = delete;
+
+    const unsigned char* data() const { return m_data; }
+    size_t size() const { return m_size; }
+
+private:
+    /* data */
+    const unsigned char* m_data{nullptr};
+    size_t m_size{0};
+#ifdef _WIN32
+    void* m_file{nullptr};
+    void* m_mapping{nullptr};
+#else
+    int m_file{-1};
+#endif
+};
+
+} // namespace hyd
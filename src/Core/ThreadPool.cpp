@@ -0,0 +1,117 @@
+#include "ThreadPool.hpp"
+
+// std
+#include <algorithm>
+#include <atomic>
+
+namespace hyd
+{
+
+namespace
+{
+    thread_local uint32_t t_threadIndex{0};
+}
+
+ThreadPool::ThreadPool(uint32_t threadCount)
+{
+    if (threadCount == 0){
+        uint32_t hardwareThreads = std::thread::hardware_concurrency();
+        threadCount = std::max(1u, hardwareThreads > 1 ? hardwareThreads - 1 : 1u);
+    }
+
+    m_workers.reserve(threadCount);
+    for (uint32_t i = 0; i < threadCount; i++){
+        m_workers.emplace_back([this, i](){ workerLoop(i + 1); });
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        m_stopping = true;
+    }
+    m_condition.notify_all();
+    for (auto& worker : m_workers){
+        worker.join();
+    }
+}
+
+void ThreadPool::enqueue(std::function<void()> task){
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        m_tasks.push_back(std::move(task));
+    }
+    m_condition.notify_one();
+}
+
+uint32_t ThreadPool::getThreadIndex(){
+    return t_threadIndex;
+}
+
+void ThreadPool::workerLoop(uint32_t threadIndex){
+    t_threadIndex = threadIndex;
+    while (true){
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock{m_mutex};
+            m_condition.wait(lock, [this](){ return m_stopping || !m_tasks.empty(); });
+            if (m_stopping && m_tasks.empty())
+                return;
+            task = std::move(m_tasks.front());
+            m_tasks.pop_front();
+        }
+        task();
+    }
+}
+
+void ThreadPool::parallelFor(uint32_t count, uint32_t chunkSize, const std::function<void(uint32_t, uint32_t)>& func){
+    if (count == 0)
+        return;
+
+    chunkSize = std::max(chunkSize, 1u);
+    const uint32_t chunkCount = (count + chunkSize - 1) / chunkSize;
+    if (chunkCount == 1){
+        func(0, count);
+        return;
+    }
+
+    // the helpers and the calling thread pull chunks until none is left
+    // the state is shared so that helpers queued behind long tasks (model loads) can start after
+    // the call returned, they find no chunk left and never touch func
+    struct SharedState
+    {
+        std::atomic<uint32_t> nextChunk{0};
+        std::mutex mutex;
+        std::condition_variable done;
+        uint32_t processedChunks{0};
+    };
+    auto state = std::make_shared<SharedState>();
+
+    auto processChunks = [state, funcPtr = &func, count, chunkSize, chunkCount](){
+        uint32_t processed = 0;
+        for (uint32_t chunk = state->nextChunk.fetch_add(1); chunk < chunkCount; chunk = state->nextChunk.fetch_add(1)){
+            uint32_t begin = chunk * chunkSize;
+            (*funcPtr)(begin, std::min(begin + chunkSize, count));
+            processed++;
+        }
+        if (processed == 0)
+            return;
+        std::lock_guard<std::mutex> lock{state->mutex};
+        state->processedChunks += processed;
+        if (state->processedChunks == chunkCount)
+            state->done.notify_one();
+    };
+
+    const uint32_t helperCount = std::min(getThreadCount(), chunkCount - 1);
+    for (uint32_t i = 0; i < helperCount; i++){
+        enqueue(processChunks);
+    }
+
+    processChunks();
+
+    std::unique_lock<std::mutex> lock{state->mutex};
+    state->done.wait(lock, [&state, chunkCount](){ return state->processedChunks == chunkCount; });
+}
+
+} // namespace hyd
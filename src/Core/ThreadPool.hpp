@@ -0,0 +1,64 @@
+/*
+Fixed set of worker threads shared by the engine systems.
+Tasks are either submitted one by one (submit) or split in chunks of a range
+that the calling thread helps to process (parallelFor).
+Each thread has an index, 0 for the threads outside the pool and 1 + i for the
+worker i, so that per-thread resources can be picked without locking.
+*/
+#pragma once
+
+// std
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace hyd
+{
+
+class ThreadPool
+{
+public:
+    // 0 uses one worker per hardware thread, minus the calling thread
+    explicit ThreadPool(uint32_t threadCount = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool &operator=(const ThreadPool&) = delete;
+
+    uint32_t getThreadCount() const { return static_cast<uint32_t>(m_workers.size()); }
+    // index of the calling thread, in [0, getThreadCount()]
+    static uint32_t getThreadIndex();
+
+    template<typename F>
+    auto submit(F&& task) -> std::future<std::invoke_result_t<std::decay_t<F>>> {
+        using Result = std::invoke_result_t<std::decay_t<F>>;
+        auto packaged = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(task));
+        std::future<Result> future = packaged->get_future();
+        enqueue([packaged](){ (*packaged)(); });
+        return future;
+    }
+
+    // calls func(begin, end) on chunks of [0, count), returns once every chunk is processed
+    // the calling thread processes the chunks no worker is free for
+    void parallelFor(uint32_t count, uint32_t chunkSize, const std::function<void(uint32_t, uint32_t)>& func);
+
+private:
+    void enqueue(std::function<void()> task);
+    void workerLoop(uint32_t threadIndex);
+
+    /* data */
+    std::vector<std::thread> m_workers;
+    std::deque<std::function<void()>> m_tasks;
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    bool m_stopping{false};
+};
+
+} // namespace hyd
@@ -19,18 +19,58 @@ MaterialManager::~MaterialManager(){
 }
 
 
+// the texture can still be the placeholder of a texture loading, updateTextures swaps it
 bool MaterialManager::loadRessource(const std::string& id){
     std::shared_ptr<Material> newRessource = std::make_shared<Material>();
     newRessource->m_textures = std::vector<std::shared_ptr<Texture>>({m_textureManager.getRessource(id)});
+    buildDescriptor(*newRessource);
+
+    m_ressources[id] = newRessource;
+    return true;
+}
+
+// every material has the same layout, a recycled set only needs its image written again
+void MaterialManager::buildDescriptor(Material& material){
+    auto imageInfo = material.m_textures[0]->getImageInfo();
+    if (!m_freeDescriptors.empty()){
+        material.m_descriptor = m_freeDescriptors.back();
+        m_freeDescriptors.pop_back();
+
+        VkWriteDescriptorSet write{};
+        write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write.dstSet = material.m_descriptor;
+        write.dstBinding = 0;
+        write.descriptorCount = 1;
+        write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        write.pImageInfo = &imageInfo;
+        vkUpdateDescriptorSets(m_device.device(), 1, &write, 0, nullptr);
+        return;
+    }
 
-    auto ptexture = m_textureManager.getRessource(id);
-    auto imageInfo = ptexture->getImageInfo();
     DescriptorBuilder(m_descriptorLayoutCache, m_descriptorAllocator)
         .bind_image(0, &imageInfo, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT)
-        .build(newRessource->m_descriptor);
+        .build(material.m_descriptor);
+}
 
-    m_ressources[id] = newRessource;
-    return true;
+// a new set is built rather than updating the old one, the frames in flight may still read it
+void MaterialManager::updateTextures(const std::vector<std::string>& textureIds){
+    m_frame++;
+    // the frames submitted before the set was replaced are complete
+    while (!m_retiredDescriptors.empty() && m_retiredDescriptors.front().frame + SwapChain::MAX_FRAMES_IN_FLIGHT <= m_frame){
+        m_freeDescriptors.push_back(m_retiredDescriptors.front().descriptor);
+        m_retiredDescriptors.pop_front();
+    }
+
+    for (const auto& id : textureIds){
+        auto it = m_ressources.find(id);
+        if (it == m_ressources.end())
+            continue;
+
+        Material& material = *it->second;
+        material.m_textures[0] = m_textureManager.getRessource(id);
+        m_retiredDescriptors.push_back({material.m_descriptor, m_frame});
+        buildDescriptor(material);
+    }
 }
 
 std::shared_ptr<Material> MaterialManager::getRessource(const std::string& id){
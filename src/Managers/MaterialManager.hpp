@@ -6,10 +6,15 @@
 #include "Renderer/Material.hpp"
 #include "Renderer/DescriptorSet.hpp"
 #include "Renderer/Device.hpp"
+#include "Renderer/SwapChain.hpp"
 
 // std
+#include <cstdint>
+#include <deque>
 #include <unordered_map>
 #include <memory>
+#include <string>
+#include <vector>
 
 namespace hyd
 {
@@ -28,7 +33,19 @@ public:
     std::shared_ptr<Material> getRessource(const std::string& id);
     std::shared_ptr<Material> loadAndGetRessource(const std::string& id);
 
+    // points the materials of the textures published by TextureManager::update to the real images
+    // to call once per frame, the replaced descriptors are recycled MAX_FRAMES_IN_FLIGHT calls later
+    void updateTextures(const std::vector<std::string>& textureIds);
+
 private:
+    void buildDescriptor(Material& material);
+
+    struct RetiredDescriptor
+    {
+        VkDescriptorSet descriptor;
+        uint64_t frame;
+    };
+
     /* data */
     Device& m_device;
     DescriptorLayoutCache& m_descriptorLayoutCache;
@@ -36,6 +53,12 @@ private:
     TextureManager& m_textureManager;
 
     std::unordered_map<std::string, std::shared_ptr<Material>> m_ressources;
+
+    // the sets replaced by updateTextures, the frames in flight may still read them
+    std::deque<RetiredDescriptor> m_retiredDescriptors;
+    // sets no frame reads anymore, rewritten by the next buildDescriptor
+    std::vector<VkDescriptorSet> m_freeDescriptors;
+    uint64_t m_frame{0};
 };
 
 } // namespace hyd
@@ -1,25 +1,44 @@
 #include "MeshManager.hpp"
 
+#include "Renderer/UploadContext.hpp"
+
+// std
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
 namespace hyd
 {
 
-MeshManager::MeshManager(Device& device)
-: m_device{device}
+MeshManager::MeshManager(Device& device, GeometryPool& geometryPool, ThreadPool& threadPool)
+: m_device{device}, m_geometryPool{geometryPool}, m_threadPool{threadPool}
 {}
 
+// the tasks point to the manager, let them finish
 MeshManager::~MeshManager(){
-
+    for (auto& task : m_tasks)
+        task.wait();
 }
 
 
 bool MeshManager::loadRessource(const std::string& id){
-    std::shared_ptr<Model> newRessource = Model::createModelFromFile(m_device, id);
-    m_ressources[id] = newRessource;
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        if (m_ressources.count(id) > 0)
+            return true;
+    }
+
+    std::shared_ptr<Model> newRessource = Model::createModelFromFile(m_device, m_geometryPool, id);
+
+    std::lock_guard<std::mutex> lock{m_mutex};
+    m_ressources.emplace(id, newRessource);
     return true;
 }
 
 std::shared_ptr<Model> MeshManager::getRessource(const std::string& id){
-    return m_ressources[id];
+    std::lock_guard<std::mutex> lock{m_mutex};
+    auto it = m_ressources.find(id);
+    return it != m_ressources.end() ? it->second : nullptr;
 }
 
 std::shared_ptr<Model> MeshManager::loadAndGetRessource(const std::string& id){
@@ -27,6 +46,80 @@ std::shared_ptr<Model> MeshManager::loadAndGetRessource(const std::string& id){
     return getRessource(id);
 }
 
+std::shared_ptr<Model> MeshManager::loadRessourceAsync(const std::string& id){
+    std::lock_guard<std::mutex> lock{m_mutex};
+    auto it = m_ressources.find(id);
+    if (it != m_ressources.end())
+        return it->second;
+
+    auto model = std::make_shared<Model>(m_device, m_geometryPool);
+    m_ressources.emplace(id, model);
+    m_loading.emplace(id, model);
+    m_tasks.push_back(m_threadPool.submit([this, id](){ parse(id); }));
+    return model;
+}
+
+// runs on a worker, only the CPU side of the load
+void MeshManager::parse(const std::string& id){
+    ParsedModel parsed{id, nullptr, nullptr, {}};
+    try {
+        parsed.meshFile = MeshFile::openCooked(id);
+        if (!parsed.meshFile){
+            parsed.builder = std::make_unique<Model::Builder>();
+            parsed.builder->loadModel(id, &m_threadPool);
+            parsed.builder->generateLods();
+        }
+    } catch (const std::exception& e) {
+        parsed.meshFile.reset();
+        parsed.builder.reset();
+        parsed.error = e.what();
+    }
+
+    std::lock_guard<std::mutex> lock{m_mutex};
+    m_parsed.push_back(std::move(parsed));
+}
+
+void MeshManager::update(){
+    std::vector<ParsedModel> parsed;
+    std::vector<std::shared_ptr<Model>> models;
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        if (m_parsed.empty())
+            return;
+        parsed.swap(m_parsed);
+
+        models.reserve(parsed.size());
+        for (auto& result : parsed){
+            auto it = m_loading.find(result.id);
+            models.push_back(it->second);
+            m_loading.erase(it);
+            // a failed model stays empty, its renderables are never drawn
+            if (!result.meshFile && !result.builder)
+                m_ressources.erase(result.id);
+        }
+
+        m_tasks.erase(std::remove_if(m_tasks.begin(), m_tasks.end(), [](const std::future<void>& task){
+            return task.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+        }), m_tasks.end());
+    }
+
+    // the geometry pool is only touched by this thread, every model parsed since the last call shares one submit
+    for (size_t i = 0; i < parsed.size(); i++){
+        if (parsed[i].meshFile)
+            models[i]->upload(*parsed[i].meshFile);
+        else if (parsed[i].builder)
+            models[i]->upload(*parsed[i].builder);
+        else
+            std::cerr << "failed to load " << parsed[i].id << ": " << parsed[i].error << std::endl;
+    }
+    m_device.uploadContext().submit();
+}
+
+uint32_t MeshManager::getLoadingCount() const{
+    std::lock_guard<std::mutex> lock{m_mutex};
+    return static_cast<uint32_t>(m_loading.size());
+}
+
 
 
 } // namespace hyd
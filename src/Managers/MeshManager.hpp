@@ -1,12 +1,19 @@
 #pragma once
 
 #include "iManager.hpp"
+#include "Core/ThreadPool.hpp"
 #include "Renderer/Model.hpp"
+#include "Renderer/MeshFile.hpp"
 #include "Renderer/Device.hpp"
+#include "Renderer/GeometryPool.hpp"
 
 // std
 #include <unordered_map>
 #include <memory>
+#include <future>
+#include <mutex>
+#include <string>
+#include <vector>
 
 namespace hyd
 {
@@ -14,18 +21,41 @@ namespace hyd
 class MeshManager : IManager<Model>
 {
 public:
-    MeshManager(Device& device);
+    MeshManager(Device& device, GeometryPool& geometryPool, ThreadPool& threadPool);
     ~MeshManager();
 
     bool loadRessource(const std::string& id);
     std::shared_ptr<Model> getRessource(const std::string& id);
     std::shared_ptr<Model> loadAndGetRessource(const std::string& id);
 
+    // parses the file (or maps its cooked file) on the thread pool and returns the model right away, empty until update uploads it
+    // a model already loaded or loading is returned as is
+    std::shared_ptr<Model> loadRessourceAsync(const std::string& id);
+    // uploads the models parsed since the last call in one batch, call it from the render thread
+    void update();
+    uint32_t getLoadingCount() const;
+
 private:
+    struct ParsedModel
+    {
+        std::string id;
+        std::unique_ptr<MeshFile> meshFile;      // the up to date cooked file, unmapped once uploaded
+        std::unique_ptr<Model::Builder> builder; // parsed when there is no cooked file
+        std::string error;
+    };
+
+    void parse(const std::string& id);
+
     /* data */
     Device& m_device;
+    GeometryPool& m_geometryPool;
+    ThreadPool& m_threadPool;
 
+    mutable std::mutex m_mutex;
     std::unordered_map<std::string, std::shared_ptr<Model>> m_ressources;
+    std::unordered_map<std::string, std::shared_ptr<Model>> m_loading;  // parsing, not uploaded yet
+    std::vector<ParsedModel> m_parsed;
+    std::vector<std::future<void>> m_tasks;
 };
 
 } // namespace hyd
@@ -1,25 +1,54 @@
 #include "TextureManager.hpp"
 
+#include "Renderer/UploadContext.hpp"
+
+// std
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <stdexcept>
+
 namespace hyd
 {
 
-TextureManager::TextureManager(Device& device)
-: m_device{device}
-{}
+TextureManager::TextureManager(Device& device, ThreadPool& threadPool)
+: m_device{device}, m_threadPool{threadPool}
+{
+    const uint32_t white = 0xffffffff;
+    m_placeholder = std::make_shared<Texture>(m_device, 1, 1, &white);
+    // the placeholder is sampled by the first frames
+    m_device.uploadContext().flush();
+}
 
+// the tasks point to the manager, let them finish
 TextureManager::~TextureManager(){
-
+    for (auto& task : m_tasks)
+        task.wait();
 }
 
 
 bool TextureManager::loadRessource(const std::string& id){
-    std::shared_ptr<Texture> newRessource = std::make_shared<Texture>(m_device, id);
+    DecodedImage decoded = readFile(id);
+    if (!decoded.image && !decoded.compressed)
+        throw std::runtime_error(decoded.error);
+
+    std::shared_ptr<Texture> newRessource = createTexture(decoded);
+    m_device.uploadContext().wait(newRessource->getUploadToken());
+
+    std::lock_guard<std::mutex> lock{m_mutex};
     m_ressources[id] = newRessource;
     return true;
 }
 
 std::shared_ptr<Texture> TextureManager::getRessource(const std::string& id){
-    return m_ressources[id];
+    std::lock_guard<std::mutex> lock{m_mutex};
+    auto it = m_ressources.find(id);
+    if (it != m_ressources.end())
+        return it->second;
+    return std::find(m_decoding.begin(), m_decoding.end(), id) != m_decoding.end() || m_uploading.count(id) > 0
+        ? m_placeholder
+        : nullptr;
 }
 
 std::shared_ptr<Texture> TextureManager::loadAndGetRessource(const std::string& id){
@@ -27,6 +56,104 @@ std::shared_ptr<Texture> TextureManager::loadAndGetRessource(const std::string&
     return getRessource(id);
 }
 
+void TextureManager::loadRessourceAsync(const std::string& id){
+    std::lock_guard<std::mutex> lock{m_mutex};
+    if (m_ressources.count(id) > 0 || m_uploading.count(id) > 0 ||
+        std::find(m_decoding.begin(), m_decoding.end(), id) != m_decoding.end())
+        return;
+
+    m_decoding.push_back(id);
+    m_tasks.push_back(m_threadPool.submit([this, id](){ decode(id); }));
+}
+
+TextureManager::DecodedImage TextureManager::readFile(const std::string& id){
+    DecodedImage decoded{id, nullptr, nullptr, {}};
+    try {
+        std::filesystem::path compressedPath{id};
+        const bool isKtx2 = compressedPath.extension() == ".ktx2";
+        compressedPath.replace_extension(".ktx2");
+
+        if (isKtx2 || std::filesystem::exists(compressedPath)){
+            auto compressed = std::make_unique<Ktx2Image>(compressedPath.string());
+            if (compressed->getLayerCount() == 1 && Texture::supportsFormat(m_device, compressed->getFormat()))
+                decoded.compressed = std::move(compressed);
+            else if (isKtx2)
+                throw std::runtime_error("the device can't sample the format of " + id);
+        }
+        if (!decoded.compressed)
+            decoded.image = std::make_unique<Image>(id);
+    } catch (const std::exception& e) {
+        decoded.error = e.what();
+    }
+    return decoded;
+}
+
+std::shared_ptr<Texture> TextureManager::createTexture(const DecodedImage& decoded){
+    if (decoded.compressed)
+        return std::make_shared<Texture>(m_device, *decoded.compressed);
+    return std::make_shared<Texture>(
+        m_device,
+        static_cast<uint32_t>(decoded.image->getWidth()),
+        static_cast<uint32_t>(decoded.image->getHeight()),
+        decoded.image->getData());
+}
+
+// runs on a worker, the images decode in parallel
+void TextureManager::decode(const std::string& id){
+    DecodedImage decoded = readFile(id);
+
+    std::lock_guard<std::mutex> lock{m_mutex};
+    m_decoded.push_back(std::move(decoded));
+}
+
+std::vector<std::string> TextureManager::update(){
+    std::vector<DecodedImage> decoded;
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        decoded.swap(m_decoded);
+        for (auto& result : decoded)
+            m_decoding.erase(std::find(m_decoding.begin(), m_decoding.end(), result.id));
+
+        m_tasks.erase(std::remove_if(m_tasks.begin(), m_tasks.end(), [](const std::future<void>& task){
+            return task.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+        }), m_tasks.end());
+    }
+
+    // every image decoded since the last call shares one submit
+    std::vector<std::pair<std::string, std::shared_ptr<Texture>>> created;
+    for (auto& result : decoded){
+        if (!result.image && !result.compressed){
+            std::cerr << "failed to load " << result.id << ": " << result.error << std::endl;
+            continue;
+        }
+        created.emplace_back(result.id, createTexture(result));
+    }
+    if (!created.empty())
+        m_device.uploadContext().submit();
+
+    std::lock_guard<std::mutex> lock{m_mutex};
+    for (auto& [id, texture] : created)
+        m_uploading.emplace(id, std::move(texture));
+
+    // the textures replace the placeholder once the graphics queue can sample them
+    std::vector<std::string> published;
+    for (auto it = m_uploading.begin(); it != m_uploading.end();){
+        if (!it->second->isResident()){
+            ++it;
+            continue;
+        }
+        m_ressources[it->first] = it->second;
+        published.push_back(it->first);
+        it = m_uploading.erase(it);
+    }
+    return published;
+}
+
+uint32_t TextureManager::getLoadingCount() const{
+    std::lock_guard<std::mutex> lock{m_mutex};
+    return static_cast<uint32_t>(m_decoding.size() + m_uploading.size());
+}
+
 
 
 } // namespace hyd
@@ -1,12 +1,19 @@
 #pragma once
 
 #include "iManager.hpp"
+#include "Core/ThreadPool.hpp"
 #include "Renderer/Texture.hpp"
 #include "Renderer/Device.hpp"
+#include "Ressources/Image.hpp"
+#include "Ressources/Ktx2.hpp"
 
 // std
 #include <unordered_map>
 #include <memory>
+#include <future>
+#include <mutex>
+#include <string>
+#include <vector>
 
 namespace hyd
 {
@@ -14,18 +21,53 @@ namespace hyd
 class TextureManager : IManager<Texture>
 {
 public:
-    TextureManager(Device& device);
+    TextureManager(Device& device, ThreadPool& threadPool);
     ~TextureManager();
 
+    // a KTX2 file next to the image (same name, .ktx2 extension) is loaded instead when the device
+    // can sample its format, the ids ending with .ktx2 are loaded as is
+
+    // blocks until the texture can be sampled
     bool loadRessource(const std::string& id);
     std::shared_ptr<Texture> getRessource(const std::string& id);
     std::shared_ptr<Texture> loadAndGetRessource(const std::string& id);
 
+    // decodes the image on the thread pool, getRessource returns the placeholder until it is resident
+    void loadRessourceAsync(const std::string& id);
+    // uploads the images decoded since the last call in one batch and publishes the resident ones
+    // returns the ids published by this call, call it from the render thread
+    std::vector<std::string> update();
+    uint32_t getLoadingCount() const;
+
+    // 1x1 white texture standing in for the textures still loading
+    std::shared_ptr<Texture> getPlaceholder() const { return m_placeholder; }
+
 private:
+    struct DecodedImage
+    {
+        std::string id;
+        std::unique_ptr<Image> image;           // one of the two, none when the load failed
+        std::unique_ptr<Ktx2Image> compressed;
+        std::string error;
+    };
+
+    // thread safe
+    DecodedImage readFile(const std::string& id);
+    std::shared_ptr<Texture> createTexture(const DecodedImage& decoded);
+    void decode(const std::string& id);
+
     /* data */
     Device& m_device;
+    ThreadPool& m_threadPool;
+
+    std::shared_ptr<Texture> m_placeholder;
 
+    mutable std::mutex m_mutex;
     std::unordered_map<std::string, std::shared_ptr<Texture>> m_ressources;
+    std::unordered_map<std::string, std::shared_ptr<Texture>> m_uploading; // waiting for their upload
+    std::vector<std::string> m_decoding;
+    std::vector<DecodedImage> m_decoded;
+    std::vector<std::future<void>> m_tasks;
 };
 
 } // namespace hyd
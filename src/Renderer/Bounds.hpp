@@ -0,0 +1,89 @@
+/*
+Bounding volumes used to cull, select LODs and fit the shadow frustum.
+An AABB is empty (min > max) until a point is added to it.
+*/
+#pragma once
+
+//libs
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+// std
+#include <limits>
+
+namespace hyd
+{
+
+struct AABB
+{
+    glm::vec3 min{std::numeric_limits<float>::max()};
+    glm::vec3 max{std::numeric_limits<float>::lowest()};
+
+    bool isEmpty() const { return min.x > max.x || min.y > max.y || min.z > max.z; }
+    glm::vec3 center() const { return (min + max) * 0.5f; }
+    glm::vec3 extent() const { return (max - min) * 0.5f; }
+
+    void expand(const glm::vec3& point){
+        min = glm::min(min, point);
+        max = glm::max(max, point);
+    }
+
+    void expand(const AABB& other){
+        if (other.isEmpty())
+            return;
+        min = glm::min(min, other.min);
+        max = glm::max(max, other.max);
+    }
+
+    // box enclosing the transformed box (Arvo), exact for the box's corners
+    AABB transformed(const glm::mat4& transform) const {
+        if (isEmpty())
+            return *this;
+
+        glm::vec3 worldCenter = transform * glm::vec4(center(), 1.f);
+        glm::vec3 halfExtent = extent();
+        glm::vec3 worldExtent{0.f};
+        for (int column = 0; column < 3; column++){
+            worldExtent += glm::abs(glm::vec3(transform[column])) * halfExtent[column];
+        }
+        return {worldCenter - worldExtent, worldCenter + worldExtent};
+    }
+};
+
+struct BoundingSphere
+{
+    glm::vec3 center{0.f};
+    float radius{0.f};
+
+    // xyz: center, w: radius, as stored in the GPU buffers
+    glm::vec4 asVec4() const { return glm::vec4(center, radius); }
+
+    // the radius grows with the largest axis scale of the transform
+    BoundingSphere transformed(const glm::mat4& transform) const {
+        float scale2 = glm::max(
+            glm::dot(glm::vec3(transform[0]), glm::vec3(transform[0])),
+            glm::max(glm::dot(glm::vec3(transform[1]), glm::vec3(transform[1])),
+                     glm::dot(glm::vec3(transform[2]), glm::vec3(transform[2]))));
+        return {glm::vec3(transform * glm::vec4(center, 1.f)), radius * glm::sqrt(scale2)};
+    }
+};
+
+// sphere centered on the box, enclosing every point of the range
+template<typename PositionIt, typename GetPosition>
+BoundingSphere computeBoundingSphere(const AABB& box, PositionIt first, PositionIt last, GetPosition getPosition){
+    BoundingSphere sphere{};
+    if (box.isEmpty())
+        return sphere;
+
+    sphere.center = box.center();
+    float radius2 = 0.f;
+    for (auto it = first; it != last; ++it){
+        glm::vec3 d = getPosition(*it) - sphere.center;
+        radius2 = glm::max(radius2, glm::dot(d, d));
+    }
+    sphere.radius = glm::sqrt(radius2);
+    return sphere;
+}
+
+} // namespace hyd
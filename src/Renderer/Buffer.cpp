@@ -49,7 +49,7 @@ Buffer::Buffer(
 Buffer::~Buffer() {
   unmap();
   vkDestroyBuffer(m_device.device(), m_buffer, nullptr);
-  vkFreeMemory(m_device.device(), m_memory, nullptr);
+  m_device.allocator().free(m_memory);
 }
 
 /**
@@ -59,23 +59,27 @@ Buffer::~Buffer() {
  * buffer range.
  * @param offset (Optional) Byte offset from beginning
  *
+ * @note Host visible memory blocks are persistently mapped by the allocator, this only points
+ * m_mapped inside the block's mapping
+ *
  * @return VkResult of the buffer mapping call
  */
 VkResult Buffer::map(VkDeviceSize size, VkDeviceSize offset) {
-  assert(m_buffer && m_memory && "Called map on buffer before create");
-  return vkMapMemory(m_device.device(), m_memory, offset, size, 0, &m_mapped);
+  assert(m_buffer && m_memory.memory && "Called map on buffer before create");
+  if (m_memory.mapped == nullptr) {
+    return VK_ERROR_MEMORY_MAP_FAILED;
+  }
+  m_mapped = static_cast<char *>(m_memory.mapped) + offset;
+  return VK_SUCCESS;
 }
 
 /**
  * Unmap a mapped memory range
  *
- * @note Does not return a result as vkUnmapMemory can't fail
+ * @note The memory block stays mapped until it is freed
  */
 void Buffer::unmap() {
-  if (m_mapped) {
-    vkUnmapMemory(m_device.device(), m_memory);
-    m_mapped = nullptr;
-  }
+  m_mapped = nullptr;
 }
 
 /**
@@ -111,12 +115,7 @@ void Buffer::writeToBuffer(void *data, VkDeviceSize size, VkDeviceSize offset) {
  * @return VkResult of the flush call
  */
 VkResult Buffer::flush(VkDeviceSize size, VkDeviceSize offset) {
-  VkMappedMemoryRange mappedRange = {};
-  mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-  mappedRange.memory = m_memory;
-  mappedRange.offset = offset;
-  mappedRange.size = size;
-  return vkFlushMappedMemoryRanges(m_device.device(), 1, &mappedRange);
+  return m_device.allocator().flush(m_memory, offset, size);
 }
 
 /**
@@ -131,12 +130,7 @@ VkResult Buffer::flush(VkDeviceSize size, VkDeviceSize offset) {
  * @return VkResult of the invalidate call
  */
 VkResult Buffer::invalidate(VkDeviceSize size, VkDeviceSize offset) {
-  VkMappedMemoryRange mappedRange = {};
-  mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-  mappedRange.memory = m_memory;
-  mappedRange.offset = offset;
-  mappedRange.size = size;
-  return vkInvalidateMappedMemoryRanges(m_device.device(), 1, &mappedRange);
+  return m_device.allocator().invalidate(m_memory, offset, size);
 }
 
 /**
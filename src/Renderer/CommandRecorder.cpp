@@ -0,0 +1,153 @@
+#include "CommandRecorder.hpp"
+
+#include "SwapChain.hpp"
+#include "Core/ThreadPool.hpp"
+
+// std
+#include <cassert>
+#include <stdexcept>
+
+namespace hyd
+{
+
+namespace
+{
+
+VkCommandPool createPool(Device& device, VkCommandPoolCreateFlags flags){
+    QueueFamilyIndices queueFamilyIndices = device.findPhysicalQueueFamilies();
+
+    VkCommandPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily;
+    // the pools are reset as a whole, no command buffer is reset alone
+    poolInfo.flags = flags;
+
+    VkCommandPool pool;
+    if (vkCreateCommandPool(device.device(), &poolInfo, nullptr, &pool) != VK_SUCCESS){
+        throw std::runtime_error("failed to create secondary command pool!");
+    }
+    return pool;
+}
+
+VkCommandBuffer allocateSecondary(Device& device, VkCommandPool pool){
+    VkCommandBufferAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+    allocInfo.commandPool = pool;
+    allocInfo.commandBufferCount = 1;
+
+    VkCommandBuffer commandBuffer;
+    if (vkAllocateCommandBuffers(device.device(), &allocInfo, &commandBuffer) != VK_SUCCESS){
+        throw std::runtime_error("failed to allocate secondary command buffer!");
+    }
+    return commandBuffer;
+}
+
+void beginSecondary(VkCommandBuffer commandBuffer, VkCommandBufferUsageFlags flags,
+    VkRenderPass renderPass, VkFramebuffer framebuffer, VkExtent2D extent){
+    VkCommandBufferInheritanceInfo inheritanceInfo{};
+    inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+    inheritanceInfo.renderPass = renderPass;
+    inheritanceInfo.subpass = 0;
+    inheritanceInfo.framebuffer = framebuffer;
+
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | flags;
+    beginInfo.pInheritanceInfo = &inheritanceInfo;
+
+    if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS){
+        throw std::runtime_error("failed to begin recording secondary command buffer");
+    }
+
+    VkViewport viewport{};
+    viewport.x = 0.0f;
+    viewport.y = 0.0f;
+    viewport.width = static_cast<float>(extent.width);
+    viewport.height = static_cast<float>(extent.height);
+    viewport.minDepth = 0.0f;
+    viewport.maxDepth = 1.0f;
+    VkRect2D scissor{{0, 0}, extent};
+    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+}
+
+} // namespace
+
+CommandRecorder::CommandRecorder(Device& device, uint32_t threadCount)
+: m_device{device}
+{
+    m_frames.resize(SwapChain::MAX_FRAMES_IN_FLIGHT);
+    for (auto& threads : m_frames){
+        threads.resize(threadCount);
+        for (auto& commands : threads)
+            commands.pool = createPool(m_device, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
+    }
+}
+
+CommandRecorder::~CommandRecorder(){
+    // destroying the pools frees the command buffers
+    for (auto& threads : m_frames){
+        for (auto& commands : threads)
+            vkDestroyCommandPool(m_device.device(), commands.pool, nullptr);
+    }
+}
+
+void CommandRecorder::beginFrame(int frameIndex){
+    m_frameIndex = frameIndex;
+    for (auto& commands : m_frames[frameIndex]){
+        if (commands.usedCount == 0)
+            continue;
+        vkResetCommandPool(m_device.device(), commands.pool, 0);
+        commands.usedCount = 0;
+    }
+}
+
+VkCommandBuffer CommandRecorder::acquire(ThreadCommands& commands){
+    if (commands.usedCount == commands.commandBuffers.size())
+        commands.commandBuffers.push_back(allocateSecondary(m_device, commands.pool));
+    return commands.commandBuffers[commands.usedCount++];
+}
+
+VkCommandBuffer CommandRecorder::begin(VkRenderPass renderPass, VkFramebuffer framebuffer, VkExtent2D extent){
+    const uint32_t threadIndex = ThreadPool::getThreadIndex();
+    assert(threadIndex < m_frames[m_frameIndex].size() && "the recorder has no pool for this thread");
+    VkCommandBuffer commandBuffer = acquire(m_frames[m_frameIndex][threadIndex]);
+    beginSecondary(commandBuffer, VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT, renderPass, framebuffer, extent);
+    return commandBuffer;
+}
+
+void CommandRecorder::end(VkCommandBuffer commandBuffer){
+    if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS){
+        throw std::runtime_error("failed to record secondary command buffer!");
+    }
+}
+
+CachedCommandBuffer::CachedCommandBuffer(Device& device)
+: m_device{device}
+{
+    m_pool = createPool(m_device, 0);
+    m_commandBuffer = allocateSecondary(m_device, m_pool);
+}
+
+CachedCommandBuffer::~CachedCommandBuffer(){
+    vkDestroyCommandPool(m_device.device(), m_pool, nullptr);
+}
+
+VkCommandBuffer CachedCommandBuffer::begin(VkRenderPass renderPass, VkExtent2D extent){
+    m_recorded = false;
+    vkResetCommandPool(m_device.device(), m_pool, 0);
+    // executed in several frames, but never twice at once
+    beginSecondary(m_commandBuffer, 0, renderPass, VK_NULL_HANDLE, extent);
+    return m_commandBuffer;
+}
+
+void CachedCommandBuffer::end(uint64_t version){
+    if (vkEndCommandBuffer(m_commandBuffer) != VK_SUCCESS){
+        throw std::runtime_error("failed to record secondary command buffer!");
+    }
+    m_version = version;
+    m_recorded = true;
+}
+
+} // namespace hyd
@@ -0,0 +1,89 @@
+/*
+Secondary command buffers recorded on several threads. Each thread of the
+thread pool has a command pool per frame in flight, so the threads record
+without locking. The pools of a frame are reset at once when the frame starts
+again, its previous submission has completed by then, and their command
+buffers are reused from one frame to the next.
+A secondary continues a render pass: it is begun for subpass 0 of the render
+pass and framebuffer it will be executed in, and gets the viewport and the
+scissor, the dynamic state isn't inherited from the primary command buffer.
+The cached command buffers hold the draws that don't change between frames,
+they are recorded again only when the version of what they reference changes.
+*/
+#pragma once
+
+#include "Device.hpp"
+
+#include <vulkan/vulkan.h>
+
+// std
+#include <cstdint>
+#include <vector>
+
+namespace hyd
+{
+
+class CommandRecorder
+{
+public:
+    // threadCount pools per frame, the calling threads are identified by ThreadPool::getThreadIndex
+    CommandRecorder(Device& device, uint32_t threadCount);
+    ~CommandRecorder();
+
+    CommandRecorder(const CommandRecorder&) = delete;
+    CommandRecorder &operator=(const CommandRecorder&) = delete;
+
+    // resets the pools of the frame, the command buffers it recorded last time must have executed
+    void beginFrame(int frameIndex);
+
+    // begins a secondary command buffer of the calling thread, for the subpass 0 of renderPass
+    // the viewport and the scissor cover extent
+    VkCommandBuffer begin(VkRenderPass renderPass, VkFramebuffer framebuffer, VkExtent2D extent);
+    void end(VkCommandBuffer commandBuffer);
+
+private:
+    struct ThreadCommands
+    {
+        VkCommandPool pool{VK_NULL_HANDLE};
+        std::vector<VkCommandBuffer> commandBuffers;
+        // command buffers of the pool recorded this frame
+        uint32_t usedCount{0};
+    };
+
+    VkCommandBuffer acquire(ThreadCommands& commands);
+
+    /* data */
+    Device& m_device;
+    // [frame][thread]
+    std::vector<std::vector<ThreadCommands>> m_frames;
+    int m_frameIndex{0};
+};
+
+// a secondary command buffer executed every frame until it is recorded again, with a pool of its own so that
+// any thread can record it; one per frame in flight, it must not be pending when it is recorded
+class CachedCommandBuffer
+{
+public:
+    CachedCommandBuffer(Device& device);
+    ~CachedCommandBuffer();
+
+    CachedCommandBuffer(const CachedCommandBuffer&) = delete;
+    CachedCommandBuffer &operator=(const CachedCommandBuffer&) = delete;
+
+    bool isRecorded(uint64_t version) const { return m_recorded && m_version == version; }
+    VkCommandBuffer getCommandBuffer() const { return m_commandBuffer; }
+
+    // the framebuffer is left to the execution, the commands are reused with every image of the swap chain
+    VkCommandBuffer begin(VkRenderPass renderPass, VkExtent2D extent);
+    void end(uint64_t version);
+
+private:
+    /* data */
+    Device& m_device;
+    VkCommandPool m_pool{VK_NULL_HANDLE};
+    VkCommandBuffer m_commandBuffer{VK_NULL_HANDLE};
+    uint64_t m_version{0};
+    bool m_recorded{false};
+};
+
+} // namespace hyd
@@ -11,15 +11,19 @@ the creation of a window surface
 #pragma once
 
 #include "Core/Window.hpp"
+#include "MemoryAllocator.hpp"
 
 #include <vulkan/vulkan.h>
 // std lib headers
+#include <memory>
 #include <string>
 #include <vector>
 
 namespace hyd
 {
 
+  class UploadContext;
+
   struct SwapChainSupportDetails
   {
     VkSurfaceCapabilitiesKHR capabilities;
@@ -31,11 +35,22 @@ namespace hyd
   {
     uint32_t graphicsFamily;
     uint32_t presentFamily;
+    uint32_t transferFamily; // transfer only family, the copy engine of discrete GPUs
     bool graphicsFamilyHasValue = false;
     bool presentFamilyHasValue = false;
+    bool transferFamilyHasValue = false;
     bool isComplete() { return graphicsFamilyHasValue && presentFamilyHasValue; }
   };
 
+  // optional device features, only true when supported and enabled
+  struct DeviceFeatures
+  {
+    bool drawIndirectFirstInstance = false;
+    bool multiDrawIndirect = false;
+    bool drawIndirectCount = false; // Vulkan 1.2 core
+    bool textureCompressionBC = false;
+  };
+
 class Device
 {
   public:
@@ -59,34 +74,35 @@ class Device
     VkSurfaceKHR surface() { return m_surface_; }
     VkQueue graphicsQueue() { return m_graphicsQueue_; }
     VkQueue presentQueue() { return m_presentQueue_; }
+    // the graphics queue when the device has no transfer only family
+    VkQueue transferQueue() { return m_transferQueue_; }
+    bool hasDedicatedTransferQueue() const { return m_transferQueue_ != m_graphicsQueue_; }
+    const DeviceFeatures& enabledFeatures() const { return m_enabledFeatures; }
+    MemoryAllocator& allocator() { return *m_allocator; }
+    // batched transfers of the loads
+    UploadContext& uploadContext() { return *m_uploadContext; }
 
     SwapChainSupportDetails getSwapChainSupport() { return querySwapChainSupport(m_physicalDevice); }
-    uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
     QueueFamilyIndices findPhysicalQueueFamilies() { return findQueueFamilies(m_physicalDevice); }
     VkFormat findSupportedFormat(
         const std::vector<VkFormat> &candidates, VkImageTiling tiling, VkFormatFeatureFlags features);
+    VkFormatProperties getFormatProperties(VkFormat format);
 
     // Buffer Helper Functions
+    // the memory comes from the allocator, release it with allocator().free()
     void createBuffer(
         VkDeviceSize size,
         VkBufferUsageFlags usage,
         VkMemoryPropertyFlags properties,
         VkBuffer &buffer,
-        VkDeviceMemory &bufferMemory);
-    VkCommandBuffer beginSingleTimeCommands();
-    void endSingleTimeCommands(VkCommandBuffer commandBuffer);
-    void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
-    void copyBufferToImage(
-        VkBuffer buffer, VkImage image, uint32_t width, uint32_t height, uint32_t layerCount);
-
+        MemoryAllocation &bufferMemory);
     void createImageWithInfo(
         const VkImageCreateInfo &imageInfo,
         VkMemoryPropertyFlags properties,
         VkImage &image,
-        VkDeviceMemory &imageMemory);
+        MemoryAllocation &imageMemory);
     
-    VkImageView createImageView(VkImage image, VkFormat format);
-    void transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, int layerCount=1);
+    VkImageView createImageView(VkImage image, VkFormat format, uint32_t mipLevels = 1);
 
 
     VkPhysicalDeviceProperties properties;
@@ -119,6 +135,11 @@ class Device
     VkSurfaceKHR m_surface_;
     VkQueue m_graphicsQueue_;
     VkQueue m_presentQueue_;
+    VkQueue m_transferQueue_;
+
+    DeviceFeatures m_enabledFeatures;
+    std::unique_ptr<MemoryAllocator> m_allocator;
+    std::unique_ptr<UploadContext> m_uploadContext;
 
     const std::vector<const char *> m_validationLayers = {"VK_LAYER_KHRONOS_validation"};
     const std::vector<const char *> m_deviceExtensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
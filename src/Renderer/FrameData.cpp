@@ -0,0 +1,76 @@
+#include "FrameData.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+
+namespace hyd
+{
+
+FrameData::FrameData(Device& device, VkDeviceSize range)
+: m_device{device}, m_range{range}
+{
+    const VkDeviceSize minAlignment = m_device.properties.limits.minUniformBufferOffsetAlignment;
+    m_alignment = std::max<VkDeviceSize>(minAlignment, 16);
+    assert(m_range <= m_device.properties.limits.maxUniformBufferRange && "uniform range above the device limit");
+
+    for (auto& ring : m_rings){
+        ring = std::make_unique<Buffer>(
+            m_device,
+            RING_SIZE,
+            1,
+            VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        ring->map();
+    }
+
+    m_pool =
+    DescriptorPool::Builder(m_device)
+        .setMaxSets(SwapChain::MAX_FRAMES_IN_FLIGHT)
+        .addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, SwapChain::MAX_FRAMES_IN_FLIGHT)
+        .build();
+
+    m_setLayout =
+        DescriptorSetLayout::Builder(m_device)
+            .addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT)
+            .build();
+
+    for (int i = 0; i < m_descriptorSets.size(); i++){
+        auto bufferInfo = descriptorInfo(i);
+        DescriptorWriter(*m_setLayout, *m_pool)
+            .writeBuffer(0, &bufferInfo)
+            .build(m_descriptorSets[i]);
+    }
+}
+
+FrameData::~FrameData(){}
+
+void FrameData::beginFrame(int frameIndex){
+    m_frameIndex = frameIndex;
+    m_head.store(0);
+}
+
+FrameData::Allocation FrameData::allocate(VkDeviceSize size){
+    const VkDeviceSize alignedSize = (size + m_alignment - 1) / m_alignment * m_alignment;
+    const VkDeviceSize offset = m_head.fetch_add(alignedSize);
+    // the descriptors read m_range bytes from the offset
+    if (offset + std::max(size, m_range) > RING_SIZE){
+        throw std::runtime_error("frame data ring is full!");
+    }
+
+    Allocation allocation;
+    allocation.data = static_cast<uint8_t*>(m_rings[m_frameIndex]->getMappedMemory()) + offset;
+    allocation.offset = static_cast<uint32_t>(offset);
+    return allocation;
+}
+
+VkDescriptorBufferInfo FrameData::descriptorInfo(int frameIndex) const {
+    VkDescriptorBufferInfo bufferInfo{};
+    bufferInfo.buffer = m_rings[frameIndex]->getBuffer();
+    bufferInfo.offset = 0;
+    bufferInfo.range = m_range;
+    return bufferInfo;
+}
+
+} // namespace hyd
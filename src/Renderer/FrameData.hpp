@@ -0,0 +1,82 @@
+/*
+The frame data holds the transient uniform data of the frames: one persistently
+mapped uniform buffer per frame in flight, used as a ring the systems bump
+allocate from. The ring of a frame is rewound when the frame starts again, its
+previous submission has completed by then, so nothing is written while the GPU
+may still read it. The data is bound with a VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC
+descriptor and the offset of the allocation: a single set per frame covers
+every allocation. The memory is coherent, there is nothing to flush.
+The allocations are lock free, any thread can allocate.
+*/
+#pragma once
+
+#include "Device.hpp"
+#include "Buffer.hpp"
+#include "DescriptorSet.hpp"
+#include "SwapChain.hpp"
+
+#include <vulkan/vulkan.h>
+
+// std
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+namespace hyd
+{
+
+class FrameData
+{
+public:
+    static constexpr VkDeviceSize RING_SIZE = 256 << 10;
+
+    struct Allocation
+    {
+        void* data{nullptr};
+        // dynamic offset of the allocation
+        uint32_t offset{0};
+    };
+
+    // range is the size of the largest uniform block read through the dynamic descriptors
+    FrameData(Device& device, VkDeviceSize range);
+    ~FrameData();
+
+    FrameData(const FrameData&) = delete;
+    FrameData &operator=(const FrameData&) = delete;
+
+    // rewinds the frame's ring, its previous submission must have completed
+    void beginFrame(int frameIndex);
+
+    Allocation allocate(VkDeviceSize size);
+    // copies value in the frame's ring, returns its dynamic offset
+    template<typename T>
+    uint32_t push(const T& value){
+        Allocation allocation = allocate(sizeof(T));
+        std::memcpy(allocation.data, &value, sizeof(T));
+        return allocation.offset;
+    }
+
+    // set 0 of the pipelines only reading the uniform data: binding 0, dynamic uniform buffer
+    VkDescriptorSetLayout getSetLayout() const { return m_setLayout->getDescriptorSetLayout(); }
+    VkDescriptorSet getDescriptorSet(int frameIndex) const { return m_descriptorSets[frameIndex]; }
+    // for the systems binding the ring in sets of their own, as a dynamic uniform buffer
+    VkDescriptorBufferInfo descriptorInfo(int frameIndex) const;
+
+private:
+    /* data */
+    Device& m_device;
+    VkDeviceSize m_range;
+    VkDeviceSize m_alignment;
+
+    std::vector<std::unique_ptr<Buffer>> m_rings = std::vector<std::unique_ptr<Buffer>>(SwapChain::MAX_FRAMES_IN_FLIGHT);
+    std::unique_ptr<DescriptorPool> m_pool;
+    std::unique_ptr<DescriptorSetLayout> m_setLayout;
+    std::vector<VkDescriptorSet> m_descriptorSets = std::vector<VkDescriptorSet>(SwapChain::MAX_FRAMES_IN_FLIGHT);
+
+    int m_frameIndex{0};
+    std::atomic<VkDeviceSize> m_head{0};
+};
+
+} // namespace hyd
@@ -12,6 +12,8 @@ namespace hyd {
         float frameTime;
         VkCommandBuffer commandBuffer;
         VkDescriptorSet globalDescriptorSet;
+        // dynamic offset of the camera's GlobalUbo in the global set
+        uint32_t globalUboOffset;
     };
     
 } // namespace hyd
\ No newline at end of file
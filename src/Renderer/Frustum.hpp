@@ -0,0 +1,55 @@
+/*
+Frustum planes extracted from a view projection matrix (Gribb & Hartmann),
+for a [0, 1] clip space depth range (GLM_FORCE_DEPTH_ZERO_TO_ONE).
+The plane normals point inside the frustum.
+*/
+#pragma once
+
+//libs
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+// std
+#include <array>
+
+namespace hyd
+{
+
+struct Frustum
+{
+    enum Plane { Left = 0, Right, Bottom, Top, Near, Far, Count };
+
+    // xyz: normal, w: distance
+    std::array<glm::vec4, Plane::Count> planes{};
+
+    static Frustum fromMatrix(const glm::mat4& viewProjection){
+        // glm is column major, row i is (m[0][i], m[1][i], m[2][i], m[3][i])
+        auto row = [&viewProjection](int i){
+            return glm::vec4{viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]};
+        };
+
+        Frustum frustum{};
+        frustum.planes[Left]   = row(3) + row(0);
+        frustum.planes[Right]  = row(3) - row(0);
+        frustum.planes[Bottom] = row(3) + row(1);
+        frustum.planes[Top]    = row(3) - row(1);
+        frustum.planes[Near]   = row(2);
+        frustum.planes[Far]    = row(3) - row(2);
+
+        for (auto& plane : frustum.planes){
+            plane /= glm::length(glm::vec3(plane));
+        }
+        return frustum;
+    }
+
+    bool intersectsSphere(const glm::vec3& center, float radius) const {
+        for (const auto& plane : planes){
+            if (glm::dot(glm::vec3(plane), center) + plane.w < -radius)
+                return false;
+        }
+        return true;
+    }
+};
+
+} // namespace hyd
@@ -0,0 +1,175 @@
+#include "GeometryPool.hpp"
+#include "UploadContext.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <iterator>
+#include <stdexcept>
+
+namespace hyd
+{
+
+GeometryPool::RangeAllocator::RangeAllocator(uint32_t capacity){
+    if (capacity > 0)
+        m_freeRanges.emplace(0, capacity);
+}
+
+bool GeometryPool::RangeAllocator::allocate(uint32_t size, uint32_t& offset){
+    if (size == 0){
+        offset = 0;
+        return true;
+    }
+
+    for (auto it = m_freeRanges.begin(); it != m_freeRanges.end(); ++it){
+        if (it->second < size)
+            continue;
+
+        offset = it->first;
+        uint32_t remaining = it->second - size;
+        m_freeRanges.erase(it);
+        if (remaining > 0)
+            m_freeRanges.emplace(offset + size, remaining);
+        return true;
+    }
+    return false;
+}
+
+void GeometryPool::RangeAllocator::free(uint32_t offset, uint32_t size){
+    if (size == 0)
+        return;
+
+    auto next = m_freeRanges.lower_bound(offset);
+    assert((next == m_freeRanges.end() || offset + size <= next->first) && "range freed twice");
+
+    // merge with the following range
+    if (next != m_freeRanges.end() && offset + size == next->first){
+        size += next->second;
+        next = m_freeRanges.erase(next);
+    }
+
+    // merge with the previous range
+    if (next != m_freeRanges.begin()){
+        auto previous = std::prev(next);
+        if (previous->first + previous->second == offset){
+            previous->second += size;
+            return;
+        }
+    }
+    m_freeRanges.emplace(offset, size);
+}
+
+GeometryPool::GeometryPool(Device& device, VkDeviceSize vertexStride, VkDeviceSize positionStride, uint32_t pageVertexCount, uint32_t pageIndexCount)
+: m_device{device}, m_vertexStride{vertexStride}, m_positionStride{positionStride}, m_pageVertexCount{pageVertexCount}, m_pageIndexCount{pageIndexCount}
+{}
+
+GeometryPool::~GeometryPool(){}
+
+VkDeviceSize GeometryPool::indexSize(VkIndexType indexType){
+    return indexType == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t);
+}
+
+void GeometryPool::createPage(uint32_t vertexCount, uint32_t indexCount, VkIndexType indexType){
+    auto page = std::make_unique<Page>(Page{
+        std::make_unique<Buffer>(
+            m_device,
+            m_vertexStride,
+            vertexCount,
+            VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT),
+        std::make_unique<Buffer>(
+            m_device,
+            indexSize(indexType),
+            indexCount,
+            VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT),
+        m_positionStride > 0 ? std::make_unique<Buffer>(
+            m_device,
+            m_positionStride,
+            vertexCount,
+            VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) : nullptr,
+        RangeAllocator{vertexCount},
+        RangeAllocator{indexCount},
+        indexType});
+    m_pages.push_back(std::move(page));
+}
+
+GeometryAllocation GeometryPool::allocate(uint32_t vertexCount, uint32_t indexCount, VkIndexType indexType){
+    GeometryAllocation allocation{};
+    allocation.vertexCount = vertexCount;
+    allocation.indexCount = indexCount;
+
+    for (uint32_t i = 0; i < m_pages.size(); i++){
+        Page& page = *m_pages[i];
+        if (page.indexType != indexType)
+            continue;
+        if (!page.vertexRanges.allocate(vertexCount, allocation.vertexOffset))
+            continue;
+        if (!page.indexRanges.allocate(indexCount, allocation.firstIndex)){
+            page.vertexRanges.free(allocation.vertexOffset, vertexCount);
+            continue;
+        }
+        allocation.page = i;
+        return allocation;
+    }
+
+    // meshes bigger than a page get a page of their own size
+    createPage(std::max(vertexCount, m_pageVertexCount), std::max(indexCount, m_pageIndexCount), indexType);
+    allocation.page = static_cast<uint32_t>(m_pages.size() - 1);
+    Page& page = *m_pages.back();
+    if (!page.vertexRanges.allocate(vertexCount, allocation.vertexOffset) ||
+        !page.indexRanges.allocate(indexCount, allocation.firstIndex)){
+        throw std::runtime_error("failed to allocate geometry in a new page");
+    }
+    return allocation;
+}
+
+void GeometryPool::free(const GeometryAllocation& allocation){
+    assert(allocation.page < m_pages.size() && "freeing an allocation of another pool");
+    Page& page = *m_pages[allocation.page];
+    page.vertexRanges.free(allocation.vertexOffset, allocation.vertexCount);
+    page.indexRanges.free(allocation.firstIndex, allocation.indexCount);
+}
+
+void GeometryPool::upload(const GeometryAllocation& allocation, const void* vertices, const void* indices, const void* positions){
+    Page& page = *m_pages[allocation.page];
+    UploadContext& uploadContext = m_device.uploadContext();
+
+    uploadContext.uploadBuffer(
+        page.vertexBuffer->getBuffer(),
+        allocation.vertexOffset * m_vertexStride,
+        vertices,
+        allocation.vertexCount * m_vertexStride);
+    uploadContext.uploadBuffer(
+        page.indexBuffer->getBuffer(),
+        allocation.firstIndex * indexSize(page.indexType),
+        indices,
+        allocation.indexCount * indexSize(page.indexType));
+
+    if (page.positionBuffer){
+        assert(positions != nullptr && "the pool keeps a position stream, the positions must be uploaded");
+        uploadContext.uploadBuffer(
+            page.positionBuffer->getBuffer(),
+            allocation.vertexOffset * m_positionStride,
+            positions,
+            allocation.vertexCount * m_positionStride);
+    }
+}
+
+void GeometryPool::bind(VkCommandBuffer commandBuffer, uint32_t page){
+    VkBuffer buffers[] = {m_pages[page]->vertexBuffer->getBuffer()};
+    VkDeviceSize offsets[] = {0};
+    vkCmdBindVertexBuffers(commandBuffer, 0, 1, buffers, offsets);
+    vkCmdBindIndexBuffer(commandBuffer, m_pages[page]->indexBuffer->getBuffer(), 0, m_pages[page]->indexType);
+}
+
+void GeometryPool::bindPositions(VkCommandBuffer commandBuffer, uint32_t page){
+    assert(m_pages[page]->positionBuffer && "the pool was created without position stream");
+    VkBuffer buffers[] = {m_pages[page]->positionBuffer->getBuffer()};
+    VkDeviceSize offsets[] = {0};
+    vkCmdBindVertexBuffers(commandBuffer, 0, 1, buffers, offsets);
+    vkCmdBindIndexBuffer(commandBuffer, m_pages[page]->indexBuffer->getBuffer(), 0, m_pages[page]->indexType);
+}
+
+} // namespace hyd
@@ -0,0 +1,107 @@
+/*
+The geometry pool owns a few large device local vertex and index buffers (pages)
+and hands out ranges of them to the models, so that meshes sharing a page are
+drawn with firstIndex / vertexOffset without rebinding buffers.
+Freed ranges go back to a first-fit free list that merges adjacent ranges.
+A page holds either 16 or 32 bits indices, the index type is bound with the page.
+A pool created with a position stride also keeps a copy of the positions alone
+at the same vertex offsets, the depth only passes fetch that one.
+*/
+#pragma once
+
+#include "Device.hpp"
+#include "Buffer.hpp"
+
+// std
+#include <map>
+#include <memory>
+#include <vector>
+
+namespace hyd
+{
+
+// a range of the pool, offsets and counts are in vertices / indices
+struct GeometryAllocation
+{
+    uint32_t page{0};
+    uint32_t vertexOffset{0};
+    uint32_t vertexCount{0};
+    uint32_t firstIndex{0};
+    uint32_t indexCount{0};
+};
+
+class GeometryPool
+{
+public:
+    static constexpr uint32_t DEFAULT_PAGE_VERTEX_COUNT = 1 << 20;
+    static constexpr uint32_t DEFAULT_PAGE_INDEX_COUNT = 1 << 22;
+    static constexpr uint32_t INVALID_PAGE = ~0u;
+
+    // positionStride 0: no position stream
+    GeometryPool(
+        Device& device,
+        VkDeviceSize vertexStride,
+        VkDeviceSize positionStride = 0,
+        uint32_t pageVertexCount = DEFAULT_PAGE_VERTEX_COUNT,
+        uint32_t pageIndexCount = DEFAULT_PAGE_INDEX_COUNT);
+    ~GeometryPool();
+
+    GeometryPool(const GeometryPool&) = delete;
+    GeometryPool &operator=(const GeometryPool&) = delete;
+
+    // a new page is created when no page of the index type has room for both ranges
+    GeometryAllocation allocate(uint32_t vertexCount, uint32_t indexCount, VkIndexType indexType = VK_INDEX_TYPE_UINT32);
+    // the range is reusable right away, the caller makes sure the GPU no longer reads it
+    void free(const GeometryAllocation& allocation);
+
+    // records the copies in the device's upload context, the data lands with its next submit
+    // the indices are of the index type of the allocation's page, the positions are required with a position stream
+    void upload(const GeometryAllocation& allocation, const void* vertices, const void* indices, const void* positions = nullptr);
+
+    void bind(VkCommandBuffer commandBuffer, uint32_t page);
+    // binds the position stream in place of the vertices, with the page's indices
+    void bindPositions(VkCommandBuffer commandBuffer, uint32_t page);
+
+    VkDeviceSize getVertexStride() const { return m_vertexStride; }
+    bool hasPositionStream() const { return m_positionStride > 0; }
+    VkIndexType getIndexType(uint32_t page) const { return m_pages[page]->indexType; }
+    uint32_t getPageCount() const { return static_cast<uint32_t>(m_pages.size()); }
+
+private:
+    // first-fit free list of [offset, offset + size) ranges, keyed by offset
+    class RangeAllocator
+    {
+    public:
+        explicit RangeAllocator(uint32_t capacity);
+
+        bool allocate(uint32_t size, uint32_t& offset);
+        void free(uint32_t offset, uint32_t size);
+
+    private:
+        std::map<uint32_t, uint32_t> m_freeRanges;
+    };
+
+    struct Page
+    {
+        std::unique_ptr<Buffer> vertexBuffer;
+        std::unique_ptr<Buffer> indexBuffer;
+        std::unique_ptr<Buffer> positionBuffer; // null without position stream
+        RangeAllocator vertexRanges;
+        RangeAllocator indexRanges;
+        VkIndexType indexType;
+    };
+
+    static VkDeviceSize indexSize(VkIndexType indexType);
+    void createPage(uint32_t vertexCount, uint32_t indexCount, VkIndexType indexType);
+
+    /* data */
+    Device& m_device;
+    VkDeviceSize m_vertexStride;
+    VkDeviceSize m_positionStride;
+    uint32_t m_pageVertexCount;
+    uint32_t m_pageIndexCount;
+
+    std::vector<std::unique_ptr<Page>> m_pages;
+};
+
+} // namespace hyd
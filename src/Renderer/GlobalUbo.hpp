@@ -0,0 +1,32 @@
+/*
+Per-view uniform data read by every pipeline at set 0, binding 0. It matches the
+GlobalUbo block of shaders/global_ubo.glsl (std140), every member is 16 bytes
+aligned so the two layouts can't drift apart. The shadow pass gets its own copy
+with the light's projection and view.
+*/
+#pragma once
+
+// libs
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+namespace hyd
+{
+
+struct GlobalUbo
+{
+    glm::mat4 projection{1.f};
+    glm::mat4 view{1.f};
+
+    glm::mat4 lightMVP{1.f};
+    glm::vec4 directionalLight{1.f, 1.f, -2.f, 0.f}; // xyz is the direction
+    glm::vec4 ambiantLightColor{1.f, 1.f, 0.5f, 0.1f}; // w is light intensity
+
+    glm::vec4 lightPosition{0.f, 0.f, 0.f, 1.f};
+    glm::vec4 lightColor{1.f}; // w is light intensity
+};
+
+static_assert(sizeof(GlobalUbo) == 3 * 64 + 4 * 16, "GlobalUbo must match the std140 layout of the shaders");
+
+} // namespace hyd
@@ -0,0 +1,344 @@
+#include "MemoryAllocator.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <iterator>
+#include <stdexcept>
+
+namespace hyd
+{
+
+namespace
+{
+
+enum class RangeKind : uint8_t
+{
+    Free,
+    Linear,
+    Optimal
+};
+
+struct Range
+{
+    VkDeviceSize size;
+    RangeKind kind;
+};
+
+VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment){
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+RangeKind toKind(ResourceTiling tiling){
+    return tiling == ResourceTiling::Linear ? RangeKind::Linear : RangeKind::Optimal;
+}
+
+bool conflicts(RangeKind a, RangeKind b){
+    return a != RangeKind::Free && b != RangeKind::Free && a != b;
+}
+
+// true when the two bytes share a bufferImageGranularity page
+bool onSamePage(VkDeviceSize firstByte, VkDeviceSize secondByte, VkDeviceSize pageSize){
+    return firstByte / pageSize == secondByte / pageSize;
+}
+
+} // namespace
+
+// the ranges cover the whole block, free or used, adjacent free ranges are merged
+struct MemoryBlock
+{
+    VkDeviceMemory memory{VK_NULL_HANDLE};
+    VkDeviceSize size{0};
+    void* mapped{nullptr};
+    uint32_t memoryType{0};
+    bool dedicated{false};
+
+    std::map<VkDeviceSize, Range> ranges;
+    uint32_t allocationCount{0};
+    VkDeviceSize usedBytes{0};
+
+    bool allocate(VkDeviceSize size, VkDeviceSize alignment, RangeKind kind, VkDeviceSize granularity, VkDeviceSize& offset);
+    void free(VkDeviceSize offset);
+};
+
+bool MemoryBlock::allocate(VkDeviceSize allocationSize, VkDeviceSize alignment, RangeKind kind, VkDeviceSize granularity, VkDeviceSize& offset){
+    for (auto it = ranges.begin(); it != ranges.end(); ++it){
+        if (it->second.kind != RangeKind::Free || it->second.size < allocationSize)
+            continue;
+
+        const VkDeviceSize rangeBegin = it->first;
+        const VkDeviceSize rangeEnd = rangeBegin + it->second.size;
+        VkDeviceSize candidate = alignUp(rangeBegin, alignment);
+
+        // a resource of the other tiling ends on the page we start on
+        if (it != ranges.begin()){
+            auto previous = std::prev(it);
+            if (conflicts(previous->second.kind, kind) && onSamePage(rangeBegin - 1, candidate, granularity))
+                candidate = alignUp(candidate, granularity);
+        }
+        if (candidate + allocationSize > rangeEnd)
+            continue;
+
+        // a resource of the other tiling starts on the page we end on
+        auto next = std::next(it);
+        if (next != ranges.end() && conflicts(next->second.kind, kind) && onSamePage(candidate + allocationSize - 1, rangeEnd, granularity))
+            continue;
+
+        ranges.erase(it);
+        if (candidate > rangeBegin)
+            ranges.emplace(rangeBegin, Range{candidate - rangeBegin, RangeKind::Free});
+        ranges.emplace(candidate, Range{allocationSize, kind});
+        if (candidate + allocationSize < rangeEnd)
+            ranges.emplace(candidate + allocationSize, Range{rangeEnd - candidate - allocationSize, RangeKind::Free});
+
+        allocationCount++;
+        usedBytes += allocationSize;
+        offset = candidate;
+        return true;
+    }
+    return false;
+}
+
+void MemoryBlock::free(VkDeviceSize offset){
+    auto it = ranges.find(offset);
+    assert(it != ranges.end() && it->second.kind != RangeKind::Free && "freeing memory that was not allocated");
+
+    allocationCount--;
+    usedBytes -= it->second.size;
+    it->second.kind = RangeKind::Free;
+
+    auto next = std::next(it);
+    if (next != ranges.end() && next->second.kind == RangeKind::Free){
+        it->second.size += next->second.size;
+        ranges.erase(next);
+    }
+    if (it != ranges.begin()){
+        auto previous = std::prev(it);
+        if (previous->second.kind == RangeKind::Free){
+            previous->second.size += it->second.size;
+            ranges.erase(it);
+        }
+    }
+}
+
+
+MemoryAllocator::MemoryAllocator(VkDevice device, VkPhysicalDevice physicalDevice)
+: m_device{device}
+{
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &m_memoryProperties);
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    m_bufferImageGranularity = std::max<VkDeviceSize>(properties.limits.bufferImageGranularity, 1);
+    m_nonCoherentAtomSize = std::max<VkDeviceSize>(properties.limits.nonCoherentAtomSize, 1);
+}
+
+MemoryAllocator::~MemoryAllocator(){
+    for (auto& blocks : m_blocks){
+        for (auto& block : blocks){
+            assert(block->allocationCount == 0 && "device memory leaked");
+            vkFreeMemory(m_device, block->memory, nullptr);
+        }
+    }
+}
+
+uint32_t MemoryAllocator::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const{
+    for (uint32_t i = 0; i < m_memoryProperties.memoryTypeCount; i++) {
+        if ((typeFilter & (1 << i)) &&
+            (m_memoryProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+            return i;
+        }
+    }
+    throw std::runtime_error("failed to find suitable memory type!");
+}
+
+VkDeviceSize MemoryAllocator::preferredBlockSize(uint32_t memoryType) const{
+    // small heaps (integrated GPUs, BAR memory) get smaller blocks
+    const uint32_t heapIndex = m_memoryProperties.memoryTypes[memoryType].heapIndex;
+    const VkDeviceSize heapSize = m_memoryProperties.memoryHeaps[heapIndex].size;
+    return std::min(MAX_BLOCK_SIZE, alignUp(heapSize / 8, 1 << 20));
+}
+
+MemoryBlock* MemoryAllocator::createBlock(uint32_t memoryType, VkDeviceSize size, bool dedicated){
+    VkMemoryAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = size;
+    allocInfo.memoryTypeIndex = memoryType;
+
+    VkDeviceMemory memory;
+    if (vkAllocateMemory(m_device, &allocInfo, nullptr, &memory) != VK_SUCCESS)
+        return nullptr;
+
+    auto block = std::make_unique<MemoryBlock>();
+    block->memory = memory;
+    block->size = size;
+    block->memoryType = memoryType;
+    block->dedicated = dedicated;
+    block->ranges.emplace(0, Range{size, RangeKind::Free});
+
+    if (m_memoryProperties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT){
+        if (vkMapMemory(m_device, memory, 0, VK_WHOLE_SIZE, 0, &block->mapped) != VK_SUCCESS){
+            vkFreeMemory(m_device, memory, nullptr);
+            throw std::runtime_error("failed to map memory block!");
+        }
+    }
+
+    m_blocks[memoryType].push_back(std::move(block));
+    return m_blocks[memoryType].back().get();
+}
+
+void MemoryAllocator::destroyBlock(MemoryBlock* block){
+    auto& blocks = m_blocks[block->memoryType];
+    auto it = std::find_if(blocks.begin(), blocks.end(), [block](const auto& other){ return other.get() == block; });
+    assert(it != blocks.end());
+
+    // vkFreeMemory unmaps the block
+    vkFreeMemory(m_device, block->memory, nullptr);
+    blocks.erase(it);
+}
+
+MemoryAllocation MemoryAllocator::allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, ResourceTiling tiling){
+    const uint32_t memoryType = findMemoryType(requirements.memoryTypeBits, properties);
+    const VkMemoryPropertyFlags typeFlags = m_memoryProperties.memoryTypes[memoryType].propertyFlags;
+
+    VkDeviceSize alignment = std::max<VkDeviceSize>(requirements.alignment, 1);
+    // flushed ranges must start on an atom of non coherent memory
+    if ((typeFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) && !(typeFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT))
+        alignment = std::max(alignment, m_nonCoherentAtomSize);
+
+    const RangeKind kind = toKind(tiling);
+    const VkDeviceSize blockSize = preferredBlockSize(memoryType);
+
+    std::lock_guard<std::mutex> lock{m_mutex};
+
+    MemoryBlock* block = nullptr;
+    VkDeviceSize offset = 0;
+
+    if (requirements.size > blockSize / 2){
+        // large resources get their own memory
+        block = createBlock(memoryType, requirements.size, true);
+        if (block == nullptr)
+            throw std::runtime_error("failed to allocate dedicated memory!");
+        block->allocate(requirements.size, alignment, kind, m_bufferImageGranularity, offset);
+    } else {
+        for (auto& candidate : m_blocks[memoryType]){
+            if (!candidate->dedicated && candidate->allocate(requirements.size, alignment, kind, m_bufferImageGranularity, offset)){
+                block = candidate.get();
+                break;
+            }
+        }
+        if (block == nullptr){
+            // new block, smaller ones when the heap is running out
+            for (VkDeviceSize size = blockSize; block == nullptr && size >= requirements.size; size /= 2){
+                block = createBlock(memoryType, size, false);
+            }
+            if (block == nullptr)
+                throw std::runtime_error("failed to allocate memory block!");
+            if (!block->allocate(requirements.size, alignment, kind, m_bufferImageGranularity, offset))
+                throw std::runtime_error("failed to allocate memory in a new block!");
+        }
+    }
+
+    MemoryAllocation allocation{};
+    allocation.memory = block->memory;
+    allocation.offset = offset;
+    allocation.size = requirements.size;
+    allocation.mapped = block->mapped ? static_cast<char*>(block->mapped) + offset : nullptr;
+    allocation.memoryType = memoryType;
+    allocation.block = block;
+    return allocation;
+}
+
+void MemoryAllocator::free(MemoryAllocation& allocation){
+    if (allocation.block == nullptr)
+        return;
+
+    std::lock_guard<std::mutex> lock{m_mutex};
+
+    MemoryBlock* block = allocation.block;
+    block->free(allocation.offset);
+
+    // keep one empty block per memory type around for the next loads
+    if (block->allocationCount == 0){
+        const auto& blocks = m_blocks[block->memoryType];
+        bool otherEmptyBlock = std::any_of(blocks.begin(), blocks.end(), [block](const auto& other){
+            return other.get() != block && !other->dedicated && other->allocationCount == 0;
+        });
+        if (block->dedicated || otherEmptyBlock)
+            destroyBlock(block);
+    }
+    allocation = MemoryAllocation{};
+}
+
+VkMappedMemoryRange MemoryAllocator::mappedRange(const MemoryAllocation& allocation, VkDeviceSize offset, VkDeviceSize size) const{
+    if (size == VK_WHOLE_SIZE)
+        size = allocation.size - offset;
+
+    const VkDeviceSize begin = (allocation.offset + offset) / m_nonCoherentAtomSize * m_nonCoherentAtomSize;
+    const VkDeviceSize end = std::min(alignUp(allocation.offset + offset + size, m_nonCoherentAtomSize), allocation.block->size);
+
+    VkMappedMemoryRange range{};
+    range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+    range.memory = allocation.memory;
+    range.offset = begin;
+    range.size = end - begin;
+    return range;
+}
+
+VkResult MemoryAllocator::flush(const MemoryAllocation& allocation, VkDeviceSize offset, VkDeviceSize size){
+    if (m_memoryProperties.memoryTypes[allocation.memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)
+        return VK_SUCCESS;
+    VkMappedMemoryRange range = mappedRange(allocation, offset, size);
+    return vkFlushMappedMemoryRanges(m_device, 1, &range);
+}
+
+VkResult MemoryAllocator::invalidate(const MemoryAllocation& allocation, VkDeviceSize offset, VkDeviceSize size){
+    if (m_memoryProperties.memoryTypes[allocation.memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)
+        return VK_SUCCESS;
+    VkMappedMemoryRange range = mappedRange(allocation, offset, size);
+    return vkInvalidateMappedMemoryRanges(m_device, 1, &range);
+}
+
+MemoryStats MemoryAllocator::getStats(uint32_t memoryType) const{
+    std::lock_guard<std::mutex> lock{m_mutex};
+
+    MemoryStats stats{};
+    for (const auto& block : m_blocks[memoryType]){
+        stats.blockCount++;
+        stats.allocationCount += block->allocationCount;
+        stats.blockBytes += block->size;
+        stats.usedBytes += block->usedBytes;
+    }
+    return stats;
+}
+
+MemoryStats MemoryAllocator::getStats() const{
+    MemoryStats total{};
+    for (uint32_t i = 0; i < m_memoryProperties.memoryTypeCount; i++){
+        MemoryStats stats = getStats(i);
+        total.blockCount += stats.blockCount;
+        total.allocationCount += stats.allocationCount;
+        total.blockBytes += stats.blockBytes;
+        total.usedBytes += stats.usedBytes;
+    }
+    return total;
+}
+
+void MemoryAllocator::printStats(std::ostream& out) const{
+    auto print = [&out](const MemoryStats& stats){
+        out << stats.allocationCount << " allocations in " << stats.blockCount << " blocks, "
+            << (stats.usedBytes >> 10) << " / " << (stats.blockBytes >> 10) << " KiB used" << std::endl;
+    };
+
+    out << "device memory: ";
+    print(getStats());
+    for (uint32_t i = 0; i < m_memoryProperties.memoryTypeCount; i++){
+        MemoryStats stats = getStats(i);
+        if (stats.blockCount == 0)
+            continue;
+        out << "\ttype " << i << " (heap " << m_memoryProperties.memoryTypes[i].heapIndex << "): ";
+        print(stats);
+    }
+}
+
+} // namespace hyd
@@ -0,0 +1,91 @@
+/*
+The memory allocator splits the device memory in large blocks per memory type
+and places the buffers and images inside them, so the number of vkAllocateMemory
+calls stays flat with the number of resources.
+Linear (buffers, linear images) and optimal (optimal images) resources sharing
+a block are kept bufferImageGranularity apart.
+Host visible blocks are persistently mapped, the allocations point inside the mapping.
+*/
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+// std
+#include <array>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+namespace hyd
+{
+
+enum class ResourceTiling : uint8_t
+{
+    Linear,  // buffers and linear images
+    Optimal  // optimal tiling images
+};
+
+struct MemoryBlock;
+
+// a range of a memory block, bind the resource at memory + offset
+struct MemoryAllocation
+{
+    VkDeviceMemory memory{VK_NULL_HANDLE};
+    VkDeviceSize offset{0};
+    VkDeviceSize size{0};
+    void* mapped{nullptr}; // start of the allocation for host visible memory, nullptr otherwise
+    uint32_t memoryType{0};
+    MemoryBlock* block{nullptr};
+};
+
+struct MemoryStats
+{
+    uint32_t blockCount{0};
+    uint32_t allocationCount{0};
+    VkDeviceSize blockBytes{0};  // allocated from the device
+    VkDeviceSize usedBytes{0};   // handed out to the resources
+};
+
+class MemoryAllocator
+{
+public:
+    static constexpr VkDeviceSize MAX_BLOCK_SIZE = 256ull << 20;
+
+    MemoryAllocator(VkDevice device, VkPhysicalDevice physicalDevice);
+    ~MemoryAllocator();
+
+    MemoryAllocator(const MemoryAllocator&) = delete;
+    MemoryAllocator &operator=(const MemoryAllocator&) = delete;
+
+    MemoryAllocation allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, ResourceTiling tiling);
+    void free(MemoryAllocation& allocation);
+
+    // ranges relative to the allocation, rounded to nonCoherentAtomSize, no-op for coherent memory
+    VkResult flush(const MemoryAllocation& allocation, VkDeviceSize offset = 0, VkDeviceSize size = VK_WHOLE_SIZE);
+    VkResult invalidate(const MemoryAllocation& allocation, VkDeviceSize offset = 0, VkDeviceSize size = VK_WHOLE_SIZE);
+
+    uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const;
+
+    MemoryStats getStats() const;
+    MemoryStats getStats(uint32_t memoryType) const;
+    void printStats(std::ostream& out) const;
+
+private:
+    VkDeviceSize preferredBlockSize(uint32_t memoryType) const;
+    MemoryBlock* createBlock(uint32_t memoryType, VkDeviceSize size, bool dedicated);
+    void destroyBlock(MemoryBlock* block);
+    VkMappedMemoryRange mappedRange(const MemoryAllocation& allocation, VkDeviceSize offset, VkDeviceSize size) const;
+
+    /* data */
+    VkDevice m_device;
+    VkPhysicalDeviceMemoryProperties m_memoryProperties;
+    VkDeviceSize m_bufferImageGranularity;
+    VkDeviceSize m_nonCoherentAtomSize;
+
+    mutable std::mutex m_mutex;
+    std::array<std::vector<std::unique_ptr<MemoryBlock>>, VK_MAX_MEMORY_TYPES> m_blocks;
+};
+
+} // namespace hyd
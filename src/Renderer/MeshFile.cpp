@@ -0,0 +1,261 @@
+#include "MeshFile.hpp"
+
+// std
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <type_traits>
+
+namespace hyd
+{
+
+namespace
+{
+
+constexpr char MAGIC[4] = {'H', 'M', 'S', 'H'};
+constexpr uint64_t SECTION_ALIGNMENT = 16;
+
+// fixed size fields only, the file is read in place
+struct Header
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t vertexSize;
+    uint32_t indexSize;
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint32_t primitiveCount;
+    uint32_t lodCount;
+    uint32_t meshletCount;
+    float aabbMin[3];
+    float aabbMax[3];
+    float sphere[4];
+    uint64_t vertexOffset;
+    uint64_t indexOffset;
+    uint64_t primitiveOffset;
+    uint64_t lodOffset;
+    uint64_t meshletOffset;
+};
+
+struct PrimitiveEntry
+{
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    int32_t materialIndex;
+    float aabbMin[3];
+    float aabbMax[3];
+    float sphere[4];
+};
+
+struct LodEntry
+{
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    float error;
+    uint32_t firstMeshlet;
+    uint32_t meshletCount;
+};
+
+struct MeshletEntry
+{
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    float sphere[4];
+    float cone[4];
+};
+
+static_assert(std::is_trivially_copyable_v<Model::PackedVertex>, "the vertices are stored as is");
+
+uint64_t alignSection(uint64_t offset){
+    return (offset + SECTION_ALIGNMENT - 1) / SECTION_ALIGNMENT * SECTION_ALIGNMENT;
+}
+
+void storeBounds(const AABB& aabb, const BoundingSphere& sphere, float aabbMin[3], float aabbMax[3], float sphereOut[4]){
+    for (int i = 0; i < 3; i++){
+        aabbMin[i] = aabb.min[i];
+        aabbMax[i] = aabb.max[i];
+        sphereOut[i] = sphere.center[i];
+    }
+    sphereOut[3] = sphere.radius;
+}
+
+void loadBounds(const float aabbMin[3], const float aabbMax[3], const float sphereIn[4], AABB& aabb, BoundingSphere& sphere){
+    aabb.min = glm::vec3(aabbMin[0], aabbMin[1], aabbMin[2]);
+    aabb.max = glm::vec3(aabbMax[0], aabbMax[1], aabbMax[2]);
+    sphere.center = glm::vec3(sphereIn[0], sphereIn[1], sphereIn[2]);
+    sphere.radius = sphereIn[3];
+}
+
+} // namespace
+
+std::string MeshFile::cookedPath(const std::string& sourcePath){
+    // the source extension is kept, cube.obj and cube.gltf don't share a cooked file
+    if (std::filesystem::path{sourcePath}.extension() == EXTENSION)
+        return sourcePath;
+    return sourcePath + EXTENSION;
+}
+
+std::unique_ptr<MeshFile> MeshFile::openCooked(const std::string& sourcePath){
+    const std::string path = cookedPath(sourcePath);
+    std::error_code error;
+    if (path == sourcePath)
+        return std::make_unique<MeshFile>(path);
+    if (!std::filesystem::exists(path, error))
+        return nullptr;
+
+    // an edited source is parsed again until it is cooked again
+    auto sourceTime = std::filesystem::last_write_time(sourcePath, error);
+    if (!error && std::filesystem::last_write_time(path, error) < sourceTime)
+        return nullptr;
+
+    try {
+        return std::make_unique<MeshFile>(path);
+    } catch (const std::exception&) {
+        // written by an older version, fall back to the source
+        return nullptr;
+    }
+}
+
+void MeshFile::write(const std::string& filepath, const Model::Builder& builder){
+    const uint32_t vertexCount = static_cast<uint32_t>(builder.vertices.size());
+    std::vector<Model::PackedVertex> vertices(vertexCount);
+    Model::packVertices(builder.vertices.data(), vertexCount, Model::computePositionDecode(builder.aabb), vertices.data());
+
+    const bool shortIndices = Model::chooseIndexType(vertexCount) == VK_INDEX_TYPE_UINT16;
+    std::vector<uint16_t> shortIndexData;
+    if (shortIndices)
+        shortIndexData.assign(builder.indices.begin(), builder.indices.end());
+    const void* indexData = shortIndices ? static_cast<const void*>(shortIndexData.data()) : builder.indices.data();
+
+    Header header{};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.vertexSize = sizeof(Model::PackedVertex);
+    header.indexSize = shortIndices ? sizeof(uint16_t) : sizeof(uint32_t);
+    header.vertexCount = vertexCount;
+    header.indexCount = static_cast<uint32_t>(builder.indices.size());
+    header.primitiveCount = static_cast<uint32_t>(builder.primitives.size());
+    header.lodCount = static_cast<uint32_t>(builder.lods.size());
+    header.meshletCount = static_cast<uint32_t>(builder.meshlets.size());
+    storeBounds(builder.aabb, builder.boundingSphere, header.aabbMin, header.aabbMax, header.sphere);
+    header.vertexOffset = alignSection(sizeof(Header));
+    header.indexOffset = alignSection(header.vertexOffset + uint64_t(header.vertexCount) * header.vertexSize);
+    header.primitiveOffset = alignSection(header.indexOffset + uint64_t(header.indexCount) * header.indexSize);
+    header.lodOffset = alignSection(header.primitiveOffset + uint64_t(header.primitiveCount) * sizeof(PrimitiveEntry));
+    header.meshletOffset = alignSection(header.lodOffset + uint64_t(header.lodCount) * sizeof(LodEntry));
+
+    std::vector<PrimitiveEntry> primitives(builder.primitives.size());
+    for (size_t i = 0; i < primitives.size(); i++){
+        const Model::Primitive& primitive = builder.primitives[i];
+        primitives[i].firstIndex = primitive.firstIndex;
+        primitives[i].indexCount = primitive.indexCount;
+        primitives[i].materialIndex = primitive.materialIndex;
+        storeBounds(primitive.aabb, primitive.boundingSphere, primitives[i].aabbMin, primitives[i].aabbMax, primitives[i].sphere);
+    }
+
+    std::vector<LodEntry> lods(builder.lods.size());
+    for (size_t i = 0; i < lods.size(); i++){
+        lods[i].firstIndex = builder.lods[i].firstIndex;
+        lods[i].indexCount = builder.lods[i].indexCount;
+        lods[i].error = builder.lods[i].error;
+        lods[i].firstMeshlet = builder.lods[i].firstMeshlet;
+        lods[i].meshletCount = builder.lods[i].meshletCount;
+    }
+
+    std::vector<MeshletEntry> meshlets(builder.meshlets.size());
+    for (size_t i = 0; i < meshlets.size(); i++){
+        const Meshlet& meshlet = builder.meshlets[i];
+        meshlets[i].firstIndex = meshlet.firstIndex;
+        meshlets[i].indexCount = meshlet.indexCount;
+        for (int c = 0; c < 4; c++){
+            meshlets[i].sphere[c] = meshlet.boundingSphere[c];
+            meshlets[i].cone[c] = meshlet.cone[c];
+        }
+    }
+
+    std::ofstream out{filepath, std::ios::binary};
+    if (!out.is_open())
+        throw std::runtime_error("failed to open file: " + filepath);
+
+    auto writeAt = [&out](uint64_t offset, const void* data, size_t size){
+        static const char padding[SECTION_ALIGNMENT]{};
+        out.write(padding, static_cast<std::streamsize>(offset - static_cast<uint64_t>(out.tellp())));
+        out.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+    };
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    writeAt(header.vertexOffset, vertices.data(), vertices.size() * sizeof(Model::PackedVertex));
+    writeAt(header.indexOffset, indexData, builder.indices.size() * header.indexSize);
+    writeAt(header.primitiveOffset, primitives.data(), primitives.size() * sizeof(PrimitiveEntry));
+    writeAt(header.lodOffset, lods.data(), lods.size() * sizeof(LodEntry));
+    writeAt(header.meshletOffset, meshlets.data(), meshlets.size() * sizeof(MeshletEntry));
+    if (!out)
+        throw std::runtime_error("failed to write file: " + filepath);
+}
+
+MeshFile::MeshFile(const std::string& filepath) : m_file{filepath}
+{
+    Header header;
+    if (m_file.size() < sizeof(header))
+        throw std::runtime_error("truncated mesh file: " + filepath);
+    std::memcpy(&header, m_file.data(), sizeof(header));
+
+    if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0)
+        throw std::runtime_error("not a mesh file: " + filepath);
+    if (header.version != VERSION || header.vertexSize != sizeof(Model::PackedVertex))
+        throw std::runtime_error("mesh file cooked by another version: " + filepath);
+    if ((header.indexSize != sizeof(uint16_t) && header.indexSize != sizeof(uint32_t)) ||
+        header.vertexOffset % SECTION_ALIGNMENT != 0 || header.indexOffset % SECTION_ALIGNMENT != 0 ||
+        header.primitiveOffset + uint64_t(header.primitiveCount) * sizeof(PrimitiveEntry) > m_file.size() ||
+        header.lodOffset + uint64_t(header.lodCount) * sizeof(LodEntry) > m_file.size() ||
+        header.meshletOffset + uint64_t(header.meshletCount) * sizeof(MeshletEntry) > m_file.size() ||
+        header.indexOffset + uint64_t(header.indexCount) * header.indexSize > m_file.size() ||
+        header.vertexOffset + uint64_t(header.vertexCount) * sizeof(Model::PackedVertex) > m_file.size())
+        throw std::runtime_error("corrupted mesh file: " + filepath);
+
+    // the mapping is page aligned and the sections 16 bytes aligned, the blobs are read in place
+    m_vertices = reinterpret_cast<const Model::PackedVertex*>(m_file.data() + header.vertexOffset);
+    m_vertexCount = header.vertexCount;
+    m_indices = m_file.data() + header.indexOffset;
+    m_indexCount = header.indexCount;
+    m_indexType = header.indexSize == sizeof(uint16_t) ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+    loadBounds(header.aabbMin, header.aabbMax, header.sphere, m_aabb, m_boundingSphere);
+
+    m_primitives.resize(header.primitiveCount);
+    for (uint32_t i = 0; i < header.primitiveCount; i++){
+        PrimitiveEntry entry;
+        std::memcpy(&entry, m_file.data() + header.primitiveOffset + i * sizeof(PrimitiveEntry), sizeof(entry));
+        m_primitives[i].firstIndex = entry.firstIndex;
+        m_primitives[i].indexCount = entry.indexCount;
+        m_primitives[i].materialIndex = entry.materialIndex;
+        loadBounds(entry.aabbMin, entry.aabbMax, entry.sphere, m_primitives[i].aabb, m_primitives[i].boundingSphere);
+    }
+
+    m_lods.resize(header.lodCount);
+    for (uint32_t i = 0; i < header.lodCount; i++){
+        LodEntry entry;
+        std::memcpy(&entry, m_file.data() + header.lodOffset + i * sizeof(LodEntry), sizeof(entry));
+        if (uint64_t(entry.firstIndex) + entry.indexCount > header.indexCount ||
+            uint64_t(entry.firstMeshlet) + entry.meshletCount > header.meshletCount)
+            throw std::runtime_error("corrupted mesh file: " + filepath);
+        m_lods[i].firstIndex = entry.firstIndex;
+        m_lods[i].indexCount = entry.indexCount;
+        m_lods[i].error = entry.error;
+        m_lods[i].firstMeshlet = entry.firstMeshlet;
+        m_lods[i].meshletCount = entry.meshletCount;
+    }
+
+    m_meshlets.resize(header.meshletCount);
+    for (uint32_t i = 0; i < header.meshletCount; i++){
+        MeshletEntry entry;
+        std::memcpy(&entry, m_file.data() + header.meshletOffset + i * sizeof(MeshletEntry), sizeof(entry));
+        if (uint64_t(entry.firstIndex) + entry.indexCount > header.indexCount)
+            throw std::runtime_error("corrupted mesh file: " + filepath);
+        m_meshlets[i].firstIndex = entry.firstIndex;
+        m_meshlets[i].indexCount = entry.indexCount;
+        m_meshlets[i].boundingSphere = glm::vec4(entry.sphere[0], entry.sphere[1], entry.sphere[2], entry.sphere[3]);
+        m_meshlets[i].cone = glm::vec4(entry.cone[0], entry.cone[1], entry.cone[2], entry.cone[3]);
+    }
+}
+
+} // namespace hyd
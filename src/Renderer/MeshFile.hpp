@@ -0,0 +1,72 @@
+/*
+Cooked mesh: the vertices and indices of a Model::Builder stored as they are
+uploaded (Model::PackedVertex quantized in the model's bounds, and 16 or 32 bits
+indices), with the bounds, the primitive, LOD and meshlet tables.
+The file is memory mapped and its blobs are copied straight to the staging
+buffer, nothing is parsed.
+Layout: header, vertices, indices, primitives, lods, meshlets, each section 16 bytes aligned.
+The version changes with the layout or with Model::PackedVertex.
+*/
+#pragma once
+
+#include "Model.hpp"
+#include "Core/MappedFile.hpp"
+
+// std
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace hyd
+{
+
+class MeshFile
+{
+public:
+    static constexpr uint32_t VERSION = 4;
+    static constexpr const char* EXTENSION = ".hmesh";
+
+    // the cooked file of a source model, next to it with .hmesh appended (cube.obj -> cube.obj.hmesh)
+    static std::string cookedPath(const std::string& sourcePath);
+    // the cooked file of the source when it exists, is compatible and not older than the source, nullptr otherwise
+    static std::unique_ptr<MeshFile> openCooked(const std::string& sourcePath);
+
+    static void write(const std::string& filepath, const Model::Builder& builder);
+
+    // throws when the file is not a compatible mesh file
+    explicit MeshFile(const std::string& filepath);
+
+    MeshFile(const MeshFile&) = delete;
+    MeshFile &operator=(const MeshFile&) = delete;
+
+    const Model::PackedVertex* getVertices() const { return m_vertices; }
+    uint32_t getVertexCount() const { return m_vertexCount; }
+    // uint16_t or uint32_t depending on the index type
+    const void* getIndices() const { return m_indices; }
+    VkIndexType getIndexType() const { return m_indexType; }
+    uint32_t getIndexCount() const { return m_indexCount; }
+    const std::vector<Model::Primitive>& getPrimitives() const { return m_primitives; }
+    // empty when the LODs were not generated
+    const std::vector<Model::Lod>& getLods() const { return m_lods; }
+    // empty when the meshlets were not built
+    const std::vector<Meshlet>& getMeshlets() const { return m_meshlets; }
+    const AABB& getAABB() const { return m_aabb; }
+    const BoundingSphere& getBoundingSphere() const { return m_boundingSphere; }
+
+private:
+    /* data */
+    MappedFile m_file;
+    const Model::PackedVertex* m_vertices{nullptr};
+    uint32_t m_vertexCount{0};
+    const void* m_indices{nullptr};
+    uint32_t m_indexCount{0};
+    VkIndexType m_indexType{VK_INDEX_TYPE_UINT32};
+    std::vector<Model::Primitive> m_primitives;
+    std::vector<Model::Lod> m_lods;
+    std::vector<Meshlet> m_meshlets;
+    AABB m_aabb{};
+    BoundingSphere m_boundingSphere{};
+};
+
+} // namespace hyd
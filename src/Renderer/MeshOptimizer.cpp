@@ -0,0 +1,287 @@
+#include "MeshOptimizer.hpp"
+
+// std
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+
+namespace hyd
+{
+
+namespace
+{
+
+// Forsyth's scoring, the cache is simulated with a LRU bigger than the hardware one
+constexpr uint32_t CACHE_SIZE = 32;
+constexpr float CACHE_DECAY_POWER = 1.5f;
+constexpr float LAST_TRIANGLE_SCORE = 0.75f;
+constexpr float VALENCE_BOOST_SCALE = 2.0f;
+constexpr float VALENCE_BOOST_POWER = 0.5f;
+constexpr uint32_t MAX_VALENCE = 64;
+
+// FIFO size of the cluster split, close to the hardware caches
+constexpr uint32_t OVERDRAW_CACHE_SIZE = 16;
+
+struct ScoreTables
+{
+    float cache[CACHE_SIZE];
+    float valence[MAX_VALENCE];
+
+    ScoreTables(){
+        for (uint32_t i = 0; i < CACHE_SIZE; i++){
+            // the last triangle's vertices get a fixed score so that its neighbours aren't favored too much
+            cache[i] = i < 3 ? LAST_TRIANGLE_SCORE :
+                std::pow(1.0f - float(i - 3) / float(CACHE_SIZE - 3), CACHE_DECAY_POWER);
+        }
+        valence[0] = 0.0f;
+        for (uint32_t i = 1; i < MAX_VALENCE; i++)
+            valence[i] = VALENCE_BOOST_SCALE * std::pow(float(i), -VALENCE_BOOST_POWER);
+    }
+};
+
+const ScoreTables& scoreTables(){
+    static const ScoreTables tables{};
+    return tables;
+}
+
+float vertexScore(int32_t cachePosition, uint32_t remainingTriangles){
+    if (remainingTriangles == 0)
+        return -1.0f;
+    const ScoreTables& tables = scoreTables();
+    float score = cachePosition < 0 ? 0.0f : tables.cache[cachePosition];
+    return score + tables.valence[std::min(remainingTriangles, MAX_VALENCE - 1)];
+}
+
+} // namespace
+
+VertexCacheStats analyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize){
+    VertexCacheStats stats{};
+    if (indexCount < 3 || vertexCount == 0)
+        return stats;
+
+    // timestamps of the FIFO: a vertex is in the cache when it was inserted less than cacheSize misses ago
+    std::vector<uint32_t> insertedAt(vertexCount, 0);
+    uint32_t time = cacheSize + 1;
+    for (size_t i = 0; i < indexCount; i++){
+        uint32_t vertex = indices[i];
+        if (time - insertedAt[vertex] > cacheSize){
+            insertedAt[vertex] = time++;
+            stats.misses++;
+        }
+    }
+
+    size_t usedVertices = 0;
+    for (uint32_t timestamp : insertedAt)
+        usedVertices += timestamp != 0 ? 1 : 0;
+    stats.acmr = float(stats.misses) / float(indexCount / 3);
+    stats.atvr = float(stats.misses) / float(usedVertices);
+    return stats;
+}
+
+void optimizeVertexCache(uint32_t* indices, size_t indexCount, size_t vertexCount){
+    const size_t triangleCount = indexCount / 3;
+    if (triangleCount < 2)
+        return;
+
+    // triangles of each vertex
+    std::vector<uint32_t> valence(vertexCount, 0);
+    for (size_t i = 0; i < triangleCount * 3; i++)
+        valence[indices[i]]++;
+    std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; v++)
+        adjacencyOffsets[v + 1] = adjacencyOffsets[v] + valence[v];
+    std::vector<uint32_t> adjacency(adjacencyOffsets.back());
+    {
+        std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+        for (size_t t = 0; t < triangleCount; t++){
+            for (size_t k = 0; k < 3; k++)
+                adjacency[fill[indices[t * 3 + k]]++] = static_cast<uint32_t>(t);
+        }
+    }
+
+    // remaining triangles are kept at the front of each vertex's adjacency list
+    std::vector<uint32_t>& remaining = valence;
+    std::vector<int32_t> cachePosition(vertexCount, -1);
+    std::vector<float> vertexScores(vertexCount);
+    for (size_t v = 0; v < vertexCount; v++)
+        vertexScores[v] = vertexScore(-1, remaining[v]);
+
+    std::vector<float> triangleScores(triangleCount);
+    for (size_t t = 0; t < triangleCount; t++){
+        triangleScores[t] = vertexScores[indices[t * 3]] + vertexScores[indices[t * 3 + 1]] + vertexScores[indices[t * 3 + 2]];
+    }
+
+    std::vector<uint32_t> output(triangleCount * 3);
+    std::vector<bool> emitted(triangleCount, false);
+    uint32_t cache[CACHE_SIZE + 3];
+    uint32_t cacheCount = 0;
+    size_t inputCursor = 0;
+
+    // the best triangle of the start is searched in the whole mesh
+    uint32_t best = static_cast<uint32_t>(std::max_element(triangleScores.begin(), triangleScores.end()) - triangleScores.begin());
+
+    for (size_t out = 0; out < triangleCount; out++){
+        if (best == UINT32_MAX){
+            // dead end: no triangle touches the cache anymore, continue in the input order
+            while (emitted[inputCursor])
+                inputCursor++;
+            best = static_cast<uint32_t>(inputCursor);
+        }
+
+        const uint32_t* triangle = indices + size_t(best) * 3;
+        std::memcpy(&output[out * 3], triangle, 3 * sizeof(uint32_t));
+        emitted[best] = true;
+
+        // the triangle's vertices go to the front of the LRU
+        uint32_t newCache[CACHE_SIZE + 3];
+        uint32_t newCount = 0;
+        for (size_t k = 0; k < 3; k++){
+            uint32_t vertex = triangle[k];
+            newCache[newCount++] = vertex;
+
+            // move the triangle out of the remaining part of the vertex's list
+            uint32_t* list = adjacency.data() + adjacencyOffsets[vertex];
+            uint32_t* last = list + remaining[vertex] - 1;
+            *std::find(list, last + 1, best) = *last;
+            *last = best;
+            remaining[vertex]--;
+        }
+        for (uint32_t i = 0; i < cacheCount; i++){
+            uint32_t vertex = cache[i];
+            if (vertex != triangle[0] && vertex != triangle[1] && vertex != triangle[2])
+                newCache[newCount++] = vertex;
+        }
+
+        // the vertices pushed out of the cache lose their cache score
+        for (uint32_t i = CACHE_SIZE; i < newCount; i++){
+            cachePosition[newCache[i]] = -1;
+            vertexScores[newCache[i]] = vertexScore(-1, remaining[newCache[i]]);
+        }
+        cacheCount = std::min(newCount, CACHE_SIZE);
+        std::memcpy(cache, newCache, cacheCount * sizeof(uint32_t));
+
+        for (uint32_t i = 0; i < cacheCount; i++){
+            cachePosition[cache[i]] = static_cast<int32_t>(i);
+            vertexScores[cache[i]] = vertexScore(static_cast<int32_t>(i), remaining[cache[i]]);
+        }
+
+        // rescore the remaining triangles of the cached vertices, the next triangle is the best of them
+        best = UINT32_MAX;
+        float bestScore = -1.0f;
+        for (uint32_t i = 0; i < cacheCount; i++){
+            uint32_t vertex = cache[i];
+            const uint32_t* list = adjacency.data() + adjacencyOffsets[vertex];
+            for (uint32_t j = 0; j < remaining[vertex]; j++){
+                uint32_t t = list[j];
+                const uint32_t* other = indices + size_t(t) * 3;
+                float score = vertexScores[other[0]] + vertexScores[other[1]] + vertexScores[other[2]];
+                triangleScores[t] = score;
+                if (score > bestScore){
+                    bestScore = score;
+                    best = t;
+                }
+            }
+        }
+    }
+
+    std::memcpy(indices, output.data(), triangleCount * 3 * sizeof(uint32_t));
+}
+
+void optimizeOverdraw(uint32_t* indices, size_t indexCount, const float* positions, size_t positionStride, size_t vertexCount){
+    const size_t triangleCount = indexCount / 3;
+    if (triangleCount < 2)
+        return;
+
+    auto position = [&](uint32_t vertex){
+        return reinterpret_cast<const float*>(reinterpret_cast<const unsigned char*>(positions) + vertex * positionStride);
+    };
+
+    // a cluster starts at each triangle missing the cache 3 times, the cache order inside the clusters is kept
+    std::vector<uint32_t> clusters;
+    {
+        std::vector<uint32_t> insertedAt(vertexCount, 0);
+        uint32_t time = OVERDRAW_CACHE_SIZE + 1;
+        for (size_t t = 0; t < triangleCount; t++){
+            uint32_t misses = 0;
+            for (size_t k = 0; k < 3; k++){
+                uint32_t vertex = indices[t * 3 + k];
+                if (time - insertedAt[vertex] > OVERDRAW_CACHE_SIZE){
+                    insertedAt[vertex] = time++;
+                    misses++;
+                }
+            }
+            if (t == 0 || misses == 3)
+                clusters.push_back(static_cast<uint32_t>(t));
+        }
+    }
+    if (clusters.size() < 2)
+        return;
+    clusters.push_back(static_cast<uint32_t>(triangleCount));
+
+    // area weighted centroid of the mesh
+    float meshCentroid[3] = {0.0f, 0.0f, 0.0f};
+    float meshArea = 0.0f;
+    std::vector<float> clusterData((clusters.size() - 1) * 7); // centroid, area, normal
+    for (size_t c = 0; c + 1 < clusters.size(); c++){
+        float* data = &clusterData[c * 7];
+        std::fill(data, data + 7, 0.0f);
+        for (uint32_t t = clusters[c]; t < clusters[c + 1]; t++){
+            const float* a = position(indices[t * 3]);
+            const float* b = position(indices[t * 3 + 1]);
+            const float* d = position(indices[t * 3 + 2]);
+            float e1[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+            float e2[3] = {d[0] - a[0], d[1] - a[1], d[2] - a[2]};
+            float normal[3] = {e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0]};
+            float area = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+            for (int i = 0; i < 3; i++){
+                data[i] += (a[i] + b[i] + d[i]) / 3.0f * area;
+                data[4 + i] += normal[i];
+            }
+            data[3] += area;
+        }
+        for (int i = 0; i < 3; i++)
+            meshCentroid[i] += data[i];
+        meshArea += data[3];
+    }
+    for (int i = 0; i < 3; i++)
+        meshCentroid[i] = meshArea > 0.0f ? meshCentroid[i] / meshArea : 0.0f;
+
+    // the clusters facing away from the center are drawn first, they occlude the others
+    std::vector<float> sortKeys(clusters.size() - 1);
+    for (size_t c = 0; c + 1 < clusters.size(); c++){
+        const float* data = &clusterData[c * 7];
+        float normalLength = std::sqrt(data[4] * data[4] + data[5] * data[5] + data[6] * data[6]);
+        float key = 0.0f;
+        if (data[3] > 0.0f && normalLength > 0.0f){
+            for (int i = 0; i < 3; i++)
+                key += (data[i] / data[3] - meshCentroid[i]) * data[4 + i] / normalLength;
+        }
+        sortKeys[c] = key;
+    }
+    std::vector<uint32_t> order(clusters.size() - 1);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b){ return sortKeys[a] > sortKeys[b]; });
+
+    std::vector<uint32_t> output;
+    output.reserve(triangleCount * 3);
+    for (uint32_t c : order)
+        output.insert(output.end(), indices + size_t(clusters[c]) * 3, indices + size_t(clusters[c + 1]) * 3);
+    std::memcpy(indices, output.data(), output.size() * sizeof(uint32_t));
+}
+
+std::vector<uint32_t> vertexFetchRemap(const uint32_t* indices, size_t indexCount, size_t vertexCount){
+    std::vector<uint32_t> remap(vertexCount, UINT32_MAX);
+    uint32_t next = 0;
+    for (size_t i = 0; i < indexCount; i++){
+        if (remap[indices[i]] == UINT32_MAX)
+            remap[indices[i]] = next++;
+    }
+    for (auto& index : remap){
+        if (index == UINT32_MAX)
+            index = next++;
+    }
+    return remap;
+}
+
+} // namespace hyd
@@ -0,0 +1,326 @@
+#include "MeshSimplifier.hpp"
+
+// std
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+#include <vector>
+
+namespace hyd
+{
+
+namespace
+{
+
+constexpr uint32_t NO_TARGET = ~0u;
+
+struct Vec3
+{
+    double x, y, z;
+};
+
+Vec3 operator-(const Vec3& a, const Vec3& b){ return {a.x - b.x, a.y - b.y, a.z - b.z}; }
+Vec3 cross(const Vec3& a, const Vec3& b){ return {a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x}; }
+double dot(const Vec3& a, const Vec3& b){ return a.x * b.x + a.y * b.y + a.z * b.z; }
+
+// sum of the squared distances to planes, weighted by the area of the triangles they come from
+struct Quadric
+{
+    double a00{0}, a01{0}, a02{0}, a11{0}, a12{0}, a22{0};
+    double b0{0}, b1{0}, b2{0};
+    double c{0};
+    double weight{0};
+
+    void addPlane(const Vec3& normal, double distance, double area){
+        a00 += area * normal.x * normal.x;
+        a01 += area * normal.x * normal.y;
+        a02 += area * normal.x * normal.z;
+        a11 += area * normal.y * normal.y;
+        a12 += area * normal.y * normal.z;
+        a22 += area * normal.z * normal.z;
+        b0 += area * normal.x * distance;
+        b1 += area * normal.y * distance;
+        b2 += area * normal.z * distance;
+        c += area * distance * distance;
+        weight += area;
+    }
+
+    void add(const Quadric& other){
+        a00 += other.a00; a01 += other.a01; a02 += other.a02;
+        a11 += other.a11; a12 += other.a12; a22 += other.a22;
+        b0 += other.b0; b1 += other.b1; b2 += other.b2;
+        c += other.c;
+        weight += other.weight;
+    }
+
+    // mean squared distance of the point to the planes
+    double error(const Vec3& p) const {
+        double r = a00 * p.x * p.x + a11 * p.y * p.y + a22 * p.z * p.z
+            + 2.0 * (a01 * p.x * p.y + a02 * p.x * p.z + a12 * p.y * p.z)
+            + 2.0 * (b0 * p.x + b1 * p.y + b2 * p.z)
+            + c;
+        return weight > 0.0 ? std::abs(r) / weight : 0.0;
+    }
+};
+
+class Positions
+{
+public:
+    Positions(const float* positions, size_t stride) : m_data{reinterpret_cast<const uint8_t*>(positions)}, m_stride{stride} {}
+
+    const float* raw(uint32_t vertex) const {
+        return reinterpret_cast<const float*>(m_data + vertex * m_stride);
+    }
+    Vec3 operator[](uint32_t vertex) const {
+        const float* p = raw(vertex);
+        return {p[0], p[1], p[2]};
+    }
+
+private:
+    const uint8_t* m_data;
+    size_t m_stride;
+};
+
+// the first vertex of each group of vertices at the same position, -0 and 0 are the same position
+std::vector<uint32_t> positionClasses(const Positions& positions, size_t vertexCount){
+    auto key = [&positions](uint32_t vertex){
+        std::array<uint32_t, 3> bits;
+        const float* p = positions.raw(vertex);
+        for (int i = 0; i < 3; i++){
+            float value = p[i] + 0.0f;
+            std::memcpy(&bits[i], &value, sizeof(float));
+        }
+        return bits;
+    };
+
+    std::vector<uint32_t> order(vertexCount);
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b){
+        auto ka = key(a), kb = key(b);
+        return ka != kb ? ka < kb : a < b;
+    });
+
+    std::vector<uint32_t> classes(vertexCount);
+    for (size_t i = 0; i < order.size(); i++){
+        bool sameAsPrevious = i > 0 && key(order[i]) == key(order[i - 1]);
+        classes[order[i]] = sameAsPrevious ? classes[order[i - 1]] : order[i];
+    }
+    return classes;
+}
+
+} // namespace
+
+size_t simplifyMesh(
+    uint32_t* destination,
+    const uint32_t* indices,
+    size_t indexCount,
+    const float* positionData,
+    size_t positionStride,
+    size_t vertexCount,
+    size_t targetIndexCount,
+    float targetError,
+    float* resultError){
+    indexCount -= indexCount % 3;
+    if (destination != indices)
+        std::copy(indices, indices + indexCount, destination);
+    if (resultError)
+        *resultError = 0.0f;
+    if (indexCount <= targetIndexCount || vertexCount == 0)
+        return indexCount;
+
+    const Positions positions{positionData, positionStride};
+    const std::vector<uint32_t> classes = positionClasses(positions, vertexCount);
+
+    // a class with several referenced vertices is an attribute seam
+    std::vector<uint8_t> locked(vertexCount, 0);
+    {
+        std::vector<uint8_t> referenced(vertexCount, 0);
+        std::vector<uint32_t> wedgeCount(vertexCount, 0);
+        for (size_t i = 0; i < indexCount; i++){
+            uint32_t vertex = destination[i];
+            if (!referenced[vertex]){
+                referenced[vertex] = 1;
+                wedgeCount[classes[vertex]]++;
+            }
+        }
+        for (size_t v = 0; v < vertexCount; v++){
+            if (wedgeCount[v] > 1)
+                locked[v] = 1;
+        }
+    }
+
+    // the border and non-manifold edges: no opposite edge, or the same directed edge twice
+    {
+        std::vector<uint64_t> edges;
+        edges.reserve(indexCount);
+        for (size_t t = 0; t < indexCount; t += 3){
+            for (int k = 0; k < 3; k++){
+                uint32_t a = classes[destination[t + k]];
+                uint32_t b = classes[destination[t + (k + 1) % 3]];
+                if (a != b)
+                    edges.push_back((uint64_t(a) << 32) | b);
+            }
+        }
+        std::sort(edges.begin(), edges.end());
+        for (size_t i = 0; i < edges.size(); i++){
+            uint32_t a = static_cast<uint32_t>(edges[i] >> 32);
+            uint32_t b = static_cast<uint32_t>(edges[i]);
+            bool duplicated = (i > 0 && edges[i - 1] == edges[i]) || (i + 1 < edges.size() && edges[i + 1] == edges[i]);
+            bool opposite = std::binary_search(edges.begin(), edges.end(), (uint64_t(b) << 32) | a);
+            if (duplicated || !opposite)
+                locked[a] = locked[b] = 1;
+        }
+    }
+
+    std::vector<Quadric> quadrics(vertexCount);
+    for (size_t t = 0; t < indexCount; t += 3){
+        Vec3 p0 = positions[destination[t]];
+        Vec3 normal = cross(positions[destination[t + 1]] - p0, positions[destination[t + 2]] - p0);
+        double length = std::sqrt(dot(normal, normal));
+        if (length == 0.0)
+            continue;
+        normal = {normal.x / length, normal.y / length, normal.z / length};
+        for (int k = 0; k < 3; k++)
+            quadrics[classes[destination[t + k]]].addPlane(normal, -dot(normal, p0), length * 0.5);
+    }
+
+    struct Collapse
+    {
+        uint32_t vertex;
+        uint32_t target;
+        double error;
+    };
+
+    const double errorLimit = double(targetError) * double(targetError);
+    double maxError = 0.0;
+
+    std::vector<uint32_t> collapseTarget(vertexCount);
+    std::iota(collapseTarget.begin(), collapseTarget.end(), 0);
+    std::vector<uint32_t> bestTarget(vertexCount);
+    std::vector<double> bestError(vertexCount);
+    std::vector<uint8_t> touched(vertexCount);
+    std::vector<uint32_t> adjacencyOffsets(vertexCount + 1);
+    std::vector<uint32_t> adjacency;
+    std::vector<Collapse> collapses;
+
+    // each pass collapses an independent set of edges, the cheapest first
+    while (indexCount > targetIndexCount){
+        // triangles around each position class
+        std::fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0);
+        for (size_t i = 0; i < indexCount; i++)
+            adjacencyOffsets[classes[destination[i]] + 1]++;
+        std::partial_sum(adjacencyOffsets.begin(), adjacencyOffsets.end(), adjacencyOffsets.begin());
+        adjacency.resize(indexCount);
+        {
+            std::vector<uint32_t> cursor(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+            for (size_t i = 0; i < indexCount; i++)
+                adjacency[cursor[classes[destination[i]]]++] = static_cast<uint32_t>(i / 3);
+        }
+
+        // cheapest collapse of every unlocked vertex onto one of its neighbours
+        std::fill(bestTarget.begin(), bestTarget.end(), NO_TARGET);
+        for (size_t t = 0; t < indexCount; t += 3){
+            for (int k = 0; k < 3; k++){
+                uint32_t vertex = destination[t + k];
+                if (locked[classes[vertex]])
+                    continue;
+                for (int other : {(k + 1) % 3, (k + 2) % 3}){
+                    uint32_t target = destination[t + other];
+                    if (classes[target] == classes[vertex])
+                        continue;
+                    Quadric quadric = quadrics[classes[vertex]];
+                    quadric.add(quadrics[classes[target]]);
+                    double error = quadric.error(positions[target]);
+                    if (bestTarget[vertex] == NO_TARGET || error < bestError[vertex]){
+                        bestTarget[vertex] = target;
+                        bestError[vertex] = error;
+                    }
+                }
+            }
+        }
+
+        collapses.clear();
+        for (uint32_t v = 0; v < vertexCount; v++){
+            if (bestTarget[v] != NO_TARGET && bestError[v] <= errorLimit)
+                collapses.push_back({v, bestTarget[v], bestError[v]});
+        }
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b){
+            return a.error < b.error;
+        });
+
+        std::fill(touched.begin(), touched.end(), 0);
+        const size_t trianglesToRemove = (indexCount - targetIndexCount + 2) / 3;
+        size_t removedTriangles = 0;
+        size_t collapseCount = 0;
+        for (const Collapse& collapse : collapses){
+            if (removedTriangles >= trianglesToRemove)
+                break;
+            const uint32_t vertexClass = classes[collapse.vertex];
+            const uint32_t targetClass = classes[collapse.target];
+            if (touched[vertexClass] || touched[targetClass])
+                continue;
+
+            // the triangles kept around the vertex must not flip
+            const Vec3 targetPosition = positions[collapse.target];
+            bool flips = false;
+            size_t removed = 0;
+            for (uint32_t a = adjacencyOffsets[vertexClass]; a < adjacencyOffsets[vertexClass + 1] && !flips; a++){
+                const uint32_t* triangle = destination + size_t(adjacency[a]) * 3;
+                Vec3 corners[3];
+                bool hasTarget = false;
+                for (int k = 0; k < 3; k++){
+                    corners[k] = positions[triangle[k]];
+                    hasTarget |= classes[triangle[k]] == targetClass;
+                }
+                if (hasTarget){
+                    removed++;
+                    continue;
+                }
+                Vec3 before = cross(corners[1] - corners[0], corners[2] - corners[0]);
+                for (int k = 0; k < 3; k++){
+                    if (classes[triangle[k]] == vertexClass)
+                        corners[k] = targetPosition;
+                }
+                Vec3 after = cross(corners[1] - corners[0], corners[2] - corners[0]);
+                flips = dot(before, after) <= 0.0;
+            }
+            if (flips)
+                continue;
+
+            collapseTarget[collapse.vertex] = collapse.target;
+            quadrics[targetClass].add(quadrics[vertexClass]);
+            for (uint32_t a = adjacencyOffsets[vertexClass]; a < adjacencyOffsets[vertexClass + 1]; a++){
+                const uint32_t* triangle = destination + size_t(adjacency[a]) * 3;
+                for (int k = 0; k < 3; k++)
+                    touched[classes[triangle[k]]] = 1;
+            }
+            removedTriangles += removed;
+            maxError = std::max(maxError, collapse.error);
+            collapseCount++;
+        }
+        if (collapseCount == 0)
+            break;
+
+        // moves the collapsed vertices and drops the triangles that became degenerate
+        size_t writeIndex = 0;
+        for (size_t t = 0; t < indexCount; t += 3){
+            uint32_t a = collapseTarget[destination[t]];
+            uint32_t b = collapseTarget[destination[t + 1]];
+            uint32_t c = collapseTarget[destination[t + 2]];
+            if (classes[a] == classes[b] || classes[b] == classes[c] || classes[a] == classes[c])
+                continue;
+            destination[writeIndex++] = a;
+            destination[writeIndex++] = b;
+            destination[writeIndex++] = c;
+        }
+        indexCount = writeIndex;
+    }
+
+    if (resultError)
+        *resultError = static_cast<float>(std::sqrt(maxError));
+    return indexCount;
+}
+
+} // namespace hyd
@@ -0,0 +1,33 @@
+/*
+Simplification of indexed triangle lists by edge collapses ordered with the
+quadric error metric (Garland and Heckbert), used to build the model LODs.
+An edge collapse moves a vertex onto one of its neighbours, so the simplified
+triangles keep indexing the original vertex buffer and every LOD shares it.
+The vertices on a border or on an attribute seam (several vertices at the same
+position) are locked, the silhouette and the uv layout are preserved.
+The error is a distance in the unit of the positions.
+*/
+#pragma once
+
+// std
+#include <cstddef>
+#include <cstdint>
+
+namespace hyd
+{
+
+// writes the simplified triangles of indices to destination (indexCount elements at most) and returns
+// their index count, stops once targetIndexCount is reached or when the next collapse would exceed targetError
+// positions is the xyz of the first vertex, the vertices are positionStride bytes apart
+size_t simplifyMesh(
+    uint32_t* destination,
+    const uint32_t* indices,
+    size_t indexCount,
+    const float* positions,
+    size_t positionStride,
+    size_t vertexCount,
+    size_t targetIndexCount,
+    float targetError,
+    float* resultError = nullptr);
+
+} // namespace hyd
@@ -0,0 +1,206 @@
+#include "Meshlet.hpp"
+
+#include "Bounds.hpp"
+
+// std
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+namespace hyd
+{
+
+namespace
+{
+
+constexpr uint32_t NONE = ~0u;
+// the cone is dropped when a normal is nearly perpendicular to the axis, it would never cull
+constexpr float MIN_CONE_DOT = 0.1f;
+
+glm::vec3 positionAt(const float* positions, size_t positionStride, uint32_t vertex){
+    const float* position = reinterpret_cast<const float*>(reinterpret_cast<const uint8_t*>(positions) + vertex * positionStride);
+    return glm::vec3(position[0], position[1], position[2]);
+}
+
+// unit normal of a counter clockwise triangle, zero when it is degenerate
+glm::vec3 faceNormal(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c){
+    glm::vec3 normal = glm::cross(b - a, c - a);
+    float length = glm::length(normal);
+    return length > 0.0f ? normal / length : glm::vec3(0.0f);
+}
+
+void computeBounds(Meshlet& meshlet, const uint32_t* indices, const float* positions, size_t positionStride){
+    const uint32_t* first = indices + meshlet.firstIndex;
+    const uint32_t* last = first + meshlet.indexCount;
+    auto getPosition = [&](uint32_t vertex){ return positionAt(positions, positionStride, vertex); };
+
+    AABB aabb{};
+    for (const uint32_t* index = first; index != last; index++)
+        aabb.expand(getPosition(*index));
+    meshlet.boundingSphere = computeBoundingSphere(aabb, first, last, getPosition).asVec4();
+
+    glm::vec3 normalSum{0.0f};
+    for (const uint32_t* index = first; index != last; index += 3)
+        normalSum += faceNormal(getPosition(index[0]), getPosition(index[1]), getPosition(index[2]));
+    float length = glm::length(normalSum);
+    if (length == 0.0f){
+        meshlet.cone = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+        return;
+    }
+
+    glm::vec3 axis = normalSum / length;
+    float minDot = 1.0f;
+    for (const uint32_t* index = first; index != last; index += 3){
+        glm::vec3 normal = faceNormal(getPosition(index[0]), getPosition(index[1]), getPosition(index[2]));
+        if (normal != glm::vec3(0.0f))
+            minDot = std::min(minDot, glm::dot(normal, axis));
+    }
+    // the test compares the view direction to the axis with the sine of the spread
+    float cutoff = minDot <= MIN_CONE_DOT ? 1.0f : std::sqrt(1.0f - minDot * minDot);
+    meshlet.cone = glm::vec4(axis, cutoff);
+}
+
+} // namespace
+
+void buildMeshlets(
+    std::vector<Meshlet>& meshlets,
+    uint32_t* indices,
+    size_t indexCount,
+    const float* positions,
+    size_t positionStride,
+    size_t vertexCount){
+    const size_t triangleCount = indexCount / 3;
+    if (triangleCount == 0)
+        return;
+
+    // triangles around each vertex
+    std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+    for (size_t i = 0; i < triangleCount * 3; i++)
+        adjacencyOffsets[indices[i] + 1]++;
+    std::partial_sum(adjacencyOffsets.begin(), adjacencyOffsets.end(), adjacencyOffsets.begin());
+    std::vector<uint32_t> adjacency(triangleCount * 3);
+    std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+    for (size_t i = 0; i < triangleCount * 3; i++)
+        adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+
+    std::vector<glm::vec3> normals(triangleCount);
+    for (size_t t = 0; t < triangleCount; t++){
+        normals[t] = faceNormal(
+            positionAt(positions, positionStride, indices[t * 3 + 0]),
+            positionAt(positions, positionStride, indices[t * 3 + 1]),
+            positionAt(positions, positionStride, indices[t * 3 + 2]));
+    }
+
+    std::vector<uint8_t> emitted(triangleCount, 0);
+    // last meshlet each vertex was added to
+    std::vector<uint32_t> vertexMeshlet(vertexCount, NONE);
+    std::vector<uint32_t> order;
+    order.reserve(triangleCount);
+
+    // meshlet being grown
+    const size_t firstMeshlet = meshlets.size();
+    uint32_t current = 0;
+    uint32_t meshletFirst = 0;
+    uint32_t meshletTriangles = 0;
+    std::vector<uint32_t> meshletVertices;
+    glm::vec3 normalSum{0.0f};
+
+    auto newVertexCount = [&](uint32_t triangle){
+        uint32_t count = 0;
+        for (int k = 0; k < 3; k++)
+            count += vertexMeshlet[indices[triangle * 3 + k]] != current ? 1 : 0;
+        return count;
+    };
+
+    auto add = [&](uint32_t triangle){
+        emitted[triangle] = 1;
+        order.push_back(triangle);
+        meshletTriangles++;
+        normalSum += normals[triangle];
+        for (int k = 0; k < 3; k++){
+            uint32_t vertex = indices[triangle * 3 + k];
+            if (vertexMeshlet[vertex] != current){
+                vertexMeshlet[vertex] = current;
+                meshletVertices.push_back(vertex);
+            }
+        }
+    };
+
+    auto flush = [&](){
+        Meshlet meshlet{};
+        meshlet.firstIndex = meshletFirst * 3;
+        meshlet.indexCount = meshletTriangles * 3;
+        meshlets.push_back(meshlet);
+        current++;
+        meshletFirst = static_cast<uint32_t>(order.size());
+        meshletTriangles = 0;
+        meshletVertices.clear();
+        normalSum = glm::vec3(0.0f);
+    };
+
+    // the fitting triangle around the vertices that adds the least vertices, then faces like the meshlet
+    auto bestAround = [&](const uint32_t* vertices, size_t count){
+        uint32_t best = NONE;
+        uint32_t bestNew = 4;
+        float bestDot = 0.0f;
+        for (size_t i = 0; i < count; i++){
+            for (uint32_t a = adjacencyOffsets[vertices[i]]; a < adjacencyOffsets[vertices[i] + 1]; a++){
+                uint32_t triangle = adjacency[a];
+                if (emitted[triangle])
+                    continue;
+                uint32_t added = newVertexCount(triangle);
+                if (meshletVertices.size() + added > Meshlet::MAX_VERTICES)
+                    continue;
+                float facing = glm::dot(normals[triangle], normalSum);
+                if (added < bestNew || (added == bestNew && facing > bestDot)){
+                    best = triangle;
+                    bestNew = added;
+                    bestDot = facing;
+                }
+            }
+        }
+        return best;
+    };
+
+    size_t seed = 0;
+    while (order.size() < triangleCount){
+        uint32_t next = NONE;
+        if (meshletTriangles > 0){
+            // the neighbours of the last triangle first, then of the whole meshlet
+            next = bestAround(&indices[order.back() * 3], 3);
+            if (next == NONE)
+                next = bestAround(meshletVertices.data(), meshletVertices.size());
+            // a disconnected part only joins a meshlet that is still small
+            if (next == NONE && meshletTriangles >= Meshlet::MAX_TRIANGLES / 4){
+                flush();
+                continue;
+            }
+        }
+        if (next == NONE){
+            while (emitted[seed])
+                seed++;
+            next = static_cast<uint32_t>(seed);
+            if (meshletTriangles > 0 && meshletVertices.size() + newVertexCount(next) > Meshlet::MAX_VERTICES){
+                flush();
+                continue;
+            }
+        }
+
+        add(next);
+        if (meshletTriangles == Meshlet::MAX_TRIANGLES)
+            flush();
+    }
+    if (meshletTriangles > 0)
+        flush();
+
+    std::vector<uint32_t> reordered(triangleCount * 3);
+    for (size_t i = 0; i < order.size(); i++){
+        std::copy(indices + order[i] * 3, indices + order[i] * 3 + 3, reordered.begin() + i * 3);
+    }
+    std::copy(reordered.begin(), reordered.end(), indices);
+
+    for (size_t m = firstMeshlet; m < meshlets.size(); m++)
+        computeBounds(meshlets[m], indices, positions, positionStride);
+}
+
+} // namespace hyd
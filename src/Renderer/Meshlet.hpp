@@ -0,0 +1,54 @@
+/*
+Meshlets: small clusters of triangles (at most 64 vertices and 124 triangles)
+with their own bounds, culled one by one before the draws. A meshlet is a
+contiguous range of the index buffer, its triangles are spatially close and
+face about the same direction so its normal cone can reject it when it is seen
+from behind, which per-object culling can't do for a large mesh.
+The triangles are outward facing when counter clockwise, as for the pipelines.
+*/
+#pragma once
+
+// libs
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+// std
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace hyd
+{
+
+struct Meshlet
+{
+    static constexpr uint32_t MAX_VERTICES = 64;
+    static constexpr uint32_t MAX_TRIANGLES = 124;
+
+    uint32_t firstIndex{0};
+    uint32_t indexCount{0};
+    glm::vec4 boundingSphere{0.f}; // xyz: center, w: radius
+    // xyz: average normal, w: sine of the normals' spread, 1 when it can't be culled this way
+    glm::vec4 cone{0.f, 0.f, 1.f, 1.f};
+};
+
+// the cone test of a meshlet's bounds, in any space: true when every triangle is back facing from any point
+// of the sphere; viewOrigin is the eye (w = 1) or the view direction of an orthographic projection (w = 0)
+inline bool isConeBackFacing(const glm::vec3& center, float radius, const glm::vec3& axis, float cutoff, const glm::vec4& viewOrigin){
+    glm::vec3 view = viewOrigin.w != 0.0f ? center - glm::vec3(viewOrigin) : glm::vec3(viewOrigin);
+    return glm::dot(view, axis) >= cutoff * glm::length(view) + radius * viewOrigin.w;
+}
+
+// splits the triangles into meshlets, growing each one from its neighbours by the least new vertices,
+// and reorders indices in place so each meshlet is contiguous; the meshlets are appended to meshlets
+// with firstIndex relative to indices, positions is the xyz of the first vertex, positionStride bytes apart
+void buildMeshlets(
+    std::vector<Meshlet>& meshlets,
+    uint32_t* indices,
+    size_t indexCount,
+    const float* positions,
+    size_t positionStride,
+    size_t vertexCount);
+
+} // namespace hyd
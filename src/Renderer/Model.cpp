@@ -1,6 +1,9 @@
 #include "Model.hpp"
 
-#include "Utils.hpp"
+#include "MeshFile.hpp"
+#include "MeshOptimizer.hpp"
+#include "MeshSimplifier.hpp"
+#include "Ressources/ObjParser.hpp"
 
 // libs
 #include "stb_image.h"
@@ -12,215 +15,615 @@
 #define TINYGLTF_NO_INCLUDE_STB_IMAGE 
 #include "tiny_gltf.h"
 
-#define TINYOBJLOADER_IMPLEMENTATION
-#include "tiny_obj_loader.h"
-#define GLM_ENABLE_EXPERIMENTAL
-#include <glm/gtx/hash.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
 // std
+#include <algorithm>
 #include <cassert>
+#include <cmath>
 #include <cstring>
+#include <limits>
 #include <stdexcept>
+#include <type_traits>
 
-namespace std {
-template<>
-struct hash<hyd::Model::Vertex> {
-  size_t operator()(hyd::Model::Vertex const &vertex) const {
-    size_t seed = 0;
-    hyd::hashCombine(seed, vertex.position, vertex.color, vertex.normal, vertex.uv);
-    return seed;
-  }
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__)
+#define HYD_MODEL_X86
+#include <immintrin.h>
+#endif
+
+namespace hyd
+{
+
+namespace
+{
+
+// the simplification stops once the error reaches this part of the bounding sphere radius
+constexpr float LOD_MAX_RELATIVE_ERROR = 0.05f;
+// below that a level doesn't save anything worth a draw range
+constexpr size_t MIN_LOD_INDEX_COUNT = 3 * 64;
+// a level that removes less than a quarter of the triangles of the previous one is dropped
+constexpr float LOD_MIN_REDUCTION = 0.75f;
+
+// open addressing set of indices into an array, looked up by the hash and the equality of the elements
+// the slots only hold the index and the hash, the elements stay in their array
+class IndexTable
+{
+public:
+    explicit IndexTable(size_t expectedCount){
+        size_t capacity = 64;
+        while (capacity < expectedCount * 2)
+            capacity *= 2;
+        m_slots.assign(capacity, Slot{0, EMPTY});
+    }
+
+    // index of the element equal to the one being looked up, newIndex is inserted and returned when there is none
+    template<typename Equal>
+    uint32_t findOrInsert(uint32_t hash, uint32_t newIndex, const Equal& equal){
+        if ((m_count + 1) * 2 > m_slots.size())
+            grow();
+
+        const size_t mask = m_slots.size() - 1;
+        for (size_t i = hash & mask;; i = (i + 1) & mask){
+            Slot& slot = m_slots[i];
+            if (slot.index == EMPTY){
+                slot = Slot{hash, newIndex};
+                m_count++;
+                return newIndex;
+            }
+            if (slot.hash == hash && equal(slot.index))
+                return slot.index;
+        }
+    }
+
+private:
+    static constexpr uint32_t EMPTY = UINT32_MAX;
+
+    struct Slot
+    {
+        uint32_t hash;
+        uint32_t index;
+    };
+
+    void grow(){
+        std::vector<Slot> slots(m_slots.size() * 2, Slot{0, EMPTY});
+        const size_t mask = slots.size() - 1;
+        for (const Slot& slot : m_slots){
+            if (slot.index == EMPTY)
+                continue;
+            size_t i = slot.hash & mask;
+            while (slots[i].index != EMPTY)
+                i = (i + 1) & mask;
+            slots[i] = slot;
+        }
+        m_slots.swap(slots);
+    }
+
+    std::vector<Slot> m_slots;
+    size_t m_count{0};
 };
 
+uint32_t hashCorner(const ObjIndex& corner){
+    uint64_t h = uint64_t(uint32_t(corner.position)) * 0x9E3779B97F4A7C15ull;
+    h ^= ((uint64_t(uint32_t(corner.texcoord)) << 32) | uint32_t(corner.normal)) * 0xC2B2AE3D27D4EB4Full;
+    return static_cast<uint32_t>(h ^ (h >> 32));
+}
 
+// consistent with Vertex::operator==, -0 and 0 hash the same
+uint32_t hashVertex(const Model::Vertex& vertex){
+    const float values[] = {
+        vertex.position.x, vertex.position.y, vertex.position.z,
+        vertex.color.x, vertex.color.y, vertex.color.z,
+        vertex.normal.x, vertex.normal.y, vertex.normal.z,
+        vertex.uv.x, vertex.uv.y};
+    uint64_t h = 0;
+    for (float value : values){
+        uint32_t bits;
+        value += 0.0f;
+        std::memcpy(&bits, &value, sizeof(bits));
+        h = (h + bits) * 0x9E3779B97F4A7C15ull;
+    }
+    return static_cast<uint32_t>(h ^ (h >> 32));
 }
-namespace hyd
+
+// typed view of a glTF accessor, the elements are stride bytes apart inside the buffer
+struct AccessorView
 {
+    const unsigned char* data{nullptr};
+    size_t count{0};
+    size_t stride{0};
+    int componentType{0};
+    bool normalized{false};
+};
+
+AccessorView accessorView(const tinygltf::Model& model, int accessorIndex, int expectedType){
+    const tinygltf::Accessor& accessor = model.accessors.at(accessorIndex);
+    if (accessor.type != expectedType)
+        throw std::runtime_error("unexpected glTF accessor type");
+    if (accessor.sparse.isSparse || accessor.bufferView < 0)
+        throw std::runtime_error("sparse glTF accessors are not supported");
+
+    const tinygltf::BufferView& bufferView = model.bufferViews.at(accessor.bufferView);
+    const tinygltf::Buffer& buffer = model.buffers.at(bufferView.buffer);
+    const int stride = accessor.ByteStride(bufferView); // the element size when the view is tightly packed
+    const size_t elementSize = size_t(tinygltf::GetComponentSizeInBytes(accessor.componentType)) * tinygltf::GetNumComponentsInType(accessor.type);
+    if (stride <= 0 || bufferView.byteOffset + bufferView.byteLength > buffer.data.size() ||
+        (accessor.count > 0 && accessor.byteOffset + (accessor.count - 1) * size_t(stride) + elementSize > bufferView.byteLength))
+        throw std::runtime_error("glTF accessor out of its buffer");
+
+    AccessorView view{};
+    view.data = buffer.data.data() + bufferView.byteOffset + accessor.byteOffset;
+    view.count = accessor.count;
+    view.stride = static_cast<size_t>(stride);
+    view.componentType = accessor.componentType;
+    view.normalized = accessor.normalized;
+    return view;
+}
+
+template<typename T>
+float componentToFloat(T value, bool normalized){
+    if constexpr (std::is_integral_v<T>){
+        if (normalized)
+            return std::max(float(value) / float(std::numeric_limits<T>::max()), -1.0f);
+    }
+    return float(value);
+}
+
+// writes the N components of every element converted to float at out + i * outStride
+template<typename T, size_t N>
+void convertElements(const AccessorView& view, float* out, size_t outStride){
+    // tightly packed floats, the source is read as one contiguous array
+    if constexpr (std::is_same_v<T, float>){
+        if (view.stride == sizeof(float) * N){
+            for (size_t i = 0; i < view.count; i++)
+                std::memcpy(out + i * outStride, view.data + i * sizeof(float) * N, sizeof(float) * N);
+            return;
+        }
+    }
+
+    // interleaved accessors and integer components
+    for (size_t i = 0; i < view.count; i++){
+        T components[N];
+        std::memcpy(components, view.data + i * view.stride, sizeof(components));
+        for (size_t c = 0; c < N; c++)
+            out[i * outStride + c] = componentToFloat(components[c], view.normalized);
+    }
+}
+
+// out points to the attribute in the first vertex, the elements are written a vertex apart
+template<size_t N>
+void readElements(const AccessorView& view, float* out){
+    static_assert(sizeof(Model::Vertex) % sizeof(float) == 0, "the vertex attributes are packed floats");
+    constexpr size_t outStride = sizeof(Model::Vertex) / sizeof(float);
+    switch (view.componentType){
+    case TINYGLTF_COMPONENT_TYPE_FLOAT: convertElements<float, N>(view, out, outStride); break;
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE: convertElements<uint8_t, N>(view, out, outStride); break;
+    case TINYGLTF_COMPONENT_TYPE_BYTE: convertElements<int8_t, N>(view, out, outStride); break;
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT: convertElements<uint16_t, N>(view, out, outStride); break;
+    case TINYGLTF_COMPONENT_TYPE_SHORT: convertElements<int16_t, N>(view, out, outStride); break;
+    default: throw std::runtime_error("unsupported glTF component type");
+    }
+}
+
+// indices are tightly packed, the conversion loop vectorizes
+template<typename T>
+void offsetIndices(const unsigned char* data, size_t count, uint32_t vertexStart, uint32_t* out){
+    for (size_t i = 0; i < count; i++){
+        T index;
+        std::memcpy(&index, data + i * sizeof(T), sizeof(T));
+        out[i] = uint32_t(index) + vertexStart;
+    }
+}
+
+// normalizes the normals 4 at a time, zero normals are left as is
+void normalizeNormals(Model::Vertex* vertices, size_t count){
+    size_t i = 0;
+#ifdef HYD_MODEL_X86
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    for (; i + 4 <= count; i += 4){
+        Model::Vertex* v = vertices + i;
+        __m128 x = _mm_setr_ps(v[0].normal.x, v[1].normal.x, v[2].normal.x, v[3].normal.x);
+        __m128 y = _mm_setr_ps(v[0].normal.y, v[1].normal.y, v[2].normal.y, v[3].normal.y);
+        __m128 z = _mm_setr_ps(v[0].normal.z, v[1].normal.z, v[2].normal.z, v[3].normal.z);
+        __m128 lengthSquared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z));
+        __m128 scale = _mm_div_ps(one, _mm_sqrt_ps(lengthSquared));
+        scale = _mm_and_ps(scale, _mm_cmpgt_ps(lengthSquared, zero));
+        scale = _mm_or_ps(scale, _mm_andnot_ps(_mm_cmpgt_ps(lengthSquared, zero), one));
+        alignas(16) float sx[4], sy[4], sz[4];
+        _mm_store_ps(sx, _mm_mul_ps(x, scale));
+        _mm_store_ps(sy, _mm_mul_ps(y, scale));
+        _mm_store_ps(sz, _mm_mul_ps(z, scale));
+        for (int k = 0; k < 4; k++)
+            v[k].normal = glm::vec3(sx[k], sy[k], sz[k]);
+    }
+#endif
+    for (; i < count; i++){
+        float lengthSquared = glm::dot(vertices[i].normal, vertices[i].normal);
+        if (lengthSquared > 0.0f)
+            vertices[i].normal = vertices[i].normal * (1.0f / std::sqrt(lengthSquared));
+    }
+}
+
+} // namespace
+
+Model::Model(Device& device, GeometryPool& geometryPool):
+m_device{device}, m_geometryPool{geometryPool}{}
+
+Model::Model(Device& device, GeometryPool& geometryPool, const Model::Builder &builder):
+m_device{device}, m_geometryPool{geometryPool}{
+    upload(builder);
+}
+
+// the models are released once the device is idle, the range is not read by the GPU anymore
+Model::~Model(){
+    if (m_uploaded)
+        m_geometryPool.free(m_geometry);
+}
+
+void Model::upload(const Model::Builder &builder){
+    const uint32_t vertexCount = static_cast<uint32_t>(builder.vertices.size());
+    const uint32_t indexCount = static_cast<uint32_t>(builder.indices.size());
+    m_positionDecode = computePositionDecode(builder.aabb);
+
+    std::vector<PackedVertex> vertices(vertexCount);
+    packVertices(builder.vertices.data(), vertexCount, m_positionDecode, vertices.data());
+
+    const VkIndexType indexType = chooseIndexType(vertexCount);
+    if (indexType == VK_INDEX_TYPE_UINT16){
+        std::vector<uint16_t> indices(builder.indices.begin(), builder.indices.end());
+        upload(vertices.data(), vertexCount, indices.data(), indexType, indexCount);
+    } else {
+        upload(vertices.data(), vertexCount, builder.indices.data(), indexType, indexCount);
+    }
+    m_aabb = builder.aabb;
+    m_boundingSphere = builder.boundingSphere;
+    m_primitives = builder.primitives;
+    if (!builder.lods.empty())
+        m_lods = builder.lods;
+    m_meshlets = builder.meshlets;
+}
+
+void Model::upload(const MeshFile &meshFile){
+    upload(meshFile.getVertices(), meshFile.getVertexCount(), meshFile.getIndices(), meshFile.getIndexType(), meshFile.getIndexCount());
+    m_aabb = meshFile.getAABB();
+    m_boundingSphere = meshFile.getBoundingSphere();
+    m_primitives = meshFile.getPrimitives();
+    if (!meshFile.getLods().empty())
+        m_lods = meshFile.getLods();
+    m_meshlets = meshFile.getMeshlets();
+    // the vertices were packed with the bounds of the file
+    m_positionDecode = computePositionDecode(m_aabb);
+}
+
+void Model::upload(const PackedVertex* vertices, uint32_t vertexCount, const void* indices, VkIndexType indexType, uint32_t indexCount){
+    assert(!m_uploaded && "model already uploaded");
+    m_vertexCount = vertexCount;
+    assert(m_vertexCount >= 3 && "Vertex count must be at least 3"); // at least 1 triangle
+    m_indexCount = indexCount;
+    m_hasIndexBuffer = m_indexCount > 0;
+    m_indexType = indexType;
+
+    m_geometry = m_geometryPool.allocate(m_vertexCount, m_indexCount, m_indexType);
+    if (m_geometryPool.hasPositionStream()){
+        // de-interleaved copy for the depth only passes
+        std::vector<PackedPosition> positions(vertexCount);
+        for (uint32_t i = 0; i < vertexCount; i++)
+            std::memcpy(positions[i].position, vertices[i].position, sizeof(PackedPosition::position));
+        m_geometryPool.upload(m_geometry, vertices, indices, positions.data());
+    } else {
+        m_geometryPool.upload(m_geometry, vertices, indices);
+    }
+    // read after the copies were recorded, a batch submitted in between only makes the token later
+    m_uploadToken = m_device.uploadContext().getPendingToken();
+    m_uploaded = true;
+    // a single level until the caller sets the simplified ones
+    m_lods.assign(1, Lod{0, m_indexCount, 0.0f, 0, 0});
+}
 
-Model::Model(Device& device, const Model::Builder &builder):
-m_device{device}{
-    createVertexBuffers(builder.vertices);
-    createIndexBuffers(builder.indices);
+uint32_t Model::selectLod(float maxError) const {
+    uint32_t lod = 0;
+    // the errors grow with the level
+    while (lod + 1 < m_lods.size() && m_lods[lod + 1].error <= maxError)
+        lod++;
+    return lod;
 }
 
-Model::~Model(){}
+bool Model::isResident(){
+    if (!m_resident && m_uploaded)
+        m_resident = m_device.uploadContext().isComplete(m_uploadToken);
+    return m_resident;
+}
 
 
 std::unique_ptr<Model> Model::createModelFromFile(
-    Device& device, const std::string& filepath){
+    Device& device, GeometryPool& geometryPool, const std::string& filepath){
+    if (auto meshFile = MeshFile::openCooked(filepath)){
+        auto model = std::make_unique<Model>(device, geometryPool);
+        model->upload(*meshFile);
+        return model;
+    }
+
+    // same levels as the asynchronous loads of the MeshManager
     Builder builder{};
+    builder.loadModel(filepath);
+    builder.generateLods();
+    return std::make_unique<Model>(device, geometryPool, builder);
+}
 
+void Model::Builder::loadModel(const std::string& filepath, ThreadPool* threadPool){
     if(filepath.substr(filepath.find_last_of(".") + 1) == "obj")
-        builder.loadOBJModel(filepath);
+        loadOBJModel(filepath, threadPool);
 
-    else if(filepath.substr(filepath.find_last_of(".") + 1) == "gltf")
-        builder.loadGLTFModel(filepath);
+    else if(filepath.substr(filepath.find_last_of(".") + 1) == "gltf" || filepath.substr(filepath.find_last_of(".") + 1) == "glb")
+        loadGLTFModel(filepath);
 
     else 
         throw std::runtime_error("unable to open file" + filepath);
-
-    return std::make_unique<Model>(device, builder);
 }
 
 
 void Model::bind(VkCommandBuffer commandBuffer){
-    VkBuffer buffers[] = {m_vertexBuffer->getBuffer()};
-    VkDeviceSize offsets[] = {0};
-    vkCmdBindVertexBuffers(commandBuffer, 0, 1, buffers, offsets);
-    
-    if (m_hasIndexBuffer) {
-        vkCmdBindIndexBuffer(commandBuffer, m_indexBuffer->getBuffer(), 0, VK_INDEX_TYPE_UINT32);
+    m_geometryPool.bind(commandBuffer, m_geometry.page);
+}
+
+void Model::bindPositions(VkCommandBuffer commandBuffer){
+    m_geometryPool.bindPositions(commandBuffer, m_geometry.page);
+}
+
+void Model::pushPositionDecode(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout){
+    vkCmdPushConstants(
+        commandBuffer,
+        pipelineLayout,
+        VK_SHADER_STAGE_VERTEX_BIT,
+        0,
+        sizeof(PositionDecode),
+        &m_positionDecode);
+}
+
+void Model::draw(VkCommandBuffer commandBuffer, uint32_t instanceCount, uint32_t firstInstance, uint32_t lod){
+    if (m_hasIndexBuffer){
+        const Lod& range = m_lods[lod];
+        vkCmdDrawIndexed(commandBuffer, range.indexCount, instanceCount, m_geometry.firstIndex + range.firstIndex, getVertexOffset(), firstInstance);
+    } else {
+        vkCmdDraw(commandBuffer, m_vertexCount, instanceCount, m_geometry.vertexOffset, firstInstance);
     }
 }
 
-void Model::draw(VkCommandBuffer commandBuffer){
+void Model::drawIndirect(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize offset, VkBuffer countBuffer, VkDeviceSize countOffset, uint32_t drawCount){
     if (m_hasIndexBuffer){
-        vkCmdDrawIndexed(commandBuffer, m_indexCount, 1, 0, 0, 0);
+        if (countBuffer != VK_NULL_HANDLE)
+            vkCmdDrawIndexedIndirectCount(commandBuffer, buffer, offset, countBuffer, countOffset, drawCount, sizeof(VkDrawIndexedIndirectCommand));
+        else
+            vkCmdDrawIndexedIndirect(commandBuffer, buffer, offset, drawCount, sizeof(VkDrawIndexedIndirectCommand));
     } else {
-        vkCmdDraw(commandBuffer, m_vertexCount, 1, 0, 0);
+        if (countBuffer != VK_NULL_HANDLE)
+            vkCmdDrawIndirectCount(commandBuffer, buffer, offset, countBuffer, countOffset, drawCount, sizeof(VkDrawIndirectCommand));
+        else
+            vkCmdDrawIndirect(commandBuffer, buffer, offset, drawCount, sizeof(VkDrawIndirectCommand));
     }
 }
 
 
-void Model::createVertexBuffers(const std::vector<Vertex> &vertices){
-    m_vertexCount = static_cast<uint32_t>(vertices.size());
-    assert(m_vertexCount >= 3 && "Vertex count must be at least 3"); // at least 1 triangle
-    VkDeviceSize bufferSize{sizeof(vertices[0]) * m_vertexCount};
-    uint32_t vertexSize = sizeof(vertices[0]);
-
-    Buffer stagingBuffer{
-        m_device,
-        vertexSize,
-        m_vertexCount,
-        VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-    };
+void Model::Builder::computeBounds(){
+    aabb = AABB{};
+    for (const auto& vertex : vertices){
+        aabb.expand(vertex.position);
+    }
+    boundingSphere = computeBoundingSphere(aabb, vertices.begin(), vertices.end(),
+        [](const Vertex& vertex){ return vertex.position; });
+}
 
 
-    stagingBuffer.map();
-    stagingBuffer.writeToBuffer( (void*) vertices.data());
+void Model::Builder::optimize(){
+    // the triangles stay in their primitive, the OBJ models are a single range
+    std::vector<std::pair<uint32_t, uint32_t>> ranges;
+    for (const auto& primitive : primitives){
+        ranges.emplace_back(primitive.firstIndex, primitive.indexCount);
+    }
+    if (ranges.empty())
+        ranges.emplace_back(0, lods.empty() ? static_cast<uint32_t>(indices.size()) : lods[0].indexCount);
+    // the simplified levels follow the full mesh
+    for (size_t i = 1; i < lods.size(); i++){
+        ranges.emplace_back(lods[i].firstIndex, lods[i].indexCount);
+    }
 
-    m_vertexBuffer = std::make_unique<Buffer>(
-        m_device,
-        vertexSize,
-        m_vertexCount,
-        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
-    );
+    std::vector<uint32_t> local;
+    for (const auto& [firstIndex, indexCount] : ranges){
+        if (indexCount < 6)
+            continue;
+        // the optimizers work on the vertices the range refers to
+        uint32_t* range = indices.data() + firstIndex;
+        auto [minIndex, maxIndex] = std::minmax_element(range, range + indexCount);
+        const uint32_t base = *minIndex;
+        const size_t vertexCount = size_t(*maxIndex - base) + 1;
+
+        local.assign(range, range + indexCount);
+        for (auto& index : local)
+            index -= base;
+        optimizeVertexCache(local.data(), local.size(), vertexCount);
+        optimizeOverdraw(local.data(), local.size(), &vertices[base].position.x, sizeof(Vertex), vertexCount);
+        for (size_t i = 0; i < local.size(); i++)
+            range[i] = local[i] + base;
+    }
 
-    m_device.copyBuffer(stagingBuffer.getBuffer(), m_vertexBuffer->getBuffer(), bufferSize);
+    std::vector<uint32_t> remap = vertexFetchRemap(indices.data(), indices.size(), vertices.size());
+    std::vector<Vertex> reordered(vertices.size());
+    for (size_t i = 0; i < vertices.size(); i++)
+        reordered[remap[i]] = vertices[i];
+    vertices.swap(reordered);
+    for (auto& index : indices)
+        index = remap[index];
 }
 
-void Model::createIndexBuffers(const std::vector<uint32_t> &indices){
-    m_indexCount = static_cast<uint32_t>(indices.size());
-    m_hasIndexBuffer = m_indexCount > 0;
+void Model::Builder::generateLods(){
+    if (!lods.empty() || indices.empty())
+        return;
 
-    if (!m_hasIndexBuffer){
+    const size_t baseCount = indices.size();
+    lods.push_back(Lod{0, static_cast<uint32_t>(baseCount), 0.0f, 0, 0});
+
+    const float maxError = boundingSphere.radius * LOD_MAX_RELATIVE_ERROR;
+    std::vector<uint32_t> simplified(baseCount);
+    for (uint32_t level = 1; level < MAX_LOD_COUNT; level++){
+        const size_t targetCount = (baseCount >> level) / 3 * 3;
+        if (targetCount < MIN_LOD_INDEX_COUNT)
+            break;
+
+        // each level is simplified from the full mesh, its error is measured against it
+        float error = 0.0f;
+        const size_t count = simplifyMesh(simplified.data(), indices.data(), baseCount,
+            &vertices[0].position.x, sizeof(Vertex), vertices.size(), targetCount, maxError, &error);
+        const Lod& previous = lods.back();
+        if (count == 0 || count > previous.indexCount * LOD_MIN_REDUCTION)
+            break;
+
+        optimizeVertexCache(simplified.data(), count, vertices.size());
+        Lod lod{};
+        lod.firstIndex = static_cast<uint32_t>(indices.size());
+        lod.indexCount = static_cast<uint32_t>(count);
+        // the selection expects the errors to grow with the level
+        lod.error = std::max(error, previous.error);
+        indices.insert(indices.end(), simplified.begin(), simplified.begin() + count);
+        lods.push_back(lod);
+    }
+}
+
+void Model::Builder::buildMeshlets(){
+    if (!meshlets.empty() || indices.empty())
         return;
+    if (lods.empty())
+        lods.push_back(Lod{0, static_cast<uint32_t>(indices.size()), 0.0f, 0, 0});
+
+    for (size_t level = 0; level < lods.size(); level++){
+        Lod& lod = lods[level];
+        // the meshlets of the full mesh don't cross its primitives
+        std::vector<std::pair<uint32_t, uint32_t>> ranges;
+        if (level == 0){
+            for (const auto& primitive : primitives)
+                ranges.emplace_back(primitive.firstIndex, primitive.indexCount);
+        }
+        if (ranges.empty())
+            ranges.emplace_back(lod.firstIndex, lod.indexCount);
+
+        lod.firstMeshlet = static_cast<uint32_t>(meshlets.size());
+        for (const auto& [firstIndex, indexCount] : ranges){
+            const size_t first = meshlets.size();
+            hyd::buildMeshlets(meshlets, indices.data() + firstIndex, indexCount,
+                &vertices[0].position.x, sizeof(Vertex), vertices.size());
+            for (size_t m = first; m < meshlets.size(); m++)
+                meshlets[m].firstIndex += firstIndex;
+        }
+        lod.meshletCount = static_cast<uint32_t>(meshlets.size()) - lod.firstMeshlet;
     }
-    VkDeviceSize bufferSize{sizeof(indices[0]) * m_indexCount};
-    uint32_t indexSize = sizeof(indices[0]);
-
-    Buffer stagingBuffer{
-        m_device,
-        indexSize,
-        m_indexCount,
-        VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-    };
+}
+
+const hyd::Vertex::Format& Model::getVertexFormat(){
+    static const hyd::Vertex::Format format{VERTEX_FORMAT};
+    assert(format.getStride() == sizeof(PackedVertex) && "PackedVertex doesn't match VERTEX_FORMAT");
+    return format;
+}
+
+const hyd::Vertex::Format& Model::getPositionFormat(){
+    static const hyd::Vertex::Format format{POSITION_FORMAT};
+    assert(format.getStride() == sizeof(PackedPosition) && "PackedPosition doesn't match POSITION_FORMAT");
+    return format;
+}
+
+VkPushConstantRange Model::getPositionDecodeRange(){
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(PositionDecode);
+    return pushConstantRange;
+}
 
-    stagingBuffer.map();
-    stagingBuffer.writeToBuffer( (void*) indices.data());
-
-    m_indexBuffer = std::make_unique<Buffer>(
-        m_device,
-        indexSize,
-        m_indexCount,
-        VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
-    );
-
-    m_device.copyBuffer(stagingBuffer.getBuffer(), m_indexBuffer->getBuffer(), bufferSize);
-}
-
-
-std::vector<VkVertexInputBindingDescription> Model::Vertex::getBindingDescriptions(){
-    std::vector<VkVertexInputBindingDescription> bindingDescriptions(1);
-    bindingDescriptions[0].binding = 0;    
-    bindingDescriptions[0].stride = sizeof(Vertex);    
-    bindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-
-    return bindingDescriptions;
-}
-
-std::vector<VkVertexInputAttributeDescription> Model::Vertex::getAttributesDescriptions(){
-    std::vector<VkVertexInputAttributeDescription> attributeDescriptions{};
-    //                              {location, binding, format, offset}
-    attributeDescriptions.push_back({0, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, position)});
-    attributeDescriptions.push_back({1, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, color)});
-    attributeDescriptions.push_back({2, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, normal)});
-    attributeDescriptions.push_back({3, 0, VK_FORMAT_R32G32_SFLOAT, offsetof(Vertex, uv)});
-    
-    return attributeDescriptions;
-}
-
-
-void Model::Builder::loadOBJModel(const std::string &filepath) {
-    tinyobj::attrib_t attrib;
-    std::vector<tinyobj::shape_t> shapes;
-    std::vector<tinyobj::material_t> materials;
-    std::string warn, err;
-
-  
-  if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, filepath.c_str())) {
-    throw std::runtime_error(warn + err);
-  }
-
-  vertices.clear();
-  indices.clear();
-
-  std::unordered_map<Vertex, uint32_t> uniqueVertices{};
-  for (const auto &shape : shapes) {
-    for (const auto &index : shape.mesh.indices) {
-      Vertex vertex{};
-
-      if (index.vertex_index >= 0) {
-        vertex.position = {
-            attrib.vertices[3 * index.vertex_index + 0],
-            attrib.vertices[3 * index.vertex_index + 1],
-            attrib.vertices[3 * index.vertex_index + 2],
-        };
-
-        vertex.color = {
-            attrib.colors[3 * index.vertex_index + 0],
-            attrib.colors[3 * index.vertex_index + 1],
-            attrib.colors[3 * index.vertex_index + 2],
-        };
-      }
-
-      if (index.normal_index >= 0) {
-        vertex.normal = {
-            attrib.normals[3 * index.normal_index + 0],
-            attrib.normals[3 * index.normal_index + 1],
-            attrib.normals[3 * index.normal_index + 2],
-        };
-      }
-
-      if (index.texcoord_index >= 0) {
-        vertex.uv = {
-            attrib.texcoords[2 * index.texcoord_index + 0],
-            attrib.texcoords[2 * index.texcoord_index + 1],
-        };
-      }
-
-      if (uniqueVertices.count(vertex) == 0) {
-        uniqueVertices[vertex] = static_cast<uint32_t>(vertices.size());
-        vertices.push_back(vertex);
-      }
-      indices.push_back(uniqueVertices[vertex]);
+Model::PositionDecode Model::computePositionDecode(const AABB& aabb){
+    PositionDecode decode{};
+    if (aabb.isEmpty())
+        return decode;
+
+    const glm::vec3 extent = aabb.extent();
+    decode.offset = glm::vec4(aabb.center(), 0.0f);
+    decode.scale = glm::vec4(
+        extent.x > 0.0f ? extent.x : 1.0f,
+        extent.y > 0.0f ? extent.y : 1.0f,
+        extent.z > 0.0f ? extent.z : 1.0f,
+        0.0f);
+    return decode;
+}
+
+void Model::packVertices(const Vertex* vertices, size_t count, const PositionDecode& decode, PackedVertex* packed){
+    using namespace hyd::Vertex;
+    const glm::vec3 offset = glm::vec3(decode.offset);
+    const glm::vec3 inverseScale = 1.0f / glm::vec3(decode.scale);
+    for (size_t i = 0; i < count; i++){
+        const Vertex& vertex = vertices[i];
+        PackedVertex& out = packed[i];
+
+        const glm::vec3 position = (vertex.position - offset) * inverseScale;
+        out.position[0] = packSnorm16(position.x);
+        out.position[1] = packSnorm16(position.y);
+        out.position[2] = packSnorm16(position.z);
+        out.position[3] = 0;
+
+        out.color[0] = packUnorm8(vertex.color.r);
+        out.color[1] = packUnorm8(vertex.color.g);
+        out.color[2] = packUnorm8(vertex.color.b);
+        out.color[3] = 255;
+
+        const glm::vec2 normal = octEncode(vertex.normal);
+        out.normal[0] = packSnorm16(normal.x);
+        out.normal[1] = packSnorm16(normal.y);
+
+        out.uv[0] = packHalf(vertex.uv.x);
+        out.uv[1] = packHalf(vertex.uv.y);
     }
-  }
+}
+
+VkIndexType Model::chooseIndexType(uint32_t vertexCount){
+    // primitive restart is disabled, 0xffff is a valid index
+    return vertexCount <= (1u << 16) ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+}
+
+
+void Model::Builder::loadOBJModel(const std::string &filepath, ThreadPool* threadPool) {
+    ObjData obj = parseObj(filepath, threadPool);
+
+    vertices.clear();
+    indices.clear();
+    indices.reserve(obj.corners.size());
+
+    // the vertex is only built for the first corner of each index triplet, it is then
+    // deduplicated by value so that repeated attributes in the file still share a vertex
+    const size_t expectedCount = std::max({obj.positions.size() / 3, obj.normals.size() / 3, obj.texcoords.size() / 2});
+    IndexTable corners{expectedCount};
+    IndexTable uniqueVertices{expectedCount};
+    for (uint32_t c = 0; c < obj.corners.size(); c++) {
+        const ObjIndex& corner = obj.corners[c];
+        uint32_t first = corners.findOrInsert(hashCorner(corner), c,
+            [&](uint32_t other){ return obj.corners[other] == corner; });
+        if (first != c) {
+            indices.push_back(indices[first]);
+            continue;
+        }
+
+        Vertex vertex{};
+        vertex.position = glm::make_vec3(&obj.positions[3 * size_t(corner.position)]);
+        vertex.color = glm::make_vec3(&obj.colors[3 * size_t(corner.position)]);
+        if (corner.normal >= 0)
+            vertex.normal = glm::make_vec3(&obj.normals[3 * size_t(corner.normal)]);
+        if (corner.texcoord >= 0)
+            vertex.uv = glm::make_vec2(&obj.texcoords[2 * size_t(corner.texcoord)]);
+
+        const uint32_t vertexCount = static_cast<uint32_t>(vertices.size());
+        uint32_t index = uniqueVertices.findOrInsert(hashVertex(vertex), vertexCount,
+            [&](uint32_t other){ return vertices[other] == vertex; });
+        if (index == vertexCount)
+            vertices.push_back(vertex);
+        indices.push_back(index);
+    }
+
+    computeBounds();
 }
 
 
@@ -230,112 +633,119 @@ void Model::Builder::loadGLTFModel(const std::string &filepath) {
     tinygltf::TinyGLTF gltfContext;
     std::string error, warning;
 
-    bool fileLoaded = gltfContext.LoadASCIIFromFile(&glTFInput, &error, &warning, filepath);
-
+    const bool binary = filepath.substr(filepath.find_last_of(".") + 1) == "glb";
+    bool fileLoaded = binary ?
+        gltfContext.LoadBinaryFromFile(&glTFInput, &error, &warning, filepath) :
+        gltfContext.LoadASCIIFromFile(&glTFInput, &error, &warning, filepath);
+    if (!fileLoaded)
+        throw std::runtime_error("failed to load " + filepath + ": " + error);
 
     vertices.clear(); // TODO for animated model update depending on vertex attributes ???
     indices.clear();
-	if (fileLoaded) {
-            
-        const tinygltf::Scene& scene = glTFInput.scenes[0];
-        for (size_t i = 0; i < scene.nodes.size(); i++) {
-            const tinygltf::Node node = glTFInput.nodes[scene.nodes[i]];
-
-            
-            // If the node contains mesh data, we load vertices and indices from the buffers
-            // In glTF this is done via accessors and buffer views
-            if (node.mesh > -1) {
-                const tinygltf::Mesh mesh = glTFInput.meshes[node.mesh];
-                for (size_t i = 0; i < mesh.primitives.size(); i++) {
-                    const tinygltf::Primitive& glTFPrimitive = mesh.primitives[i];
-                    uint32_t firstIndex = static_cast<uint32_t>(indices.size());
-                    uint32_t vertexStart = static_cast<uint32_t>(vertices.size());
-                    uint32_t indexCount = 0;
-                    // Vertices
-				    {
-                    const float* positionBuffer = nullptr;
-                    const float* normalsBuffer = nullptr;
-                    const float* texCoordsBuffer = nullptr;
-                    size_t vertexCount = 0;
-
-                        // Get buffer data for vertex normals
-                        if (glTFPrimitive.attributes.find("POSITION") != glTFPrimitive.attributes.end()) {
-                            const tinygltf::Accessor& accessor = glTFInput.accessors[glTFPrimitive.attributes.find("POSITION")->second];
-                            const tinygltf::BufferView& view = glTFInput.bufferViews[accessor.bufferView];
-                            positionBuffer = reinterpret_cast<const float*>(&(glTFInput.buffers[view.buffer].data[accessor.byteOffset + view.byteOffset]));
-                            vertexCount = accessor.count;
-                        }
-                        // Get buffer data for vertex normals
-                        if (glTFPrimitive.attributes.find("NORMAL") != glTFPrimitive.attributes.end()) {
-                            const tinygltf::Accessor& accessor = glTFInput.accessors[glTFPrimitive.attributes.find("NORMAL")->second];
-                            const tinygltf::BufferView& view = glTFInput.bufferViews[accessor.bufferView];
-                            normalsBuffer = reinterpret_cast<const float*>(&(glTFInput.buffers[view.buffer].data[accessor.byteOffset + view.byteOffset]));
-                        }
-                        // Get buffer data for vertex texture coordinates
-                        // glTF supports multiple sets, we only load the first one
-                        if (glTFPrimitive.attributes.find("TEXCOORD_0") != glTFPrimitive.attributes.end()) {
-                            const tinygltf::Accessor& accessor = glTFInput.accessors[glTFPrimitive.attributes.find("TEXCOORD_0")->second];
-                            const tinygltf::BufferView& view = glTFInput.bufferViews[accessor.bufferView];
-                            texCoordsBuffer = reinterpret_cast<const float*>(&(glTFInput.buffers[view.buffer].data[accessor.byteOffset + view.byteOffset]));
-                        }
-
-                        					// Append data to model's vertex buffer
-                        for (size_t v = 0; v < vertexCount; v++) {
-                            Vertex vert{};
-                            vert.position = glm::vec4(glm::make_vec3(&positionBuffer[v * 3]), 1.0f);
-                            vert.normal = glm::normalize(glm::vec3(normalsBuffer ? glm::make_vec3(&normalsBuffer[v * 3]) : glm::vec3(0.0f)));
-                            vert.uv = texCoordsBuffer ? glm::make_vec2(&texCoordsBuffer[v * 2]) : glm::vec3(0.0f);
-                            vert.color = glm::vec3(1.0f);
-                            vertices.push_back(vert);
-                        }
-                    }
-                    // Indices
-                    {
-                        const tinygltf::Accessor& accessor = glTFInput.accessors[glTFPrimitive.indices];
-                        const tinygltf::BufferView& bufferView = glTFInput.bufferViews[accessor.bufferView];
-                        const tinygltf::Buffer& buffer = glTFInput.buffers[bufferView.buffer];
-
-                        indexCount += static_cast<uint32_t>(accessor.count);
-
-                        // glTF supports different component types of indices
-                        switch (accessor.componentType) {
-                        case TINYGLTF_PARAMETER_TYPE_UNSIGNED_INT: {
-                            const uint32_t* buf = reinterpret_cast<const uint32_t*>(&buffer.data[accessor.byteOffset + bufferView.byteOffset]);
-                            for (size_t index = 0; index < accessor.count; index++) {
-                                indices.push_back(buf[index] + vertexStart);
-                            }
-                            break;
-                        }
-                        case TINYGLTF_PARAMETER_TYPE_UNSIGNED_SHORT: {
-                            const uint16_t* buf = reinterpret_cast<const uint16_t*>(&buffer.data[accessor.byteOffset + bufferView.byteOffset]);
-                            for (size_t index = 0; index < accessor.count; index++) {
-                                indices.push_back(buf[index] + vertexStart);
-                            }
-                            break;
-                        }
-                        case TINYGLTF_PARAMETER_TYPE_UNSIGNED_BYTE: {
-                            const uint8_t* buf = reinterpret_cast<const uint8_t*>(&buffer.data[accessor.byteOffset + bufferView.byteOffset]);
-                            for (size_t index = 0; index < accessor.count; index++) {
-                                indices.push_back(buf[index] + vertexStart);
-                            }
-                            break;
-                        }
-                        default:
-                            std::cerr << "Index component type " << accessor.componentType << " not supported!" << std::endl;
-                            return;
-                        }
-                    }
-                    // Primitive primitive{};
-                    // primitive.firstIndex = firstIndex;
-                    // primitive.indexCount = indexCount;
-                    // primitive.materialIndex = glTFPrimitive.material;
-                    // node.mesh.primitives.push_back(primitive);
+    primitives.clear();
+
+    const tinygltf::Scene& scene = glTFInput.scenes.at(glTFInput.defaultScene > -1 ? glTFInput.defaultScene : 0);
+
+    // the output is sized once from the accessor counts
+    size_t vertexTotal = 0, indexTotal = 0, primitiveTotal = 0;
+    for (int nodeIndex : scene.nodes) {
+        const tinygltf::Node& node = glTFInput.nodes.at(nodeIndex);
+        if (node.mesh < 0)
+            continue;
+        for (const tinygltf::Primitive& glTFPrimitive : glTFInput.meshes.at(node.mesh).primitives) {
+            auto position = glTFPrimitive.attributes.find("POSITION");
+            if (position == glTFPrimitive.attributes.end())
+                continue;
+            const size_t vertexCount = glTFInput.accessors.at(position->second).count;
+            vertexTotal += vertexCount;
+            indexTotal += glTFPrimitive.indices > -1 ? glTFInput.accessors.at(glTFPrimitive.indices).count : vertexCount;
+            primitiveTotal++;
+        }
+    }
+    vertices.reserve(vertexTotal);
+    indices.reserve(indexTotal);
+    primitives.reserve(primitiveTotal);
+
+    for (int nodeIndex : scene.nodes) {
+        const tinygltf::Node& node = glTFInput.nodes.at(nodeIndex);
+
+        // If the node contains mesh data, we load vertices and indices from the buffers
+        // In glTF this is done via accessors and buffer views
+        if (node.mesh < 0)
+            continue;
+        const tinygltf::Mesh& mesh = glTFInput.meshes.at(node.mesh);
+        for (const tinygltf::Primitive& glTFPrimitive : mesh.primitives) {
+            auto position = glTFPrimitive.attributes.find("POSITION");
+            if (position == glTFPrimitive.attributes.end())
+                continue;
+
+            const uint32_t firstIndex = static_cast<uint32_t>(indices.size());
+            const uint32_t vertexStart = static_cast<uint32_t>(vertices.size());
+
+            // Vertices, every attribute is converted straight from its buffer view
+            const AccessorView positions = accessorView(glTFInput, position->second, TINYGLTF_TYPE_VEC3);
+            vertices.resize(vertexStart + positions.count);
+            Vertex* out = vertices.data() + vertexStart;
+            readElements<3>(positions, &out[0].position.x);
+            for (size_t i = 0; i < positions.count; i++)
+                out[i].color = glm::vec3(1.0f);
+
+            auto normal = glTFPrimitive.attributes.find("NORMAL");
+            if (normal != glTFPrimitive.attributes.end()) {
+                AccessorView normals = accessorView(glTFInput, normal->second, TINYGLTF_TYPE_VEC3);
+                normals.count = std::min(normals.count, positions.count);
+                readElements<3>(normals, &out[0].normal.x);
+                normalizeNormals(out, normals.count);
+            }
+
+            // glTF supports multiple sets, we only load the first one
+            auto texCoord = glTFPrimitive.attributes.find("TEXCOORD_0");
+            if (texCoord != glTFPrimitive.attributes.end()) {
+                AccessorView texCoords = accessorView(glTFInput, texCoord->second, TINYGLTF_TYPE_VEC2);
+                texCoords.count = std::min(texCoords.count, positions.count);
+                readElements<2>(texCoords, &out[0].uv.x);
+            }
+
+            // Indices, a primitive without indices draws its vertices in order
+            if (glTFPrimitive.indices > -1) {
+                const AccessorView indexView = accessorView(glTFInput, glTFPrimitive.indices, TINYGLTF_TYPE_SCALAR);
+                indices.resize(firstIndex + indexView.count);
+                uint32_t* indexOut = indices.data() + firstIndex;
+
+                // glTF supports different component types of indices
+                switch (indexView.componentType) {
+                case TINYGLTF_PARAMETER_TYPE_UNSIGNED_INT: offsetIndices<uint32_t>(indexView.data, indexView.count, vertexStart, indexOut); break;
+                case TINYGLTF_PARAMETER_TYPE_UNSIGNED_SHORT: offsetIndices<uint16_t>(indexView.data, indexView.count, vertexStart, indexOut); break;
+                case TINYGLTF_PARAMETER_TYPE_UNSIGNED_BYTE: offsetIndices<uint8_t>(indexView.data, indexView.count, vertexStart, indexOut); break;
+                default:
+                    throw std::runtime_error("unsupported glTF index component type in " + filepath);
                 }
+            } else {
+                indices.resize(firstIndex + positions.count);
+                for (size_t i = 0; i < positions.count; i++)
+                    indices[firstIndex + i] = vertexStart + static_cast<uint32_t>(i);
             }
+
+            Primitive primitive{};
+            primitive.firstIndex = firstIndex;
+            primitive.indexCount = static_cast<uint32_t>(indices.size()) - firstIndex;
+            primitive.materialIndex = glTFPrimitive.material;
+            for (size_t v = vertexStart; v < vertices.size(); v++) {
+                primitive.aabb.expand(vertices[v].position);
+            }
+            primitive.boundingSphere = computeBoundingSphere(primitive.aabb, vertices.begin() + vertexStart, vertices.end(),
+                [](const Vertex& vertex){ return vertex.position; });
+            primitives.push_back(primitive);
         }
     }
 
-        
+    // the model's box is the union of the primitives' boxes, its sphere is refit on the vertices
+    aabb = AABB{};
+    for (const auto& primitive : primitives){
+        aabb.expand(primitive.aabb);
+    }
+    boundingSphere = computeBoundingSphere(aabb, vertices.begin(), vertices.end(),
+        [](const Vertex& vertex){ return vertex.position; });
 }
 
 }
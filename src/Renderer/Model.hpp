@@ -1,11 +1,29 @@
 /*
 This class takes vertex data in file (on cpu) and allocate the memory
 and copy the data on the device's GPU so it can be rendered effeciently
+The vertices and indices live in a range of the geometry pool's shared buffers.
+A model can be created empty and uploaded later, it is resident once its upload
+has completed and only then may be drawn.
+A cooked mesh file (MeshFile) is uploaded straight from its mapping.
+The GPU copy is quantized (VERTEX_FORMAT): the positions are snorm16 in the
+model's bounds and decoded by the vertex shaders with the pushed PositionDecode,
+the normals are octahedral snorm16, the uvs half floats and the colors unorm8.
+The indices are 16 bits when the vertex count allows it.
+The depth only passes bind the position stream of the pool (POSITION_FORMAT),
+8 bytes per vertex instead of the full vertex.
+The levels of detail are ranges of the index buffer over the same vertices,
+from the full mesh to the coarsest simplification, each with its error.
+The optional meshlets split every level in clusters culled one by one.
 */
 #pragma once
 
 #include "Device.hpp"
 #include "Buffer.hpp"
+#include "Bounds.hpp"
+#include "GeometryPool.hpp"
+#include "Meshlet.hpp"
+#include "UploadContext.hpp"
+#include "Vertex.hpp"
 
 //libs
 #define GLM_FORCE_RADIANS
@@ -18,6 +36,9 @@ and copy the data on the device's GPU so it can be rendered effeciently
 
 namespace hyd {
 
+class MeshFile;
+class ThreadPool;
+
 class Model
 {
 public:
@@ -29,50 +50,186 @@ public:
         glm::vec3 normal{};
         glm::vec2 uv{};
 
-        static std::vector<VkVertexInputBindingDescription> getBindingDescriptions();
-        static std::vector<VkVertexInputAttributeDescription> getAttributesDescriptions();
-
         bool operator==(const Vertex& other) const {
             return position == other.position && color == other.color && normal == other.normal && uv == other.uv;
         }
 
     };
+
+    // the vertex as uploaded, laid out as VERTEX_FORMAT (the w of the position is unused)
+    struct PackedVertex
+    {
+        int16_t position[4];
+        uint8_t color[4];
+        int16_t normal[2];
+        uint16_t uv[2];
+    };
+
+    static constexpr VertexFormat VERTEX_FORMAT = VF_P4S_C4B_N2S_T2H;
+    static const hyd::Vertex::Format& getVertexFormat();
+
+    // the position of PackedVertex alone, laid out as POSITION_FORMAT
+    struct PackedPosition
+    {
+        int16_t position[4];
+    };
+
+    static constexpr VertexFormat POSITION_FORMAT = VF_P4S;
+    static const hyd::Vertex::Format& getPositionFormat();
+
+    // matches the push constant block of the mesh shaders, position = offset + inPos * scale
+    struct PositionDecode
+    {
+        glm::vec4 offset{0.0f};
+        glm::vec4 scale{1.0f};
+    };
+
+    // the range to add to the layouts of the pipelines drawing models
+    static VkPushConstantRange getPositionDecodeRange();
+    // maps the bounds to [-1, 1], a flat axis keeps a scale of 1
+    static PositionDecode computePositionDecode(const AABB& aabb);
+    static void packVertices(const Vertex* vertices, size_t count, const PositionDecode& decode, PackedVertex* packed);
+    // 16 bits indices when they can address all the vertices
+    static VkIndexType chooseIndexType(uint32_t vertexCount);
     
+    static constexpr uint32_t MAX_LOD_COUNT = 4;
+
+    // a level of detail, a range of the model's indices over the shared vertices
+    struct Lod
+    {
+        uint32_t firstIndex{0};
+        uint32_t indexCount{0};
+        float error{0.0f}; // distance to the full mesh, in the model's space
+        // the meshlets covering the range, none when they were not built
+        uint32_t firstMeshlet{0};
+        uint32_t meshletCount{0};
+    };
+
+    // a range of the index buffer, one per glTF primitive (of the full mesh)
+    struct Primitive
+    {
+        uint32_t firstIndex{0};
+        uint32_t indexCount{0};
+        int32_t materialIndex{-1};
+        AABB aabb{};
+        BoundingSphere boundingSphere{};
+    };
+
     struct Builder
     {
         std::vector<Vertex> vertices{};
         std::vector<uint32_t> indices{};
+        std::vector<Primitive> primitives{};
+        // empty until generateLods, the first level is then the full mesh
+        std::vector<Lod> lods{};
+        // empty until buildMeshlets
+        std::vector<Meshlet> meshlets{};
+
+        // local space bounds of all the vertices, filled by the loaders
+        AABB aabb{};
+        BoundingSphere boundingSphere{};
         
-        void loadOBJModel(const std::string& filepath);
+        // picks the loader from the file extension, the OBJ files are parsed in parallel on the thread pool
+        void loadModel(const std::string& filepath, ThreadPool* threadPool = nullptr);
+        void loadOBJModel(const std::string& filepath, ThreadPool* threadPool = nullptr);
         void loadGLTFModel(const std::string& filepath);
+
+        // computes the bounds of the whole model from its vertices
+        void computeBounds();
+
+        // reorders the triangles of each primitive and LOD for the vertex cache then for overdraw,
+        // and the vertices in the order they are fetched, run by the cook step
+        void optimize();
+
+        // appends the simplified levels of the full mesh to the indices, halving the triangles each level
+        // until the error gets too large compared to the model's size
+        void generateLods();
+
+        // splits each primitive and LOD in meshlets, their triangles are reordered so it must be the last step
+        void buildMeshlets();
     };
     
     
-    Model(Device& device, const Model::Builder &builder);
+    // empty model, not resident until upload is called and completes
+    Model(Device& device, GeometryPool& geometryPool);
+    Model(Device& device, GeometryPool& geometryPool, const Model::Builder &builder);
     ~Model();
 
     Model(const Model&) = delete;
     Model &operator=(const Model&) = delete;
 
-    static std::unique_ptr<Model> createModelFromFile(Device& device, const std::string& filepath);
+    // loads the cooked file of filepath when it is up to date, parses filepath otherwise
+    static std::unique_ptr<Model> createModelFromFile(Device& device, GeometryPool& geometryPool, const std::string& filepath);
+
+    // allocates the geometry and records its copy in the upload context, once per model
+    void upload(const Model::Builder &builder);
+    // the data is copied to the staging buffer, the file can be closed right after
+    void upload(const MeshFile &meshFile);
+    // true once the uploaded geometry can be read by the graphics queue
+    bool isResident();
 
+    // binds the geometry pool page of the model, models of the same page share the binding
     void bind(VkCommandBuffer VkCommandBuffer);
-    void draw(VkCommandBuffer VkCommandBuffer);
+    // binds the positions only, for the pipelines reading POSITION_FORMAT, the pool must have the position stream
+    void bindPositions(VkCommandBuffer commandBuffer);
+    // pushes the position decode of the model, the layout must include getPositionDecodeRange
+    void pushPositionDecode(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout);
+    void draw(VkCommandBuffer VkCommandBuffer, uint32_t instanceCount = 1, uint32_t firstInstance = 0, uint32_t lod = 0);
+    // drawCount draws read from consecutive VkDrawIndexedIndirectCommand (VkDrawIndirectCommand without index buffer),
+    // with the optional count buffer drawCount is the maximum and the buffer holds the actual count
+    // more than one draw needs the multiDrawIndirect feature
+    void drawIndirect(VkCommandBuffer VkCommandBuffer, VkBuffer buffer, VkDeviceSize offset, VkBuffer countBuffer = VK_NULL_HANDLE, VkDeviceSize countOffset = 0, uint32_t drawCount = 1);
+
+    bool hasIndexBuffer() const { return m_hasIndexBuffer; }
+    // indices of all the LODs
+    uint32_t getIndexCount() const { return m_indexCount; }
+    uint32_t getVertexCount() const { return m_vertexCount; }
+
+    // location of the model in the geometry pool
+    uint32_t getGeometryPage() const { return m_geometry.page; }
+    uint32_t getFirstIndex() const { return m_geometry.firstIndex; }
+    int32_t getVertexOffset() const { return static_cast<int32_t>(m_geometry.vertexOffset); }
+    VkIndexType getIndexType() const { return m_indexType; }
+    const PositionDecode& getPositionDecode() const { return m_positionDecode; }
+
+    // local space bounds
+    const AABB& getAABB() const { return m_aabb; }
+    const BoundingSphere& getBoundingSphere() const { return m_boundingSphere; }
+    const std::vector<Primitive>& getPrimitives() const { return m_primitives; }
+
+    uint32_t getLodCount() const { return static_cast<uint32_t>(m_lods.size()); }
+    const Lod& getLod(uint32_t lod) const { return m_lods[lod]; }
+    // the coarsest level whose error is not above maxError
+    uint32_t selectLod(float maxError) const;
+
+    // indexed by the LODs' meshlet ranges, firstIndex is relative to getFirstIndex
+    const std::vector<Meshlet>& getMeshlets() const { return m_meshlets; }
 
 
 private:
-    void createVertexBuffers(const std::vector<Vertex> &vertices);
-    void createIndexBuffers(const std::vector<uint32_t> &indices);
+    void upload(const PackedVertex* vertices, uint32_t vertexCount, const void* indices, VkIndexType indexType, uint32_t indexCount);
 
     /* data */
     Device& m_device;
+    GeometryPool& m_geometryPool;
+    GeometryAllocation m_geometry{};
+
+    bool m_uploaded = false;
+    bool m_resident = false;
+    UploadToken m_uploadToken{0};
 
-    std::unique_ptr<Buffer> m_vertexBuffer;
-    uint32_t m_vertexCount;
+    uint32_t m_vertexCount = 0;
 
     bool m_hasIndexBuffer = false;
-    std::unique_ptr<Buffer> m_indexBuffer;
-    uint32_t m_indexCount;
+    uint32_t m_indexCount = 0;
+    VkIndexType m_indexType = VK_INDEX_TYPE_UINT32;
+
+    PositionDecode m_positionDecode{};
+    AABB m_aabb{};
+    BoundingSphere m_boundingSphere{};
+    std::vector<Primitive> m_primitives;
+    std::vector<Lod> m_lods;
+    std::vector<Meshlet> m_meshlets;
 };
 
 }
\ No newline at end of file
@@ -269,8 +269,55 @@ void Pipeline::defaultPipelineConfigInfo(PipelineConfigInfo& configInfo){
     configInfo.dynamicStateInfo.dynamicStateCount = static_cast<uint32_t>(configInfo.dynamicStateEnables.size());
     configInfo.dynamicStateInfo.flags = 0;
 
-    configInfo.bindingDescriptions = Model::Vertex::getBindingDescriptions();
-    configInfo.attributeDescriptions = Model::Vertex::getAttributesDescriptions();
+    configInfo.bindingDescriptions = {Model::getVertexFormat().getBindingDescription()};
+    configInfo.attributeDescriptions = Model::getVertexFormat().getAttributeDescriptions();
+}
+
+
+ComputePipeline::ComputePipeline(
+    Device& device,
+    const std::string& compFilepath,
+    VkPipelineLayout pipelineLayout)
+    : m_device{device}
+{
+    assert(pipelineLayout != VK_NULL_HANDLE && "Cannot create compute pipeline: no pipelineLayout provided");
+
+    auto compCode = Pipeline::readFile(compFilepath);
+
+    VkShaderModuleCreateInfo createInfo{};
+    createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    createInfo.codeSize = compCode.size();
+    createInfo.pCode = reinterpret_cast<const uint32_t*>(compCode.data());
+
+    if (vkCreateShaderModule(m_device.device(), &createInfo, nullptr, &m_compShaderModule) != VK_SUCCESS){
+        throw std::runtime_error("failed to create shader module");
+    }
+
+    VkPipelineShaderStageCreateInfo shaderStage{};
+    shaderStage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    shaderStage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    shaderStage.module = m_compShaderModule;
+    shaderStage.pName = "main";
+
+    VkComputePipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage = shaderStage;
+    pipelineInfo.layout = pipelineLayout;
+    pipelineInfo.basePipelineIndex = -1;
+    pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+
+    if (vkCreateComputePipelines(m_device.device(), VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &m_computePipeline) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create compute pipeline");
+    }
+}
+
+ComputePipeline::~ComputePipeline(){
+    vkDestroyShaderModule(m_device.device(), m_compShaderModule, nullptr);
+    vkDestroyPipeline(m_device.device(), m_computePipeline, nullptr);
+}
+
+void ComputePipeline::bind(VkCommandBuffer commandBuffer){
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_computePipeline);
 }
 
 
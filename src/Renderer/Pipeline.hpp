@@ -57,9 +57,9 @@ public:
 
     static void  defaultPipelineConfigInfo(PipelineConfigInfo& configInfo);
 
+    static std::vector<char> readFile(const std::string& filepath);
 
 private:
-    static std::vector<char> readFile(const std::string& filepath);
     void createGraphicspipeline(
         const std::string& vertFilepath, 
         const std::string& fragFilepath,
@@ -80,5 +80,27 @@ private:
     bool m_hasFragmentShader{true};
 };
 
+class ComputePipeline
+{
+public:
+    ComputePipeline(
+        Device& device,
+        const std::string& compFilepath,
+        VkPipelineLayout pipelineLayout);
+
+    ~ComputePipeline();
+
+    ComputePipeline(const ComputePipeline&) = delete;
+    ComputePipeline operator=(const ComputePipeline&) = delete;
+
+    void bind(VkCommandBuffer commandBuffer);
+
+private:
+    /* data */
+    Device& m_device;
+    VkPipeline m_computePipeline;
+    VkShaderModule m_compShaderModule;
+};
+
 
 } // namespace se
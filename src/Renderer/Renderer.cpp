@@ -36,6 +36,7 @@ void Renderer::recreateSwapChain(){
             throw std::runtime_error("swapchain image(or depth) format has change!");
         }
     }
+    m_swapChainVersion++;
 }
 
 void Renderer::createCommandBuffers(){
@@ -110,7 +111,7 @@ void Renderer::endFrame(){
     m_currentFrameIndex = (m_currentFrameIndex + 1) % SwapChain::MAX_FRAMES_IN_FLIGHT;    
 }
 
-void Renderer::beginSwapChainRenderPass(VkCommandBuffer commandBuffer){
+void Renderer::beginSwapChainRenderPass(VkCommandBuffer commandBuffer, VkSubpassContents contents){
     assert(m_isFrameStarted && "Can't call beginSwapChainRenderPass if freame is not in progress!");
     assert(commandBuffer == getCurrentCommandBuffer() && 
         "Can't call beginSwapChainRenderPass if freame is not in progress!");
@@ -129,7 +130,9 @@ void Renderer::beginSwapChainRenderPass(VkCommandBuffer commandBuffer){
     renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
     renderPassInfo.pClearValues = clearValues.data();
 
-    vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+    vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, contents);
+    if (contents != VK_SUBPASS_CONTENTS_INLINE)
+        return;
 
     VkViewport viewport{};
     viewport.x = 0.0f;
@@ -24,7 +24,14 @@ public:
 
     VkRenderPass getSwapChainRenderPass() { return m_swapChain->getRenderPass(); }
     float getAspectRatio() const { return m_swapChain->extentAspectRatio(); }
+    VkExtent2D getSwapChainExtent() const { return m_swapChain->getSwapChainExtent(); }
+    VkFramebuffer getCurrentFrameBuffer() {
+        assert(m_isFrameStarted && "Cannot get the frame buffer when no frame is in progress");
+        return m_swapChain->getFrameBuffer(m_currentImageIndex);
+    }
     bool isFrameInProgress() const { return m_isFrameStarted;}
+    // changes every time the swap chain is recreated, with its render pass and framebuffers
+    uint32_t getSwapChainVersion() const { return m_swapChainVersion; }
 
     VkCommandBuffer getCurrentCommandBuffer() const { 
         assert(m_isFrameStarted && "Cannot get command buffer when no frame is in progress");
@@ -33,7 +40,9 @@ public:
 
     VkCommandBuffer beginFrame();
     void endFrame();
-    void beginSwapChainRenderPass(VkCommandBuffer commandBuffer);
+    // with VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS the pass only executes secondary command buffers,
+    // they set their own viewport and scissor
+    void beginSwapChainRenderPass(VkCommandBuffer commandBuffer, VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE);
     void endSwapChainRenderPass(VkCommandBuffer commandBuffer);
 
     int getFrameIndex() const {
@@ -58,6 +67,7 @@ private:
 
     uint32_t m_currentImageIndex;
     int m_currentFrameIndex{0};
+    uint32_t m_swapChainVersion{0};
     bool m_isFrameStarted{false};
 
     bool m_frameBufferResized{false};
@@ -47,7 +47,7 @@ SwapChain::~SwapChain() {
   for (int i = 0; i < depthImages.size(); i++) {
     vkDestroyImageView(device.device(), depthImageViews[i], nullptr);
     vkDestroyImage(device.device(), depthImages[i], nullptr);
-    vkFreeMemory(device.device(), depthImageMemorys[i], nullptr);
+    device.allocator().free(depthImageMemorys[i]);
   }
 
   for (auto framebuffer : swapChainFramebuffers) {
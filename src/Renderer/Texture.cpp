@@ -1,9 +1,13 @@
 #include "Texture.hpp"
 
 #include "Ressources/Image.hpp"
+#include "Ressources/Mipmaps.hpp"
+#include "UploadContext.hpp"
 
 // std
+#include <algorithm>
 #include <stdexcept>
+#include <vector>
 
 namespace hyd
 {
@@ -14,33 +18,55 @@ Texture::Texture(Device& device, const std::string& filepath): m_device{device}
     createImageView();
     createTextureSampler();
 }
+
+Texture::Texture(Device& device, uint32_t width, uint32_t height, const void* pixels): m_device{device}
+{
+    createImage(width, height, pixels);
+    createImageView();
+    createTextureSampler();
+}
+
+Texture::Texture(Device& device, const Ktx2Image& image): m_device{device}
+{
+    createCompressedImage(image);
+    createImageView();
+    createTextureSampler();
+}
     
 Texture::~Texture(){
     vkDestroySampler(m_device.device(), m_sampler, nullptr);
     vkDestroyImageView(m_device.device(), m_imageView, nullptr);
 
     vkDestroyImage(m_device.device(), m_image, nullptr);
-    vkFreeMemory(m_device.device(), m_imageMemory, nullptr);
+    m_device.allocator().free(m_imageMemory);
 
 }
     
 void Texture::loadTexture(const std::string& filepath){
     
     Image image{filepath};
-    VkDeviceSize bufferSize = image.getWidth() * image.getHeight() * 4;
-    uint32_t instanceCount = 1;
+    createImage(
+        static_cast<uint32_t>(image.getWidth()),
+        static_cast<uint32_t>(image.getHeight()),
+        image.getData());
+}
 
-    // loading in staging buffer
-    Buffer stagingBuffer{
-        m_device,
-        bufferSize,
-        instanceCount,
-        VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
-    };
+bool Texture::supportsFormat(Device& device, VkFormat format){
+    const bool blockCompressed = format >= VK_FORMAT_BC1_RGB_UNORM_BLOCK && format <= VK_FORMAT_BC7_SRGB_BLOCK;
+    if (blockCompressed && !device.enabledFeatures().textureCompressionBC)
+        return false;
+    return (device.getFormatProperties(format).optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) != 0;
+}
 
-    stagingBuffer.map();
-    stagingBuffer.writeToBuffer( (void*) image.getData());
+void Texture::createCompressedImage(const Ktx2Image& image){
+    if (image.getLayerCount() != 1)
+        throw std::runtime_error("only 2D KTX2 textures are supported by Texture");
+    if (!supportsFormat(m_device, image.getFormat()))
+        throw std::runtime_error("the device can't sample the KTX2 texture format");
+
+    const auto& levels = image.getLevels();
+    m_format = image.getFormat();
+    m_mipLevels = static_cast<uint32_t>(levels.size());
 
     VkImageCreateInfo imageInfo{};
     imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -48,15 +74,63 @@ void Texture::loadTexture(const std::string& filepath){
     imageInfo.extent.width = image.getWidth();
     imageInfo.extent.height = image.getHeight();
     imageInfo.extent.depth = 1;
-    imageInfo.mipLevels = 1;
+    imageInfo.mipLevels = m_mipLevels;
     imageInfo.arrayLayers = 1;
-    imageInfo.format = VK_FORMAT_R8G8B8A8_SRGB;
+    imageInfo.format = m_format;
     imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
     imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
     imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
     imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
     imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
+    m_device.createImageWithInfo(
+        imageInfo,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        m_image,
+        m_imageMemory);
+
+    // the levels are packed in the file, they are staged at once and copied with a region each
+    size_t begin = levels[0].offset;
+    size_t end = 0;
+    for (const auto& level : levels){
+        begin = std::min(begin, level.offset);
+        end = std::max(end, level.offset + level.size);
+    }
+
+    std::vector<VkBufferImageCopy> regions(levels.size());
+    for (uint32_t level = 0; level < levels.size(); level++){
+        regions[level].bufferOffset = levels[level].offset - begin;
+        regions[level].imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1};
+        regions[level].imageExtent = {levels[level].width, levels[level].height, 1};
+    }
+
+    UploadContext& uploadContext = m_device.uploadContext();
+    uploadContext.transitionImageLayout(m_image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, m_mipLevels);
+    uploadContext.uploadImage(m_image, image.getData() + begin, end - begin, regions);
+    uploadContext.transitionImageLayout(m_image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, 1, m_mipLevels);
+    m_uploadToken = uploadContext.getPendingToken();
+}
+
+void Texture::createImage(uint32_t width, uint32_t height, const void* pixels){
+    VkDeviceSize bufferSize = static_cast<VkDeviceSize>(width) * height * 4;
+    m_mipLevels = mipLevelCount(width, height);
+
+    VkImageCreateInfo imageInfo{};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.extent.width = width;
+    imageInfo.extent.height = height;
+    imageInfo.extent.depth = 1;
+    imageInfo.mipLevels = m_mipLevels;
+    imageInfo.arrayLayers = 1;
+    imageInfo.format = VK_FORMAT_R8G8B8A8_SRGB;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    // the mip levels are blitted from level 0
+    imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
 
     m_device.createImageWithInfo(
         imageInfo,
@@ -64,19 +138,27 @@ void Texture::loadTexture(const std::string& filepath){
         m_image,
         m_imageMemory);
 
-    m_device.transitionImageLayout(m_image, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-    m_device.copyBufferToImage(
-        stagingBuffer.getBuffer(), 
+    // recorded in the upload batch of the load, the pixels are staged right away
+    m_device.uploadContext().uploadImageMipmapped(
         m_image,
-        static_cast<uint32_t>(image.getWidth()),
-        static_cast<uint32_t>(image.getHeight()),
-        static_cast<uint32_t>(1));
-    m_device.transitionImageLayout(m_image, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+        VK_FORMAT_R8G8B8A8_SRGB,
+        pixels,
+        bufferSize,
+        width,
+        height,
+        m_mipLevels);
+    m_uploadToken = m_device.uploadContext().getPendingToken();
+}
+
+bool Texture::isResident(){
+    if (!m_resident)
+        m_resident = m_device.uploadContext().isComplete(m_uploadToken);
+    return m_resident;
 }
 
 
 void Texture::createImageView(){
-    m_imageView = m_device.createImageView(m_image, VK_FORMAT_R8G8B8A8_SRGB);
+    m_imageView = m_device.createImageView(m_image, m_format, m_mipLevels);
 }
 
 void Texture::createTextureSampler(){
@@ -100,7 +182,7 @@ void Texture::createTextureSampler(){
     samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
     samplerInfo.mipLodBias = 0.0f;
     samplerInfo.minLod = 0.0f;
-    samplerInfo.maxLod = 0.0f;
+    samplerInfo.maxLod = static_cast<float>(m_mipLevels);
 
     if (vkCreateSampler(m_device.device(), &samplerInfo, nullptr, &m_sampler) != VK_SUCCESS) {
         throw std::runtime_error("failed to create texture sampler!");
@@ -2,6 +2,8 @@
 
 #include "Device.hpp"
 #include "Buffer.hpp"
+#include "UploadContext.hpp"
+#include "Ressources/Ktx2.hpp"
 
 //libs
 #include <vulkan/vulkan.h>
@@ -16,6 +18,10 @@ class Texture
 {
 public:
     Texture(Device& device, const std::string& filepath);
+    // rgba8 pixels, already decoded
+    Texture(Device& device, uint32_t width, uint32_t height, const void* pixels);
+    // block compressed levels of a KTX2 file, copied as is
+    Texture(Device& device, const Ktx2Image& image);
     ~Texture();
 
     Texture(const Texture&) = delete;
@@ -23,8 +29,17 @@ public:
 
     VkDescriptorImageInfo getImageInfo();
 
+    // true once the upload of the pixels has completed
+    bool isResident();
+    UploadToken getUploadToken() const { return m_uploadToken; }
+
+    // the format can be sampled from an optimal tiling image, BC formats also need the enabled feature
+    static bool supportsFormat(Device& device, VkFormat format);
+
 private:
     void loadTexture(const std::string& filepath);
+    void createImage(uint32_t width, uint32_t height, const void* pixels);
+    void createCompressedImage(const Ktx2Image& image);
     void createImageView();
     void createTextureSampler();
     
@@ -33,10 +48,15 @@ private:
     Device& m_device;
 
     VkImage m_image; 
-    VkDeviceMemory m_imageMemory;
+    MemoryAllocation m_imageMemory;
     VkImageView m_imageView;
 
     VkSampler m_sampler;
+
+    VkFormat m_format{VK_FORMAT_R8G8B8A8_SRGB};
+    uint32_t m_mipLevels{1};
+    UploadToken m_uploadToken{0};
+    bool m_resident = false;
 };
 
 } // namespace hyd
@@ -0,0 +1,619 @@
+#include "UploadContext.hpp"
+
+#include "Device.hpp"
+#include "Ressources/Mipmaps.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <stdexcept>
+
+namespace hyd
+{
+
+static uint64_t alignUp(uint64_t value, uint64_t alignment){
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+UploadContext::UploadContext(Device& device)
+: m_device{device}
+{
+    QueueFamilyIndices queueFamilyIndices = m_device.findPhysicalQueueFamilies();
+    m_dedicatedTransfer = m_device.hasDedicatedTransferQueue();
+    m_graphicsFamily = queueFamilyIndices.graphicsFamily;
+    m_transferFamily = m_dedicatedTransfer ? queueFamilyIndices.transferFamily : queueFamilyIndices.graphicsFamily;
+
+    createCommandPools();
+    createStagingRing();
+}
+
+UploadContext::~UploadContext(){
+    flush();
+
+    for (auto& batch : m_freeBatches){
+        vkDestroyFence(m_device.device(), batch.fence, nullptr);
+        if (batch.transferFence != VK_NULL_HANDLE)
+            vkDestroyFence(m_device.device(), batch.transferFence, nullptr);
+    }
+    // destroying the pools frees the command buffers
+    vkDestroyCommandPool(m_device.device(), m_commandPool, nullptr);
+    if (m_acquirePool != VK_NULL_HANDLE)
+        vkDestroyCommandPool(m_device.device(), m_acquirePool, nullptr);
+    destroyStaging(m_ring);
+}
+
+void UploadContext::createCommandPools(){
+    VkCommandPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.queueFamilyIndex = m_transferFamily;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+
+    if (vkCreateCommandPool(m_device.device(), &poolInfo, nullptr, &m_commandPool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create upload command pool!");
+    }
+
+    if (!m_dedicatedTransfer)
+        return;
+
+    poolInfo.queueFamilyIndex = m_graphicsFamily;
+    if (vkCreateCommandPool(m_device.device(), &poolInfo, nullptr, &m_acquirePool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create upload acquire command pool!");
+    }
+}
+
+VkCommandBuffer UploadContext::allocateCommandBuffer(VkCommandPool pool){
+    VkCommandBufferAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandPool = pool;
+    allocInfo.commandBufferCount = 1;
+
+    VkCommandBuffer commandBuffer;
+    if (vkAllocateCommandBuffers(m_device.device(), &allocInfo, &commandBuffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate upload command buffer!");
+    }
+    return commandBuffer;
+}
+
+void UploadContext::createStagingRing(){
+    m_device.createBuffer(
+        RING_SIZE,
+        VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        m_ring.buffer,
+        m_ring.memory);
+}
+
+void UploadContext::destroyStaging(StagingBuffer& staging){
+    vkDestroyBuffer(m_device.device(), staging.buffer, nullptr);
+    m_device.allocator().free(staging.memory);
+    staging.buffer = VK_NULL_HANDLE;
+}
+
+void UploadContext::beginBatch(){
+    if (m_recording)
+        return;
+
+    if (!m_freeBatches.empty()){
+        m_current = std::move(m_freeBatches.back());
+        m_freeBatches.pop_back();
+    } else {
+        m_current = Batch{};
+        m_current.commandBuffer = allocateCommandBuffer(m_commandPool);
+
+        VkFenceCreateInfo fenceInfo{};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        if (vkCreateFence(m_device.device(), &fenceInfo, nullptr, &m_current.fence) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create upload fence!");
+        }
+
+        if (m_dedicatedTransfer){
+            m_current.acquireCommandBuffer = allocateCommandBuffer(m_acquirePool);
+            if (vkCreateFence(m_device.device(), &fenceInfo, nullptr, &m_current.transferFence) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create upload fence!");
+            }
+        }
+    }
+    m_current.token = m_nextToken;
+
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    vkBeginCommandBuffer(m_current.commandBuffer, &beginInfo);
+
+    m_recording = true;
+}
+
+void UploadContext::recordOwnershipTransfers(){
+    // release on the transfer queue, the destination access is ignored there
+    if (!m_current.bufferReleases.empty() || !m_current.imageReleases.empty()){
+        vkCmdPipelineBarrier(
+            m_current.commandBuffer,
+            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+            0,
+            0, nullptr,
+            static_cast<uint32_t>(m_current.bufferReleases.size()), m_current.bufferReleases.data(),
+            static_cast<uint32_t>(m_current.imageReleases.size()), m_current.imageReleases.data());
+    }
+
+    // matching acquire on the graphics queue, the source access is ignored there
+    std::vector<VkBufferMemoryBarrier> bufferAcquires = m_current.bufferReleases;
+    for (auto& barrier : bufferAcquires){
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_UNIFORM_READ_BIT |
+                                VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+    }
+    std::vector<VkImageMemoryBarrier> imageAcquires = m_current.imageReleases;
+    for (auto& barrier : imageAcquires){
+        barrier.srcAccessMask = 0;
+        // the images of the mip chains stay in transfer dst for their blits
+        barrier.dstAccessMask = barrier.newLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL
+            ? VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT
+            : VK_ACCESS_SHADER_READ_BIT;
+    }
+
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    vkBeginCommandBuffer(m_current.acquireCommandBuffer, &beginInfo);
+    if (!bufferAcquires.empty() || !imageAcquires.empty()){
+        vkCmdPipelineBarrier(
+            m_current.acquireCommandBuffer,
+            VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+            VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT |
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+            0,
+            0, nullptr,
+            static_cast<uint32_t>(bufferAcquires.size()), bufferAcquires.data(),
+            static_cast<uint32_t>(imageAcquires.size()), imageAcquires.data());
+    }
+    for (const auto& chain : m_current.mipChains)
+        recordMipChain(m_current.acquireCommandBuffer, chain);
+    vkEndCommandBuffer(m_current.acquireCommandBuffer);
+
+    m_current.bufferReleases.clear();
+    m_current.imageReleases.clear();
+    m_current.mipChains.clear();
+}
+
+bool UploadContext::supportsLinearBlit(VkFormat format){
+    const VkFormatFeatureFlags features =
+        VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+    return (m_device.getFormatProperties(format).optimalTilingFeatures & features) == features;
+}
+
+void UploadContext::recordMipChain(VkCommandBuffer commandBuffer, const MipChain& chain){
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = chain.image;
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.levelCount = 1;
+    barrier.subresourceRange.baseArrayLayer = 0;
+    barrier.subresourceRange.layerCount = chain.layerCount;
+
+    int32_t width = static_cast<int32_t>(chain.width);
+    int32_t height = static_cast<int32_t>(chain.height);
+    for (uint32_t level = 1; level < chain.mipLevels; level++){
+        // the previous level becomes the source of the blit
+        barrier.subresourceRange.baseMipLevel = level - 1;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        vkCmdPipelineBarrier(commandBuffer,
+            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+            0, nullptr,
+            0, nullptr,
+            1, &barrier);
+
+        const int32_t nextWidth = std::max(width / 2, 1);
+        const int32_t nextHeight = std::max(height / 2, 1);
+
+        VkImageBlit blit{};
+        blit.srcOffsets[1] = {width, height, 1};
+        blit.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level - 1, 0, chain.layerCount};
+        blit.dstOffsets[1] = {nextWidth, nextHeight, 1};
+        blit.dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level, 0, chain.layerCount};
+        vkCmdBlitImage(commandBuffer,
+            chain.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            chain.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            1, &blit,
+            VK_FILTER_LINEAR);
+
+        // done with the previous level
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        vkCmdPipelineBarrier(commandBuffer,
+            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+            0, nullptr,
+            0, nullptr,
+            1, &barrier);
+
+        width = nextWidth;
+        height = nextHeight;
+    }
+
+    // the last level was only written
+    barrier.subresourceRange.baseMipLevel = chain.mipLevels - 1;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+        0, nullptr,
+        0, nullptr,
+        1, &barrier);
+}
+
+UploadToken UploadContext::submitBatch(){
+    if (!m_recording)
+        return m_nextToken - 1;
+
+    if (m_dedicatedTransfer){
+        recordOwnershipTransfers();
+        vkEndCommandBuffer(m_current.commandBuffer);
+
+        // the acquire is submitted once the transfer fence is signaled, see retireBatches
+        VkSubmitInfo transferSubmit{};
+        transferSubmit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        transferSubmit.commandBufferCount = 1;
+        transferSubmit.pCommandBuffers = &m_current.commandBuffer;
+        if (vkQueueSubmit(m_device.transferQueue(), 1, &transferSubmit, m_current.transferFence) != VK_SUCCESS) {
+            throw std::runtime_error("failed to submit upload command buffer!");
+        }
+    } else {
+        // the uploaded data is visible to every later use on the queue
+        VkMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_UNIFORM_READ_BIT |
+                                VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+        vkCmdPipelineBarrier(
+            m_current.commandBuffer,
+            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+            0,
+            1, &barrier,
+            0, nullptr,
+            0, nullptr);
+
+        vkEndCommandBuffer(m_current.commandBuffer);
+
+        VkSubmitInfo submitInfo{};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &m_current.commandBuffer;
+        if (vkQueueSubmit(m_device.graphicsQueue(), 1, &submitInfo, m_current.fence) != VK_SUCCESS) {
+            throw std::runtime_error("failed to submit upload command buffer!");
+        }
+        m_current.acquireSubmitted = true;
+    }
+
+    m_current.ringEnd = m_ringHead;
+    UploadToken token = m_current.token;
+    m_inFlight.push_back(std::move(m_current));
+    m_current = Batch{};
+    m_recording = false;
+    m_nextToken++;
+    return token;
+}
+
+void UploadContext::submitAcquire(Batch& batch){
+    VkSubmitInfo acquireSubmit{};
+    acquireSubmit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    acquireSubmit.commandBufferCount = 1;
+    acquireSubmit.pCommandBuffers = &batch.acquireCommandBuffer;
+    if (vkQueueSubmit(m_device.graphicsQueue(), 1, &acquireSubmit, batch.fence) != VK_SUCCESS) {
+        throw std::runtime_error("failed to submit upload acquire command buffer!");
+    }
+    batch.acquireSubmitted = true;
+}
+
+void UploadContext::retireBatches(bool waitOldest){
+    // hand the finished transfers over to the graphics queue, the transfer queue runs them in order
+    for (auto& batch : m_inFlight){
+        if (batch.acquireSubmitted)
+            continue;
+        if (vkGetFenceStatus(m_device.device(), batch.transferFence) != VK_SUCCESS)
+            break;
+        submitAcquire(batch);
+    }
+
+    if (waitOldest && !m_inFlight.empty()){
+        Batch& oldest = m_inFlight.front();
+        if (!oldest.acquireSubmitted){
+            vkWaitForFences(m_device.device(), 1, &oldest.transferFence, VK_TRUE, UINT64_MAX);
+            submitAcquire(oldest);
+        }
+        vkWaitForFences(m_device.device(), 1, &oldest.fence, VK_TRUE, UINT64_MAX);
+    }
+
+    // the batches complete in submission order
+    while (!m_inFlight.empty() && vkGetFenceStatus(m_device.device(), m_inFlight.front().fence) == VK_SUCCESS){
+        Batch batch = std::move(m_inFlight.front());
+        m_inFlight.pop_front();
+
+        m_ringTail = batch.ringEnd;
+        m_completedToken = batch.token;
+        for (auto& staging : batch.dedicatedStaging)
+            destroyStaging(staging);
+        batch.dedicatedStaging.clear();
+
+        vkResetFences(m_device.device(), 1, &batch.fence);
+        vkResetCommandBuffer(batch.commandBuffer, 0);
+        if (batch.acquireCommandBuffer != VK_NULL_HANDLE){
+            vkResetFences(m_device.device(), 1, &batch.transferFence);
+            vkResetCommandBuffer(batch.acquireCommandBuffer, 0);
+        }
+        batch.acquireSubmitted = false;
+        m_freeBatches.push_back(std::move(batch));
+    }
+}
+
+void UploadContext::waitToken(UploadToken token){
+    if (token >= m_nextToken)
+        submitBatch();
+    while (m_completedToken < token && !m_inFlight.empty())
+        retireBatches(true);
+}
+
+UploadContext::Staging UploadContext::allocateStaging(VkDeviceSize size){
+    if (size > RING_SIZE){
+        StagingBuffer staging{};
+        m_device.createBuffer(
+            size,
+            VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            staging.buffer,
+            staging.memory);
+        m_current.dedicatedStaging.push_back(staging);
+        return {staging.buffer, 0, staging.memory.mapped};
+    }
+
+    for (;;){
+        uint64_t start = alignUp(m_ringHead, STAGING_ALIGNMENT);
+        // a range never wraps around the end of the ring
+        if (start % RING_SIZE + size > RING_SIZE)
+            start = alignUp(start, RING_SIZE);
+
+        if (start + size - m_ringTail <= RING_SIZE){
+            m_ringHead = start + size;
+            const VkDeviceSize offset = start % RING_SIZE;
+            return {m_ring.buffer, offset, static_cast<char*>(m_ring.memory.mapped) + offset};
+        }
+
+        if (!m_inFlight.empty()){
+            retireBatches(true);
+        } else if (m_ringHead == m_ringTail){
+            // nobody reads the ring, restart at its beginning
+            m_ringHead = m_ringTail = 0;
+        } else {
+            // the batch being recorded fills the ring
+            submitBatch();
+            retireBatches(true);
+            beginBatch();
+        }
+    }
+}
+
+void UploadContext::uploadBuffer(VkBuffer buffer, VkDeviceSize offset, const void* data, VkDeviceSize size){
+    if (size == 0)
+        return;
+
+    std::lock_guard<std::mutex> lock{m_mutex};
+    beginBatch();
+
+    Staging staging = allocateStaging(size);
+    std::memcpy(staging.mapped, data, size);
+
+    VkBufferCopy copyRegion{};
+    copyRegion.srcOffset = staging.offset;
+    copyRegion.dstOffset = offset;
+    copyRegion.size = size;
+    vkCmdCopyBuffer(m_current.commandBuffer, staging.buffer, buffer, 1, &copyRegion);
+
+    if (m_dedicatedTransfer){
+        VkBufferMemoryBarrier release{};
+        release.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        release.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        release.srcQueueFamilyIndex = m_transferFamily;
+        release.dstQueueFamilyIndex = m_graphicsFamily;
+        release.buffer = buffer;
+        release.offset = offset;
+        release.size = size;
+        m_current.bufferReleases.push_back(release);
+    }
+}
+
+void UploadContext::uploadImage(VkImage image, const void* data, VkDeviceSize size, const std::vector<VkBufferImageCopy>& regions){
+    std::lock_guard<std::mutex> lock{m_mutex};
+    beginBatch();
+
+    Staging staging = allocateStaging(size);
+    std::memcpy(staging.mapped, data, size);
+
+    std::vector<VkBufferImageCopy> stagedRegions = regions;
+    for (auto& region : stagedRegions)
+        region.bufferOffset += staging.offset;
+
+    vkCmdCopyBufferToImage(
+        m_current.commandBuffer,
+        staging.buffer,
+        image,
+        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        static_cast<uint32_t>(stagedRegions.size()),
+        stagedRegions.data());
+}
+
+void UploadContext::uploadImage(VkImage image, const void* data, VkDeviceSize size, uint32_t width, uint32_t height, uint32_t layerCount){
+    VkBufferImageCopy region{};
+    region.bufferOffset = 0;
+    region.bufferRowLength = 0;
+    region.bufferImageHeight = 0;
+
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.mipLevel = 0;
+    region.imageSubresource.baseArrayLayer = 0;
+    region.imageSubresource.layerCount = layerCount;
+
+    region.imageOffset = {0, 0, 0};
+    region.imageExtent = {width, height, 1};
+
+    transitionImageLayout(image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, layerCount);
+    uploadImage(image, data, size, {region});
+    transitionImageLayout(image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, layerCount);
+}
+
+void UploadContext::uploadImageMipmapped(VkImage image, VkFormat format, const void* data, VkDeviceSize size,
+    uint32_t width, uint32_t height, uint32_t mipLevels, uint32_t layerCount){
+    if (mipLevels <= 1){
+        uploadImage(image, data, size, width, height, layerCount);
+        return;
+    }
+
+    if (!supportsLinearBlit(format)){
+        const bool srgb = format == VK_FORMAT_R8G8B8A8_SRGB || format == VK_FORMAT_B8G8R8A8_SRGB;
+        if (!srgb && format != VK_FORMAT_R8G8B8A8_UNORM && format != VK_FORMAT_B8G8R8A8_UNORM)
+            throw std::invalid_argument("unsupported format for the CPU mip chain!");
+
+        std::vector<unsigned char> chain;
+        std::vector<MipLevel> levels = generateMipChain(
+            static_cast<const unsigned char*>(data), width, height, layerCount, mipLevels, srgb, chain);
+
+        // the whole chain in one copy, a region per level
+        std::vector<VkBufferImageCopy> regions(levels.size());
+        for (uint32_t level = 0; level < levels.size(); level++){
+            regions[level].bufferOffset = levels[level].offset;
+            regions[level].imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level, 0, layerCount};
+            regions[level].imageExtent = {levels[level].width, levels[level].height, 1};
+        }
+
+        transitionImageLayout(image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, layerCount, mipLevels);
+        uploadImage(image, chain.data(), chain.size(), regions);
+        transitionImageLayout(image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, layerCount, mipLevels);
+        return;
+    }
+
+    VkBufferImageCopy region{};
+    region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, layerCount};
+    region.imageExtent = {width, height, 1};
+
+    transitionImageLayout(image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, layerCount, mipLevels);
+    uploadImage(image, data, size, {region});
+
+    std::lock_guard<std::mutex> lock{m_mutex};
+    beginBatch();
+
+    const MipChain chain{image, width, height, mipLevels, layerCount};
+    if (!m_dedicatedTransfer){
+        recordMipChain(m_current.commandBuffer, chain);
+        return;
+    }
+
+    // the blits need the graphics queue, the image is handed over still in transfer dst
+    VkImageMemoryBarrier release{};
+    release.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    release.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    release.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    release.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    release.srcQueueFamilyIndex = m_transferFamily;
+    release.dstQueueFamilyIndex = m_graphicsFamily;
+    release.image = image;
+    release.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, mipLevels, 0, layerCount};
+    m_current.imageReleases.push_back(release);
+    m_current.mipChains.push_back(chain);
+}
+
+void UploadContext::transitionImageLayout(VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t layerCount, uint32_t mipLevels){
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.oldLayout = oldLayout;
+    barrier.newLayout = newLayout;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = image;
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.baseMipLevel = 0;
+    barrier.subresourceRange.levelCount = mipLevels;
+    barrier.subresourceRange.baseArrayLayer = 0;
+    barrier.subresourceRange.layerCount = layerCount;
+
+    VkPipelineStageFlags sourceStage;
+    VkPipelineStageFlags destinationStage;
+
+    if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED && newLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL) {
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+        sourceStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+        destinationStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+    } else if (oldLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL && newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) {
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+        sourceStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+        destinationStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    } else {
+        throw std::invalid_argument("unsupported layout transition!");
+    }
+
+    std::lock_guard<std::mutex> lock{m_mutex};
+    beginBatch();
+
+    // the transition to the sampled layout doubles as the ownership transfer to the graphics queue
+    if (m_dedicatedTransfer && newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL){
+        barrier.srcQueueFamilyIndex = m_transferFamily;
+        barrier.dstQueueFamilyIndex = m_graphicsFamily;
+        m_current.imageReleases.push_back(barrier);
+        return;
+    }
+
+    vkCmdPipelineBarrier(
+        m_current.commandBuffer,
+        sourceStage, destinationStage,
+        0,
+        0, nullptr,
+        0, nullptr,
+        1, &barrier);
+}
+
+VkCommandBuffer UploadContext::getCommandBuffer(){
+    std::lock_guard<std::mutex> lock{m_mutex};
+    beginBatch();
+    return m_current.commandBuffer;
+}
+
+UploadToken UploadContext::getPendingToken() const{
+    std::lock_guard<std::mutex> lock{m_mutex};
+    return m_nextToken;
+}
+
+UploadToken UploadContext::submit(){
+    std::lock_guard<std::mutex> lock{m_mutex};
+    // also the chance to pass the finished transfers to the graphics queue
+    retireBatches(false);
+    return submitBatch();
+}
+
+bool UploadContext::isComplete(UploadToken token){
+    std::lock_guard<std::mutex> lock{m_mutex};
+    retireBatches(false);
+    return token <= m_completedToken;
+}
+
+void UploadContext::wait(UploadToken token){
+    std::lock_guard<std::mutex> lock{m_mutex};
+    waitToken(token);
+}
+
+void UploadContext::flush(){
+    std::lock_guard<std::mutex> lock{m_mutex};
+    waitToken(submitBatch());
+}
+
+} // namespace hyd
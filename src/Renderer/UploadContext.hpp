@@ -0,0 +1,157 @@
+/*
+The upload context records the copies and layout transitions of the loads in
+one command buffer and stages their data in a persistently mapped ring buffer.
+The batch is submitted once with a fence, the returned token tells when the
+data has landed. The ring space of a batch is reused once its fence is signaled.
+Uploads bigger than the ring get a staging buffer of their own.
+On devices with a transfer only queue family the batches run on the transfer
+queue: the written ranges and images are released by the transfer queue, then
+acquired by a small graphics queue submission once the transfer fence is seen
+signaled, so the frames never wait on the copies. The token completes once the
+graphics queue owns the data.
+The mip chains are blitted from level 0 when the format allows a linear blit,
+in the acquire submission with a dedicated transfer queue since blits need a
+graphics queue. Otherwise the chain is built on the CPU and copied at once.
+*/
+#pragma once
+
+#include "MemoryAllocator.hpp"
+
+#include <vulkan/vulkan.h>
+
+// std
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+namespace hyd
+{
+
+class Device;
+
+// increasing id of a submitted batch, 0 is always complete
+using UploadToken = uint64_t;
+
+class UploadContext
+{
+public:
+    static constexpr VkDeviceSize RING_SIZE = 64ull << 20;
+    // satisfies the buffer to image copies of every uncompressed and block format
+    static constexpr VkDeviceSize STAGING_ALIGNMENT = 16;
+
+    UploadContext(Device& device);
+    ~UploadContext();
+
+    UploadContext(const UploadContext&) = delete;
+    UploadContext &operator=(const UploadContext&) = delete;
+
+    void uploadBuffer(VkBuffer buffer, VkDeviceSize offset, const void* data, VkDeviceSize size);
+
+    // copies data in the image, the regions' buffer offsets are relative to data
+    // the image must be in VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL
+    void uploadImage(VkImage image, const void* data, VkDeviceSize size, const std::vector<VkBufferImageCopy>& regions);
+    // whole color image: undefined -> transfer dst -> copy -> shader read only
+    void uploadImage(VkImage image, const void* data, VkDeviceSize size, uint32_t width, uint32_t height, uint32_t layerCount = 1);
+    // same with a mip chain, data holds level 0 of every layer, the image needs VK_IMAGE_USAGE_TRANSFER_SRC_BIT
+    // the CPU fallback only handles 4 bytes rgba/bgra formats
+    void uploadImageMipmapped(VkImage image, VkFormat format, const void* data, VkDeviceSize size,
+        uint32_t width, uint32_t height, uint32_t mipLevels, uint32_t layerCount = 1);
+
+    void transitionImageLayout(VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t layerCount = 1, uint32_t mipLevels = 1);
+
+    // command buffer of the batch being recorded, for the commands the context has no helper for
+    VkCommandBuffer getCommandBuffer();
+
+    // token of the batch being recorded, complete once the next submit has executed
+    UploadToken getPendingToken() const;
+
+    // submits the recorded batch, returns the token of the last submitted batch when nothing was recorded
+    UploadToken submit();
+    bool isComplete(UploadToken token);
+    void wait(UploadToken token);
+    // submits and waits for every upload
+    void flush();
+
+private:
+    struct StagingBuffer
+    {
+        VkBuffer buffer{VK_NULL_HANDLE};
+        MemoryAllocation memory{};
+    };
+
+    struct MipChain
+    {
+        VkImage image;
+        uint32_t width;
+        uint32_t height;
+        uint32_t mipLevels;
+        uint32_t layerCount;
+    };
+
+    struct Batch
+    {
+        VkCommandBuffer commandBuffer{VK_NULL_HANDLE};
+        VkFence fence{VK_NULL_HANDLE};
+        // queue family ownership transfer, only used with a dedicated transfer queue
+        VkCommandBuffer acquireCommandBuffer{VK_NULL_HANDLE};
+        VkFence transferFence{VK_NULL_HANDLE};
+        bool acquireSubmitted{false};
+        std::vector<VkBufferMemoryBarrier> bufferReleases;
+        std::vector<VkImageMemoryBarrier> imageReleases;
+        std::vector<MipChain> mipChains; // blitted after the acquire
+
+        UploadToken token{0};
+        uint64_t ringEnd{0}; // ring position released when the batch completes
+        std::vector<StagingBuffer> dedicatedStaging;
+    };
+
+    struct Staging
+    {
+        VkBuffer buffer;
+        VkDeviceSize offset;
+        void* mapped;
+    };
+
+    void createStagingRing();
+    void createCommandPools();
+    VkCommandBuffer allocateCommandBuffer(VkCommandPool pool);
+
+    bool supportsLinearBlit(VkFormat format);
+    // every level in transfer dst with level 0 written -> every level in shader read only
+    void recordMipChain(VkCommandBuffer commandBuffer, const MipChain& chain);
+    void recordOwnershipTransfers();
+    void submitAcquire(Batch& batch);
+
+    void beginBatch();
+    UploadToken submitBatch();
+    void retireBatches(bool waitOldest);
+    void waitToken(UploadToken token);
+
+    Staging allocateStaging(VkDeviceSize size);
+    void destroyStaging(StagingBuffer& staging);
+
+    /* data */
+    Device& m_device;
+    mutable std::mutex m_mutex;
+
+    bool m_dedicatedTransfer{false};
+    uint32_t m_transferFamily{0};
+    uint32_t m_graphicsFamily{0};
+    VkCommandPool m_commandPool{VK_NULL_HANDLE};     // transfer family
+    VkCommandPool m_acquirePool{VK_NULL_HANDLE};     // graphics family
+
+    StagingBuffer m_ring{};
+    uint64_t m_ringHead{0}; // next free position, positions grow forever and wrap modulo RING_SIZE
+    uint64_t m_ringTail{0}; // oldest position still read by the GPU
+
+    bool m_recording{false};
+    Batch m_current{};
+    std::deque<Batch> m_inFlight;
+    std::vector<Batch> m_freeBatches;
+
+    UploadToken m_nextToken{1};
+    UploadToken m_completedToken{0};
+};
+
+} // namespace hyd
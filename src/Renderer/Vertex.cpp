@@ -0,0 +1,210 @@
+#include "Vertex.hpp"
+
+//libs
+#include <glm/gtc/packing.hpp>
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+namespace hyd
+{
+
+namespace Vertex
+{
+
+namespace
+{
+
+const AttributeUsageData USAGE_DATA_TABLE[static_cast<uint32_t>(AttributeUsage::NumUsages)] =
+{
+    // {friendlyName, semanticName}
+    { "Position", "POSITION" },
+    { "Color", "COLOR" },
+    { "Normal", "NORMAL" },
+    { "TexCoord", "TEXCOORD" },
+    { "Weights", "BLENDWEIGHT" },
+    { "Indices", "BLENDINDICES" },
+    { "Tangent", "TEXCOORD" },
+    { "BiTangent", "TEXCOORD" }
+};
+
+const AttributeTypeData TYPE_DATA_TABLE[static_cast<uint32_t>(AttributeType::NumTypes)] =
+{
+    // {friendlyName, byteSize, format}
+    { "Float16_1", 2, VK_FORMAT_R16_SFLOAT },
+    { "Float16_2", 4, VK_FORMAT_R16G16_SFLOAT },
+    { "Float16_4", 8, VK_FORMAT_R16G16B16A16_SFLOAT },
+
+    { "Float32_1", 4, VK_FORMAT_R32_SFLOAT },
+    { "Float32_2", 8, VK_FORMAT_R32G32_SFLOAT },
+    { "Float32_3", 12, VK_FORMAT_R32G32B32_SFLOAT },
+    { "Float32_4", 16, VK_FORMAT_R32G32B32A32_SFLOAT },
+
+    { "Byte_1", 1, VK_FORMAT_R8_UNORM },
+    { "Byte_2", 2, VK_FORMAT_R8G8_UNORM },
+    { "Byte_4", 4, VK_FORMAT_R8G8B8A8_UNORM },
+
+    { "Short_1", 2, VK_FORMAT_R16_SNORM },
+    { "Short_2", 4, VK_FORMAT_R16G16_SNORM },
+    { "Short_4", 8, VK_FORMAT_R16G16B16A16_SNORM },
+
+    { "UInt16_1", 2, VK_FORMAT_R16_UINT },
+    { "UInt16_2", 4, VK_FORMAT_R16G16_UINT },
+    { "UInt16_4", 8, VK_FORMAT_R16G16B16A16_UINT },
+
+    { "UInt32_1", 4, VK_FORMAT_R32_UINT },
+    { "UInt32_2", 8, VK_FORMAT_R32G32_UINT },
+    { "UInt32_3", 12, VK_FORMAT_R32G32B32_UINT },
+    { "UInt32_4", 16, VK_FORMAT_R32G32B32A32_UINT },
+};
+
+} // namespace
+
+const AttributeUsageData& getUsageData(AttributeUsage usage){
+    return USAGE_DATA_TABLE[static_cast<uint32_t>(usage)];
+}
+
+const AttributeTypeData& getTypeData(AttributeType type){
+    return TYPE_DATA_TABLE[static_cast<uint32_t>(type)];
+}
+
+Format::Format(VertexFormat format){
+    switch (format)
+    {
+    case VF_P3F_C4B_T2F:
+        addAttribute(AttributeUsage::Position, AttributeType::Float32_3);
+        addAttribute(AttributeUsage::Color, AttributeType::Byte_4);
+        addAttribute(AttributeUsage::TexCoord, AttributeType::Float32_2);
+        break;
+    case VF_P3F_C4B_T2F_W4B_I4S: // Skinned vertex stream.
+        addAttribute(AttributeUsage::Position, AttributeType::Float32_3);
+        addAttribute(AttributeUsage::Color, AttributeType::Byte_4);
+        addAttribute(AttributeUsage::TexCoord, AttributeType::Float32_2);
+        addAttribute(AttributeUsage::Weights, AttributeType::Byte_4);
+        addAttribute(AttributeUsage::Indices, AttributeType::UInt16_4);
+        break;
+    case VF_P2F_C4B_T2F_F4B:
+        addAttribute(AttributeUsage::Position, AttributeType::Float32_2);
+        addAttribute(AttributeUsage::Color, AttributeType::Byte_4);
+        addAttribute(AttributeUsage::TexCoord, AttributeType::Float32_2);
+        addAttribute(AttributeUsage::Indices, AttributeType::UInt16_2);
+        break;
+    case VF_P4S_C4B_N2S_T2H:
+        addAttribute(AttributeUsage::Position, AttributeType::Short_4);
+        addAttribute(AttributeUsage::Color, AttributeType::Byte_4);
+        addAttribute(AttributeUsage::Normal, AttributeType::Short_2);
+        addAttribute(AttributeUsage::TexCoord, AttributeType::Float16_2);
+        break;
+    case VF_P4S_N2S_T2H:
+        addAttribute(AttributeUsage::Position, AttributeType::Short_4);
+        addAttribute(AttributeUsage::Normal, AttributeType::Short_2);
+        addAttribute(AttributeUsage::TexCoord, AttributeType::Float16_2);
+        break;
+    case VF_P4S:
+        addAttribute(AttributeUsage::Position, AttributeType::Short_4);
+        break;
+    case VF_Unknown:
+    case VF_Max:
+    default:
+        format = VF_Unknown;
+    }
+    m_enum = format;
+    calculateStrideAndUsageCounts();
+}
+
+void Format::addAttribute(AttributeUsage usage, AttributeType type){
+    assert(m_numAttributes < MAX_ATTRIBUTES && "Too many attributes added, change the size of MAX_ATTRIBUTES");
+    m_vertexAttributes[m_numAttributes++] = Attribute::createAttribute(usage, type);
+}
+
+void Format::calculateStrideAndUsageCounts(){
+    static_assert(static_cast<uint32_t>(AttributeUsage::NumUsages) <= 8, "We use 3 bits to represent usage so we only support 8 usages for a vertex format attribute.");
+    static_assert(static_cast<uint32_t>(AttributeType::NumTypes) <= 32, "We use 5 bits to represent type so we only support up to 32 types for a vertex format attribute.");
+
+    std::fill(std::begin(m_attributeUsageCounts), std::end(m_attributeUsageCounts), uint8_t{0});
+    uint32_t stride = 0;
+    for (uint32_t i = 0; i < m_numAttributes; i++){
+        uint8_t attribute = m_vertexAttributes[i];
+        stride += Attribute::getByteLength(attribute);
+        m_attributeUsageCounts[static_cast<uint32_t>(Attribute::getUsage(attribute))]++;
+    }
+    assert(stride < (1u << (sizeof(m_stride) * 8)) && "Vertex stride is larger than the maximum supported, update the type of m_stride");
+    assert(stride % VERTEX_BUFFER_ALIGNMENT == 0 && "the vertices must stay aligned in the buffer");
+    m_stride = static_cast<uint8_t>(stride);
+}
+
+uint32_t Format::getOffset(AttributeUsage usage) const {
+    uint32_t offset = 0;
+    for (uint32_t i = 0; i < m_numAttributes; i++){
+        if (Attribute::getUsage(m_vertexAttributes[i]) == usage)
+            return offset;
+        offset += Attribute::getByteLength(m_vertexAttributes[i]);
+    }
+    return NO_OFFSET;
+}
+
+VkVertexInputBindingDescription Format::getBindingDescription(uint32_t binding) const {
+    VkVertexInputBindingDescription bindingDescription{};
+    bindingDescription.binding = binding;
+    bindingDescription.stride = m_stride;
+    bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+    return bindingDescription;
+}
+
+std::vector<VkVertexInputAttributeDescription> Format::getAttributeDescriptions(uint32_t binding) const {
+    std::vector<AttributeUsage> usages;
+    for (uint32_t usage = 0; usage < static_cast<uint32_t>(AttributeUsage::NumUsages); usage++)
+        usages.push_back(static_cast<AttributeUsage>(usage));
+    return getAttributeDescriptions(usages, binding);
+}
+
+std::vector<VkVertexInputAttributeDescription> Format::getAttributeDescriptions(
+    const std::vector<AttributeUsage>& usages, uint32_t binding) const {
+    std::vector<VkVertexInputAttributeDescription> attributeDescriptions{};
+    for (AttributeUsage usage : usages){
+        uint32_t offset = 0;
+        for (uint32_t i = 0; i < m_numAttributes; i++){
+            uint8_t attribute = m_vertexAttributes[i];
+            if (Attribute::getUsage(attribute) == usage){
+                //                              {location, binding, format, offset}
+                attributeDescriptions.push_back({static_cast<uint32_t>(usage), binding, Attribute::getFormat(attribute), offset});
+                break;
+            }
+            offset += Attribute::getByteLength(attribute);
+        }
+    }
+    return attributeDescriptions;
+}
+
+int16_t packSnorm16(float value){
+    return static_cast<int16_t>(std::lround(std::clamp(value, -1.0f, 1.0f) * 32767.0f));
+}
+
+uint8_t packUnorm8(float value){
+    return static_cast<uint8_t>(std::lround(std::clamp(value, 0.0f, 1.0f) * 255.0f));
+}
+
+uint16_t packHalf(float value){
+    return glm::packHalf1x16(value);
+}
+
+glm::vec2 octEncode(const glm::vec3& normal){
+    float length = std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+    if (length == 0.0f)
+        return glm::vec2(0.0f);
+
+    glm::vec2 encoded = glm::vec2(normal.x, normal.y) / length;
+    // the lower hemisphere is folded over the diagonals
+    if (normal.z < 0.0f){
+        glm::vec2 folded = glm::vec2(1.0f - std::abs(encoded.y), 1.0f - std::abs(encoded.x));
+        encoded.x = encoded.x >= 0.0f ? folded.x : -folded.x;
+        encoded.y = encoded.y >= 0.0f ? folded.y : -folded.y;
+    }
+    return encoded;
+}
+
+} // namespace Vertex
+
+} // namespace hyd
@@ -1,304 +1,185 @@
+/*
+Flexible vertex formats. A format is a list of attributes (usage and type)
+packed one after the other in a single stream, it gives the stride, the offset
+of each usage and the Vulkan vertex input descriptions of the pipelines.
+An attribute is read by the shaders at the location of its usage, so a format
+without colors still reads the normals at location 2.
+The integer types are normalized: the bytes as unorm and the shorts as snorm,
+the quantized attributes reach the shaders as floats.
+*/
 #pragma once
 
-
 #include "VertexFormat.hpp"
 
+//libs
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+#include <vulkan/vulkan.h>
+
 // std
+#include <cstdint>
 #include <string>
+#include <vector>
 
 namespace hyd
 {
-    
 
-    namespace Vertex
+namespace Vertex
+{
+    const uint32_t VERTEX_BUFFER_ALIGNMENT = 4;
+
+    // This enum must only have 8 entries because only 3 bits are used to store usage.
+    // the usage is also the shader location of the attribute
+    enum class AttributeUsage : uint8_t
     {
-        const uint32_t VERTEX_BUFFER_ALIGNMENT = 4;
-        // This enum must only have 8 entries because only 3 bits are used to store usage.
-        enum class AttributeUsage : uint8
-        {
-            Position,
-            Color,
-            Normal,
-            TexCoord,
-            Weights,
-            Indices,
-            Tangent,
-            BiTangent,
-            NumUsages
-        };
-
-
-        struct AttributeUsageData
-        {
-            std::string friendlyName;
-            std::string semanticName;
-        };
-
-        static AttributeUsageData AttributeUsageDataTable[(uint)AttributeUsage::NumUsages] =
-        {
-            // {friendlyName, semanticName}
-            { "Position", "POSITION" },
-            { "Color", "COLOR" },
-            { "Normal", "NORMAL" },
-            { "TexCoord", "TEXCOORD" },
-            { "Weights", "BLENDWEIGHT" },
-            { "Indices", "BLENDINDICES" },
-            { "Tangent", "TEXCOORD" },
-            { "BiTangent", "TEXCOORD" }
-        };
-
-
-      // This enum must have 32 or less entries as 5 bits are used to store type.
-        enum class AttributeType : uint8
-        {
-            Float16_1 = 0,
-            Float16_2,
-            Float16_4,
-
-            Float32_1,
-            Float32_2,
-            Float32_3,
-            Float32_4,
-
-            Byte_1,
-            Byte_2,
-            Byte_4,
-
-            Short_1,
-            Short_2,
-            Short_4,
-
-            UInt16_1,
-            UInt16_2,
-            UInt16_4,
-
-            UInt32_1,
-            UInt32_2,
-            UInt32_3,
-            UInt32_4,
-
-            NumTypes
-        };
+        Position,
+        Color,
+        Normal,
+        TexCoord,
+        Weights,
+        Indices,
+        Tangent,
+        BiTangent,
+        NumUsages
+    };
+
+    struct AttributeUsageData
+    {
+        std::string friendlyName;
+        std::string semanticName;
+    };
+
+    // This enum must have 32 or less entries as 5 bits are used to store type.
+    enum class AttributeType : uint8_t
+    {
+        Float16_1 = 0,
+        Float16_2,
+        Float16_4,
+
+        Float32_1,
+        Float32_2,
+        Float32_3,
+        Float32_4,
+
+        Byte_1, // unorm
+        Byte_2,
+        Byte_4,
+
+        Short_1, // snorm
+        Short_2,
+        Short_4,
+
+        UInt16_1,
+        UInt16_2,
+        UInt16_4,
+
+        UInt32_1,
+        UInt32_2,
+        UInt32_3,
+        UInt32_4,
+
+        NumTypes
+    };
 
     struct AttributeTypeData
-        {
-            std::string friendlyName;
-            uint8 byteSize;
-        };
-
-        static AttributeTypeData AttributeTypeDataTable[(unsigned int)AZ::Vertex::AttributeType::NumTypes] =
-        {
-            { "Float16_1", 2 },
-            { "Float16_2", 4 },
-            { "Float16_4", 8 },
-
-            { "Float32_1", 4 },
-            { "Float32_2", 8 },
-            { "Float32_3", 12 },
-            { "Float32_4", 16 },
-
-            { "Byte_1", 1 },
-            { "Byte_2", 2 },
-            { "Byte_4", 4 },
-
-            { "Short_1", 2 },
-            { "Short_2", 4 },
-            { "Short_4", 8 },
-
-            { "UInt16_1", 2 },
-            { "UInt16_2", 4 },
-            { "UInt16_4", 8 },
-
-            { "UInt32_1", 4 },
-            { "UInt32_2", 8 },
-            { "UInt32_3", 12 },
-            { "UInt32_4", 16 },
-        };
-
-   //! Stores the usage, type, and byte length of an individual vertex attribute
-        class Attribute
-        {
-        public:
-            // Usage stored in the 3 lower bits and Type stored in the 5 upper bits.
-            static const uint8 kUsageBitCount = 3;
-            static const uint8 kUsageMask = 0x07;
-            static const uint8 kTypeMask = 0xf8;
-            static uint8 CreateAttribute(AttributeUsage usage, AttributeType type)
-            {
-                return (static_cast<uint8>(type) << kUsageBitCount) | static_cast<uint8>(usage);
-            }
-            static AttributeUsage GetUsage(const uint8 attribute)
-            {
-                return static_cast<AttributeUsage>(attribute & kUsageMask);
-            }
-            static AttributeType GetType(const uint8 attribute)
-            {
-                return static_cast<AttributeType>((attribute & kTypeMask) >> kUsageBitCount);
-            }
-            static uint8 GetByteLength(const uint8 attribute)
-            {
-                return AttributeTypeDataTable[(uint)GetType(attribute)].byteSize;
-            }
-            static const AZStd::string& GetSemanticName(uint8 attribute)
-            {
-                return AttributeUsageDataTable[(uint)GetUsage(attribute)].semanticName;
-            }
-        };
-
-
-     //! Flexible vertex format class
-        class Format
-        {
-        public:
-            Format(){};
-
-            //! Conversion from old hard-coded EVertexFormat enum to new, flexible vertex class
-            Format(VertexFormat format)
-            {
-                m_enum = VF_Unknown;
-                m_numAttributes = 0;
-                switch (format)
-                {
-                case VF_Unknown:
-                    m_enum = VF_Unknown;
-                    break;
-                case VF_P3F_C4B_T2F:
-                    AddAttribute(Attribute::CreateAttribute(AttributeUsage::Position, AttributeType::Float32_3));
-                    AddAttribute(Attribute::CreateAttribute(AttributeUsage::Color, AttributeType::Byte_4));
-                    AddAttribute(Attribute::CreateAttribute(AttributeUsage::TexCoord, AttributeType::Float32_2));
-                    m_enum = VF_P3F_C4B_T2F;
-                    break;
-                case VF_P3F_C4B_T2F_W4B_I4S:// Skinned vertex stream.
-                    AddAttribute(Attribute::CreateAttribute(AttributeUsage::Position, AttributeType::Float32_3));
-                    AddAttribute(Attribute::CreateAttribute(AttributeUsage::Color, AttributeType::Byte_4));
-                    AddAttribute(Attribute::CreateAttribute(AttributeUsage::TexCoord, AttributeType::Float32_2));
-                    AddAttribute(Attribute::CreateAttribute(AttributeUsage::Weights, AttributeType::Byte_4));
-                    AddAttribute(Attribute::CreateAttribute(AttributeUsage::Indices, AttributeType::UInt16_4));
-                    m_enum = VF_W4B_I4S;
-                    break;
-                case VF_P2F_C4B_T2F_F4B:
-                    AddAttribute(Attribute::CreateAttribute(AttributeUsage::Position, AttributeType::Float32_2));
-                    AddAttribute(Attribute::CreateAttribute(AttributeUsage::Color, AttributeType::Byte_4));
-                    AddAttribute(Attribute::CreateAttribute(AttributeUsage::TexCoord, AttributeType::Float32_2));
-                    AddAttribute(Attribute::CreateAttribute(AttributeUsage::Indices, AttributeType::UInt16_2));
-                    m_enum = VF_P2F_C4B_T2F_F4B;
-                    break;
-                case VF_Max:
-                default:
-                    // AZ_Error("VF", false, "Invalid vertex format");
-                    m_enum = VF_Unknown;
-                }
-                CalculateStrideAndUsageCounts();
-            }
-
-            //! Get the equivalent old-style EVertexFormat enum
-            uint GetEnum() const { return m_enum; }
-
-            static const uint8 kHas16BitFloatPosition  = 0x4;
-            static const uint8 kHas16BitFloatTexCoords = 0x2;
-            static const uint8 kHas32BitFloatTexCoords = 0x1;
-
-
-            uint32 GetAttributeUsageCount(AttributeUsage usage) const
-            {
-                return (uint32)m_attributeUsageCounts[(uint)usage];
-            }
-
-            const uint8* GetAttributes( uint32 &outCount) const
-            {
-                outCount = m_numAttributes;
-                return m_vertexAttributes;
-            }
-
-            uint GetStride(void) const { return m_stride; }
-
-            // Quick comparison operators.
-            bool operator==(const Format& other) const
-            {
-                return m_enum == other.m_enum;
-            }
-            bool operator!=(const Format& other) const
-            {
-                return !(*this == other);
-            }
-            bool operator==(const EVertexFormat& other) const
-            {
-                return m_enum == other;
-            }
-            // Used in RendermeshMerger.cpp
-            // CHWShader_D3D::mfUpdateFXVertexFormat and CHWShader_D3D::mfVertexFormat want the max between two vertex formats...why? It seems like a bad guess of which vertex format to use since there's no particular order to EVertexFormats...other than the more specialized EVertexFormats come after the base EVertexFormats
-            bool operator<(const Format& other) const
-            {
-                return m_enum < other.m_enum;
-            }
-            bool operator<=(const Format& other) const
-            {
-                return (*this == other || *this < other);
-            }
-            bool operator>(const Format& other) const
-            {
-                return !(*this <= other);
-            }
-            bool operator>=(const Format& other) const
-            {
-                return (*this == other || *this > other);
-            }
-        private:
-            void AddAttribute(uint8 attribute)
-            {
-                // AZ_Assert(m_numAttributes < kMaxAttributes, "Too many attributes added.  Change the size of kMaxAttributes");
-                m_vertexAttributes[m_numAttributes++] = attribute;
-
-                // Update the flags.
-                AttributeUsage usage = Attribute::GetUsage(attribute);
-                AttributeType type = Attribute::GetType(attribute);
-                if (usage == AttributeUsage::TexCoord)
-                {
-                    if (type == AttributeType::Float16_2) {
-                        m_flags |= kHas16BitFloatTexCoords;
-                    }
-                    else if (type == AttributeType::Float32_2 || type == AttributeType::Float32_3 || type == AttributeType::Float32_4) {
-                        m_flags |= kHas32BitFloatTexCoords;
-                    }
-                }
-                else if (usage == AttributeUsage::Position && type == AttributeType::Float16_4) {
-                    m_flags |= kHas16BitFloatPosition;
-                }
-            }
-
-            //! Calculates the sum of the size in bytes of all attributes that make up this format
-            void CalculateStrideAndUsageCounts()
-            {
-                static_assert((uint32)AttributeUsage::NumUsages <= 8, "We use 3 bits to represent usage so we only support 8 usages for a vertex format attribute.");
-                static_assert((uint32)AttributeType::NumTypes <= 32, "We use 5 bits to represent type so we only support up to 32 types for a vertex format attribute.");
-
-                for (uint index = 0; index < (uint)AttributeUsage::NumUsages; ++index)
-                {
-                    m_attributeUsageCounts[index] = 0;
-                }
-                uint32 stride = 0;
-                for (uint ii = 0; ii < m_numAttributes; ++ii)
-                {
-                    uint8 attribute = m_vertexAttributes[ii];
-                    stride += Attribute::GetByteLength(attribute);
-                    m_attributeUsageCounts[(uint)Attribute::GetUsage(attribute)]++;
-                }
-                // AZ_Assert(stride < (0x1 << (sizeof(m_stride) * 8)), "Vertex stride is larger than the maximum supported, update the type for m_stride in Vertex.h");
-
-                m_stride = static_cast<uint8>(stride);
-            }
-
-
-            static const uint32_t kMaxAttributes = 8;
-            uint8 m_vertexAttributes[kMaxAttributes] = { 0 };
-
-            uint8 m_attributeUsageCounts[(uint)AttributeUsage::NumUsages] = { 0 };
-            uint8 m_numAttributes = 0;
-            uint8 m_enum = VF_Unknown;
-            uint8 m_stride = 0;
-            uint8 m_flags = 0x0;
-        };
+    {
+        std::string friendlyName;
+        uint8_t byteSize;
+        VkFormat format;
+    };
 
+    const AttributeUsageData& getUsageData(AttributeUsage usage);
+    const AttributeTypeData& getTypeData(AttributeType type);
 
+    //! Stores the usage, type, and byte length of an individual vertex attribute
+    class Attribute
+    {
+    public:
+        // Usage stored in the 3 lower bits and Type stored in the 5 upper bits.
+        static const uint8_t USAGE_BIT_COUNT = 3;
+        static const uint8_t USAGE_MASK = 0x07;
+        static const uint8_t TYPE_MASK = 0xf8;
+
+        static uint8_t createAttribute(AttributeUsage usage, AttributeType type){
+            return static_cast<uint8_t>((static_cast<uint8_t>(type) << USAGE_BIT_COUNT) | static_cast<uint8_t>(usage));
+        }
+        static AttributeUsage getUsage(uint8_t attribute){
+            return static_cast<AttributeUsage>(attribute & USAGE_MASK);
+        }
+        static AttributeType getType(uint8_t attribute){
+            return static_cast<AttributeType>((attribute & TYPE_MASK) >> USAGE_BIT_COUNT);
+        }
+        static uint8_t getByteLength(uint8_t attribute){
+            return getTypeData(getType(attribute)).byteSize;
+        }
+        static VkFormat getFormat(uint8_t attribute){
+            return getTypeData(getType(attribute)).format;
+        }
+        static const std::string& getSemanticName(uint8_t attribute){
+            return getUsageData(getUsage(attribute)).semanticName;
+        }
+    };
+
+    //! Flexible vertex format class
+    class Format
+    {
+    public:
+        static const uint32_t NO_OFFSET = ~0u;
+
+        Format(){}
+        //! Conversion from the hard-coded VertexFormat enum to the flexible vertex class
+        Format(VertexFormat format);
+
+        VertexFormat getEnum() const { return m_enum; }
+
+        uint32_t getAttributeUsageCount(AttributeUsage usage) const {
+            return m_attributeUsageCounts[static_cast<uint32_t>(usage)];
+        }
+        bool hasUsage(AttributeUsage usage) const { return getAttributeUsageCount(usage) > 0; }
+
+        const uint8_t* getAttributes(uint32_t& outCount) const {
+            outCount = m_numAttributes;
+            return m_vertexAttributes;
+        }
+
+        uint32_t getStride() const { return m_stride; }
+        // byte offset of the first attribute of the usage in the vertex, NO_OFFSET when the format doesn't have it
+        uint32_t getOffset(AttributeUsage usage) const;
+
+        VkVertexInputBindingDescription getBindingDescription(uint32_t binding = 0) const;
+        // one attribute per usage (the first one), at the location of the usage
+        std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions(uint32_t binding = 0) const;
+        // the subset of the attributes a pass reads, the missing usages are skipped
+        std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions(
+            const std::vector<AttributeUsage>& usages, uint32_t binding = 0) const;
+
+        bool operator==(const Format& other) const { return m_enum == other.m_enum; }
+        bool operator!=(const Format& other) const { return !(*this == other); }
+        bool operator==(VertexFormat other) const { return m_enum == other; }
+
+    private:
+        void addAttribute(AttributeUsage usage, AttributeType type);
+        //! Calculates the sum of the size in bytes of all attributes that make up this format
+        void calculateStrideAndUsageCounts();
+
+        static const uint32_t MAX_ATTRIBUTES = 8;
+        uint8_t m_vertexAttributes[MAX_ATTRIBUTES] = { 0 };
+
+        uint8_t m_attributeUsageCounts[static_cast<uint32_t>(AttributeUsage::NumUsages)] = { 0 };
+        uint8_t m_numAttributes = 0;
+        VertexFormat m_enum = VF_Unknown;
+        uint8_t m_stride = 0;
+    };
+
+    // quantization of the attributes to the normalized types
+    int16_t packSnorm16(float value);
+    uint8_t packUnorm8(float value);
+    uint16_t packHalf(float value);
+    // unit vector to the octahedral map in [-1, 1]², the zero vector maps to (0, 0)
+    // decoded by the vertex shaders
+    glm::vec2 octEncode(const glm::vec3& normal);
+
+} // namespace Vertex
 
 } // namespace hyd
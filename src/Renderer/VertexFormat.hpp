@@ -1,17 +1,22 @@
 #pragma once
 
+// std
+#include <cstdint>
 
 namespace hyd
 {
-    
-enum VertexFormat : uint8
+
+enum VertexFormat : uint8_t
 {
     VF_Unknown,
 
     VF_P3F_C4B_T2F, // simple
     VF_P3F_C4B_T2F_W4B_I4S,  // Skinned weights/indices stream.
     VF_P2F_C4B_T2F_F4B, // UI
-    
+    VF_P4S_C4B_N2S_T2H, // quantized mesh: position in its bounds, color, octahedral normal, half uv
+    VF_P4S_N2S_T2H, // quantized mesh without color
+    VF_P4S, // quantized positions only, the stream of the depth passes
+
     VF_Max,
 };
 
@@ -0,0 +1,324 @@
+#include "BlockCompression.hpp"
+
+#include "Core/ThreadPool.hpp"
+
+// std
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+
+namespace hyd
+{
+
+namespace
+{
+
+constexpr uint32_t TEXEL_COUNT = 16;
+
+struct Color
+{
+    float r, g, b, a;
+};
+
+// least significant bit first, as the BC formats lay their fields
+class BitWriter
+{
+public:
+    explicit BitWriter(unsigned char* out, uint32_t byteCount) : m_out{out} { std::memset(out, 0, byteCount); }
+
+    void write(uint32_t value, uint32_t bitCount){
+        for (uint32_t i = 0; i < bitCount; i++, m_position++){
+            if (value & (1u << i))
+                m_out[m_position / 8] |= static_cast<unsigned char>(1u << (m_position % 8));
+        }
+    }
+
+private:
+    unsigned char* m_out;
+    uint32_t m_position{0};
+};
+
+// principal axis of the texels through their mean, by power iteration on the covariance
+void principalAxis(const unsigned char* block, uint32_t channelCount, float mean[4], float axis[4]){
+    for (uint32_t c = 0; c < 4; c++){
+        mean[c] = 0.f;
+        axis[c] = 0.f;
+    }
+    for (uint32_t i = 0; i < TEXEL_COUNT; i++)
+        for (uint32_t c = 0; c < channelCount; c++)
+            mean[c] += block[i * 4 + c];
+    for (uint32_t c = 0; c < channelCount; c++)
+        mean[c] /= TEXEL_COUNT;
+
+    float covariance[4][4]{};
+    for (uint32_t i = 0; i < TEXEL_COUNT; i++){
+        for (uint32_t c0 = 0; c0 < channelCount; c0++){
+            for (uint32_t c1 = 0; c1 < channelCount; c1++){
+                covariance[c0][c1] += (block[i * 4 + c0] - mean[c0]) * (block[i * 4 + c1] - mean[c1]);
+            }
+        }
+    }
+
+    float vector[4] = {1.f, 1.f, 1.f, 1.f};
+    for (int iteration = 0; iteration < 8; iteration++){
+        float next[4]{};
+        float length = 0.f;
+        for (uint32_t c0 = 0; c0 < channelCount; c0++){
+            for (uint32_t c1 = 0; c1 < channelCount; c1++)
+                next[c0] += covariance[c0][c1] * vector[c1];
+            length = std::max(length, std::abs(next[c0]));
+        }
+        if (length == 0.f)
+            break;
+        for (uint32_t c = 0; c < channelCount; c++)
+            vector[c] = next[c] / length;
+    }
+    for (uint32_t c = 0; c < channelCount; c++)
+        axis[c] = vector[c];
+}
+
+// the texels with the lowest and highest projection on the principal axis
+void axisExtremes(const unsigned char* block, uint32_t channelCount, float low[4], float high[4]){
+    float mean[4], axis[4];
+    principalAxis(block, channelCount, mean, axis);
+
+    float minProjection = 1e30f, maxProjection = -1e30f;
+    for (uint32_t i = 0; i < TEXEL_COUNT; i++){
+        float projection = 0.f;
+        for (uint32_t c = 0; c < channelCount; c++)
+            projection += (block[i * 4 + c] - mean[c]) * axis[c];
+        minProjection = std::min(minProjection, projection);
+        maxProjection = std::max(maxProjection, projection);
+    }
+
+    float axisLength2 = 0.f;
+    for (uint32_t c = 0; c < channelCount; c++)
+        axisLength2 += axis[c] * axis[c];
+    if (axisLength2 == 0.f)
+        axisLength2 = 1.f;
+    for (uint32_t c = 0; c < 4; c++){
+        low[c] = c < channelCount ? std::clamp(mean[c] + axis[c] * minProjection / axisLength2, 0.f, 255.f) : 255.f;
+        high[c] = c < channelCount ? std::clamp(mean[c] + axis[c] * maxProjection / axisLength2, 0.f, 255.f) : 255.f;
+    }
+}
+
+uint16_t packRgb565(const float color[4]){
+    uint32_t r = static_cast<uint32_t>(std::lround(color[0] * 31.f / 255.f));
+    uint32_t g = static_cast<uint32_t>(std::lround(color[1] * 63.f / 255.f));
+    uint32_t b = static_cast<uint32_t>(std::lround(color[2] * 31.f / 255.f));
+    return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+}
+
+void unpackRgb565(uint16_t packed, int color[3]){
+    color[0] = ((packed >> 11) & 31) * 255 / 31;
+    color[1] = ((packed >> 5) & 63) * 255 / 63;
+    color[2] = (packed & 31) * 255 / 31;
+}
+
+void encodeColorBlock(const unsigned char* block, unsigned char* out){
+    float low[4], high[4];
+    axisExtremes(block, 3, low, high);
+
+    uint16_t color0 = packRgb565(high);
+    uint16_t color1 = packRgb565(low);
+    // color0 > color1 selects the 4 colors mode
+    if (color0 < color1)
+        std::swap(color0, color1);
+
+    uint32_t indices = 0;
+    if (color0 != color1){
+        int palette[4][3];
+        unpackRgb565(color0, palette[0]);
+        unpackRgb565(color1, palette[1]);
+        for (int c = 0; c < 3; c++){
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        }
+
+        for (uint32_t i = 0; i < TEXEL_COUNT; i++){
+            uint32_t best = 0;
+            int bestError = 1 << 30;
+            for (uint32_t p = 0; p < 4; p++){
+                int error = 0;
+                for (int c = 0; c < 3; c++){
+                    int d = block[i * 4 + c] - palette[p][c];
+                    error += d * d;
+                }
+                if (error < bestError){
+                    bestError = error;
+                    best = p;
+                }
+            }
+            indices |= best << (2 * i);
+        }
+    }
+
+    BitWriter writer{out, 8};
+    writer.write(color0, 16);
+    writer.write(color1, 16);
+    writer.write(indices, 32);
+}
+
+// one channel of the block, 8 values mode
+void encodeChannelBlock(const unsigned char* block, uint32_t channel, unsigned char* out){
+    int low = 255, high = 0;
+    for (uint32_t i = 0; i < TEXEL_COUNT; i++){
+        low = std::min<int>(low, block[i * 4 + channel]);
+        high = std::max<int>(high, block[i * 4 + channel]);
+    }
+
+    BitWriter writer{out, 8};
+    writer.write(static_cast<uint32_t>(high), 8);
+    writer.write(static_cast<uint32_t>(low), 8);
+    for (uint32_t i = 0; i < TEXEL_COUNT; i++){
+        uint32_t index = 0;
+        if (high > low){
+            // step from the high end: 0 is high (index 0), 7 is low (index 1), the others are interpolated (2..7)
+            int step = static_cast<int>(std::lround((high - block[i * 4 + channel]) * 7.f / (high - low)));
+            index = step == 0 ? 0 : step == 7 ? 1 : static_cast<uint32_t>(step + 1);
+        }
+        writer.write(index, 3);
+    }
+}
+
+constexpr std::array<int, 16> BC7_WEIGHTS = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+// 7 bit endpoint and its p-bit, the p-bit is shared by the 4 channels of the endpoint
+void quantizeBC7Endpoint(const float color[4], uint32_t quantized[4], uint32_t& pBit){
+    float bestError = 1e30f;
+    for (uint32_t p = 0; p < 2; p++){
+        uint32_t candidate[4];
+        float error = 0.f;
+        for (uint32_t c = 0; c < 4; c++){
+            candidate[c] = static_cast<uint32_t>(std::clamp(std::lround((color[c] - p) / 2.f), 0l, 127l));
+            float d = color[c] - float((candidate[c] << 1) | p);
+            error += d * d;
+        }
+        if (error < bestError){
+            bestError = error;
+            pBit = p;
+            std::copy(candidate, candidate + 4, quantized);
+        }
+    }
+}
+
+} // namespace
+
+uint32_t blockSize(BlockFormat format){
+    return format == BlockFormat::BC1 ? 8 : 16;
+}
+
+size_t compressedSize(BlockFormat format, uint32_t width, uint32_t height){
+    return size_t((width + 3) / 4) * ((height + 3) / 4) * blockSize(format);
+}
+
+void encodeBlockBC1(const unsigned char* block, unsigned char* out){
+    encodeColorBlock(block, out);
+}
+
+void encodeBlockBC3(const unsigned char* block, unsigned char* out){
+    encodeChannelBlock(block, 3, out);
+    encodeColorBlock(block, out + 8);
+}
+
+void encodeBlockBC5(const unsigned char* block, unsigned char* out){
+    encodeChannelBlock(block, 0, out);
+    encodeChannelBlock(block, 1, out + 8);
+}
+
+void encodeBlockBC7(const unsigned char* block, unsigned char* out){
+    float low[4], high[4];
+    axisExtremes(block, 4, low, high);
+
+    uint32_t endpoints[2][4];
+    uint32_t pBits[2];
+    quantizeBC7Endpoint(low, endpoints[0], pBits[0]);
+    quantizeBC7Endpoint(high, endpoints[1], pBits[1]);
+
+    int palette[16][4];
+    for (uint32_t c = 0; c < 4; c++){
+        int e0 = static_cast<int>((endpoints[0][c] << 1) | pBits[0]);
+        int e1 = static_cast<int>((endpoints[1][c] << 1) | pBits[1]);
+        for (uint32_t w = 0; w < 16; w++)
+            palette[w][c] = ((64 - BC7_WEIGHTS[w]) * e0 + BC7_WEIGHTS[w] * e1 + 32) >> 6;
+    }
+
+    uint32_t indices[TEXEL_COUNT];
+    for (uint32_t i = 0; i < TEXEL_COUNT; i++){
+        int bestError = 1 << 30;
+        for (uint32_t w = 0; w < 16; w++){
+            int error = 0;
+            for (uint32_t c = 0; c < 4; c++){
+                int d = block[i * 4 + c] - palette[w][c];
+                error += d * d;
+            }
+            if (error < bestError){
+                bestError = error;
+                indices[i] = w;
+            }
+        }
+    }
+
+    // the first index is stored without its high bit, swap the endpoints when it is set
+    if (indices[0] >= 8){
+        std::swap(endpoints[0], endpoints[1]);
+        std::swap(pBits[0], pBits[1]);
+        for (auto& index : indices)
+            index = 15 - index;
+    }
+
+    BitWriter writer{out, 16};
+    writer.write(1u << 6, 7); // mode 6
+    for (uint32_t c = 0; c < 4; c++){
+        writer.write(endpoints[0][c], 7);
+        writer.write(endpoints[1][c], 7);
+    }
+    writer.write(pBits[0], 1);
+    writer.write(pBits[1], 1);
+    writer.write(indices[0], 3);
+    for (uint32_t i = 1; i < TEXEL_COUNT; i++)
+        writer.write(indices[i], 4);
+}
+
+std::vector<unsigned char> compressImage(
+    BlockFormat format, const unsigned char* rgba, uint32_t width, uint32_t height, ThreadPool* threadPool)
+{
+    using EncodeBlock = void (*)(const unsigned char*, unsigned char*);
+    EncodeBlock encodeBlock = encodeBlockBC1;
+    switch (format){
+    case BlockFormat::BC1: encodeBlock = encodeBlockBC1; break;
+    case BlockFormat::BC3: encodeBlock = encodeBlockBC3; break;
+    case BlockFormat::BC5: encodeBlock = encodeBlockBC5; break;
+    case BlockFormat::BC7: encodeBlock = encodeBlockBC7; break;
+    }
+
+    const uint32_t blocksX = (width + 3) / 4;
+    const uint32_t blocksY = (height + 3) / 4;
+    const uint32_t bytesPerBlock = blockSize(format);
+    std::vector<unsigned char> compressed(compressedSize(format, width, height));
+
+    auto encodeRows = [&](uint32_t beginRow, uint32_t endRow){
+        unsigned char block[TEXEL_COUNT * 4];
+        for (uint32_t by = beginRow; by < endRow; by++){
+            for (uint32_t bx = 0; bx < blocksX; bx++){
+                for (uint32_t y = 0; y < 4; y++){
+                    for (uint32_t x = 0; x < 4; x++){
+                        const uint32_t sx = std::min(bx * 4 + x, width - 1);
+                        const uint32_t sy = std::min(by * 4 + y, height - 1);
+                        std::memcpy(block + (y * 4 + x) * 4, rgba + (size_t(sy) * width + sx) * 4, 4);
+                    }
+                }
+                encodeBlock(block, compressed.data() + (size_t(by) * blocksX + bx) * bytesPerBlock);
+            }
+        }
+    };
+
+    if (threadPool)
+        threadPool->parallelFor(blocksY, 4, encodeRows);
+    else
+        encodeRows(0, blocksY);
+    return compressed;
+}
+
+} // namespace hyd
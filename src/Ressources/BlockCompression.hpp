@@ -0,0 +1,43 @@
+/*
+CPU encoders of the BC block compressed formats, used offline by the texture
+encoder tool. The images are rgba8, split in 4x4 blocks, the blocks crossing
+the right or bottom edge repeat the last column or row.
+BC1 stores opaque colors in 8 bytes, BC3 adds a BC4 alpha block, BC5 stores
+the red and green channels as two BC4 blocks (normal maps) and BC7 uses its
+mode 6, a single rgba line with 4 bit indices.
+*/
+#pragma once
+
+// std
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace hyd
+{
+
+class ThreadPool;
+
+enum class BlockFormat : uint8_t
+{
+    BC1,
+    BC3,
+    BC5,
+    BC7
+};
+
+// 8 or 16
+uint32_t blockSize(BlockFormat format);
+size_t compressedSize(BlockFormat format, uint32_t width, uint32_t height);
+
+// block is 4x4 rgba8 texels, row major
+void encodeBlockBC1(const unsigned char* block, unsigned char* out);
+void encodeBlockBC3(const unsigned char* block, unsigned char* out);
+void encodeBlockBC5(const unsigned char* block, unsigned char* out);
+void encodeBlockBC7(const unsigned char* block, unsigned char* out);
+
+// the rows of blocks are spread on the thread pool when one is given
+std::vector<unsigned char> compressImage(
+    BlockFormat format, const unsigned char* rgba, uint32_t width, uint32_t height, ThreadPool* threadPool = nullptr);
+
+} // namespace hyd
@@ -12,6 +12,9 @@ public:
     Image(const std::string& filepath);
     ~Image();
 
+    Image(const Image&) = delete;
+    Image &operator=(const Image&) = delete;
+
     int getWidth() { return m_width; }
     int getHeight() { return m_height; }
     int getChannelsNumber() { return m_channelsNumber; }
@@ -0,0 +1,195 @@
+#include "Ktx2.hpp"
+
+// std
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+namespace hyd
+{
+
+namespace
+{
+
+const unsigned char KTX2_IDENTIFIER[12] = {0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'};
+
+struct Ktx2Header
+{
+    unsigned char identifier[12];
+    uint32_t vkFormat;
+    uint32_t typeSize;
+    uint32_t pixelWidth;
+    uint32_t pixelHeight;
+    uint32_t pixelDepth;
+    uint32_t layerCount;
+    uint32_t faceCount;
+    uint32_t levelCount;
+    uint32_t supercompressionScheme;
+    uint32_t dfdByteOffset;
+    uint32_t dfdByteLength;
+    uint32_t kvdByteOffset;
+    uint32_t kvdByteLength;
+    uint64_t sgdByteOffset;
+    uint64_t sgdByteLength;
+};
+static_assert(sizeof(Ktx2Header) == 80, "the header is read as is");
+
+struct Ktx2LevelIndex
+{
+    uint64_t byteOffset;
+    uint64_t byteLength;
+    uint64_t uncompressedByteLength;
+};
+
+// data format descriptor of the BC formats (Khronos data format specification, color models 128+)
+struct BlockDescriptor
+{
+    uint8_t colorModel;
+    uint8_t bytesPerBlock;
+    // bits of each sample, 64 for the BC1/3/5 ones, 128 for the single BC7 one
+    uint8_t sampleBits;
+    // channel ids of the samples, in bit order
+    std::vector<uint8_t> channels;
+};
+
+bool blockDescriptor(VkFormat format, BlockDescriptor& descriptor, bool& srgb){
+    srgb = false;
+    switch (format){
+    case VK_FORMAT_BC1_RGB_SRGB_BLOCK: srgb = true; [[fallthrough]];
+    case VK_FORMAT_BC1_RGB_UNORM_BLOCK: descriptor = {128, 8, 64, {0}}; return true;
+    case VK_FORMAT_BC3_SRGB_BLOCK: srgb = true; [[fallthrough]];
+    case VK_FORMAT_BC3_UNORM_BLOCK: descriptor = {130, 16, 64, {15, 0}}; return true;
+    case VK_FORMAT_BC5_UNORM_BLOCK: descriptor = {132, 16, 64, {0, 1}}; return true;
+    case VK_FORMAT_BC7_SRGB_BLOCK: srgb = true; [[fallthrough]];
+    case VK_FORMAT_BC7_UNORM_BLOCK: descriptor = {134, 16, 128, {0}}; return true;
+    default: return false;
+    }
+}
+
+template<typename T>
+void append(std::vector<unsigned char>& out, const T& value){
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&value);
+    out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+} // namespace
+
+Ktx2Image::Ktx2Image(const std::string& filepath){
+    std::ifstream file{filepath, std::ios::ate | std::ios::binary};
+    if (!file.is_open())
+        throw std::runtime_error("failed to open file: " + filepath);
+
+    m_data.resize(static_cast<size_t>(file.tellg()));
+    file.seekg(0);
+    file.read(reinterpret_cast<char*>(m_data.data()), m_data.size());
+
+    Ktx2Header header;
+    if (m_data.size() < sizeof(header))
+        throw std::runtime_error("truncated KTX2 file: " + filepath);
+    std::memcpy(&header, m_data.data(), sizeof(header));
+
+    if (std::memcmp(header.identifier, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) != 0)
+        throw std::runtime_error("not a KTX2 file: " + filepath);
+    if (header.supercompressionScheme != 0)
+        throw std::runtime_error("supercompressed KTX2 files are not supported: " + filepath);
+    if (header.pixelDepth > 1 || header.pixelHeight == 0 || header.vkFormat == VK_FORMAT_UNDEFINED)
+        throw std::runtime_error("only 2D KTX2 textures are supported: " + filepath);
+
+    m_format = static_cast<VkFormat>(header.vkFormat);
+    m_width = header.pixelWidth;
+    m_height = header.pixelHeight;
+    m_cubemap = header.faceCount == 6;
+    m_layerCount = std::max(header.layerCount, 1u) * header.faceCount;
+
+    // a level count of 0 asks the loader to generate the mips, keep the single stored level
+    const uint32_t levelCount = std::max(header.levelCount, 1u);
+    if (m_data.size() < sizeof(header) + levelCount * sizeof(Ktx2LevelIndex))
+        throw std::runtime_error("truncated KTX2 file: " + filepath);
+
+    m_levels.resize(levelCount);
+    for (uint32_t level = 0; level < levelCount; level++){
+        Ktx2LevelIndex index;
+        std::memcpy(&index, m_data.data() + sizeof(header) + level * sizeof(index), sizeof(index));
+        if (index.byteOffset + index.byteLength > m_data.size())
+            throw std::runtime_error("truncated KTX2 file: " + filepath);
+
+        m_levels[level] = {
+            static_cast<size_t>(index.byteOffset),
+            static_cast<size_t>(index.byteLength),
+            std::max(1u, m_width >> level),
+            std::max(1u, m_height >> level)};
+    }
+}
+
+void Ktx2Image::write(const std::string& filepath, VkFormat format, uint32_t width, uint32_t height,
+    const std::vector<std::vector<unsigned char>>& levels)
+{
+    BlockDescriptor descriptor;
+    bool srgb;
+    if (!blockDescriptor(format, descriptor, srgb))
+        throw std::invalid_argument("unsupported KTX2 format!");
+
+    // basic data format descriptor block: 24 bytes and 16 per sample, after its total size
+    std::vector<unsigned char> dfd;
+    const uint16_t blockSize = static_cast<uint16_t>(24 + 16 * descriptor.channels.size());
+    append<uint32_t>(dfd, 4u + blockSize);
+    append<uint32_t>(dfd, 0);              // vendor Khronos, descriptor type basic
+    append<uint16_t>(dfd, 2);              // version
+    append<uint16_t>(dfd, blockSize);
+    dfd.push_back(descriptor.colorModel);
+    dfd.push_back(1);                      // BT709 primaries
+    dfd.push_back(srgb ? 2 : 1);           // srgb or linear transfer
+    dfd.push_back(0);                      // straight alpha
+    const unsigned char texelBlockDimensions[4] = {3, 3, 0, 0};
+    dfd.insert(dfd.end(), texelBlockDimensions, texelBlockDimensions + 4);
+    unsigned char bytesPlane[8] = {descriptor.bytesPerBlock, 0, 0, 0, 0, 0, 0, 0};
+    dfd.insert(dfd.end(), bytesPlane, bytesPlane + 8);
+    for (size_t sample = 0; sample < descriptor.channels.size(); sample++){
+        append<uint16_t>(dfd, static_cast<uint16_t>(sample * descriptor.sampleBits)); // bit offset
+        dfd.push_back(static_cast<unsigned char>(descriptor.sampleBits - 1));        // bit length - 1
+        dfd.push_back(descriptor.channels[sample]);
+        append<uint32_t>(dfd, 0);                                   // sample position
+        append<uint32_t>(dfd, 0);                                   // lower
+        append<uint32_t>(dfd, 0xFFFFFFFF);                          // upper
+    }
+
+    const uint32_t levelCount = static_cast<uint32_t>(levels.size());
+    Ktx2Header header{};
+    std::memcpy(header.identifier, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER));
+    header.vkFormat = static_cast<uint32_t>(format);
+    header.typeSize = 1;
+    header.pixelWidth = width;
+    header.pixelHeight = height;
+    header.faceCount = 1;
+    header.levelCount = levelCount;
+    header.dfdByteOffset = static_cast<uint32_t>(sizeof(header) + levelCount * sizeof(Ktx2LevelIndex));
+    header.dfdByteLength = static_cast<uint32_t>(dfd.size());
+
+    // the levels are stored from the smallest, aligned on the block size
+    std::vector<Ktx2LevelIndex> index(levelCount);
+    uint64_t offset = header.dfdByteOffset + header.dfdByteLength;
+    for (uint32_t level = levelCount; level-- > 0;){
+        offset = (offset + descriptor.bytesPerBlock - 1) / descriptor.bytesPerBlock * descriptor.bytesPerBlock;
+        index[level] = {offset, levels[level].size(), levels[level].size()};
+        offset += levels[level].size();
+    }
+
+    std::vector<unsigned char> file;
+    file.reserve(static_cast<size_t>(offset));
+    append(file, header);
+    for (const auto& entry : index)
+        append(file, entry);
+    file.insert(file.end(), dfd.begin(), dfd.end());
+    for (uint32_t level = levelCount; level-- > 0;){
+        file.resize(static_cast<size_t>(index[level].byteOffset), 0);
+        file.insert(file.end(), levels[level].begin(), levels[level].end());
+    }
+
+    std::ofstream out{filepath, std::ios::binary};
+    if (!out.is_open())
+        throw std::runtime_error("failed to open file: " + filepath);
+    out.write(reinterpret_cast<const char*>(file.data()), file.size());
+}
+
+} // namespace hyd
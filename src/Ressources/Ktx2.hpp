@@ -0,0 +1,59 @@
+/*
+KTX2 container of 2D textures and cubemaps, without supercompression.
+The whole file is read at once and the levels point inside it, so they can be
+staged as is. The writer is used by the texture encoder tool for the BC formats.
+*/
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+// std
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace hyd
+{
+
+class Ktx2Image
+{
+public:
+    // the layers (faces of a cubemap) of a level follow each other
+    struct Level
+    {
+        size_t offset;
+        size_t size;
+        uint32_t width;
+        uint32_t height;
+    };
+
+    explicit Ktx2Image(const std::string& filepath);
+
+    Ktx2Image(const Ktx2Image&) = delete;
+    Ktx2Image &operator=(const Ktx2Image&) = delete;
+
+    VkFormat getFormat() const { return m_format; }
+    uint32_t getWidth() const { return m_width; }
+    uint32_t getHeight() const { return m_height; }
+    uint32_t getLayerCount() const { return m_layerCount; }
+    bool isCubemap() const { return m_cubemap; }
+    const std::vector<Level>& getLevels() const { return m_levels; }
+    const unsigned char* getData() const { return m_data.data(); }
+
+    // levels[0] is the full size level, BC1/BC3/BC5/BC7 formats only
+    static void write(const std::string& filepath, VkFormat format, uint32_t width, uint32_t height,
+        const std::vector<std::vector<unsigned char>>& levels);
+
+private:
+    /* data */
+    std::vector<unsigned char> m_data;
+    VkFormat m_format{VK_FORMAT_UNDEFINED};
+    uint32_t m_width{0};
+    uint32_t m_height{0};
+    uint32_t m_layerCount{1};
+    bool m_cubemap{false};
+    std::vector<Level> m_levels;
+};
+
+} // namespace hyd
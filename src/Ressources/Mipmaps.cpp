@@ -0,0 +1,160 @@
+#include "Mipmaps.hpp"
+
+// std
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__)
+#define HYD_MIPMAPS_X86
+#include <immintrin.h>
+#endif
+
+namespace hyd
+{
+
+namespace
+{
+
+constexpr uint32_t LINEAR_TO_SRGB_SIZE = 4096;
+
+struct SrgbTables
+{
+    std::array<float, 256> toLinear;
+    std::array<unsigned char, LINEAR_TO_SRGB_SIZE> toSrgb;
+
+    SrgbTables(){
+        for (uint32_t i = 0; i < 256; i++){
+            float c = i / 255.f;
+            toLinear[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+        }
+        for (uint32_t i = 0; i < LINEAR_TO_SRGB_SIZE; i++){
+            float l = i / float(LINEAR_TO_SRGB_SIZE - 1);
+            float c = l <= 0.0031308f ? l * 12.92f : 1.055f * std::pow(l, 1.f / 2.4f) - 0.055f;
+            toSrgb[i] = static_cast<unsigned char>(std::clamp(c * 255.f + 0.5f, 0.f, 255.f));
+        }
+    }
+};
+
+const SrgbTables& srgbTables(){
+    static const SrgbTables tables{};
+    return tables;
+}
+
+// one destination row from the two source rows (equal when the source has a single row)
+// the destination width is max(1, srcWidth / 2), the odd last column of the source is dropped
+void downsampleRowUnorm(const unsigned char* row0, const unsigned char* row1, uint32_t srcWidth, unsigned char* dst, uint32_t dstWidth){
+    uint32_t x = 0;
+#ifdef HYD_MIPMAPS_X86
+    if (srcWidth >= 2){
+        // 2 destination pixels from 4 source pixels of each row
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i rounding = _mm_set1_epi16(2);
+        for (; x + 2 <= dstWidth; x += 2){
+            __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + x * 8));
+            __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + x * 8));
+            // pixels 0,1 and 2,3 in 16 bit lanes
+            __m128i low = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+            __m128i high = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+            // horizontal pair sums: (p0 + p1, p2 + p3)
+            __m128i sums = _mm_add_epi16(_mm_unpacklo_epi64(low, high), _mm_unpackhi_epi64(low, high));
+            sums = _mm_srli_epi16(_mm_add_epi16(sums, rounding), 2);
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(dst + x * 4), _mm_packus_epi16(sums, zero));
+        }
+    }
+#endif
+    for (; x < dstWidth; x++){
+        const uint32_t x0 = std::min(2 * x, srcWidth - 1) * 4;
+        const uint32_t x1 = std::min(2 * x + 1, srcWidth - 1) * 4;
+        for (uint32_t c = 0; c < 4; c++){
+            dst[x * 4 + c] = static_cast<unsigned char>((row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2) >> 2);
+        }
+    }
+}
+
+void downsampleRowSrgb(const unsigned char* row0, const unsigned char* row1, uint32_t srcWidth, unsigned char* dst, uint32_t dstWidth){
+    const SrgbTables& tables = srgbTables();
+    const float* toLinear = tables.toLinear.data();
+
+#ifdef HYD_MIPMAPS_X86
+    // the color channels are summed in linear space, the alpha channel as is
+    const __m128 scale = _mm_set_ps(1.f / 4.f, (LINEAR_TO_SRGB_SIZE - 1) / 4.f, (LINEAR_TO_SRGB_SIZE - 1) / 4.f, (LINEAR_TO_SRGB_SIZE - 1) / 4.f);
+    auto load = [toLinear](const unsigned char* p){
+        return _mm_set_ps(static_cast<float>(p[3]), toLinear[p[2]], toLinear[p[1]], toLinear[p[0]]);
+    };
+    alignas(16) int32_t indices[4];
+    for (uint32_t x = 0; x < dstWidth; x++){
+        const uint32_t x0 = std::min(2 * x, srcWidth - 1) * 4;
+        const uint32_t x1 = std::min(2 * x + 1, srcWidth - 1) * 4;
+        __m128 sum = _mm_add_ps(_mm_add_ps(load(row0 + x0), load(row0 + x1)), _mm_add_ps(load(row1 + x0), load(row1 + x1)));
+        _mm_store_si128(reinterpret_cast<__m128i*>(indices), _mm_cvtps_epi32(_mm_mul_ps(sum, scale)));
+        dst[x * 4 + 0] = tables.toSrgb[indices[0]];
+        dst[x * 4 + 1] = tables.toSrgb[indices[1]];
+        dst[x * 4 + 2] = tables.toSrgb[indices[2]];
+        dst[x * 4 + 3] = static_cast<unsigned char>(indices[3]);
+    }
+#else
+    for (uint32_t x = 0; x < dstWidth; x++){
+        const uint32_t x0 = std::min(2 * x, srcWidth - 1) * 4;
+        const uint32_t x1 = std::min(2 * x + 1, srcWidth - 1) * 4;
+        for (uint32_t c = 0; c < 3; c++){
+            float sum = toLinear[row0[x0 + c]] + toLinear[row0[x1 + c]] + toLinear[row1[x0 + c]] + toLinear[row1[x1 + c]];
+            dst[x * 4 + c] = tables.toSrgb[static_cast<uint32_t>(sum * ((LINEAR_TO_SRGB_SIZE - 1) / 4.f) + 0.5f)];
+        }
+        dst[x * 4 + 3] = static_cast<unsigned char>((row0[x0 + 3] + row0[x1 + 3] + row1[x0 + 3] + row1[x1 + 3] + 2) >> 2);
+    }
+#endif
+}
+
+} // namespace
+
+uint32_t mipLevelCount(uint32_t width, uint32_t height){
+    uint32_t levels = 1;
+    for (uint32_t size = std::max(width, height); size > 1; size >>= 1)
+        levels++;
+    return levels;
+}
+
+std::vector<MipLevel> generateMipChain(
+    const unsigned char* pixels,
+    uint32_t width,
+    uint32_t height,
+    uint32_t layerCount,
+    uint32_t levelCount,
+    bool srgb,
+    std::vector<unsigned char>& chain)
+{
+    levelCount = std::clamp(levelCount, 1u, mipLevelCount(width, height));
+
+    std::vector<MipLevel> levels(levelCount);
+    size_t size = 0;
+    for (uint32_t level = 0; level < levelCount; level++){
+        levels[level] = {size, std::max(1u, width >> level), std::max(1u, height >> level)};
+        size += size_t(levels[level].width) * levels[level].height * 4 * layerCount;
+    }
+
+    chain.resize(size);
+    std::memcpy(chain.data(), pixels, size_t(width) * height * 4 * layerCount);
+
+    auto downsampleRow = srgb ? downsampleRowSrgb : downsampleRowUnorm;
+    for (uint32_t level = 1; level < levelCount; level++){
+        const MipLevel& src = levels[level - 1];
+        const MipLevel& dst = levels[level];
+        const size_t srcLayerSize = size_t(src.width) * src.height * 4;
+        const size_t dstLayerSize = size_t(dst.width) * dst.height * 4;
+
+        for (uint32_t layer = 0; layer < layerCount; layer++){
+            const unsigned char* srcLayer = chain.data() + src.offset + layer * srcLayerSize;
+            unsigned char* dstLayer = chain.data() + dst.offset + layer * dstLayerSize;
+            for (uint32_t y = 0; y < dst.height; y++){
+                const unsigned char* row0 = srcLayer + size_t(std::min(2 * y, src.height - 1)) * src.width * 4;
+                const unsigned char* row1 = srcLayer + size_t(std::min(2 * y + 1, src.height - 1)) * src.width * 4;
+                downsampleRow(row0, row1, src.width, dstLayer + size_t(y) * dst.width * 4, dst.width);
+            }
+        }
+    }
+    return levels;
+}
+
+} // namespace hyd
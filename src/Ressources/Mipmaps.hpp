@@ -0,0 +1,37 @@
+/*
+CPU generation of the mip chains of rgba8 images, used for the formats the
+device can't blit with a linear filter. Each level is the 2x2 box filter of
+the previous one, averaged in linear space for the srgb images.
+*/
+#pragma once
+
+// std
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace hyd
+{
+
+// location of a level in the chain, the layers of a level follow each other
+struct MipLevel
+{
+    size_t offset;
+    uint32_t width;
+    uint32_t height;
+};
+
+// levels down to 1x1
+uint32_t mipLevelCount(uint32_t width, uint32_t height);
+
+// pixels holds level 0 of every layer, the whole chain (level 0 included) is written in chain
+std::vector<MipLevel> generateMipChain(
+    const unsigned char* pixels,
+    uint32_t width,
+    uint32_t height,
+    uint32_t layerCount,
+    uint32_t levelCount,
+    bool srgb,
+    std::vector<unsigned char>& chain);
+
+} // namespace hyd
@@ -0,0 +1,330 @@
+#include "ObjParser.hpp"
+
+#include "Core/MappedFile.hpp"
+#include "Core/ThreadPool.hpp"
+
+// std
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <functional>
+#include <stdexcept>
+#include <utility>
+
+namespace hyd
+{
+
+namespace
+{
+
+constexpr size_t MIN_CHUNK_SIZE = 256 << 10;
+constexpr size_t MAX_CHUNK_COUNT = 1024;
+
+// corners whose indices count back from the end of the chunk, resolved with the chunk offsets
+constexpr uint8_t RELATIVE_POSITION = 1 << 0;
+constexpr uint8_t RELATIVE_TEXCOORD = 1 << 1;
+constexpr uint8_t RELATIVE_NORMAL = 1 << 2;
+
+struct Chunk
+{
+    const char* begin;
+    const char* end;
+
+    std::vector<float> positions;
+    std::vector<float> colors;
+    std::vector<float> normals;
+    std::vector<float> texcoords;
+    std::vector<ObjIndex> corners;
+    std::vector<std::pair<uint32_t, uint8_t>> relativeCorners;
+    std::string error;
+
+    // first element of the chunk in the merged arrays
+    size_t positionBase{0};
+    size_t texcoordBase{0};
+    size_t normalBase{0};
+    size_t cornerBase{0};
+};
+
+inline bool isBlank(char c){ return c == ' ' || c == '\t'; }
+inline bool isLineEnd(char c){ return c == '\n' || c == '\r'; }
+inline bool isDigit(char c){ return c >= '0' && c <= '9'; }
+
+inline const char* skipBlanks(const char* p, const char* end){
+    while (p < end && isBlank(*p))
+        p++;
+    return p;
+}
+
+inline const char* tokenEnd(const char* p, const char* end){
+    while (p < end && !isBlank(*p) && !isLineEnd(*p))
+        p++;
+    return p;
+}
+
+// reads the next token of the line, value is left as is when it isn't a number
+// parsed as a double and rounded to float like tinyobj, from_chars is correctly rounded
+bool parseFloat(const char*& p, const char* end, float& value){
+    p = skipBlanks(p, end);
+    const char* last = tokenEnd(p, end);
+    const char* start = (p < last && *p == '+') ? p + 1 : p;
+    // from_chars also reads nan and inf, tinyobj doesn't
+    const char* digits = (start < last && *start == '-') ? start + 1 : start;
+    bool valid = digits < last && (isDigit(*digits) || *digits == '.');
+
+    double parsed = 0.0;
+    if (valid)
+        valid = std::from_chars(start, last, parsed).ec == std::errc{};
+    if (valid)
+        value = static_cast<float>(parsed);
+    p = last;
+    return valid;
+}
+
+// atoi of the OBJ indices, stops at the slashes
+int32_t parseInt(const char*& p, const char* end){
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')){
+        negative = *p == '-';
+        p++;
+    }
+    int64_t value = 0;
+    while (p < end && isDigit(*p)){
+        value = std::min<int64_t>(value * 10 + (*p - '0'), INT32_MAX);
+        p++;
+    }
+    return static_cast<int32_t>(negative ? -value : value);
+}
+
+// 1 based index to 0 based, negative indices are relative to the count of the chunk
+bool fixIndex(int32_t index, size_t count, uint8_t relativeBit, int32_t& fixed, uint8_t& relative){
+    if (index > 0){
+        fixed = index - 1;
+        return true;
+    }
+    if (index < 0){
+        fixed = static_cast<int32_t>(count) + index;
+        relative |= relativeBit;
+        return true;
+    }
+    return false; // 0 is not a valid index
+}
+
+// v, v/vt, v//vn or v/vt/vn
+bool parseCorner(const char*& p, const char* end, const Chunk& chunk, ObjIndex& corner, uint8_t& relative){
+    int32_t position = parseInt(p, end);
+    int32_t texcoord = 0;
+    int32_t normal = 0;
+    if (p < end && *p == '/'){
+        p++;
+        if (p < end && *p == '/'){
+            p++;
+            normal = parseInt(p, end);
+        } else {
+            texcoord = parseInt(p, end);
+            if (p < end && *p == '/'){
+                p++;
+                normal = parseInt(p, end);
+            }
+        }
+    }
+    p = tokenEnd(p, end);
+
+    relative = 0;
+    corner.texcoord = -1;
+    corner.normal = -1;
+    if (!fixIndex(position, chunk.positions.size() / 3, RELATIVE_POSITION, corner.position, relative))
+        return false;
+    if (texcoord != 0)
+        fixIndex(texcoord, chunk.texcoords.size() / 2, RELATIVE_TEXCOORD, corner.texcoord, relative);
+    if (normal != 0)
+        fixIndex(normal, chunk.normals.size() / 3, RELATIVE_NORMAL, corner.normal, relative);
+    return true;
+}
+
+void parseChunk(Chunk& chunk){
+    std::vector<ObjIndex> face;
+    std::vector<uint8_t> faceRelative;
+
+    const char* p = chunk.begin;
+    const char* end = chunk.end;
+    while (p < end){
+        p = skipBlanks(p, end);
+        if (p == end)
+            break;
+        const char* next = p + 1;
+
+        if (p[0] == 'v' && next < end && isBlank(next[0])){
+            p += 2;
+            float x = 0.0f, y = 0.0f, z = 0.0f;
+            parseFloat(p, end, x);
+            parseFloat(p, end, y);
+            parseFloat(p, end, z);
+            // the color is only kept when the three channels are there
+            float r = 1.0f, g = 1.0f, b = 1.0f;
+            if (!(parseFloat(p, end, r) && parseFloat(p, end, g) && parseFloat(p, end, b)))
+                r = g = b = 1.0f;
+            chunk.positions.insert(chunk.positions.end(), {x, y, z});
+            chunk.colors.insert(chunk.colors.end(), {r, g, b});
+        }
+        else if (p[0] == 'v' && next < end && next[0] == 'n' && next + 1 < end && isBlank(next[1])){
+            p += 3;
+            float x = 0.0f, y = 0.0f, z = 0.0f;
+            parseFloat(p, end, x);
+            parseFloat(p, end, y);
+            parseFloat(p, end, z);
+            chunk.normals.insert(chunk.normals.end(), {x, y, z});
+        }
+        else if (p[0] == 'v' && next < end && next[0] == 't' && next + 1 < end && isBlank(next[1])){
+            p += 3;
+            float u = 0.0f, v = 0.0f;
+            parseFloat(p, end, u);
+            parseFloat(p, end, v);
+            chunk.texcoords.insert(chunk.texcoords.end(), {u, v});
+        }
+        else if (p[0] == 'f' && next < end && isBlank(next[0])){
+            p += 2;
+            face.clear();
+            faceRelative.clear();
+            for (p = skipBlanks(p, end); p < end && !isLineEnd(*p); p = skipBlanks(p, end)){
+                ObjIndex corner;
+                uint8_t relative;
+                if (!parseCorner(p, end, chunk, corner, relative)){
+                    chunk.error = "invalid face index";
+                    return;
+                }
+                face.push_back(corner);
+                faceRelative.push_back(relative);
+            }
+
+            // fan triangulation
+            for (size_t k = 2; k < face.size(); k++){
+                for (size_t i : {size_t(0), k - 1, k}){
+                    if (faceRelative[i] != 0)
+                        chunk.relativeCorners.emplace_back(static_cast<uint32_t>(chunk.corners.size()), faceRelative[i]);
+                    chunk.corners.push_back(face[i]);
+                }
+            }
+        }
+
+        // comments, groups, materials and the unsupported statements are skipped
+        while (p < end && !isLineEnd(*p))
+            p++;
+        while (p < end && isLineEnd(*p))
+            p++;
+    }
+}
+
+// offsets the relative indices and checks the range of all of them
+void resolveChunk(Chunk& chunk, ObjData& data){
+    const int64_t positionCount = static_cast<int64_t>(data.positions.size() / 3);
+    const int64_t texcoordCount = static_cast<int64_t>(data.texcoords.size() / 2);
+    const int64_t normalCount = static_cast<int64_t>(data.normals.size() / 3);
+
+    for (const auto& [cornerIndex, relative] : chunk.relativeCorners){
+        ObjIndex& corner = chunk.corners[cornerIndex];
+        if (relative & RELATIVE_POSITION)
+            corner.position += static_cast<int32_t>(chunk.positionBase);
+        if (relative & RELATIVE_TEXCOORD){
+            corner.texcoord += static_cast<int32_t>(chunk.texcoordBase);
+            if (corner.texcoord < 0)
+                corner.texcoord = INT32_MAX; // out of range, not missing
+        }
+        if (relative & RELATIVE_NORMAL){
+            corner.normal += static_cast<int32_t>(chunk.normalBase);
+            if (corner.normal < 0)
+                corner.normal = INT32_MAX;
+        }
+    }
+
+    for (const ObjIndex& corner : chunk.corners){
+        if (corner.position < 0 || corner.position >= positionCount ||
+            corner.texcoord >= texcoordCount || corner.normal >= normalCount){
+            chunk.error = "face index out of range";
+            return;
+        }
+    }
+
+    std::copy(chunk.positions.begin(), chunk.positions.end(), data.positions.begin() + chunk.positionBase * 3);
+    std::copy(chunk.colors.begin(), chunk.colors.end(), data.colors.begin() + chunk.positionBase * 3);
+    std::copy(chunk.texcoords.begin(), chunk.texcoords.end(), data.texcoords.begin() + chunk.texcoordBase * 2);
+    std::copy(chunk.normals.begin(), chunk.normals.end(), data.normals.begin() + chunk.normalBase * 3);
+    std::copy(chunk.corners.begin(), chunk.corners.end(), data.corners.begin() + chunk.cornerBase);
+
+    // the merged copy is all that is needed from now on
+    chunk.positions = {};
+    chunk.colors = {};
+    chunk.texcoords = {};
+    chunk.normals = {};
+    chunk.corners = {};
+    chunk.relativeCorners = {};
+}
+
+} // namespace
+
+ObjData parseObj(const std::string& filepath, ThreadPool* threadPool){
+    MappedFile file{filepath};
+    const char* text = reinterpret_cast<const char*>(file.data());
+    const size_t size = file.size();
+
+    // chunks start after a line feed, a chunk can be empty when a line spans its whole range
+    const size_t chunkCount = std::clamp<size_t>(size / MIN_CHUNK_SIZE, 1, MAX_CHUNK_COUNT);
+    std::vector<Chunk> chunks(chunkCount);
+    for (size_t i = 0; i < chunkCount; i++){
+        const char* begin = i == 0 ? text : chunks[i - 1].end;
+        const char* end = text + size;
+        if (i + 1 < chunkCount){
+            end = std::max(begin, text + size * (i + 1) / chunkCount);
+            const void* lineFeed = std::memchr(end, '\n', static_cast<size_t>(text + size - end));
+            end = lineFeed ? static_cast<const char*>(lineFeed) + 1 : text + size;
+        }
+        chunks[i].begin = begin;
+        chunks[i].end = end;
+    }
+
+    auto forEachChunk = [&](const std::function<void(Chunk&)>& func){
+        auto process = [&](uint32_t begin, uint32_t end){
+            for (uint32_t i = begin; i < end; i++)
+                func(chunks[i]);
+        };
+        if (threadPool)
+            threadPool->parallelFor(static_cast<uint32_t>(chunkCount), 1, process);
+        else
+            process(0, static_cast<uint32_t>(chunkCount));
+    };
+    auto checkErrors = [&](){
+        for (const auto& chunk : chunks){
+            if (!chunk.error.empty())
+                throw std::runtime_error(chunk.error + " in " + filepath);
+        }
+    };
+
+    forEachChunk(parseChunk);
+    checkErrors();
+
+    size_t positionCount = 0, texcoordCount = 0, normalCount = 0, cornerCount = 0;
+    for (auto& chunk : chunks){
+        chunk.positionBase = positionCount;
+        chunk.texcoordBase = texcoordCount;
+        chunk.normalBase = normalCount;
+        chunk.cornerBase = cornerCount;
+        positionCount += chunk.positions.size() / 3;
+        texcoordCount += chunk.texcoords.size() / 2;
+        normalCount += chunk.normals.size() / 3;
+        cornerCount += chunk.corners.size();
+    }
+    if (std::max({positionCount, texcoordCount, normalCount, cornerCount}) > size_t(INT32_MAX))
+        throw std::runtime_error("too many elements in " + filepath);
+
+    ObjData data{};
+    data.positions.resize(positionCount * 3);
+    data.colors.resize(positionCount * 3);
+    data.texcoords.resize(texcoordCount * 2);
+    data.normals.resize(normalCount * 3);
+    data.corners.resize(cornerCount);
+
+    forEachChunk([&data](Chunk& chunk){ resolveChunk(chunk, data); });
+    checkErrors();
+    return data;
+}
+
+} // namespace hyd
@@ -0,0 +1,44 @@
+/*
+Wavefront OBJ parser for the big meshes. The file is memory mapped and cut in
+chunks at line boundaries, the chunks are parsed in parallel then concatenated,
+the relative (negative) indices being resolved once the chunk offsets are known.
+Only the geometry is read (v, vt, vn, f), the faces are triangulated as fans
+and the vertex colors default to white, like tinyobj did.
+*/
+#pragma once
+
+// std
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace hyd
+{
+
+class ThreadPool;
+
+// 0 based indices of a face corner, -1 when the attribute is missing
+struct ObjIndex
+{
+    int32_t position;
+    int32_t texcoord;
+    int32_t normal;
+
+    bool operator==(const ObjIndex& other) const {
+        return position == other.position && texcoord == other.texcoord && normal == other.normal;
+    }
+};
+
+struct ObjData
+{
+    std::vector<float> positions; // xyz
+    std::vector<float> colors;    // rgb of each position
+    std::vector<float> normals;   // xyz
+    std::vector<float> texcoords; // uv
+    std::vector<ObjIndex> corners; // 3 per triangle, in file order
+};
+
+// throws when the file can't be read or a face refers to a missing attribute
+ObjData parseObj(const std::string& filepath, ThreadPool* threadPool = nullptr);
+
+} // namespace hyd
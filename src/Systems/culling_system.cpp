@@ -0,0 +1,687 @@
+#include "culling_system.hpp"
+
+#include "Renderer/Frustum.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+
+namespace hyd
+{
+
+static constexpr uint32_t INITIAL_CAPACITY = 1024;
+static constexpr uint32_t CULL_GROUP_SIZE = 64; // local_size_x of cull.comp
+
+// matches the push constant block of cull.comp
+struct CullPushConstantData
+{
+    std::array<glm::vec4, Frustum::Plane::Count> frustumPlanes;
+    uint32_t instanceCount;
+};
+
+// matches the push constant block of cluster_cull.comp
+struct ClusterCullPushConstantData
+{
+    std::array<glm::vec4, Frustum::Plane::Count> frustumPlanes;
+    glm::vec4 viewOrigin;
+    uint32_t clusterCount;
+    uint32_t visibleBase;
+};
+
+// the point every ray of the projection starts from (w = 1), or the direction of an orthographic
+// projection (w = 0): the null vector of the x, y and w rows, the w = 0 direction points where depth grows
+static glm::vec4 computeViewOrigin(const glm::mat4& viewProjection){
+    auto row = [&viewProjection](int i){
+        return glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+    };
+    const glm::vec4 a = row(0), b = row(1), c = row(3);
+    auto minor = [&](int i, int j, int k){
+        return a[i] * (b[j] * c[k] - b[k] * c[j]) - a[j] * (b[i] * c[k] - b[k] * c[i]) + a[k] * (b[i] * c[j] - b[j] * c[i]);
+    };
+    glm::vec4 origin{minor(1, 2, 3), -minor(0, 2, 3), minor(0, 1, 3), -minor(0, 1, 2)};
+
+    if (std::abs(origin.w) > 1e-6f * glm::length(glm::vec3(origin)))
+        return glm::vec4(glm::vec3(origin) / origin.w, 1.f);
+    glm::vec3 direction = glm::normalize(glm::vec3(origin));
+    if (glm::dot(glm::vec3(row(2)), direction) < 0.f)
+        direction = -direction;
+    return glm::vec4(direction, 0.f);
+}
+
+CullingSystem::CullingSystem(Device& device)
+: m_device{device}
+{
+    const uint32_t setCount = SwapChain::MAX_FRAMES_IN_FLIGHT * VIEW_COUNT;
+    m_pool =
+    DescriptorPool::Builder(m_device)
+        .setMaxSets(3 * setCount)
+        .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 13 * setCount)
+        .build();
+
+    m_computeSetLayout =
+        DescriptorSetLayout::Builder(m_device)
+            .addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT) // instances
+            .addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT) // batch id per instance
+            .addBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT) // batches
+            .addBinding(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT) // commands
+            .addBinding(4, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT) // draw counts
+            .addBinding(5, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT) // visible ids
+            .build();
+
+    m_drawSetLayout =
+        DescriptorSetLayout::Builder(m_device)
+            .addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT)
+            .addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT)
+            .build();
+
+    m_clusterSetLayout =
+        DescriptorSetLayout::Builder(m_device)
+            .addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT) // instances
+            .addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT) // clusters
+            .addBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT) // cluster commands
+            .addBinding(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT) // cluster counts
+            .addBinding(4, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT) // visible ids
+            .build();
+
+    for (auto& frame : m_frames){
+        reserve(frame.batchIds, sizeof(uint32_t), INITIAL_CAPACITY, 0);
+        reserve(frame.batchData, sizeof(BatchData), INITIAL_CAPACITY, 0);
+        for (auto& view : frame.views){
+            reserve(view.commands, COMMAND_STRIDE, INITIAL_CAPACITY, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT);
+            reserve(view.drawCounts, sizeof(uint32_t), INITIAL_CAPACITY, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT);
+            reserve(view.visibleIds, sizeof(uint32_t), INITIAL_CAPACITY, 0);
+            reserve(view.clusters, sizeof(ClusterData), INITIAL_CAPACITY, 0);
+            reserve(view.clusterCommands, COMMAND_STRIDE, INITIAL_CAPACITY, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT);
+            reserve(view.clusterCounts, sizeof(uint32_t), INITIAL_CAPACITY, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT);
+
+            if (!m_pool->allocateDescriptor(m_computeSetLayout->getDescriptorSetLayout(), view.computeSet) ||
+                !m_pool->allocateDescriptor(m_drawSetLayout->getDescriptorSetLayout(), view.drawSet) ||
+                !m_pool->allocateDescriptor(m_clusterSetLayout->getDescriptorSetLayout(), view.clusterSet)){
+                throw std::runtime_error("failed to allocate culling descriptor sets");
+            }
+        }
+    }
+
+    createPipelineLayouts();
+    createPipelines();
+
+    setMode(CullingMode::Gpu);
+}
+
+CullingSystem::~CullingSystem(){
+    vkDestroyPipelineLayout(m_device.device(), m_pipelineLayout, nullptr);
+    vkDestroyPipelineLayout(m_device.device(), m_clusterPipelineLayout, nullptr);
+}
+
+void CullingSystem::createPipelineLayouts(){
+    auto createLayout = [this](VkDescriptorSetLayout descriptorSetLayout, uint32_t pushConstantSize, VkPipelineLayout& pipelineLayout){
+        VkPushConstantRange pushConstantRange{};
+        pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        pushConstantRange.offset = 0;
+        pushConstantRange.size = pushConstantSize;
+
+        VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+        pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        pipelineLayoutInfo.setLayoutCount = 1;
+        pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
+        pipelineLayoutInfo.pushConstantRangeCount = 1;
+        pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+        if (vkCreatePipelineLayout(m_device.device(), &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS){
+            throw std::runtime_error("failed to create pipeline layout");
+        }
+    };
+    createLayout(m_computeSetLayout->getDescriptorSetLayout(), sizeof(CullPushConstantData), m_pipelineLayout);
+    createLayout(m_clusterSetLayout->getDescriptorSetLayout(), sizeof(ClusterCullPushConstantData), m_clusterPipelineLayout);
+}
+
+void CullingSystem::createPipelines(){
+    assert(m_pipelineLayout != nullptr && m_clusterPipelineLayout != nullptr && "cannot create pipeline before pipeline layout");
+
+    m_pipeline = std::make_unique<ComputePipeline>(
+        m_device,
+        "../shaders/cull.comp.spv",
+        m_pipelineLayout);
+
+    m_clusterPipeline = std::make_unique<ComputePipeline>(
+        m_device,
+        "../shaders/cluster_cull.comp.spv",
+        m_clusterPipelineLayout);
+}
+
+void CullingSystem::setMode(CullingMode mode){
+    // the compacted instances start at the batch's firstInstance, that the indirect commands must carry
+    if (mode == CullingMode::Gpu && !m_device.enabledFeatures().drawIndirectFirstInstance)
+        mode = CullingMode::Cpu;
+    m_mode = mode;
+}
+
+bool CullingSystem::reserve(std::unique_ptr<Buffer>& buffer, VkDeviceSize instanceSize, uint32_t count, VkBufferUsageFlags usage){
+    if (buffer != nullptr && count <= buffer->getInstanceCount())
+        return false;
+
+    // host visible so the Cpu mode and the per frame resets can write them directly
+    uint32_t capacity = buffer != nullptr ? std::max(count, buffer->getInstanceCount() * 2) : count;
+    buffer = std::make_unique<Buffer>(
+        m_device,
+        instanceSize,
+        capacity,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | usage,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    buffer->map();
+    return true;
+}
+
+void CullingSystem::updateDescriptors(int frameIndex, Buffer& instanceBuffer){
+    // the buffers may have been reallocated, the frame's sets are no longer in use
+    auto& frame = m_frames[frameIndex];
+    auto instanceInfo = instanceBuffer.descriptorInfo();
+    auto batchIdInfo = frame.batchIds->descriptorInfo();
+    auto batchDataInfo = frame.batchData->descriptorInfo();
+
+    for (auto& view : frame.views){
+        auto commandInfo = view.commands->descriptorInfo();
+        auto drawCountInfo = view.drawCounts->descriptorInfo();
+        auto visibleInfo = view.visibleIds->descriptorInfo();
+        auto clusterInfo = view.clusters->descriptorInfo();
+        auto clusterCommandInfo = view.clusterCommands->descriptorInfo();
+        auto clusterCountInfo = view.clusterCounts->descriptorInfo();
+
+        DescriptorWriter(*m_computeSetLayout, *m_pool)
+            .writeBuffer(0, &instanceInfo)
+            .writeBuffer(1, &batchIdInfo)
+            .writeBuffer(2, &batchDataInfo)
+            .writeBuffer(3, &commandInfo)
+            .writeBuffer(4, &drawCountInfo)
+            .writeBuffer(5, &visibleInfo)
+            .overwrite(view.computeSet);
+
+        DescriptorWriter(*m_drawSetLayout, *m_pool)
+            .writeBuffer(0, &instanceInfo)
+            .writeBuffer(1, &visibleInfo)
+            .overwrite(view.drawSet);
+
+        DescriptorWriter(*m_clusterSetLayout, *m_pool)
+            .writeBuffer(0, &instanceInfo)
+            .writeBuffer(1, &clusterInfo)
+            .writeBuffer(2, &clusterCommandInfo)
+            .writeBuffer(3, &clusterCountInfo)
+            .writeBuffer(4, &visibleInfo)
+            .overwrite(view.clusterSet);
+    }
+}
+
+// command slots a static batch keeps per instance whatever its LOD, the meshlets are built for every level or none
+static uint32_t maxMeshletCount(const Model& model){
+    uint32_t count = 0;
+    for (uint32_t lod = 0; lod < model.getLodCount(); lod++)
+        count = std::max(count, model.getLod(lod).meshletCount);
+    return count;
+}
+
+void CullingSystem::appendClusters(const DrawBatch& batch, uint32_t lod, uint32_t group, uint32_t firstCommand, std::vector<ClusterData>& clusters) const {
+    const Model::Lod& level = batch.model->getLod(lod);
+    const auto& meshlets = batch.model->getMeshlets();
+    for (uint32_t i = 0; i < batch.instanceCount; i++){
+        for (uint32_t m = level.firstMeshlet; m < level.firstMeshlet + level.meshletCount; m++){
+            ClusterData cluster{};
+            cluster.boundingSphere = meshlets[m].boundingSphere;
+            cluster.cone = meshlets[m].cone;
+            cluster.instanceId = batch.firstInstance + i;
+            cluster.firstIndex = batch.model->getFirstIndex() + meshlets[m].firstIndex;
+            cluster.indexCount = meshlets[m].indexCount;
+            cluster.vertexOffset = batch.model->getVertexOffset();
+            cluster.group = group;
+            cluster.firstCommand = firstCommand;
+            clusters.push_back(cluster);
+        }
+    }
+}
+
+void CullingSystem::gatherStaticClusters(uint32_t view, const InstanceBatchSystem& instanceBatches){
+    const auto& batches = instanceBatches.getBatches();
+    const uint32_t staticBatchCount = instanceBatches.getStaticBatchCount();
+    auto& cache = m_staticClusters[view];
+    cache.lods.resize(staticBatchCount);
+    cache.groups.clear();
+    cache.batchGroups.assign(staticBatchCount, NO_GROUP);
+    cache.clusterData.clear();
+
+    // the groups only depend on the layout, the recorded draws of the static batches keep reading the same slots
+    uint32_t firstCommand = 0;
+    for (uint32_t b = 0; b < staticBatchCount; b++){
+        const DrawBatch& batch = batches[b];
+        cache.lods[b] = getViewLod(view, batch);
+        const uint32_t meshletCount = maxMeshletCount(*batch.model);
+        if (meshletCount == 0 || !batch.model->hasIndexBuffer())
+            continue;
+
+        const uint32_t group = static_cast<uint32_t>(cache.groups.size());
+        cache.groups.push_back({firstCommand, meshletCount * batch.instanceCount});
+        cache.batchGroups[b] = group;
+        appendClusters(batch, cache.lods[b], group, firstCommand, cache.clusterData);
+        firstCommand += meshletCount * batch.instanceCount;
+    }
+    cache.commandCount = firstCommand;
+    cache.layoutVersion = instanceBatches.getStaticVersion();
+    cache.version++;
+}
+
+void CullingSystem::gatherClusters(int frameIndex, const InstanceBatchSystem& instanceBatches, const std::array<glm::mat4, VIEW_COUNT>& viewProjections){
+    const auto& batches = instanceBatches.getBatches();
+    const uint32_t staticBatchCount = instanceBatches.getStaticBatchCount();
+    for (uint32_t v = 0; v < VIEW_COUNT; v++){
+        auto& view = m_frames[frameIndex].views[v];
+        view.viewOrigin = computeViewOrigin(viewProjections[v]);
+
+        // the static clusters are gathered again when their layout or one of their LODs changed
+        const auto& cache = m_staticClusters[v];
+        bool staticChanged = cache.layoutVersion != instanceBatches.getStaticVersion();
+        for (uint32_t b = 0; b < staticBatchCount && !staticChanged; b++)
+            staticChanged = cache.lods[b] != getViewLod(v, batches[b]);
+        if (staticChanged)
+            gatherStaticClusters(v, instanceBatches);
+
+        view.clusterGroups.assign(cache.groups.begin(), cache.groups.end());
+        view.batchGroups.assign(cache.batchGroups.begin(), cache.batchGroups.end());
+        view.batchGroups.resize(batches.size(), NO_GROUP);
+        view.clusterData.clear();
+
+        uint32_t firstCommand = cache.commandCount;
+        for (size_t b = staticBatchCount; b < batches.size(); b++){
+            const DrawBatch& batch = batches[b];
+            const uint32_t lod = getViewLod(v, batch);
+            const uint32_t meshletCount = batch.model->getLod(lod).meshletCount;
+            if (meshletCount == 0 || !batch.model->hasIndexBuffer())
+                continue;
+
+            const uint32_t group = static_cast<uint32_t>(view.clusterGroups.size());
+            view.clusterGroups.push_back({firstCommand, meshletCount * batch.instanceCount});
+            view.batchGroups[b] = group;
+            appendClusters(batch, lod, group, firstCommand, view.clusterData);
+            firstCommand += meshletCount * batch.instanceCount;
+        }
+        view.clusterCount = static_cast<uint32_t>(cache.clusterData.size() + view.clusterData.size());
+        view.commandCount = firstCommand;
+
+        view.clusterDraws.assign(view.commandCount, VkDrawIndexedIndirectCommand{});
+        view.clusterDrawCounts.assign(view.clusterGroups.size(), 0);
+    }
+}
+
+void CullingSystem::writeClusters(int frameIndex){
+    for (uint32_t v = 0; v < VIEW_COUNT; v++){
+        auto& view = m_frames[frameIndex].views[v];
+        const auto& cache = m_staticClusters[v];
+        auto* clusters = static_cast<ClusterData*>(view.clusters->getMappedMemory());
+        if (view.staticClusterVersion != cache.version){
+            std::memcpy(clusters, cache.clusterData.data(), cache.clusterData.size() * sizeof(ClusterData));
+            view.staticClusterVersion = cache.version;
+        }
+        std::memcpy(clusters + cache.clusterData.size(), view.clusterData.data(), view.clusterData.size() * sizeof(ClusterData));
+
+        // the draws without count buffer read every slot, the ones past the visible clusters must stay empty
+        if (!m_device.enabledFeatures().drawIndirectCount)
+            std::memset(view.clusterCommands->getMappedMemory(), 0, size_t(view.commandCount) * COMMAND_STRIDE);
+        std::memset(view.clusterCounts->getMappedMemory(), 0, view.clusterGroups.size() * sizeof(uint32_t));
+    }
+}
+
+void CullingSystem::writeBatches(int frameIndex, const InstanceBatchSystem& instanceBatches){
+    auto& frame = m_frames[frameIndex];
+    const auto& batches = instanceBatches.getBatches();
+    const auto& instanceBatchIds = instanceBatches.getInstanceBatches();
+
+    // the static part only changes with the static layout
+    const bool staticChanged = frame.staticVersion != instanceBatches.getStaticVersion();
+    const uint32_t firstBatch = staticChanged ? 0 : instanceBatches.getStaticBatchCount();
+    const uint32_t firstInstance = staticChanged ? 0 : instanceBatches.getStaticInstanceCount();
+    frame.staticVersion = instanceBatches.getStaticVersion();
+
+    auto* batchData = static_cast<BatchData*>(frame.batchData->getMappedMemory());
+    for (size_t b = firstBatch; b < batches.size(); b++){
+        batchData[b].boundingSphere = batches[b].model->getBoundingSphere().asVec4();
+        batchData[b].firstInstance = batches[b].firstInstance;
+    }
+    std::memcpy(static_cast<uint32_t*>(frame.batchIds->getMappedMemory()) + firstInstance, instanceBatchIds.data() + firstInstance,
+        (instanceBatches.getInstanceCount() - firstInstance) * sizeof(uint32_t));
+}
+
+void CullingSystem::setShadowLodBias(uint32_t bias){
+    if (bias == m_shadowLodBias)
+        return;
+    // the shadow draws index the LOD chosen with the old bias
+    m_shadowLodBias = bias;
+    m_drawVersion++;
+}
+
+uint32_t CullingSystem::getViewLod(uint32_t view, const DrawBatch& batch) const {
+    uint32_t lod = batch.lod;
+    if (view == static_cast<uint32_t>(CullingView::Shadow))
+        lod += m_shadowLodBias;
+    return std::min(lod, batch.model->getLodCount() - 1);
+}
+
+void CullingSystem::writeCommands(int frameIndex, const std::vector<DrawBatch>& batches){
+    // instance counts start at 0, the culling increments them
+    // the index and vertex offsets locate the model's LOD in its geometry pool page
+    for (uint32_t v = 0; v < VIEW_COUNT; v++){
+        auto& view = m_frames[frameIndex].views[v];
+        auto* commands = static_cast<uint8_t*>(view.commands->getMappedMemory());
+        for (size_t i = 0; i < batches.size(); i++){
+            const DrawBatch& batch = batches[i];
+            if (batch.model->hasIndexBuffer()){
+                const Model::Lod& lod = batch.model->getLod(getViewLod(v, batch));
+                VkDrawIndexedIndirectCommand command{lod.indexCount, 0, batch.model->getFirstIndex() + lod.firstIndex, batch.model->getVertexOffset(), batch.firstInstance};
+                std::memcpy(commands + i * COMMAND_STRIDE, &command, sizeof(command));
+            } else {
+                VkDrawIndirectCommand command{batch.model->getVertexCount(), 0, static_cast<uint32_t>(batch.model->getVertexOffset()), batch.firstInstance};
+                std::memcpy(commands + i * COMMAND_STRIDE, &command, sizeof(command));
+            }
+        }
+        std::memset(view.drawCounts->getMappedMemory(), 0, batches.size() * sizeof(uint32_t));
+    }
+}
+
+void CullingSystem::cull(
+    FrameInfo& frameInfo,
+    const InstanceBatchSystem& instanceBatches,
+    FrustumCullingSystem& frustumCulling,
+    const std::array<glm::mat4, VIEW_COUNT>& viewProjections){
+    const int frameIndex = frameInfo.FrameIndex;
+    const auto& batches = instanceBatches.getBatches();
+    const uint32_t batchCount = static_cast<uint32_t>(batches.size());
+    const uint32_t instanceCount = instanceBatches.getInstanceCount();
+
+    auto& frame = m_frames[frameIndex];
+    gatherClusters(frameIndex, instanceBatches, viewProjections);
+    bool replaced = false;
+    bool batchesReplaced = reserve(frame.batchIds, sizeof(uint32_t), instanceCount, 0);
+    batchesReplaced |= reserve(frame.batchData, sizeof(BatchData), batchCount, 0);
+    // a new buffer has none of the static data
+    if (batchesReplaced)
+        frame.staticVersion = 0;
+    replaced |= batchesReplaced;
+    for (auto& view : frame.views){
+        replaced |= reserve(view.commands, COMMAND_STRIDE, batchCount, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT);
+        replaced |= reserve(view.drawCounts, sizeof(uint32_t), batchCount, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT);
+        // the instances of the cluster draws follow the ones of the batches, one per command slot
+        replaced |= reserve(view.visibleIds, sizeof(uint32_t), instanceCount + view.commandCount, 0);
+        if (reserve(view.clusters, sizeof(ClusterData), view.clusterCount, 0)){
+            view.staticClusterVersion = 0;
+            replaced = true;
+        }
+        replaced |= reserve(view.clusterCommands, COMMAND_STRIDE, view.commandCount, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT);
+        replaced |= reserve(view.clusterCounts, sizeof(uint32_t), static_cast<uint32_t>(view.clusterGroups.size()), VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT);
+    }
+    // rewriting a set invalidates the command buffers it is bound in, the recorded draws are kept otherwise
+    Buffer& instanceBuffer = instanceBatches.getInstanceBuffer(frameIndex);
+    if (replaced || frame.instanceBuffer != instanceBuffer.getBuffer()){
+        updateDescriptors(frameIndex, instanceBuffer);
+        frame.instanceBuffer = instanceBuffer.getBuffer();
+        m_drawVersion++;
+    }
+
+    if (batchCount == 0)
+        return;
+
+    writeCommands(frameIndex, batches);
+    writeClusters(frameIndex);
+
+    if (m_mode == CullingMode::Gpu){
+        writeBatches(frameIndex, instanceBatches);
+        cullGpu(frameInfo, instanceCount, viewProjections);
+    } else {
+        cullCpu(frameIndex, instanceBatches, frustumCulling, viewProjections);
+        cullClustersCpu(frameIndex, instanceBatches, viewProjections);
+    }
+}
+
+void CullingSystem::cullClustersCpu(int frameIndex, const InstanceBatchSystem& instanceBatches, const std::array<glm::mat4, VIEW_COUNT>& viewProjections){
+    const uint32_t visibleBase = instanceBatches.getInstanceCount();
+
+    for (uint32_t v = 0; v < VIEW_COUNT; v++){
+        auto& view = m_frames[frameIndex].views[v];
+        if (view.clusterCount == 0)
+            continue;
+
+        const Frustum frustum = Frustum::fromMatrix(viewProjections[v]);
+        auto* visibleIds = static_cast<uint32_t*>(view.visibleIds->getMappedMemory());
+        const auto& staticClusters = m_staticClusters[v].clusterData;
+        for (uint32_t c = 0; c < view.clusterCount; c++){
+            const ClusterData& cluster = c < staticClusters.size() ? staticClusters[c] : view.clusterData[c - staticClusters.size()];
+            if (m_mode == CullingMode::Cpu){
+                // same tests as cluster_cull.comp
+                const glm::mat4& model = instanceBatches.getInstanceMatrix(cluster.instanceId);
+                const glm::vec3 center = model * glm::vec4(glm::vec3(cluster.boundingSphere), 1.f);
+                const glm::vec3 scale2{
+                    glm::dot(glm::vec3(model[0]), glm::vec3(model[0])),
+                    glm::dot(glm::vec3(model[1]), glm::vec3(model[1])),
+                    glm::dot(glm::vec3(model[2]), glm::vec3(model[2]))};
+                const float maxScale2 = std::max(scale2.x, std::max(scale2.y, scale2.z));
+                const float minScale2 = std::min(scale2.x, std::min(scale2.y, scale2.z));
+                const float radius = cluster.boundingSphere.w * std::sqrt(maxScale2);
+                if (!frustum.intersectsSphere(center, radius))
+                    continue;
+                // the cone angles only survive a uniform scale
+                if (cluster.cone.w < 1.f && maxScale2 <= minScale2 * 1.001f){
+                    const glm::vec3 axis = glm::normalize(glm::mat3(model) * glm::vec3(cluster.cone));
+                    if (isConeBackFacing(center, radius, axis, cluster.cone.w, view.viewOrigin))
+                        continue;
+                }
+            }
+
+            const uint32_t command = cluster.firstCommand + view.clusterDrawCounts[cluster.group]++;
+            const uint32_t firstInstance = visibleBase + command;
+            view.clusterDraws[command] = {cluster.indexCount, 1, cluster.firstIndex, cluster.vertexOffset, firstInstance};
+            visibleIds[firstInstance] = cluster.instanceId;
+        }
+
+        std::memcpy(view.clusterCommands->getMappedMemory(), view.clusterDraws.data(), view.clusterDraws.size() * COMMAND_STRIDE);
+        std::memcpy(view.clusterCounts->getMappedMemory(), view.clusterDrawCounts.data(), view.clusterDrawCounts.size() * sizeof(uint32_t));
+    }
+}
+
+void CullingSystem::cullCpu(
+    int frameIndex,
+    const InstanceBatchSystem& instanceBatches,
+    FrustumCullingSystem& frustumCulling,
+    const std::array<glm::mat4, VIEW_COUNT>& viewProjections){
+    const auto& batches = instanceBatches.getBatches();
+    const auto& entityInstances = instanceBatches.getEntityInstances();
+    const auto& instanceBatchIds = instanceBatches.getInstanceBatches();
+
+    for (uint32_t v = 0; v < VIEW_COUNT; v++){
+        auto& view = m_frames[frameIndex].views[v];
+        auto& visibleCounts = m_visibleCounts[frameIndex][v];
+        visibleCounts.assign(batches.size(), 0);
+
+        auto* commands = static_cast<uint8_t*>(view.commands->getMappedMemory());
+        auto* drawCounts = static_cast<uint32_t*>(view.drawCounts->getMappedMemory());
+        auto* visibleIds = static_cast<uint32_t*>(view.visibleIds->getMappedMemory());
+
+        if (m_mode == CullingMode::Cpu){
+            // the visible entities index the entity list the batches were built from
+            frustumCulling.cull(Frustum::fromMatrix(viewProjections[v]), m_visibleEntities);
+            for (uint32_t entityIndex : m_visibleEntities){
+                uint32_t instance = entityInstances[entityIndex];
+                uint32_t b = instanceBatchIds[instance];
+                visibleIds[batches[b].firstInstance + visibleCounts[b]++] = instance;
+            }
+        } else {
+            for (size_t b = 0; b < batches.size(); b++){
+                for (uint32_t i = 0; i < batches[b].instanceCount; i++){
+                    visibleIds[batches[b].firstInstance + i] = batches[b].firstInstance + i;
+                }
+                visibleCounts[b] = batches[b].instanceCount;
+            }
+        }
+
+        for (size_t b = 0; b < batches.size(); b++){
+            // instanceCount sits at the same offset in both command layouts
+            std::memcpy(commands + b * COMMAND_STRIDE + offsetof(VkDrawIndexedIndirectCommand, instanceCount), &visibleCounts[b], sizeof(uint32_t));
+            drawCounts[b] = visibleCounts[b] > 0 ? 1 : 0;
+        }
+    }
+}
+
+void CullingSystem::cullGpu(FrameInfo& frameInfo, uint32_t instanceCount, const std::array<glm::mat4, VIEW_COUNT>& viewProjections){
+    VkCommandBuffer commandBuffer = frameInfo.commandBuffer;
+    m_pipeline->bind(commandBuffer);
+
+    for (uint32_t v = 0; v < VIEW_COUNT; v++){
+        auto& view = m_frames[frameInfo.FrameIndex].views[v];
+
+        vkCmdBindDescriptorSets(
+            commandBuffer,
+            VK_PIPELINE_BIND_POINT_COMPUTE,
+            m_pipelineLayout,
+            0,
+            1,
+            &view.computeSet,
+            0,
+            nullptr);
+
+        CullPushConstantData push{};
+        push.frustumPlanes = Frustum::fromMatrix(viewProjections[v]).planes;
+        push.instanceCount = instanceCount;
+        vkCmdPushConstants(
+            commandBuffer,
+            m_pipelineLayout,
+            VK_SHADER_STAGE_COMPUTE_BIT,
+            0,
+            sizeof(CullPushConstantData),
+            &push);
+
+        vkCmdDispatch(commandBuffer, (instanceCount + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+    }
+
+    cullClustersGpu(frameInfo, instanceCount, viewProjections);
+
+    // the draws of both passes read the compacted lists
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+    vkCmdPipelineBarrier(
+        commandBuffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
+        0,
+        1, &barrier,
+        0, nullptr,
+        0, nullptr);
+}
+
+void CullingSystem::cullClustersGpu(FrameInfo& frameInfo, uint32_t instanceCount, const std::array<glm::mat4, VIEW_COUNT>& viewProjections){
+    VkCommandBuffer commandBuffer = frameInfo.commandBuffer;
+    bool bound = false;
+
+    for (uint32_t v = 0; v < VIEW_COUNT; v++){
+        auto& view = m_frames[frameInfo.FrameIndex].views[v];
+        const uint32_t clusterCount = view.clusterCount;
+        if (clusterCount == 0)
+            continue;
+        if (!bound){
+            m_clusterPipeline->bind(commandBuffer);
+            bound = true;
+        }
+
+        vkCmdBindDescriptorSets(
+            commandBuffer,
+            VK_PIPELINE_BIND_POINT_COMPUTE,
+            m_clusterPipelineLayout,
+            0,
+            1,
+            &view.clusterSet,
+            0,
+            nullptr);
+
+        ClusterCullPushConstantData push{};
+        push.frustumPlanes = Frustum::fromMatrix(viewProjections[v]).planes;
+        push.viewOrigin = view.viewOrigin;
+        push.clusterCount = clusterCount;
+        push.visibleBase = instanceCount;
+        vkCmdPushConstants(
+            commandBuffer,
+            m_clusterPipelineLayout,
+            VK_SHADER_STAGE_COMPUTE_BIT,
+            0,
+            sizeof(ClusterCullPushConstantData),
+            &push);
+
+        vkCmdDispatch(commandBuffer, (clusterCount + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+    }
+}
+
+void CullingSystem::bindDrawSet(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t set, int frameIndex, CullingView view){
+    vkCmdBindDescriptorSets(
+        commandBuffer,
+        VK_PIPELINE_BIND_POINT_GRAPHICS,
+        pipelineLayout,
+        set,
+        1,
+        &m_frames[frameIndex].views[static_cast<uint32_t>(view)].drawSet,
+        0,
+        nullptr);
+}
+
+void CullingSystem::drawBatch(VkCommandBuffer commandBuffer, int frameIndex, CullingView view, uint32_t batchIndex, const DrawBatch& batch){
+    const uint32_t v = static_cast<uint32_t>(view);
+    const DeviceFeatures& features = m_device.enabledFeatures();
+
+    const auto& batchGroups = m_frames[frameIndex].views[v].batchGroups;
+    if (batchIndex < batchGroups.size() && batchGroups[batchIndex] != NO_GROUP){
+        drawClusters(commandBuffer, frameIndex, v, batchGroups[batchIndex], *batch.model);
+        return;
+    }
+
+    if (!features.drawIndirectFirstInstance){
+        // indirect commands would be limited to firstInstance 0, use the counts of the Cpu culling
+        uint32_t count = m_visibleCounts[frameIndex][v][batchIndex];
+        if (count > 0)
+            batch.model->draw(commandBuffer, count, batch.firstInstance, getViewLod(v, batch));
+        return;
+    }
+
+    const auto& resources = m_frames[frameIndex].views[v];
+    batch.model->drawIndirect(
+        commandBuffer,
+        resources.commands->getBuffer(),
+        batchIndex * COMMAND_STRIDE,
+        features.drawIndirectCount ? resources.drawCounts->getBuffer() : VK_NULL_HANDLE,
+        batchIndex * sizeof(uint32_t));
+}
+
+void CullingSystem::drawClusters(VkCommandBuffer commandBuffer, int frameIndex, uint32_t view, uint32_t group, Model& model){
+    const auto& resources = m_frames[frameIndex].views[view];
+    const ClusterGroup& clusterGroup = resources.clusterGroups[group];
+    const DeviceFeatures& features = m_device.enabledFeatures();
+
+    if (!features.drawIndirectFirstInstance){
+        // the Cpu culling compacted the draws of the group
+        for (uint32_t i = 0; i < resources.clusterDrawCounts[group]; i++){
+            const VkDrawIndexedIndirectCommand& command = resources.clusterDraws[clusterGroup.firstCommand + i];
+            vkCmdDrawIndexed(commandBuffer, command.indexCount, command.instanceCount, command.firstIndex, command.vertexOffset, command.firstInstance);
+        }
+        return;
+    }
+
+    const VkDeviceSize offset = VkDeviceSize(clusterGroup.firstCommand) * COMMAND_STRIDE;
+    if (features.drawIndirectCount){
+        model.drawIndirect(commandBuffer, resources.clusterCommands->getBuffer(), offset,
+            resources.clusterCounts->getBuffer(), group * sizeof(uint32_t), clusterGroup.commandCount);
+    } else if (features.multiDrawIndirect){
+        // the slots past the visible clusters hold empty draws
+        model.drawIndirect(commandBuffer, resources.clusterCommands->getBuffer(), offset, VK_NULL_HANDLE, 0, clusterGroup.commandCount);
+    } else {
+        for (uint32_t i = 0; i < clusterGroup.commandCount; i++)
+            model.drawIndirect(commandBuffer, resources.clusterCommands->getBuffer(), offset + i * COMMAND_STRIDE);
+    }
+}
+
+} // namespace hyd
@@ -0,0 +1,233 @@
+/*
+The culling system tests the instances of the batches against the view frustums
+(camera and shadow light) and fills one indirect draw command per batch with the
+surviving instances. The test runs in a compute shader, or on the CPU with the
+frustum culling system when the device cannot read firstInstance from indirect
+commands.
+The vertex shaders fetch their instance through the visible list:
+instances[visibleIds[gl_InstanceIndex]].
+Each command draws the index range of the batch's LOD, the shadow view goes a
+few levels coarser since its texels are larger than the camera's pixels.
+The batches whose LOD has meshlets are culled per cluster instead (frustum and
+normal cone, cluster_cull.comp or the CPU): each visible cluster of an instance
+gets its own command in the batch's group of commands.
+When the device reads firstInstance from indirect commands, the draws only point
+to the culling results in the frame's buffers: the recorded draws stay valid
+from one frame to the next until those buffers or the draw sets are replaced.
+The LOD of a static batch only changes the content of its command and clusters:
+its cluster group has a slot for every meshlet of its largest level, and its
+clusters, batch data and batch ids are only gathered and uploaded again when the
+static layout or a static LOD changes.
+*/
+#pragma once
+
+#include "Renderer/Device.hpp"
+#include "Renderer/Buffer.hpp"
+#include "Renderer/DescriptorSet.hpp"
+#include "Renderer/FrameInfo.hpp"
+#include "Renderer/Pipeline.hpp"
+#include "Renderer/SwapChain.hpp"
+
+#include "instance_batch_system.hpp"
+#include "frustum_culling_system.hpp"
+
+//libs
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+// std
+#include <array>
+#include <memory>
+#include <vector>
+
+namespace hyd
+{
+
+enum class CullingMode
+{
+    Disabled, // every instance is drawn
+    Cpu,
+    Gpu
+};
+
+enum class CullingView : uint32_t
+{
+    Camera = 0,
+    Shadow,
+    Count
+};
+
+class CullingSystem
+{
+public:
+    static constexpr uint32_t VIEW_COUNT = static_cast<uint32_t>(CullingView::Count);
+
+    CullingSystem(Device& device);
+    ~CullingSystem();
+
+    CullingSystem(const CullingSystem&) = delete;
+    CullingSystem &operator=(const CullingSystem&) = delete;
+
+    // Gpu falls back to Cpu when drawIndirectFirstInstance is not supported
+    void setMode(CullingMode mode);
+    CullingMode getMode() const { return m_mode; }
+
+    // set layout of the draw pipelines: binding 0 instances, binding 1 visible instance ids
+    VkDescriptorSetLayout getDrawSetLayout() const { return m_drawSetLayout->getDescriptorSetLayout(); }
+
+    // records the culling work for every view, must be called outside of a render pass
+    // once the instance batches of the frame are updated
+    void cull(
+        FrameInfo& frameInfo,
+        const InstanceBatchSystem& instanceBatches,
+        FrustumCullingSystem& frustumCulling,
+        const std::array<glm::mat4, VIEW_COUNT>& viewProjections);
+
+    // levels added to the camera's LOD of a batch for the shadow view, a change records the draws again
+    void setShadowLodBias(uint32_t bias);
+    uint32_t getShadowLodBias() const { return m_shadowLodBias; }
+
+    // true when the recorded draws of a batch can be executed again in later frames
+    bool hasReusableDraws() const { return m_device.enabledFeatures().drawIndirectFirstInstance; }
+    // changes whenever the buffers or the draw sets of a frame are replaced, the draws are recorded again then
+    uint64_t getDrawVersion() const { return m_drawVersion; }
+
+    void bindDrawSet(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t set, int frameIndex, CullingView view);
+    void drawBatch(VkCommandBuffer commandBuffer, int frameIndex, CullingView view, uint32_t batchIndex, const DrawBatch& batch);
+
+private:
+    // stride of the command buffer, a VkDrawIndirectCommand fits in the same slot
+    static constexpr uint32_t COMMAND_STRIDE = sizeof(VkDrawIndexedIndirectCommand);
+    static constexpr uint32_t NO_GROUP = ~0u;
+
+    // matches the BatchData struct of cull.comp (std430)
+    struct BatchData
+    {
+        glm::vec4 boundingSphere{0.f};
+        uint32_t firstInstance{0};
+        uint32_t pad[3];
+    };
+
+    // matches the ClusterData struct of cluster_cull.comp (std430)
+    struct ClusterData
+    {
+        glm::vec4 boundingSphere{0.f};
+        glm::vec4 cone{0.f};
+        uint32_t instanceId{0};
+        uint32_t firstIndex{0};
+        uint32_t indexCount{0};
+        int32_t vertexOffset{0};
+        uint32_t group{0};
+        uint32_t firstCommand{0};
+        uint32_t pad[2];
+    };
+
+    // the cluster commands of a batch in a view, one slot per meshlet of every instance
+    struct ClusterGroup
+    {
+        uint32_t firstCommand{0};
+        uint32_t commandCount{0};
+    };
+
+    struct ViewResources
+    {
+        std::unique_ptr<Buffer> commands;
+        std::unique_ptr<Buffer> drawCounts;
+        std::unique_ptr<Buffer> visibleIds;
+        std::unique_ptr<Buffer> clusters;
+        std::unique_ptr<Buffer> clusterCommands;
+        std::unique_ptr<Buffer> clusterCounts;
+        VkDescriptorSet computeSet;
+        VkDescriptorSet drawSet;
+        VkDescriptorSet clusterSet;
+
+        // written on the CPU, kept for the direct draws and the Cpu mode
+        std::vector<ClusterGroup> clusterGroups; // the static ones first
+        std::vector<uint32_t> batchGroups; // group of each batch, NO_GROUP when drawn whole
+        std::vector<ClusterData> clusterData; // clusters of the other batches, after the static ones
+        std::vector<VkDrawIndexedIndirectCommand> clusterDraws;
+        std::vector<uint32_t> clusterDrawCounts;
+        uint32_t clusterCount{0}; // static and other clusters
+        uint32_t commandCount{0}; // command slots of all the groups
+        glm::vec4 viewOrigin{0.f};
+        // version of the static clusters in the clusters buffer
+        uint64_t staticClusterVersion{0};
+    };
+
+    struct FrameResources
+    {
+        std::unique_ptr<Buffer> batchIds;
+        std::unique_ptr<Buffer> batchData;
+        std::array<ViewResources, VIEW_COUNT> views;
+        // instance buffer of the descriptors, they are only rewritten when a buffer changes
+        VkBuffer instanceBuffer{VK_NULL_HANDLE};
+        // static layout of the static batch data and batch ids
+        uint64_t staticVersion{0};
+    };
+
+    // the clusters of the static batches in a view, shared by the frames
+    struct StaticClusters
+    {
+        uint64_t layoutVersion{0};
+        std::vector<uint32_t> lods; // view LOD of each static batch
+        std::vector<ClusterGroup> groups;
+        std::vector<uint32_t> batchGroups;
+        std::vector<ClusterData> clusterData;
+        uint32_t commandCount{0};
+        // changes whenever the clusters are gathered again
+        uint64_t version{0};
+    };
+
+    void createPipelineLayouts();
+    void createPipelines();
+
+    // returns true when the buffer was replaced
+    bool reserve(std::unique_ptr<Buffer>& buffer, VkDeviceSize instanceSize, uint32_t count, VkBufferUsageFlags usage);
+    void updateDescriptors(int frameIndex, Buffer& instanceBuffer);
+
+    // lists the clusters of the batches drawn per meshlet, then writes them for the Gpu mode
+    void gatherClusters(int frameIndex, const InstanceBatchSystem& instanceBatches, const std::array<glm::mat4, VIEW_COUNT>& viewProjections);
+    void gatherStaticClusters(uint32_t view, const InstanceBatchSystem& instanceBatches);
+    void appendClusters(const DrawBatch& batch, uint32_t lod, uint32_t group, uint32_t firstCommand, std::vector<ClusterData>& clusters) const;
+    void writeClusters(int frameIndex);
+    void writeBatches(int frameIndex, const InstanceBatchSystem& instanceBatches);
+    void cullClustersCpu(int frameIndex, const InstanceBatchSystem& instanceBatches, const std::array<glm::mat4, VIEW_COUNT>& viewProjections);
+    void drawClusters(VkCommandBuffer commandBuffer, int frameIndex, uint32_t view, uint32_t group, Model& model);
+
+    uint32_t getViewLod(uint32_t view, const DrawBatch& batch) const;
+    void writeCommands(int frameIndex, const std::vector<DrawBatch>& batches);
+    void cullCpu(
+        int frameIndex,
+        const InstanceBatchSystem& instanceBatches,
+        FrustumCullingSystem& frustumCulling,
+        const std::array<glm::mat4, VIEW_COUNT>& viewProjections);
+    void cullGpu(FrameInfo& frameInfo, uint32_t instanceCount, const std::array<glm::mat4, VIEW_COUNT>& viewProjections);
+    void cullClustersGpu(FrameInfo& frameInfo, uint32_t instanceCount, const std::array<glm::mat4, VIEW_COUNT>& viewProjections);
+
+    /* data */
+    Device& m_device;
+    CullingMode m_mode{CullingMode::Gpu};
+    uint32_t m_shadowLodBias{1};
+    uint64_t m_drawVersion{0};
+
+    std::unique_ptr<DescriptorPool> m_pool{};
+    std::unique_ptr<DescriptorSetLayout> m_computeSetLayout;
+    std::unique_ptr<DescriptorSetLayout> m_drawSetLayout;
+    std::unique_ptr<DescriptorSetLayout> m_clusterSetLayout;
+
+    std::unique_ptr<ComputePipeline> m_pipeline;
+    VkPipelineLayout m_pipelineLayout;
+    std::unique_ptr<ComputePipeline> m_clusterPipeline;
+    VkPipelineLayout m_clusterPipelineLayout;
+
+    std::vector<FrameResources> m_frames = std::vector<FrameResources>(SwapChain::MAX_FRAMES_IN_FLIGHT);
+    std::array<StaticClusters, VIEW_COUNT> m_staticClusters;
+
+    // indices in the frustum culling system's entity list, scratch memory of the Cpu mode
+    std::vector<uint32_t> m_visibleEntities;
+    // per batch instance count of the frame's views, used for the direct draws of the Cpu mode
+    std::vector<std::array<std::vector<uint32_t>, VIEW_COUNT>> m_visibleCounts = std::vector<std::array<std::vector<uint32_t>, VIEW_COUNT>>(SwapChain::MAX_FRAMES_IN_FLIGHT);
+};
+
+} // namespace hyd
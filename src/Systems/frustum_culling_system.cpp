@@ -0,0 +1,249 @@
+#include "frustum_culling_system.hpp"
+
+#include "Components/Transform.hpp"
+#include "Components/Renderable.hpp"
+
+// std
+#include <algorithm>
+#include <cmath>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__)
+#define HYD_CULLING_X86
+#include <immintrin.h>
+#endif
+
+namespace hyd
+{
+
+static constexpr uint32_t SIMD_WIDTH = 8;
+static_assert(FrustumCullingSystem::CHUNK_SIZE % SIMD_WIDTH == 0, "chunks must hold whole SIMD batches");
+
+// the padding boxes have a negative extent, they are outside of every plane
+static constexpr float CULLED_EXTENT = -1e30f;
+
+namespace
+{
+
+struct BoxesSoA
+{
+    const float* centerX;
+    const float* centerY;
+    const float* centerZ;
+    const float* extentX;
+    const float* extentY;
+    const float* extentZ;
+};
+
+// a box is outside when n.c + w + |n|.e < 0 for one of the planes
+// writes the indices of the visible boxes of [begin, end) in out, returns their count
+using CullKernel = uint32_t (*)(const BoxesSoA&, const Frustum&, uint32_t, uint32_t, uint32_t*);
+
+uint32_t cullScalar(const BoxesSoA& boxes, const Frustum& frustum, uint32_t begin, uint32_t end, uint32_t* out){
+    uint32_t count = 0;
+    for (uint32_t i = begin; i < end; i++){
+        bool visible = true;
+        for (const auto& plane : frustum.planes){
+            float distance = plane.x * boxes.centerX[i] + plane.y * boxes.centerY[i] + plane.z * boxes.centerZ[i] + plane.w;
+            float radius = std::abs(plane.x) * boxes.extentX[i] + std::abs(plane.y) * boxes.extentY[i] + std::abs(plane.z) * boxes.extentZ[i];
+            if (distance + radius < 0.f){
+                visible = false;
+                break;
+            }
+        }
+        if (visible)
+            out[count++] = i;
+    }
+    return count;
+}
+
+#ifdef HYD_CULLING_X86
+
+inline uint32_t appendVisible(uint32_t mask, uint32_t base, uint32_t* out, uint32_t count){
+    while (mask != 0){
+        out[count++] = base + static_cast<uint32_t>(__builtin_ctz(mask));
+        mask &= mask - 1;
+    }
+    return count;
+}
+
+// SSE2 is always available on x86-64, two groups of 4 boxes per iteration
+uint32_t cullSse(const BoxesSoA& boxes, const Frustum& frustum, uint32_t begin, uint32_t end, uint32_t* out){
+    const __m128 signMask = _mm_set1_ps(-0.f);
+    __m128 nx[Frustum::Count], ny[Frustum::Count], nz[Frustum::Count], nw[Frustum::Count];
+    __m128 ax[Frustum::Count], ay[Frustum::Count], az[Frustum::Count];
+    for (int p = 0; p < Frustum::Count; p++){
+        nx[p] = _mm_set1_ps(frustum.planes[p].x);
+        ny[p] = _mm_set1_ps(frustum.planes[p].y);
+        nz[p] = _mm_set1_ps(frustum.planes[p].z);
+        nw[p] = _mm_set1_ps(frustum.planes[p].w);
+        ax[p] = _mm_andnot_ps(signMask, nx[p]);
+        ay[p] = _mm_andnot_ps(signMask, ny[p]);
+        az[p] = _mm_andnot_ps(signMask, nz[p]);
+    }
+
+    uint32_t count = 0;
+    for (uint32_t i = begin; i < end; i += SIMD_WIDTH){
+        uint32_t visibleMask = 0;
+        for (uint32_t half = 0; half < SIMD_WIDTH; half += 4){
+            const uint32_t j = i + half;
+            __m128 cx = _mm_loadu_ps(boxes.centerX + j);
+            __m128 cy = _mm_loadu_ps(boxes.centerY + j);
+            __m128 cz = _mm_loadu_ps(boxes.centerZ + j);
+            __m128 ex = _mm_loadu_ps(boxes.extentX + j);
+            __m128 ey = _mm_loadu_ps(boxes.extentY + j);
+            __m128 ez = _mm_loadu_ps(boxes.extentZ + j);
+
+            __m128 outside = _mm_setzero_ps();
+            for (int p = 0; p < Frustum::Count; p++){
+                __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx[p], cx), _mm_mul_ps(ny[p], cy)), _mm_add_ps(_mm_mul_ps(nz[p], cz), nw[p]));
+                __m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax[p], ex), _mm_mul_ps(ay[p], ey)), _mm_mul_ps(az[p], ez));
+                outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(distance, radius), _mm_setzero_ps()));
+            }
+            visibleMask |= (~static_cast<uint32_t>(_mm_movemask_ps(outside)) & 0xFu) << half;
+        }
+        count = appendVisible(visibleMask, i, out, count);
+    }
+    return count;
+}
+
+__attribute__((target("avx2,fma")))
+uint32_t cullAvx2(const BoxesSoA& boxes, const Frustum& frustum, uint32_t begin, uint32_t end, uint32_t* out){
+    const __m256 signMask = _mm256_set1_ps(-0.f);
+    __m256 nx[Frustum::Count], ny[Frustum::Count], nz[Frustum::Count], nw[Frustum::Count];
+    __m256 ax[Frustum::Count], ay[Frustum::Count], az[Frustum::Count];
+    for (int p = 0; p < Frustum::Count; p++){
+        nx[p] = _mm256_set1_ps(frustum.planes[p].x);
+        ny[p] = _mm256_set1_ps(frustum.planes[p].y);
+        nz[p] = _mm256_set1_ps(frustum.planes[p].z);
+        nw[p] = _mm256_set1_ps(frustum.planes[p].w);
+        ax[p] = _mm256_andnot_ps(signMask, nx[p]);
+        ay[p] = _mm256_andnot_ps(signMask, ny[p]);
+        az[p] = _mm256_andnot_ps(signMask, nz[p]);
+    }
+
+    uint32_t count = 0;
+    for (uint32_t i = begin; i < end; i += SIMD_WIDTH){
+        __m256 cx = _mm256_loadu_ps(boxes.centerX + i);
+        __m256 cy = _mm256_loadu_ps(boxes.centerY + i);
+        __m256 cz = _mm256_loadu_ps(boxes.centerZ + i);
+        __m256 ex = _mm256_loadu_ps(boxes.extentX + i);
+        __m256 ey = _mm256_loadu_ps(boxes.extentY + i);
+        __m256 ez = _mm256_loadu_ps(boxes.extentZ + i);
+
+        __m256 outside = _mm256_setzero_ps();
+        for (int p = 0; p < Frustum::Count; p++){
+            __m256 distance = _mm256_fmadd_ps(nx[p], cx, _mm256_fmadd_ps(ny[p], cy, _mm256_fmadd_ps(nz[p], cz, nw[p])));
+            __m256 extended = _mm256_fmadd_ps(ax[p], ex, _mm256_fmadd_ps(ay[p], ey, _mm256_fmadd_ps(az[p], ez, distance)));
+            outside = _mm256_or_ps(outside, _mm256_cmp_ps(extended, _mm256_setzero_ps(), _CMP_LT_OQ));
+        }
+        uint32_t visibleMask = ~static_cast<uint32_t>(_mm256_movemask_ps(outside)) & 0xFFu;
+        count = appendVisible(visibleMask, i, out, count);
+    }
+    return count;
+}
+
+#endif
+
+CullKernel selectKernel(){
+#ifdef HYD_CULLING_X86
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+        return cullAvx2;
+    return cullSse;
+#else
+    return cullScalar;
+#endif
+}
+
+} // namespace
+
+FrustumCullingSystem::FrustumCullingSystem(ThreadPool& threadPool)
+: m_threadPool{threadPool}
+{}
+
+FrustumCullingSystem::~FrustumCullingSystem(){}
+
+void FrustumCullingSystem::resize(uint32_t count){
+    m_count = count;
+    const size_t padded = (static_cast<size_t>(count) + SIMD_WIDTH - 1) / SIMD_WIDTH * SIMD_WIDTH;
+    for (auto* component : {&m_centerX, &m_centerY, &m_centerZ}){
+        component->resize(padded);
+        std::fill(component->begin() + count, component->end(), 0.f);
+    }
+    for (auto* component : {&m_extentX, &m_extentY, &m_extentZ}){
+        component->resize(padded);
+        std::fill(component->begin() + count, component->end(), CULLED_EXTENT);
+    }
+}
+
+void FrustumCullingSystem::setBounds(uint32_t index, const AABB& aabb){
+    if (aabb.isEmpty()){
+        m_centerX[index] = m_centerY[index] = m_centerZ[index] = 0.f;
+        m_extentX[index] = m_extentY[index] = m_extentZ[index] = CULLED_EXTENT;
+        return;
+    }
+
+    glm::vec3 center = aabb.center();
+    glm::vec3 extent = aabb.extent();
+    m_centerX[index] = center.x;
+    m_centerY[index] = center.y;
+    m_centerZ[index] = center.z;
+    m_extentX[index] = extent.x;
+    m_extentY[index] = extent.y;
+    m_extentZ[index] = extent.z;
+}
+
+void FrustumCullingSystem::update(entt::registry& registry){
+    auto renderable_view = registry.view<TransformComponent, WorldTransformComponent, RenderableComponent>();
+
+    m_entities.clear();
+    for (auto entity : renderable_view){
+        auto& renderable = renderable_view.get<RenderableComponent>(entity);
+        // models still loading are skipped until their geometry is resident
+        if (renderable.material == nullptr || renderable.model == nullptr || !renderable.model->isResident())
+            continue;
+        m_entities.push_back(entity);
+    }
+
+    resize(static_cast<uint32_t>(m_entities.size()));
+
+    // each chunk only touches its own entities' transforms
+    m_threadPool.parallelFor(m_count, CHUNK_SIZE, [this, &renderable_view](uint32_t begin, uint32_t end){
+        for (uint32_t i = begin; i < end; i++){
+            auto& transform  = renderable_view.get<TransformComponent>(m_entities[i]);
+            auto& world      = renderable_view.get<WorldTransformComponent>(m_entities[i]);
+            auto& renderable = renderable_view.get<RenderableComponent>(m_entities[i]);
+            transform.updateWorldBounds(world, renderable.model->getAABB(), renderable.model->getBoundingSphere());
+            setBounds(i, transform.worldAABB);
+        }
+    });
+}
+
+void FrustumCullingSystem::cull(const Frustum& frustum, std::vector<uint32_t>& visible){
+    static const CullKernel kernel = selectKernel();
+
+    const uint32_t paddedCount = static_cast<uint32_t>(m_centerX.size());
+    const uint32_t chunkCount = (paddedCount + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    visible.resize(paddedCount);
+    m_chunkVisibleCounts.assign(chunkCount, 0);
+
+    const BoxesSoA boxes{
+        m_centerX.data(), m_centerY.data(), m_centerZ.data(),
+        m_extentX.data(), m_extentY.data(), m_extentZ.data()};
+
+    // every chunk compacts its survivors at its own offset
+    m_threadPool.parallelFor(paddedCount, CHUNK_SIZE, [this, &boxes, &frustum, &visible](uint32_t begin, uint32_t end){
+        m_chunkVisibleCounts[begin / CHUNK_SIZE] = kernel(boxes, frustum, begin, end, visible.data() + begin);
+    });
+
+    // close the gaps between the chunks, the destination never overlaps ahead of the source
+    uint32_t visibleCount = 0;
+    for (uint32_t chunk = 0; chunk < chunkCount; chunk++){
+        const uint32_t* first = visible.data() + chunk * CHUNK_SIZE;
+        if (first != visible.data() + visibleCount)
+            std::copy(first, first + m_chunkVisibleCounts[chunk], visible.data() + visibleCount);
+        visibleCount += m_chunkVisibleCounts[chunk];
+    }
+    visible.resize(visibleCount);
+}
+
+} // namespace hyd
@@ -0,0 +1,68 @@
+/*
+The frustum culling system keeps the world AABBs of the renderable entities in
+SoA form (center and half extent per axis) and tests them against the frustum
+planes with SSE or AVX2, 8 boxes per iteration, split across the thread pool.
+The result is a compact list of indices in the entity list of the frame.
+*/
+#pragma once
+
+#include "Core/ThreadPool.hpp"
+#include "Renderer/Bounds.hpp"
+#include "Renderer/Frustum.hpp"
+
+//libs
+#include <entt/entt.hpp>
+
+// std
+#include <cstdint>
+#include <vector>
+
+namespace hyd
+{
+
+class FrustumCullingSystem
+{
+public:
+    // boxes per task, multiple of the SIMD width
+    static constexpr uint32_t CHUNK_SIZE = 16384;
+
+    FrustumCullingSystem(ThreadPool& threadPool);
+    ~FrustumCullingSystem();
+
+    FrustumCullingSystem(const FrustumCullingSystem&) = delete;
+    FrustumCullingSystem &operator=(const FrustumCullingSystem&) = delete;
+
+    // gathers the renderable entities and refreshes their world bounds,
+    // to call once per frame after the transform system and before the instance batching
+    void update(entt::registry& registry);
+
+    // renderable entities of the frame, the culling results index this list
+    const std::vector<entt::entity>& getEntities() const { return m_entities; }
+
+    // direct access to the boxes, for the tools and benchmarks working without a registry
+    void resize(uint32_t count);
+    void setBounds(uint32_t index, const AABB& aabb);
+    uint32_t getCount() const { return m_count; }
+
+    // fills visible with the sorted indices of the boxes intersecting the frustum
+    void cull(const Frustum& frustum, std::vector<uint32_t>& visible);
+
+private:
+    /* data */
+    ThreadPool& m_threadPool;
+
+    std::vector<entt::entity> m_entities;
+    uint32_t m_count{0};
+
+    // SoA boxes, padded to a multiple of 8 with boxes that are always culled
+    std::vector<float> m_centerX;
+    std::vector<float> m_centerY;
+    std::vector<float> m_centerZ;
+    std::vector<float> m_extentX;
+    std::vector<float> m_extentY;
+    std::vector<float> m_extentZ;
+
+    std::vector<uint32_t> m_chunkVisibleCounts;
+};
+
+} // namespace hyd
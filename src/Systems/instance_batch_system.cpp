@@ -0,0 +1,287 @@
+#include "instance_batch_system.hpp"
+
+#include "Renderer/Utils.hpp"
+
+#include "Components/Renderable.hpp"
+
+// std
+#include <algorithm>
+#include <numeric>
+
+namespace hyd
+{
+
+static constexpr uint32_t INITIAL_INSTANCE_CAPACITY = 1024;
+
+size_t InstanceBatchSystem::BatchKeyHash::operator()(const BatchKey& key) const {
+    size_t seed = 0;
+    hashCombine(seed, key.model, key.material, key.lod, key.isStatic);
+    return seed;
+}
+
+InstanceBatchSystem::InstanceBatchSystem(Device& device)
+: m_device{device}
+{
+    for (int i = 0; i < m_instanceBuffers.size(); i++) {
+        m_instanceBuffers[i] = std::make_unique<Buffer>(
+            m_device,
+            sizeof(InstanceData),
+            INITIAL_INSTANCE_CAPACITY,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        m_instanceBuffers[i]->map();
+    }
+}
+
+InstanceBatchSystem::~InstanceBatchSystem(){}
+
+void InstanceBatchSystem::reserveInstances(int frameIndex, uint32_t instanceCount){
+    auto& buffer = m_instanceBuffers[frameIndex];
+    if (instanceCount <= buffer->getInstanceCount())
+        return;
+
+    // the previous submission using this frame index is finished, the buffer can be replaced
+    // (the culling system sees the new buffer, rewrites the frame's sets and bumps its draw version,
+    // which records the cached command buffers bound to the old sets again)
+    uint32_t capacity = std::max(instanceCount, buffer->getInstanceCount() * 2);
+    buffer = std::make_unique<Buffer>(
+        m_device,
+        sizeof(InstanceData),
+        capacity,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    buffer->map();
+    // none of the matrices were copied
+    m_writtenSlots[frameIndex].clear();
+}
+
+// the scale of the model in the world, from its local and world spheres
+static float worldScale(const Model& model, const BoundingSphere& worldSphere){
+    const float localRadius = model.getBoundingSphere().radius;
+    return localRadius > 0.0f ? worldSphere.radius / localRadius : 1.0f;
+}
+
+uint32_t InstanceBatchSystem::selectLod(const Model& model, float scale, float distance, const LodSelection& lodSelection){
+    if (model.getLodCount() <= 1 || lodSelection.pixelsPerUnit <= 0.0f)
+        return 0;
+    // the errors are in the model's space
+    if (distance <= 0.0f || scale <= 0.0f)
+        return 0;
+
+    // error * scale * pixelsPerUnit / distance pixels on screen
+    return model.selectLod(lodSelection.maxPixelError * distance / (lodSelection.pixelsPerUnit * scale));
+}
+
+bool InstanceBatchSystem::drawOrder(const DrawBatch& lhs, const DrawBatch& rhs){
+    if (lhs.material != rhs.material)
+        return std::less<Material*>{}(lhs.material, rhs.material);
+    if (lhs.model->getGeometryPage() != rhs.model->getGeometryPage())
+        return lhs.model->getGeometryPage() < rhs.model->getGeometryPage();
+    if (lhs.model != rhs.model)
+        return std::less<Model*>{}(lhs.model, rhs.model);
+    return lhs.lod < rhs.lod;
+}
+
+bool InstanceBatchSystem::staticSetChanged(const std::vector<entt::entity>& entities, entt::registry& registry) const {
+    if (m_staticInstancing != m_instancingEnabled)
+        return true;
+
+    auto renderable_view = registry.view<RenderableComponent>();
+    auto static_view = registry.view<StaticComponent>();
+    size_t count = 0;
+    for (auto entity : entities){
+        if (!static_view.contains(entity))
+            continue;
+        if (count == m_staticInstances.size())
+            return true;
+        const StaticInstance& instance = m_staticInstances[count++];
+        const auto& renderable = renderable_view.get<RenderableComponent>(entity);
+        if (instance.entity != entity || instance.model != renderable.model.get() || instance.material != renderable.material.get())
+            return true;
+    }
+    return count != m_staticInstances.size();
+}
+
+void InstanceBatchSystem::layoutStaticBatches(const std::vector<entt::entity>& entities, entt::registry& registry){
+    m_staticInstances.clear();
+    m_staticBatches.clear();
+    m_batchLookup.clear();
+    m_entityBatch.clear();
+
+    // bucket the static entities by model and material, every level of a model in the same batch
+    auto renderable_view = registry.view<TransformComponent, RenderableComponent>();
+    auto static_view = registry.view<StaticComponent>();
+    for (auto entity : entities){
+        if (!static_view.contains(entity))
+            continue;
+        auto& renderable = renderable_view.get<RenderableComponent>(entity);
+
+        BatchKey key{renderable.model.get(), renderable.material.get(), 0, true};
+        uint32_t batchIndex;
+        auto it = m_instancingEnabled ? m_batchLookup.find(key) : m_batchLookup.end();
+        if (it == m_batchLookup.end()){
+            batchIndex = static_cast<uint32_t>(m_staticBatches.size());
+            m_staticBatches.push_back({key.model, key.material, 0, 0, 0, true});
+            if (m_instancingEnabled)
+                m_batchLookup.emplace(key, batchIndex);
+        } else {
+            batchIndex = it->second;
+        }
+        m_staticBatches[batchIndex].instanceCount++;
+
+        m_entityBatch.push_back(batchIndex);
+        m_staticInstances.push_back({entity, key.model, key.material, 0});
+    }
+
+    std::vector<uint32_t> order(m_staticBatches.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b){
+        return drawOrder(m_staticBatches[a], m_staticBatches[b]);
+    });
+
+    m_batchCursor.assign(m_staticBatches.size(), 0);
+    m_batchRank.assign(m_staticBatches.size(), 0);
+    uint32_t firstInstance = 0;
+    for (uint32_t rank = 0; rank < order.size(); rank++){
+        uint32_t batchIndex = order[rank];
+        m_staticBatches[batchIndex].firstInstance = firstInstance;
+        m_batchCursor[batchIndex] = firstInstance;
+        m_batchRank[batchIndex] = rank;
+        firstInstance += m_staticBatches[batchIndex].instanceCount;
+    }
+    m_staticInstanceCount = firstInstance;
+
+    // the slots and the bounds of the static instances, they never move
+    m_instanceBatch.resize(m_staticInstanceCount);
+    m_staticBounds.assign(m_staticBatches.size(), StaticBounds{AABB{}, 0.f});
+    for (size_t i = 0; i < m_staticInstances.size(); i++){
+        StaticInstance& instance = m_staticInstances[i];
+        const uint32_t batchIndex = m_entityBatch[i];
+        instance.slot = m_batchCursor[batchIndex]++;
+        m_instanceBatch[instance.slot] = m_batchRank[batchIndex];
+
+        const BoundingSphere& sphere = renderable_view.get<TransformComponent>(instance.entity).worldBoundingSphere;
+        StaticBounds& bounds = m_staticBounds[m_batchRank[batchIndex]];
+        bounds.box.expand(sphere.center - glm::vec3(sphere.radius));
+        bounds.box.expand(sphere.center + glm::vec3(sphere.radius));
+        bounds.scale = std::max(bounds.scale, worldScale(*instance.model, sphere));
+    }
+
+    std::vector<DrawBatch> sorted;
+    sorted.reserve(m_staticBatches.size());
+    for (uint32_t batchIndex : order)
+        sorted.push_back(m_staticBatches[batchIndex]);
+    m_staticBatches = std::move(sorted);
+
+    m_staticInstancing = m_instancingEnabled;
+    m_staticVersion++;
+}
+
+void InstanceBatchSystem::update(int frameIndex, entt::registry& registry, const std::vector<entt::entity>& entities,
+    const LodSelection& lodSelection){
+    // 1. the static batches keep their layout while the static set doesn't change, only their LODs follow the camera
+    if (staticSetChanged(entities, registry))
+        layoutStaticBatches(entities, registry);
+
+    m_batches.assign(m_staticBatches.begin(), m_staticBatches.end());
+    for (size_t b = 0; b < m_batches.size(); b++){
+        // the finest level any instance needs, measured to the closest point of the batch
+        const AABB& box = m_staticBounds[b].box;
+        const glm::vec3 outside = glm::max(glm::max(box.min - lodSelection.cameraPosition, lodSelection.cameraPosition - box.max), glm::vec3{0.f});
+        m_batches[b].lod = selectLod(*m_batches[b].model, m_staticBounds[b].scale, glm::length(outside), lodSelection);
+    }
+    const uint32_t staticBatchCount = static_cast<uint32_t>(m_batches.size());
+
+    m_batchLookup.clear();
+    m_entityBatch.clear();
+
+    // 2. bucket the other entities by model, material and LOD
+    auto renderable_view = registry.view<TransformComponent, WorldTransformComponent, RenderableComponent>();
+    auto static_view = registry.view<StaticComponent>();
+    for(auto entity: entities) {
+        if (static_view.contains(entity))
+            continue;
+        auto &transform  = renderable_view.get<TransformComponent>(entity);
+        auto &renderable = renderable_view.get<RenderableComponent>(entity);
+
+        Model* model = renderable.model.get();
+        const BoundingSphere& sphere = transform.worldBoundingSphere;
+        const float distance = glm::length(sphere.center - lodSelection.cameraPosition) - sphere.radius;
+        BatchKey key{model, renderable.material.get(), selectLod(*model, worldScale(*model, sphere), distance, lodSelection), false};
+        uint32_t batchIndex;
+        auto it = m_instancingEnabled ? m_batchLookup.find(key) : m_batchLookup.end();
+        if (it == m_batchLookup.end()){
+            batchIndex = static_cast<uint32_t>(m_batches.size());
+            m_batches.push_back({key.model, key.material, key.lod, 0, 0, false});
+            if (m_instancingEnabled)
+                m_batchLookup.emplace(key, batchIndex);
+        } else {
+            batchIndex = it->second;
+        }
+        m_batches[batchIndex].instanceCount++;
+
+        m_entityBatch.push_back(batchIndex);
+    }
+
+    m_instanceCount = m_staticInstanceCount + static_cast<uint32_t>(m_entityBatch.size());
+
+    // 3. order the other batches and lay them out after the static ones
+    std::vector<uint32_t> order(m_batches.size() - staticBatchCount);
+    std::iota(order.begin(), order.end(), staticBatchCount);
+    std::sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b){
+        return drawOrder(m_batches[a], m_batches[b]);
+    });
+
+    m_batchCursor.assign(m_batches.size(), 0);
+    m_batchRank.assign(m_batches.size(), 0);
+    uint32_t firstInstance = m_staticInstanceCount;
+    for (uint32_t rank = 0; rank < order.size(); rank++){
+        uint32_t batchIndex = order[rank];
+        m_batches[batchIndex].firstInstance = firstInstance;
+        m_batchCursor[batchIndex] = firstInstance;
+        m_batchRank[batchIndex] = staticBatchCount + rank;
+        firstInstance += m_batches[batchIndex].instanceCount;
+    }
+
+    // 4. give the entities their slots, the static ones come from the layout, and copy the world matrices
+    // the frame's buffer doesn't hold yet, its previous submission is finished
+    reserveInstances(frameIndex, m_instanceCount);
+    auto* instances = static_cast<InstanceData*>(m_instanceBuffers[frameIndex]->getMappedMemory());
+    auto& writtenSlots = m_writtenSlots[frameIndex];
+    writtenSlots.resize(m_instanceCount);
+    m_entityInstanceSlot.resize(entities.size());
+    m_instanceBatch.resize(m_instanceCount);
+    m_instanceWorlds.resize(m_instanceCount);
+    size_t staticIndex = 0;
+    size_t dynamicIndex = 0;
+    for (size_t i = 0; i < entities.size(); i++){
+        const entt::entity entity = entities[i];
+        uint32_t slot;
+        if (static_view.contains(entity)){
+            slot = m_staticInstances[staticIndex++].slot;
+        } else {
+            const uint32_t batchIndex = m_entityBatch[dynamicIndex++];
+            slot = m_batchCursor[batchIndex]++;
+            m_instanceBatch[slot] = m_batchRank[batchIndex];
+        }
+        m_entityInstanceSlot[i] = slot;
+
+        const WorldTransformComponent& world = renderable_view.get<WorldTransformComponent>(entity);
+        m_instanceWorlds[slot] = &world;
+        // the buffer is coherent, only the slots holding another entity or older matrices are written
+        WrittenSlot& written = writtenSlots[slot];
+        if (written.entity != entity || written.version != world.version){
+            instances[slot] = {world.matrix, world.normalMatrix};
+            written = {entity, world.version};
+        }
+    }
+
+    // the static batches stay first
+    std::vector<DrawBatch> sorted(m_batches.begin(), m_batches.begin() + staticBatchCount);
+    sorted.reserve(m_batches.size());
+    for (uint32_t batchIndex : order)
+        sorted.push_back(m_batches[batchIndex]);
+    m_batches = std::move(sorted);
+}
+
+} // namespace hyd
@@ -0,0 +1,181 @@
+/*
+The instance batch system groups the renderable entities by (model, material)
+and writes their per-instance matrices in a per-frame storage buffer, so that
+each group can be drawn with a single instanced draw call.
+Each entity also picks the level of detail of its model whose error, projected
+on the screen from the camera, stays under a pixel budget; the entities of the
+same model at different levels go in different batches.
+The batches of the static entities come first, so their indices and instance
+ranges stay the same from one frame to the next while the static set doesn't
+change and the draws recorded for them can be reused. Their layout is only
+built again when a static entity, its model or its material changes; a static
+batch is not split by LOD but takes the finest level any of its instances
+needs, chosen from the bounds of the batch, and the level only reaches the
+indirect commands and the clusters, never the recorded draws.
+The instance buffers of the frames keep their matrices from one use to the
+next: a slot is only written again, from the world matrices cached by the
+transform system, when it holds another entity or an older world version than
+the current one, so the static and the still slots are left untouched.
+*/
+#pragma once
+
+#include "Renderer/Device.hpp"
+#include "Renderer/Buffer.hpp"
+#include "Renderer/SwapChain.hpp"
+#include "Renderer/Model.hpp"
+#include "Renderer/Material.hpp"
+#include "Renderer/Bounds.hpp"
+#include "Components/Transform.hpp"
+#include "transform_kernel.hpp"
+
+//libs
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+#include <entt/entt.hpp>
+
+// std
+#include <memory>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace hyd
+{
+
+// a range of the instance buffer drawn with the same model, LOD and material
+struct DrawBatch
+{
+    Model* model{nullptr};
+    Material* material{nullptr};
+    uint32_t lod{0};
+    uint32_t firstInstance{0};
+    uint32_t instanceCount{0};
+    bool isStatic{false};
+};
+
+// what the LOD selection needs from the camera
+struct LodSelection
+{
+    glm::vec3 cameraPosition{0.f};
+    // pixels covered by a unit at distance 1, |projection[1][1]| * height / 2, 0 keeps the full meshes
+    float pixelsPerUnit{0.f};
+    // the largest simplification error allowed on screen
+    float maxPixelError{1.f};
+};
+
+class InstanceBatchSystem
+{
+public:
+    InstanceBatchSystem(Device& device);
+    ~InstanceBatchSystem();
+
+    InstanceBatchSystem(const InstanceBatchSystem&) = delete;
+    InstanceBatchSystem &operator=(const InstanceBatchSystem&) = delete;
+
+    // must be called once the frame is started (the frame's buffer is no longer in use),
+    // entities are the renderables gathered by the frustum culling system
+    void update(int frameIndex, entt::registry& registry, const std::vector<entt::entity>& entities,
+        const LodSelection& lodSelection = {});
+
+    const std::vector<DrawBatch>& getBatches() const { return m_batches; }
+    // the static batches are the first ones, and their instances the first slots
+    uint32_t getStaticBatchCount() const { return static_cast<uint32_t>(m_staticBatches.size()); }
+    uint32_t getStaticInstanceCount() const { return m_staticInstanceCount; }
+    // changes whenever the static batches are laid out again, their LODs excepted
+    uint64_t getStaticVersion() const { return m_staticVersion; }
+    uint32_t getInstanceCount() const { return m_instanceCount; }
+
+    // world matrix of an instance slot, read from the entity's WorldTransformComponent, the storage buffer is never read back
+    const glm::mat4& getInstanceMatrix(uint32_t slot) const { return m_instanceWorlds[slot]->matrix; }
+    Buffer& getInstanceBuffer(int frameIndex) const { return *m_instanceBuffers[frameIndex]; }
+
+    // instance slot of each entity of the update's list, and batch of each instance slot
+    const std::vector<uint32_t>& getEntityInstances() const { return m_entityInstanceSlot; }
+    const std::vector<uint32_t>& getInstanceBatches() const { return m_instanceBatch; }
+
+    // when disabled every entity gets its own batch (one draw per entity)
+    void setInstancingEnabled(bool enabled) { m_instancingEnabled = enabled; }
+    bool isInstancingEnabled() const { return m_instancingEnabled; }
+
+private:
+    struct BatchKey
+    {
+        Model* model;
+        Material* material;
+        uint32_t lod;
+        bool isStatic;
+
+        bool operator==(const BatchKey& other) const {
+            return model == other.model && material == other.material && lod == other.lod && isStatic == other.isStatic;
+        }
+    };
+
+    struct BatchKeyHash
+    {
+        size_t operator()(const BatchKey& key) const;
+    };
+
+    // a static entity of the current layout, in the order of the entity list
+    struct StaticInstance
+    {
+        entt::entity entity;
+        Model* model;
+        Material* material;
+        uint32_t slot;
+    };
+
+    // world box of the instances of a static batch and their largest scale, for its LOD
+    struct StaticBounds
+    {
+        AABB box;
+        float scale{1.f};
+    };
+
+    void reserveInstances(int frameIndex, uint32_t instanceCount);
+    // true when the static entities of the list are not the ones of the current layout
+    bool staticSetChanged(const std::vector<entt::entity>& entities, entt::registry& registry) const;
+    void layoutStaticBatches(const std::vector<entt::entity>& entities, entt::registry& registry);
+    // batches first sorted by material, geometry page, model then LOD to limit the binds
+    static bool drawOrder(const DrawBatch& lhs, const DrawBatch& rhs);
+    // scale of the model in the world, distance from the camera to the closest point of the instances
+    static uint32_t selectLod(const Model& model, float scale, float distance, const LodSelection& lodSelection);
+
+    /* data */
+    Device& m_device;
+
+    std::vector<std::unique_ptr<Buffer>> m_instanceBuffers = std::vector<std::unique_ptr<Buffer>>(SwapChain::MAX_FRAMES_IN_FLIGHT);
+
+    std::vector<DrawBatch> m_batches;
+    // entity and world version whose matrices a slot of a frame's buffer holds
+    struct WrittenSlot
+    {
+        entt::entity entity{entt::null};
+        uint64_t version{0};
+    };
+
+    // world transform of the entity of each instance slot, valid until the registry changes
+    std::vector<const WorldTransformComponent*> m_instanceWorlds;
+    // the slots of each frame's buffer, reset when the buffer is replaced
+    std::vector<std::vector<WrittenSlot>> m_writtenSlots = std::vector<std::vector<WrittenSlot>>(SwapChain::MAX_FRAMES_IN_FLIGHT);
+    std::vector<uint32_t> m_entityInstanceSlot;
+    std::vector<uint32_t> m_instanceBatch;
+    uint32_t m_instanceCount{0};
+    bool m_instancingEnabled{true};
+
+    // layout of the static batches, kept while the static set doesn't change
+    std::vector<StaticInstance> m_staticInstances;
+    std::vector<DrawBatch> m_staticBatches;
+    std::vector<StaticBounds> m_staticBounds;
+    uint32_t m_staticInstanceCount{0};
+    uint64_t m_staticVersion{0};
+    bool m_staticInstancing{true};
+
+    // scratch memory kept between frames to avoid reallocations
+    std::unordered_map<BatchKey, uint32_t, BatchKeyHash> m_batchLookup;
+    std::vector<uint32_t> m_entityBatch;
+    std::vector<uint32_t> m_batchCursor;
+    std::vector<uint32_t> m_batchRank;
+};
+
+} // namespace hyd
@@ -4,6 +4,8 @@
 
 #include "Renderer/Buffer.hpp"
 #include "Renderer/Texture.hpp"
+#include "Renderer/UploadContext.hpp"
+#include "Renderer/GlobalUbo.hpp"
 
 #include "Components/Transform.hpp"
 #include "Components/Camera.hpp"
@@ -15,78 +17,55 @@
 #include <glm/gtc/constants.hpp> // two_pi
 #include <glm/gtx/quaternion.hpp>
 
+// std
+#include <algorithm>
+#include <cmath>
+
 namespace hyd
 {
 
-struct GlobalUbo
+namespace
 {
-    glm::mat4 projection{1.f};
-    glm::mat4 view{1.f};
-
-    glm::mat4 lightMVP{1.f};
-    glm::vec3 directionalLight{1.f, 1.f, -2.f};
-    alignas(16) glm::vec4 ambiantLightColor{1.f, 1.f, 0.5f, 0.1f}; // w is light intensity
-    
-    glm::vec3 lightPosition{0.f, 0.f, 0.f};
-    alignas(16) glm::vec4 lightColor{1.f}; // w is light intensity
-};
-
+    // a secondary command buffer rebinds the pipeline and the sets, smaller chunks cost more than they share
+    constexpr uint32_t MIN_BATCHES_PER_CHUNK = 16;
+}
 
-RenderSystem::RenderSystem(Device& device, Renderer& renderer)
-: m_device{device}, m_renderer{renderer}
+RenderSystem::RenderSystem(Device& device, Renderer& renderer, ThreadPool& threadPool, GeometryPool& geometryPool)
+: m_device{device}, m_renderer{renderer}, m_threadPool{threadPool}
 {
-    // global descriptor pool
-    globalPool =
-    DescriptorPool::Builder(m_device)
-        .setMaxSets(SwapChain::MAX_FRAMES_IN_FLIGHT)
-        .addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, SwapChain::MAX_FRAMES_IN_FLIGHT)
-        .build();
-
-
-    // global descriptor set layout
-    auto globalSetLayout =
-        DescriptorSetLayout::Builder(m_device)
-            .addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT)
-            .build();
-
-    // create buffers
-    for (int i = 0; i < m_uboBuffers.size(); i++) {
-        m_uboBuffers[i] = std::make_unique<Buffer>(
-            m_device,
-            sizeof(GlobalUbo),
-            1,
-            VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
-        m_uboBuffers[i]->map();
-    }
+    // transient uniform data of the frames, every pass reads its GlobalUbo at set 0 through a dynamic offset
+    m_frameData = std::make_unique<FrameData>(m_device, sizeof(GlobalUbo));
 
-    // write descriptors with buffers
-    for (int i = 0; i < m_globalDescriptorSets.size(); i++) {
-        auto bufferInfo = m_uboBuffers[i]->descriptorInfo();
-        DescriptorWriter(*globalSetLayout, *globalPool)
-            .writeBuffer(0, &bufferInfo)
-            .build(m_globalDescriptorSets[i]);
-    }
+    // per-instance data shared by the shadow and the object passes
+    m_frustumCullingSystem = std::make_unique<FrustumCullingSystem>(threadPool);
+    m_instanceBatchSystem = std::make_unique<InstanceBatchSystem>(m_device);
+    m_cullingSystem = std::make_unique<CullingSystem>(m_device);
+
+    // one pool per worker and one for the calling thread, which records its share of the jobs
+    m_commandRecorder = std::make_unique<CommandRecorder>(m_device, threadPool.getThreadCount() + 1);
 
     // SUB RENDER SYSTEMS
     m_pointLightRenderSystem = std::make_unique<PointLightRenderSystem>(
         m_device,
         m_renderer.getSwapChainRenderPass(),
-        globalSetLayout->getDescriptorSetLayout());
+        m_frameData->getSetLayout());
 
     m_skyboxRenderSystem = std::make_unique<SkyboxRenderSystem>(
         m_device,
+        geometryPool,
         m_renderer.getSwapChainRenderPass(),
-        globalSetLayout->getDescriptorSetLayout());
+        m_frameData->getSetLayout());
         
     m_shadow_mapping_system = std::make_unique<shadowMappingSystem>(
     m_device,
-    globalSetLayout->getDescriptorSetLayout());
+    *m_frameData,
+    m_cullingSystem->getDrawSetLayout());
 
     m_objectRenderSystem = std::make_unique<ObjectRenderSystem>(
         m_device,
+        *m_frameData,
         m_renderer.getSwapChainRenderPass(),
-        globalSetLayout->getDescriptorSetLayout(),
+        m_cullingSystem->getDrawSetLayout(),
         m_shadow_mapping_system->getImage());
         
     m_imageViewer = std::make_unique<ImageViewer>(
@@ -103,6 +82,7 @@ void RenderSystem::renderEntities(const float frameTime, entt::registry& registr
 {
 
     GlobalUbo ubo{};
+    LodSelection lodSelection{};
     // get camera
     auto camera_view = registry.view<CameraComponent>();
 
@@ -113,61 +93,165 @@ void RenderSystem::renderEntities(const float frameTime, entt::registry& registr
 
         ubo.projection = camera.getProjection();
         ubo.view = camera.getView();
-    }
 
+        // the LODs are chosen for the swap chain's height
+        lodSelection.cameraPosition = glm::vec3(glm::inverse(ubo.view)[3]);
+        lodSelection.pixelsPerUnit = std::abs(ubo.projection[1][1]) * 0.5f * static_cast<float>(m_renderer.getSwapChainExtent().height);
+    }
 
+    // gather the renderables and refresh their world bounds, no GPU resource involved
+    m_frustumCullingSystem->update(registry);
 
+    // uploads recorded since the last frame, ordered before the frame on the graphics queue
+    m_device.uploadContext().submit();
 
     if (auto commandBuffer = m_renderer.beginFrame()){
         int frameIndex = m_renderer.getFrameIndex();
 
+        // the ring of the frame is free again, its previous submission has completed
+        m_frameData->beginFrame(frameIndex);
+
         FrameInfo frameInfo{
             frameIndex,
             frameTime,
             commandBuffer,
-            m_globalDescriptorSets[frameIndex]};
+            m_frameData->getDescriptorSet(frameIndex)};
 
+        // group the renderables and upload their instance matrices
+        m_instanceBatchSystem->update(frameIndex, registry, m_frustumCullingSystem->getEntities(), lodSelection);
 
+        // cull the instances for the camera and the light, before any render pass
+        m_cullingSystem->cull(frameInfo, *m_instanceBatchSystem, *m_frustumCullingSystem, {ubo.projection * ubo.view, m_shadow_mapping_system->getdepthMVP()});
 
-        // update
+        // light and camera data of the passes, written before the recording threads start
+        m_shadow_mapping_system->update(*m_instanceBatchSystem);
         ubo.lightMVP = m_shadow_mapping_system->getdepthMVP();
-        m_uboBuffers[frameIndex]->writeToBuffer(&ubo);
-        m_uboBuffers[frameIndex]->flush();
+        frameInfo.globalUboOffset = m_frameData->push(ubo);
 
         // RENDER
+        // the shadow and the main pass are recorded together, in secondary command buffers on the worker threads
+        // the static batches are drawn by cached command buffers when the draws read the culling from the GPU
+        const uint32_t batchCount = static_cast<uint32_t>(m_instanceBatchSystem->getBatches().size());
+        const uint32_t staticBatchCount = m_cullingSystem->hasReusableDraws() ? m_instanceBatchSystem->getStaticBatchCount() : 0;
+        updateStaticVersion(staticBatchCount, {m_shadow_mapping_system->getUboOffset(), frameInfo.globalUboOffset});
+
+        m_recordJobs.clear();
+        addBatchJobs(RecordJob::Kind::StaticShadowBatches, frameIndex, 0, staticBatchCount);
+        addBatchJobs(RecordJob::Kind::ShadowBatches, frameIndex, staticBatchCount, batchCount);
+        m_shadowJobCount = static_cast<uint32_t>(m_recordJobs.size());
+        m_recordJobs.push_back({RecordJob::Kind::Skybox});
+        addBatchJobs(RecordJob::Kind::StaticSceneBatches, frameIndex, 0, staticBatchCount);
+        addBatchJobs(RecordJob::Kind::SceneBatches, frameIndex, staticBatchCount, batchCount);
+        m_recordJobs.push_back({RecordJob::Kind::PointLights});
+
+        m_commandRecorder->beginFrame(frameIndex);
+        m_recordedJobs.resize(m_recordJobs.size());
+        m_threadPool.parallelFor(static_cast<uint32_t>(m_recordJobs.size()), 1, [&](uint32_t begin, uint32_t end){
+            for (uint32_t i = begin; i < end; i++)
+                m_recordedJobs[i] = recordJob(m_recordJobs[i], frameInfo);
+        });
+
         // shadow pass
-        // m_renderer.beginSwapChainRenderPass(commandBuffer); // check if thoses would work
-        m_shadow_mapping_system->beginSwapChainRenderPass(commandBuffer);
-            m_shadow_mapping_system->renderEntities(frameInfo, registry);
-        // m_renderer.endSwapChainRenderPass(commandBuffer);
+        m_shadow_mapping_system->beginSwapChainRenderPass(commandBuffer, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+        if (m_shadowJobCount > 0)
+            vkCmdExecuteCommands(commandBuffer, m_shadowJobCount, m_recordedJobs.data());
         m_shadow_mapping_system->endSwapChainRenderPass(commandBuffer);
 
         // render
-        m_renderer.beginSwapChainRenderPass(commandBuffer);        
-            m_skyboxRenderSystem->render(frameInfo);
-            m_objectRenderSystem->renderEntities(frameInfo, registry, m_shadow_mapping_system->getdepthMVP(), m_shadow_mapping_system->getImage(), m_renderer.getAspectRatio());
-            m_pointLightRenderSystem->renderPointLightEntities(frameInfo);
-
-
-            VkExtent2D extent2d{400, 400};
-            VkViewport viewport{};
-            viewport.x = 0.0f;
-            viewport.y = 0.0f;
-            viewport.width = static_cast<float>(extent2d.width);
-            viewport.height = static_cast<float>(extent2d.height);
-            viewport.minDepth = 0.0f;
-            viewport.maxDepth = 1.0f;
-            VkRect2D scissor{{0, 0}, extent2d};
-            vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
-            vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+        m_renderer.beginSwapChainRenderPass(commandBuffer, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+            vkCmdExecuteCommands(
+                commandBuffer,
+                static_cast<uint32_t>(m_recordedJobs.size()) - m_shadowJobCount,
+                m_recordedJobs.data() + m_shadowJobCount);
             // m_imageViewer->renderImage(frameInfo, m_shadow_mapping_system->getImage());
-
         m_renderer.endSwapChainRenderPass(commandBuffer);
 
-        
         m_renderer.endFrame();
     }
 
 }
 
+void RenderSystem::addBatchJobs(RecordJob::Kind kind, int frameIndex, uint32_t firstBatch, uint32_t endBatch){
+    const uint32_t batchCount = endBatch - firstBatch;
+    const uint32_t threadCount = m_threadPool.getThreadCount() + 1;
+    const uint32_t chunkSize = std::max(MIN_BATCHES_PER_CHUNK, (batchCount + threadCount - 1) / threadCount);
+
+    const bool isStatic = kind == RecordJob::Kind::StaticShadowBatches || kind == RecordJob::Kind::StaticSceneBatches;
+    auto& cache = m_staticCommands[frameIndex][kind == RecordJob::Kind::StaticShadowBatches ? 0 : 1];
+    uint32_t cacheSlot = 0;
+    for (uint32_t first = firstBatch; first < endBatch; first += chunkSize){
+        if (isStatic && cacheSlot == cache.size())
+            cache.push_back(std::make_unique<CachedCommandBuffer>(m_device));
+        m_recordJobs.push_back({kind, first, std::min(first + chunkSize, endBatch), isStatic ? cacheSlot++ : 0});
+    }
+}
+
+void RenderSystem::updateStaticVersion(uint32_t staticBatchCount, const std::array<uint32_t, 2>& uboOffsets){
+    const auto& batches = m_instanceBatchSystem->getBatches();
+    // the dynamic offsets of the ubos are recorded in the cached draws
+    bool changed = m_instanceBatchSystem->getStaticVersion() != m_recordedLayoutVersion ||
+        m_cullingSystem->getDrawVersion() != m_recordedDrawVersion ||
+        m_renderer.getSwapChainVersion() != m_recordedSwapChainVersion ||
+        staticBatchCount != m_recordedMaterialDescriptors.size() ||
+        uboOffsets != m_recordedUboOffsets;
+    // a loaded texture gives its material a new descriptor set
+    for (uint32_t i = 0; i < staticBatchCount && !changed; i++)
+        changed = batches[i].material->m_descriptor != m_recordedMaterialDescriptors[i];
+    if (!changed)
+        return;
+
+    // every frame's cached draws are recorded again on their next use
+    m_staticVersion++;
+    m_recordedLayoutVersion = m_instanceBatchSystem->getStaticVersion();
+    m_recordedDrawVersion = m_cullingSystem->getDrawVersion();
+    m_recordedSwapChainVersion = m_renderer.getSwapChainVersion();
+    m_recordedUboOffsets = uboOffsets;
+    m_recordedMaterialDescriptors.clear();
+    for (uint32_t i = 0; i < staticBatchCount; i++)
+        m_recordedMaterialDescriptors.push_back(batches[i].material->m_descriptor);
+}
+
+VkCommandBuffer RenderSystem::recordJob(const RecordJob& job, const FrameInfo& frameInfo){
+    const bool shadowPass = job.kind == RecordJob::Kind::StaticShadowBatches || job.kind == RecordJob::Kind::ShadowBatches;
+    const bool isStatic = job.kind == RecordJob::Kind::StaticShadowBatches || job.kind == RecordJob::Kind::StaticSceneBatches;
+    const VkRenderPass renderPass = shadowPass ? m_shadow_mapping_system->getRenderPass() : m_renderer.getSwapChainRenderPass();
+    const VkExtent2D extent = shadowPass ? m_shadow_mapping_system->getExtent() : m_renderer.getSwapChainExtent();
+
+    // same frame, recorded in a secondary command buffer of the calling thread or in the cache of the static draws
+    FrameInfo jobInfo = frameInfo;
+    CachedCommandBuffer* cached{nullptr};
+    if (isStatic){
+        cached = m_staticCommands[frameInfo.FrameIndex][shadowPass ? 0 : 1][job.cacheSlot].get();
+        if (cached->isRecorded(m_staticVersion))
+            return cached->getCommandBuffer();
+        jobInfo.commandBuffer = cached->begin(renderPass, extent);
+    } else {
+        VkFramebuffer framebuffer = shadowPass ? m_shadow_mapping_system->getFrameBuffer() : m_renderer.getCurrentFrameBuffer();
+        jobInfo.commandBuffer = m_commandRecorder->begin(renderPass, framebuffer, extent);
+    }
+
+    switch (job.kind){
+        case RecordJob::Kind::StaticShadowBatches:
+        case RecordJob::Kind::ShadowBatches:
+            m_shadow_mapping_system->renderEntities(jobInfo, *m_instanceBatchSystem, *m_cullingSystem, job.firstBatch, job.endBatch);
+            break;
+        case RecordJob::Kind::Skybox:
+            m_skyboxRenderSystem->render(jobInfo);
+            break;
+        case RecordJob::Kind::StaticSceneBatches:
+        case RecordJob::Kind::SceneBatches:
+            m_objectRenderSystem->renderEntities(jobInfo, *m_instanceBatchSystem, *m_cullingSystem, job.firstBatch, job.endBatch);
+            break;
+        case RecordJob::Kind::PointLights:
+            m_pointLightRenderSystem->renderPointLightEntities(jobInfo);
+            break;
+    }
+
+    if (cached != nullptr)
+        cached->end(m_staticVersion);
+    else
+        m_commandRecorder->end(jobInfo.commandBuffer);
+    return jobInfo.commandBuffer;
+}
+
 } // namespace hyd
@@ -1,41 +1,96 @@
 #pragma once
 
 #include "Core/Window.hpp"
+#include "Core/ThreadPool.hpp"
 
 #include "Renderer/Renderer.hpp"
 #include "Renderer/DescriptorSet.hpp"
+#include "Renderer/CommandRecorder.hpp"
+#include "Renderer/FrameData.hpp"
+#include "Renderer/GeometryPool.hpp"
 
 #include "sub_render_systems/point_light_render_system.hpp"
 #include "sub_render_systems/object_render_system.hpp"
 #include "sub_render_systems/skybox_render_system.hpp"
 #include "sub_render_systems/shadowMappingSystem.hpp"
 #include "sub_render_systems/imageViewer.hpp"
+#include "instance_batch_system.hpp"
+#include "frustum_culling_system.hpp"
+#include "culling_system.hpp"
 
 // libs
 #include <entt/entt.hpp>
 
 // std
+#include <array>
+#include <cstdint>
 #include <memory>
+#include <vector>
 
 namespace hyd
 {
     class RenderSystem
     {
     public:
-        RenderSystem(Device& device, Renderer& renderer);
+        RenderSystem(Device& device, Renderer& renderer, ThreadPool& threadPool, GeometryPool& geometryPool);
         ~RenderSystem();
     
         RenderSystem (const RenderSystem&) = delete;
         RenderSystem& operator=(const RenderSystem&) = delete;
 
         void renderEntities(float frameTime, entt::registry& registry);
+
     private:
+        // a part of the frame recorded in a secondary command buffer, the jobs of both passes are recorded together
+        struct RecordJob
+        {
+            enum class Kind : uint8_t { StaticShadowBatches, ShadowBatches, Skybox, StaticSceneBatches, SceneBatches, PointLights };
+            Kind kind;
+            uint32_t firstBatch{0};
+            uint32_t endBatch{0};
+            // cached command buffer of the static jobs, in the frame's list of the pass
+            uint32_t cacheSlot{0};
+        };
+
+        // splits the batches [firstBatch, endBatch) of a pass in about one chunk per thread
+        void addBatchJobs(RecordJob::Kind kind, int frameIndex, uint32_t firstBatch, uint32_t endBatch);
+        VkCommandBuffer recordJob(const RecordJob& job, const FrameInfo& frameInfo);
+        // changes the static version when the cached draws no longer match the static batches or their resources
+        // the batches are built from every resident renderable, before the culling, so the visibility never changes
+        // them, and their LODs only reach the indirect data: the draws are recorded again when the static set,
+        // the swap chain, the culling buffers or a material descriptor change
+        void updateStaticVersion(uint32_t staticBatchCount, const std::array<uint32_t, 2>& uboOffsets);
+
         /* data */
         Device& m_device;
         Renderer& m_renderer;
+        ThreadPool& m_threadPool;
+
+        // per-thread command pools of the secondary command buffers
+        std::unique_ptr<CommandRecorder> m_commandRecorder;
+        // the shadow jobs come first, then the main pass ones in drawing order
+        std::vector<RecordJob> m_recordJobs;
+        std::vector<VkCommandBuffer> m_recordedJobs;
+        uint32_t m_shadowJobCount{0};
+
+        // draws of the static batches per frame in flight, for the shadow then the main pass, one per chunk
+        std::vector<std::array<std::vector<std::unique_ptr<CachedCommandBuffer>>, 2>> m_staticCommands =
+            std::vector<std::array<std::vector<std::unique_ptr<CachedCommandBuffer>>, 2>>(SwapChain::MAX_FRAMES_IN_FLIGHT);
+        // material descriptor of each static batch when they were recorded
+        std::vector<VkDescriptorSet> m_recordedMaterialDescriptors;
+        uint64_t m_recordedLayoutVersion{0};
+        uint64_t m_recordedDrawVersion{0};
+        uint32_t m_recordedSwapChainVersion{0};
+        // shadow then camera ubo offsets
+        std::array<uint32_t, 2> m_recordedUboOffsets{};
+        uint64_t m_staticVersion{1};
+
+        // per-frame rings of the uniform data shared by all renderers
+        std::unique_ptr<FrameData> m_frameData;
 
-        // global pool, for objects shared by all renderers
-        std::unique_ptr<DescriptorPool> globalPool{};
+        std::unique_ptr<FrustumCullingSystem> m_frustumCullingSystem;
+        std::unique_ptr<InstanceBatchSystem> m_instanceBatchSystem;
+        std::unique_ptr<CullingSystem> m_cullingSystem;
 
         //subrenderSystems
         std::unique_ptr<SkyboxRenderSystem> m_skyboxRenderSystem;
@@ -45,8 +100,6 @@ namespace hyd
         std::unique_ptr<ImageViewer> m_imageViewer;
         
 
-        std::vector<VkDescriptorSet> m_globalDescriptorSets = std::vector<VkDescriptorSet>(SwapChain::MAX_FRAMES_IN_FLIGHT);
-        std::vector<std::unique_ptr<Buffer>> m_uboBuffers = std::vector<std::unique_ptr<Buffer>>(SwapChain::MAX_FRAMES_IN_FLIGHT);
     
         VkSampler m_sampler;
     };
@@ -18,31 +18,13 @@
 namespace hyd
 {
 
-struct GlobalUbo
-{
-    glm::mat4 projection{1.f};
-    glm::mat4 view{1.f};
-
-    glm::mat4 lightMVP{1.f};
-    glm::vec3 directionalLight{1.f, 1.f, -2.f};
-    alignas(16) glm::vec4 ambiantLightColor{1.f, 1.f, 0.5f, 0.1f}; // w is light intensity
-    
-    glm::vec3 lightPosition{0.f, 0.f, 0.f};
-    alignas(16) glm::vec4 lightColor{1.f}; // w is light intensity
-};
-struct SimplePushConstantData {
-    glm::mat4 modelMatrix{1.f}; // projection * view * model
-    glm::mat4 normalMatrix{1.f};
-};
-
-
-ObjectRenderSystem::ObjectRenderSystem(Device& device, VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout, VkImageView imageView):
+ObjectRenderSystem::ObjectRenderSystem(Device& device, FrameData& frameData, VkRenderPass renderPass, VkDescriptorSetLayout drawSetLayout, VkImageView imageView):
 m_device{device}{
 
     m_globalPool =
     DescriptorPool::Builder(m_device)
         .setMaxSets(SwapChain::MAX_FRAMES_IN_FLIGHT)
-        .addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, SwapChain::MAX_FRAMES_IN_FLIGHT)
+        .addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, SwapChain::MAX_FRAMES_IN_FLIGHT)
         .addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, SwapChain::MAX_FRAMES_IN_FLIGHT)
         .build();
 
@@ -59,25 +41,14 @@ m_device{device}{
             .addBinding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT)
             .build();
 
-    // global descriptor set layout
+    // global descriptor set layout, the GlobalUbo is bound at the offset of the frame
     m_globalSetLayout =
         DescriptorSetLayout::Builder(m_device)
-            .addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT)
+            .addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT)
             .addBinding(1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT)
             .build();
 
 
-    // create buffers
-    for (int i = 0; i < m_uboBuffers.size(); i++) {
-        m_uboBuffers[i] = std::make_unique<Buffer>(
-            m_device,
-            sizeof(GlobalUbo),
-            1,
-            VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
-        m_uboBuffers[i]->map();
-    }
-
     for (int i = 0; i < m_sampler.size(); i++)
     {
         // Create sampler to sample from to depth attachment
@@ -111,9 +82,9 @@ m_device{device}{
     }
     
 
-    // write descriptors with buffers
+    // write descriptors with the frame data rings
     for (int i = 0; i < m_globalDescriptorSets.size(); i++) {
-        auto bufferInfo = m_uboBuffers[i]->descriptorInfo();
+        auto bufferInfo = frameData.descriptorInfo(i);
         auto descriptorImageInfo = m_descriptorImageInfo[i];
         DescriptorWriter(*m_globalSetLayout, *m_globalPool)
             .writeBuffer(0, &bufferInfo)
@@ -121,7 +92,7 @@ m_device{device}{
             .build(m_globalDescriptorSets[i]);
     }
 
-    createPipelineLayout(globalSetLayout, m_materialSetLayout->getDescriptorSetLayout());
+    createPipelineLayout(m_materialSetLayout->getDescriptorSetLayout(), drawSetLayout);
     createPipeline(renderPass);
 }
 
@@ -131,19 +102,15 @@ ObjectRenderSystem::~ObjectRenderSystem(){
     vkDestroyPipelineLayout(m_device.device(), m_pipelineLayout, nullptr);
 }
 
-void ObjectRenderSystem::createPipelineLayout(VkDescriptorSetLayout globalSetLayout, VkDescriptorSetLayout objectSetLayout) {
+void ObjectRenderSystem::createPipelineLayout(VkDescriptorSetLayout objectSetLayout, VkDescriptorSetLayout drawSetLayout) {
 
-    VkPushConstantRange pushConstantRange{};
-    pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
-    pushConstantRange.offset = 0;
-    pushConstantRange.size = sizeof(SimplePushConstantData);
-
-  std::vector<VkDescriptorSetLayout> descriptorSetLayouts{m_globalSetLayout->getDescriptorSetLayout(), objectSetLayout};
+  std::vector<VkDescriptorSetLayout> descriptorSetLayouts{m_globalSetLayout->getDescriptorSetLayout(), objectSetLayout, drawSetLayout};
 
     VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
     pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
     pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size());
     pipelineLayoutInfo.pSetLayouts = descriptorSetLayouts.data();
+    VkPushConstantRange pushConstantRange = Model::getPositionDecodeRange();
     pipelineLayoutInfo.pushConstantRangeCount = 1;
     pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
 
@@ -170,35 +137,15 @@ void ObjectRenderSystem::createPipeline(VkRenderPass renderPass){
 
 void ObjectRenderSystem::renderEntities(
      FrameInfo& frameInfo,
-     entt::registry& registry,
-     const glm::mat4& lightDepthMVP,
-     VkImageView imageView,
-     float aspectRatio){
-
-    GlobalUbo ubo{};
-    // get camera
-    auto camera_view = registry.view<CameraComponent>();
-
-    for(auto entity: camera_view) {
-        auto& camera = camera_view.get<CameraComponent>(entity).camera;
-        float aspect = aspectRatio;
-        camera.setPerspectiveProjection(glm::radians(50.f), aspect, 0.1f, 100.f);
-
-        ubo.projection = camera.getProjection();
-        ubo.view = camera.getView();
-    }
-
-
+     const InstanceBatchSystem& instanceBatches,
+     CullingSystem& cullingSystem,
+     uint32_t firstBatch,
+     uint32_t endBatch){
 
     // bind pipline
     m_pipeline->bind(frameInfo.commandBuffer);
 
-
     // bind global descriptor set - at set #0
-    ubo.lightMVP = lightDepthMVP;
-    m_uboBuffers[frameInfo.FrameIndex]->writeToBuffer(&ubo);
-    m_uboBuffers[frameInfo.FrameIndex]->flush();
-
     vkCmdBindDescriptorSets(
             frameInfo.commandBuffer,
             VK_PIPELINE_BIND_POINT_GRAPHICS,
@@ -206,51 +153,45 @@ void ObjectRenderSystem::renderEntities(
             0,
             1,
             &m_globalDescriptorSets[frameInfo.FrameIndex],
-            0,
-            nullptr);
-
-    auto renderable_view = registry.view<TransformComponent, RenderableComponent>();
-    
-    static int material_index{0};
-    // for each object/Materials
-    for(auto entity: renderable_view) {
-        auto &transform  = renderable_view.get<TransformComponent>(entity);
-        auto &renderable = renderable_view.get<RenderableComponent>(entity);
-
-        if (renderable.material == nullptr || renderable.model == nullptr)
-            continue;
-
-        // TODO reduce binds calls by grouping objects by materials
-        // bind material descriptor set - at set #1
-        vkCmdBindDescriptorSets(
-                frameInfo.commandBuffer,
-                VK_PIPELINE_BIND_POINT_GRAPHICS,
-                m_pipelineLayout,
-                1,
-                1,
-                &renderable.material->m_descriptor,
-                0,
-                nullptr);
-    
-        // for each obj that uses the material
-            // bind object descriptor set - at set #2
-
-            SimplePushConstantData push{};
-            push.modelMatrix = transform.mat4();
-            push.normalMatrix = transform.normalMatrix();
-
-            vkCmdPushConstants(
-                frameInfo.commandBuffer,
-                m_pipelineLayout,
-                VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
-                0,
-                sizeof(SimplePushConstantData),
-                &push);
-
-            // bind obj model
-            renderable.model->bind(frameInfo.commandBuffer);
-            // draw object
-            renderable.model->draw(frameInfo.commandBuffer);
+            1,
+            &frameInfo.globalUboOffset);
+
+    // bind instances and camera visible list - at set #2
+    cullingSystem.bindDrawSet(frameInfo.commandBuffer, m_pipelineLayout, 2, frameInfo.FrameIndex, CullingView::Camera);
+
+    // batches are sorted by material then model, only rebind what changed
+    Material* boundMaterial{nullptr};
+    Model* boundModel{nullptr};
+    uint32_t boundPage{GeometryPool::INVALID_PAGE};
+    const auto& batches = instanceBatches.getBatches();
+    for(uint32_t batchIndex = firstBatch; batchIndex < endBatch; batchIndex++) {
+        const DrawBatch& batch = batches[batchIndex];
+        if (batch.material != boundMaterial){
+            // bind material descriptor set - at set #1
+            vkCmdBindDescriptorSets(
+                    frameInfo.commandBuffer,
+                    VK_PIPELINE_BIND_POINT_GRAPHICS,
+                    m_pipelineLayout,
+                    1,
+                    1,
+                    &batch.material->m_descriptor,
+                    0,
+                    nullptr);
+            boundMaterial = batch.material;
+        }
+
+        // models of the same geometry page share their vertex and index buffers
+        if (batch.model->getGeometryPage() != boundPage){
+            batch.model->bind(frameInfo.commandBuffer);
+            boundPage = batch.model->getGeometryPage();
+        }
+        if (batch.model != boundModel){
+            batch.model->pushPositionDecode(frameInfo.commandBuffer, m_pipelineLayout);
+            boundModel = batch.model;
+        }
+
+        // the instance count comes from the culling, gl_InstanceIndex indexes the visible list
+        cullingSystem.drawBatch(frameInfo.commandBuffer, frameInfo.FrameIndex, CullingView::Camera, batchIndex, batch);
     }
 }
 
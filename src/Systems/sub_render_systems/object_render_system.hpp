@@ -6,6 +6,10 @@
 #include "Renderer/Buffer.hpp"
 #include "Renderer/DescriptorSet.hpp"
 #include "Renderer/SwapChain.hpp"
+#include "Renderer/FrameData.hpp"
+
+#include "Systems/instance_batch_system.hpp"
+#include "Systems/culling_system.hpp"
 
 //libs
 #include <entt/entt.hpp>
@@ -20,20 +24,22 @@ namespace hyd
 class ObjectRenderSystem
 {
 public:
-    ObjectRenderSystem(Device& device, VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout, VkImageView imageView);
+    // set 0 holds the GlobalUbo of the frame data ring and the shadow map
+    ObjectRenderSystem(Device& device, FrameData& frameData, VkRenderPass renderPass, VkDescriptorSetLayout drawSetLayout, VkImageView imageView);
     ~ObjectRenderSystem();
 
     ObjectRenderSystem(const ObjectRenderSystem&) = delete;
     ObjectRenderSystem &operator=(const ObjectRenderSystem&) = delete;
 
+    // records the batches [firstBatch, endBatch), safe to call from several threads with different command buffers
     void renderEntities(
         FrameInfo& frameInfo,
-        entt::registry& registry,
-        const glm::mat4& lightDepthMVP,
-        VkImageView imageView,
-        float aspectRatio);
+        const InstanceBatchSystem& instanceBatches,
+        CullingSystem& cullingSystem,
+        uint32_t firstBatch,
+        uint32_t endBatch);
 private:
-    void createPipelineLayout(VkDescriptorSetLayout globalSetLayout, VkDescriptorSetLayout objectSetLayout);
+    void createPipelineLayout(VkDescriptorSetLayout objectSetLayout, VkDescriptorSetLayout drawSetLayout);
     void createPipeline(VkRenderPass renderPass);
 
     /* data */
@@ -52,7 +58,6 @@ private:
     std::vector<VkDescriptorSet> m_descriptorSets = std::vector<VkDescriptorSet>(1000);
     std::vector<VkDescriptorSet> m_globalDescriptorSets = std::vector<VkDescriptorSet>(SwapChain::MAX_FRAMES_IN_FLIGHT);
 
-    std::vector<std::unique_ptr<Buffer>> m_uboBuffers = std::vector<std::unique_ptr<Buffer>>(SwapChain::MAX_FRAMES_IN_FLIGHT);
    
     std::vector<VkDescriptorImageInfo> m_descriptorImageInfo = std::vector<VkDescriptorImageInfo>(SwapChain::MAX_FRAMES_IN_FLIGHT);
     std::vector<VkSampler> m_sampler = std::vector<VkSampler>(SwapChain::MAX_FRAMES_IN_FLIGHT);
@@ -74,8 +74,8 @@ void PointLightRenderSystem::renderPointLightEntities(FrameInfo& frameInfo){
         0,
         1,
         &frameInfo.globalDescriptorSet,
-        0,
-        nullptr);
+        1,
+        &frameInfo.globalUboOffset);
 
     vkCmdDraw(frameInfo.commandBuffer, 6, 1, 0, 0);
     
@@ -2,6 +2,7 @@
 
 #include "Components/Transform.hpp"
 #include "Components/Renderable.hpp"
+#include "Renderer/GlobalUbo.hpp"
 
 //libs
 #define GLM_FORCE_RADIANS
@@ -19,31 +20,12 @@ namespace hyd
 {
 
 
-struct GlobalUbo
-{
-    glm::mat4 projection{1.f};
-    glm::mat4 view{1.f};
-
-    glm::vec3 directionalLight{1.f, 1.f, -2.f};
-    alignas(16) glm::vec4 ambiantLightColor{1.f, 1.f, 0.5f, 0.1f}; // w is light intensity
-    
-    glm::vec3 lightPosition{-1.f, -3.f, -1.f};
-    alignas(16)glm::vec4 lightColor{1.f}; // w is light intensity
-};
-
-struct SimplePushConstantData {
-    glm::mat4 modelMatrix{1.f}; // projection * view * model
-    glm::mat4 normalMatrix{1.f};
-};
-
-
-shadowMappingSystem::shadowMappingSystem(Device& device, VkDescriptorSetLayout globalSetLayout):
-m_device{device}{
+shadowMappingSystem::shadowMappingSystem(Device& device, FrameData& frameData, VkDescriptorSetLayout drawSetLayout):
+m_device{device}, m_frameData{frameData}{
 
     m_objectPool = 
     DescriptorPool::Builder(m_device)
         .setMaxSets(1000) // large amount alocated
-        .addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1)
         .addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1)
         .build();
 
@@ -53,30 +35,13 @@ m_device{device}{
             .addBinding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT)
             .build();
 
-    auto globalSetLayout2 =
-        DescriptorSetLayout::Builder(m_device)
-            .addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT)
-            .build();
-
-    // create buffers
-    m_uboBuffer = std::make_unique<Buffer>(
-        m_device,
-        sizeof(GlobalUbo),
-        1,
-        VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
-    m_uboBuffer->map();
-
-    // write descriptors with buffers
-    auto bufferInfo = m_uboBuffer->descriptorInfo();
-    DescriptorWriter(*globalSetLayout2, *m_objectPool)
-        .writeBuffer(0, &bufferInfo)
-        .build(m_globalDescriptor);
+    // known before the first frame, the light frustum is culled before the shadow pass
+    updateLightMatrices();
 
     createImage();
     createRenderPass();
     createFrameBuffer();
-    createPipelineLayout(globalSetLayout, m_materialSetLayout->getDescriptorSetLayout());
+    createPipelineLayout(m_frameData.getSetLayout(), drawSetLayout);
     createPipeline(m_renderPass);
 }
 
@@ -87,23 +52,20 @@ shadowMappingSystem::~shadowMappingSystem(){
     vkDestroyFramebuffer(m_device.device(), m_shadow_map_fb, nullptr);
     vkDestroyImageView(m_device.device(), m_shadow_map_view, nullptr);
     vkDestroyImage(m_device.device(), m_image, nullptr);
-    vkFreeMemory(m_device.device(), m_memory, nullptr);
+    m_device.allocator().free(m_memory);
 
 }
 
-void shadowMappingSystem::createPipelineLayout(VkDescriptorSetLayout globalSetLayout, VkDescriptorSetLayout objectSetLayout) {
-
-    VkPushConstantRange pushConstantRange{};
-    pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
-    pushConstantRange.offset = 0;
-    pushConstantRange.size = sizeof(SimplePushConstantData);
+void shadowMappingSystem::createPipelineLayout(VkDescriptorSetLayout globalSetLayout, VkDescriptorSetLayout drawSetLayout) {
 
-  std::vector<VkDescriptorSetLayout> descriptorSetLayouts{globalSetLayout, objectSetLayout};
+  // the depth pass does not sample materials, set #1 holds the instances and the light visible list
+  std::vector<VkDescriptorSetLayout> descriptorSetLayouts{globalSetLayout, drawSetLayout};
 
     VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
     pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
     pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size());
     pipelineLayoutInfo.pSetLayouts = descriptorSetLayouts.data();
+    VkPushConstantRange pushConstantRange = Model::getPositionDecodeRange();
     pipelineLayoutInfo.pushConstantRangeCount = 1;
     pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
 
@@ -123,10 +85,8 @@ void shadowMappingSystem::createPipeline(VkRenderPass renderPass){
     pipelineConfig.colorBlendInfo.attachmentCount = 0;
     // pipelineConfig.dynamicStateEnables.push_back();
 
-    std::vector<VkVertexInputAttributeDescription> attributeDescriptions{};
-    //                              {location, binding, format, offset}
-    attributeDescriptions.push_back({0, 0, VK_FORMAT_R32G32B32_SFLOAT, 0});
-    pipelineConfig.attributeDescriptions = attributeDescriptions;
+    // only the positions are read, from the position stream of the geometry pool
+    pipelineConfig.attributeDescriptions = Model::getPositionFormat().getAttributeDescriptions();
     
     // pipelineConfig.rasterizationInfo.cullMode = VK_CULL_MODE_FRONT_BIT;
     // pipelineConfig.rasterizationInfo.depthBiasEnable = VK_TRUE;
@@ -134,11 +94,7 @@ void shadowMappingSystem::createPipeline(VkRenderPass renderPass){
     // pipelineConfig.dynamicStateEnables.push_back(VK_DYNAMIC_STATE_DEPTH_BIAS);
 
 
-    std::vector<VkVertexInputBindingDescription> bindingDescriptions(1);
-    bindingDescriptions[0].binding = 0;    
-    bindingDescriptions[0].stride = sizeof(Model::Vertex);    
-    bindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-    pipelineConfig.bindingDescriptions = bindingDescriptions;
+    pipelineConfig.bindingDescriptions = {Model::getPositionFormat().getBindingDescription()};
 
     pipelineConfig.renderPass = renderPass;
     pipelineConfig.pipelineLayout = m_pipelineLayout;
@@ -149,99 +105,94 @@ void shadowMappingSystem::createPipeline(VkRenderPass renderPass){
 }
 
 
+void shadowMappingSystem::update(const InstanceBatchSystem& instanceBatches){
+    updateLightMatrices();
+
+    // the light's view of the frame, next to the camera's one in the frame data ring
+    GlobalUbo ubo{};
+    ubo.projection = m_lightProjection;
+    ubo.view = m_lightView;
+    m_uboOffset = m_frameData.push(ubo);
+
+    // the descriptors are written here, the recording threads only read them
+    for (const DrawBatch& batch : instanceBatches.getBatches()) {
+        Material* material = batch.material;
+        if (material->m_descriptor == VK_NULL_HANDLE){
+            // write a descriptor in the pool
+            auto imageInfo = material->m_textures[0]->getImageInfo();
+            DescriptorWriter(*m_materialSetLayout, *m_objectPool)
+                .writeImage(0, &imageInfo)
+                .build(m_descriptorSets[m_materialDescriptorCount]);
+            material->m_descriptor = m_descriptorSets[m_materialDescriptorCount];
+            m_materialDescriptorCount++;
+        }
+    }
+}
+
 void shadowMappingSystem::renderEntities(
      FrameInfo& frameInfo,
-     entt::registry& registry){
-    auto view = registry.view<TransformComponent, RenderableComponent>();
-
+     const InstanceBatchSystem& instanceBatches,
+     CullingSystem& cullingSystem,
+     uint32_t firstBatch,
+     uint32_t endBatch){
 
     // Set depth bias (aka "Polygon offset")
     // Required to avoid shadow mapping artifacts
     // vkCmdSetDepthBias(
-    //     m_shadow_map_cmd_buf,
+    //     frameInfo.commandBuffer,
     //     1.25f,
     //     0.0f,
     //     1.75f);
 
     // bind pipline
-    m_pipeline->bind(m_shadow_map_cmd_buf);
-
+    m_pipeline->bind(frameInfo.commandBuffer);
 
-    GlobalUbo ubo{};
-    ubo.projection = glm::ortho<float>(-10,10,-10,10,-5,10);
-    ubo.view = glm::lookAt(-ubo.directionalLight, glm::vec3(0,0,0), glm::vec3(0,0,1));
-    m_uboBuffer->writeToBuffer(&ubo);
-    m_uboBuffer->flush();
-
-    // Matrix from light's point of view
-    glm::mat4 depthModelMatrix = glm::mat4(1.0f);
-    m_depthMVP = ubo.projection * ubo.view * depthModelMatrix;
-
-    // bind global descriptor set - at set #0
+    // bind the light ubo of the frame - at set #0
+    VkDescriptorSet globalDescriptor = m_frameData.getDescriptorSet(frameInfo.FrameIndex);
     vkCmdBindDescriptorSets(
-            m_shadow_map_cmd_buf,
+            frameInfo.commandBuffer,
             VK_PIPELINE_BIND_POINT_GRAPHICS,
             m_pipelineLayout,
             0,
             1,
-            // &m_globalDescriptor,
-            &m_globalDescriptor,
-            0,
-            nullptr);
-
-    static int material_index{0};
-    // for each object/Materials
-    for(auto entity: view) {
-        auto &transform = view.get<TransformComponent>(entity);
-        auto &renderable = view.get<RenderableComponent>(entity);
-
-        if (renderable.material == nullptr || renderable.model == nullptr)
-            continue; // don't treat a undefined renderable
-
-        if (renderable.material->m_descriptor == VK_NULL_HANDLE){
-            // write a descriptor in the pool
-            auto imageInfo = renderable.material->m_textures[0]->getImageInfo();
-            DescriptorWriter(*m_materialSetLayout, *m_objectPool)
-                .writeImage(0, &imageInfo)
-                .build(m_descriptorSets[material_index]);
-            renderable.material->m_descriptor = m_descriptorSets[material_index];
-            material_index++;
+            &globalDescriptor,
+            1,
+            &m_uboOffset);
+
+    // bind instances and light visible list - at set #1
+    cullingSystem.bindDrawSet(frameInfo.commandBuffer, m_pipelineLayout, 1, frameInfo.FrameIndex, CullingView::Shadow);
+
+    uint32_t boundPage{GeometryPool::INVALID_PAGE};
+    Model* boundModel{nullptr};
+    // for each (model, material) batch of the chunk
+    const auto& batches = instanceBatches.getBatches();
+    for(uint32_t batchIndex = firstBatch; batchIndex < endBatch; batchIndex++) {
+        const DrawBatch& batch = batches[batchIndex];
+
+        // bind the positions of the model's geometry page, usually once for the whole chunk
+        if (batch.model->getGeometryPage() != boundPage){
+            batch.model->bindPositions(frameInfo.commandBuffer);
+            boundPage = batch.model->getGeometryPage();
         }
-
-        // TODO reduce binds calls by grouping objects by materials
-        // bind material descriptor set - at set #1
-        vkCmdBindDescriptorSets(
-                m_shadow_map_cmd_buf,
-                VK_PIPELINE_BIND_POINT_GRAPHICS,
-                m_pipelineLayout,
-                1,
-                1,
-                &renderable.material->m_descriptor,
-                0,
-                nullptr);
-    
-        // for each obj that uses the material
-            // bind object descriptor set - at set #2
-
-            SimplePushConstantData push{};
-            push.modelMatrix = transform.mat4();
-            push.normalMatrix = transform.normalMatrix();
-
-            vkCmdPushConstants(
-                m_shadow_map_cmd_buf,
-                m_pipelineLayout,
-                VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
-                0,
-                sizeof(SimplePushConstantData),
-                &push);
-
-            // bind obj model
-            renderable.model->bind(m_shadow_map_cmd_buf);
-            // draw object
-            renderable.model->draw(m_shadow_map_cmd_buf);
+        if (batch.model != boundModel){
+            batch.model->pushPositionDecode(frameInfo.commandBuffer, m_pipelineLayout);
+            boundModel = batch.model;
+        }
+        // draw the instances inside the light frustum
+        cullingSystem.drawBatch(frameInfo.commandBuffer, frameInfo.FrameIndex, CullingView::Shadow, batchIndex, batch);
     }
 }
 
+void shadowMappingSystem::updateLightMatrices(){
+    GlobalUbo ubo{};
+    m_lightProjection = glm::ortho<float>(-10,10,-10,10,-5,10);
+    m_lightView = glm::lookAt(-glm::vec3(ubo.directionalLight), glm::vec3(0,0,0), glm::vec3(0,0,1));
+
+    // Matrix from light's point of view
+    glm::mat4 depthModelMatrix = glm::mat4(1.0f);
+    m_depthMVP = m_lightProjection * m_lightView * depthModelMatrix;
+}
+
 
 
 void shadowMappingSystem::createImage(){
@@ -350,12 +301,11 @@ void shadowMappingSystem::createFrameBuffer()
 }
 
 
-void shadowMappingSystem::beginSwapChainRenderPass(VkCommandBuffer commandBuffer){
+void shadowMappingSystem::beginSwapChainRenderPass(VkCommandBuffer commandBuffer, VkSubpassContents contents){
     // assert(m_isFrameStarted && "Can't call beginSwapChainRenderPass if freame is not in progress!");
     // assert(commandBuffer == getCurrentCommandBuffer() && 
         // "Can't call beginSwapChainRenderPass if freame is not in progress!");
     
-    m_shadow_map_cmd_buf = commandBuffer;
     VkClearValue clear_values[1];
     clear_values[0].depthStencil.depth = 1.0f;
     clear_values[0].depthStencil.stencil = 0;
@@ -372,7 +322,10 @@ void shadowMappingSystem::beginSwapChainRenderPass(VkCommandBuffer commandBuffer
     rp_begin.clearValueCount = 1;
     rp_begin.pClearValues = clear_values;
 
-    vkCmdBeginRenderPass(commandBuffer, &rp_begin, VK_SUBPASS_CONTENTS_INLINE);
+    vkCmdBeginRenderPass(commandBuffer, &rp_begin, contents);
+    // the secondary command buffers set their own viewport and scissor
+    if (contents != VK_SUBPASS_CONTENTS_INLINE)
+        return;
 
     VkViewport viewport;
     viewport.height = SHADOW_MAP_HEIGHT;
@@ -381,14 +334,14 @@ void shadowMappingSystem::beginSwapChainRenderPass(VkCommandBuffer commandBuffer
     viewport.maxDepth = 1.0f;
     viewport.x = 0;
     viewport.y = 0;
-    vkCmdSetViewport(m_shadow_map_cmd_buf, 0, 1, &viewport);
+    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
     
     VkRect2D scissor;
     scissor.extent.width = SHADOW_MAP_WIDTH;
     scissor.extent.height = SHADOW_MAP_HEIGHT;
     scissor.offset.x = 0;
     scissor.offset.y = 0;
-    vkCmdSetScissor(m_shadow_map_cmd_buf, 0, 1, &scissor);
+    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
 }
 
 void shadowMappingSystem::endSwapChainRenderPass(VkCommandBuffer commandBuffer){
@@ -6,6 +6,10 @@
 #include "Renderer/Buffer.hpp"
 #include "Renderer/DescriptorSet.hpp"
 #include "Renderer/SwapChain.hpp"
+#include "Renderer/FrameData.hpp"
+
+#include "Systems/instance_batch_system.hpp"
+#include "Systems/culling_system.hpp"
 
 //libs
 #include <entt/entt.hpp>
@@ -22,25 +26,38 @@ namespace hyd
 class shadowMappingSystem
 {
 public:
-    shadowMappingSystem(Device& device, VkDescriptorSetLayout globalSetLayout);
+    // the light ubo is pushed in the frame data ring, set 0 of the pipeline is its set
+    shadowMappingSystem(Device& device, FrameData& frameData, VkDescriptorSetLayout drawSetLayout);
     ~shadowMappingSystem();
 
     shadowMappingSystem(const shadowMappingSystem&) = delete;
     shadowMappingSystem &operator=(const shadowMappingSystem&) = delete;
 
 
+    // light matrices, light ubo and material descriptors, before any recording
+    void update(const InstanceBatchSystem& instanceBatches);
+    // records the batches [firstBatch, endBatch), safe to call from several threads with different command buffers
     void renderEntities(
         FrameInfo& frameInfo,
-        entt::registry& registry);
+        const InstanceBatchSystem& instanceBatches,
+        CullingSystem& cullingSystem,
+        uint32_t firstBatch,
+        uint32_t endBatch);
 
     VkImageView getImage() {return m_shadow_map_view;}
     glm::mat4 getdepthMVP() {return m_depthMVP;}
+    // dynamic offset of the light ubo of the frame
+    uint32_t getUboOffset() const { return m_uboOffset; }
+    VkRenderPass getRenderPass() const { return m_renderPass; }
+    VkFramebuffer getFrameBuffer() const { return m_shadow_map_fb; }
+    VkExtent2D getExtent() const { return {SHADOW_MAP_WIDTH, SHADOW_MAP_HEIGHT}; }
 
-    void beginSwapChainRenderPass(VkCommandBuffer commandBuffer);
+    void beginSwapChainRenderPass(VkCommandBuffer commandBuffer, VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE);
     void endSwapChainRenderPass(VkCommandBuffer commandBuffer);
 
 private:
-    void createPipelineLayout(VkDescriptorSetLayout globalSetLayout, VkDescriptorSetLayout objectSetLayout);
+    void createPipelineLayout(VkDescriptorSetLayout globalSetLayout, VkDescriptorSetLayout drawSetLayout);
+    void updateLightMatrices();
     void createPipeline(VkRenderPass renderPass);
 
     void createImage();
@@ -49,6 +66,7 @@ private:
 
     /* data */
     Device& m_device;
+    FrameData& m_frameData;
 
     std::unique_ptr<DescriptorPool> m_objectPool{};
 
@@ -57,23 +75,24 @@ private:
 
     std::unique_ptr<DescriptorSetLayout> m_materialSetLayout;
     std::vector<VkDescriptorSet> m_descriptorSets = std::vector<VkDescriptorSet>(1000);
+    uint32_t m_materialDescriptorCount{0};
 
     // shadow map  stuff
     VkImage m_image;
-    VkDeviceMemory m_memory;
+    MemoryAllocation m_memory;
     VkImageView m_shadow_map_view;
     VkFramebuffer m_shadow_map_fb;
     VkRenderPass m_renderPass;
-    VkCommandBuffer m_shadow_map_cmd_buf;
 
     VkAttachmentDescription m_attachments[2];
     VkAttachmentReference m_depth_ref;
     VkSubpassDescription m_subpass[1];
     VkRenderPassCreateInfo m_rp_info;
 
-    std::unique_ptr<Buffer> m_uboBuffer;
-    VkDescriptorSet m_globalDescriptor;
+    uint32_t m_uboOffset{0};
 
+    glm::mat4 m_lightProjection{1.f};
+    glm::mat4 m_lightView{1.f};
     glm::mat4 m_depthMVP{1.f};
 
 };
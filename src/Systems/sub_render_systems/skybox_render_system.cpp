@@ -1,6 +1,8 @@
 #include "skybox_render_system.hpp"
 
 #include "Ressources/Image.hpp"
+#include "Ressources/Mipmaps.hpp"
+#include "Renderer/UploadContext.hpp"
 
 #include "Components/Transform.hpp"
 #include "Components/Renderable.hpp"
@@ -19,7 +21,7 @@
 namespace hyd
 {
 
-SkyboxRenderSystem::SkyboxRenderSystem(Device& device, VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout):
+SkyboxRenderSystem::SkyboxRenderSystem(Device& device, GeometryPool& geometryPool, VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout):
 m_device{device}{
 
     // create descriptor pool
@@ -52,7 +54,7 @@ m_device{device}{
     createPipelineLayout(globalSetLayout, m_materialSetLayout->getDescriptorSetLayout());
     createPipeline(renderPass);
 
-    m_skybox_model = Model::createModelFromFile(m_device, "../models/cube.obj");
+    m_skybox_model = Model::createModelFromFile(m_device, geometryPool, "../models/cube.obj");
 }
 
 SkyboxRenderSystem::~SkyboxRenderSystem(){
@@ -61,7 +63,7 @@ SkyboxRenderSystem::~SkyboxRenderSystem(){
     vkDestroySampler(m_device.device(), m_sampler, nullptr);
     vkDestroyImageView(m_device.device(), m_imageView, nullptr);
     vkDestroyImage(m_device.device(), m_image, nullptr);
-    vkFreeMemory(m_device.device(), m_imageMemory, nullptr);
+    m_device.allocator().free(m_imageMemory);
 
 }
 
@@ -73,8 +75,9 @@ void SkyboxRenderSystem::createPipelineLayout(VkDescriptorSetLayout globalSetLay
     pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
     pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size());
     pipelineLayoutInfo.pSetLayouts = descriptorSetLayouts.data();
-    pipelineLayoutInfo.pushConstantRangeCount = 0;
-    pipelineLayoutInfo.pPushConstantRanges = nullptr;
+    VkPushConstantRange pushConstantRange = Model::getPositionDecodeRange();
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
 
     if (vkCreatePipelineLayout(m_device.device(), &pipelineLayoutInfo, nullptr, &m_pipelineLayout) != VK_SUCCESS){
         throw std::runtime_error("failed to create pipeline layout");
@@ -100,6 +103,8 @@ void SkyboxRenderSystem::createPipeline(VkRenderPass renderPass){
 
 
 void SkyboxRenderSystem::render(FrameInfo& frameInfo){
+    if (!m_skybox_model->isResident())
+        return;
 
     // bind pipline
     m_pipeline->bind(frameInfo.commandBuffer);
@@ -112,8 +117,8 @@ void SkyboxRenderSystem::render(FrameInfo& frameInfo){
             0,
             1,
             &frameInfo.globalDescriptorSet,
-            0,
-            nullptr);
+            1,
+            &frameInfo.globalUboOffset);
 
     // bind skybox descriptor set - at set #1
     vkCmdBindDescriptorSets(
@@ -128,6 +133,7 @@ void SkyboxRenderSystem::render(FrameInfo& frameInfo){
     
     // bind obj model
     m_skybox_model->bind(frameInfo.commandBuffer);
+    m_skybox_model->pushPositionDecode(frameInfo.commandBuffer, m_pipelineLayout);
     // draw object
     m_skybox_model->draw(frameInfo.commandBuffer);
 }
@@ -155,27 +161,13 @@ void SkyboxRenderSystem::loadImage(){
     std::vector<unsigned char> cubemap_image_data;
     for( size_t i = 0; i < cubemap_images.size(); ++i ) {
         Image image{cubemap_images[i]};
-        for (int j = 0; j < image.getHeight() * image.getWidth() * 4; ++j){
-            cubemap_image_data.push_back(image.getData()[j]);
-        }
+        cubemap_image_data.insert(cubemap_image_data.end(), image.getData(), image.getData() + image.getHeight() * image.getWidth() * 4);
         width = image.getWidth();
         height = image.getHeight();
     }
 
     VkDeviceSize imageSize = cubemap_image_data.size();
-    uint32_t instanceCount = 1;
-
-    // loading in staging buffer
-    Buffer stagingBuffer{
-        m_device,
-        imageSize,
-        instanceCount,
-        VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
-    };
-
-    stagingBuffer.map();
-    stagingBuffer.writeToBuffer( (void*) cubemap_image_data.data());
+    const uint32_t mipLevels = mipLevelCount(static_cast<uint32_t>(width), static_cast<uint32_t>(height));
 
 
    VkImageCreateInfo imageInfo{};
@@ -184,12 +176,12 @@ void SkyboxRenderSystem::loadImage(){
     imageInfo.extent.width = width;
     imageInfo.extent.height = height;
     imageInfo.extent.depth = 1;
-    imageInfo.mipLevels = 1;
+    imageInfo.mipLevels = mipLevels;
     imageInfo.arrayLayers = 6;
     imageInfo.format = VK_FORMAT_R8G8B8A8_SRGB;
     imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
     imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
     imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
     imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
     imageInfo.flags = VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT;
@@ -202,14 +194,16 @@ void SkyboxRenderSystem::loadImage(){
 
 
 
-    m_device.transitionImageLayout(m_image, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 6);
-    m_device.copyBufferToImage(
-        stagingBuffer.getBuffer(), 
+    // the 6 faces in one copy and their mip chains, submitted with the other loads
+    m_device.uploadContext().uploadImageMipmapped(
         m_image,
+        VK_FORMAT_R8G8B8A8_SRGB,
+        cubemap_image_data.data(),
+        imageSize,
         static_cast<uint32_t>(width),
         static_cast<uint32_t>(height),
-        static_cast<uint32_t>(6));
-    m_device.transitionImageLayout(m_image, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, 6);
+        mipLevels,
+        6);
 
 
     // create image view
@@ -221,7 +215,7 @@ void SkyboxRenderSystem::loadImage(){
     viewInfo.format = VK_FORMAT_R8G8B8A8_SRGB;
     viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
     viewInfo.subresourceRange.baseMipLevel = 0;
-    viewInfo.subresourceRange.levelCount = 1;
+    viewInfo.subresourceRange.levelCount = mipLevels;
     viewInfo.subresourceRange.baseArrayLayer = 0;
     viewInfo.subresourceRange.layerCount = 6;
 
@@ -251,7 +245,7 @@ void SkyboxRenderSystem::loadImage(){
     samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
     samplerInfo.mipLodBias = 0.0f;
     samplerInfo.minLod = 0.0f;
-    samplerInfo.maxLod = 0.0f;
+    samplerInfo.maxLod = static_cast<float>(mipLevels);
 
     if (vkCreateSampler(m_device.device(), &samplerInfo, nullptr, &m_sampler) != VK_SUCCESS) {
         throw std::runtime_error("failed to create texture sampler!");
@@ -21,7 +21,7 @@ namespace hyd
 class SkyboxRenderSystem
 {
 public:
-    SkyboxRenderSystem(Device& device, VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout);
+    SkyboxRenderSystem(Device& device, GeometryPool& geometryPool, VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout);
     ~SkyboxRenderSystem();
 
     SkyboxRenderSystem(const SkyboxRenderSystem&) = delete;
@@ -48,7 +48,7 @@ private:
 
     //
     VkImage m_image; 
-    VkDeviceMemory m_imageMemory;
+    MemoryAllocation m_imageMemory;
     VkImageView m_imageView;
     VkSampler m_sampler;
 
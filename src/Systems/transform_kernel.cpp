@@ -0,0 +1,219 @@
+#include "transform_kernel.hpp"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__)
+#define HYD_TRANSFORM_X86
+#include <immintrin.h>
+#endif
+
+namespace hyd
+{
+
+void TransformsSoA::resize(uint32_t count){
+    for (auto* component : {&translationX, &translationY, &translationZ,
+        &orientationX, &orientationY, &orientationZ, &orientationW,
+        &scaleX, &scaleY, &scaleZ})
+        component->resize(count);
+}
+
+void TransformsSoA::set(uint32_t index, const glm::vec3& translation, const glm::quat& orientation, const glm::vec3& scale){
+    translationX[index] = translation.x;
+    translationY[index] = translation.y;
+    translationZ[index] = translation.z;
+    orientationX[index] = orientation.x;
+    orientationY[index] = orientation.y;
+    orientationZ[index] = orientation.z;
+    orientationW[index] = orientation.w;
+    scaleX[index] = scale.x;
+    scaleY[index] = scale.y;
+    scaleZ[index] = scale.z;
+}
+
+namespace
+{
+
+using ComposeKernel = void (*)(const TransformsSoA&, uint32_t, uint32_t, InstanceData*);
+
+// model = rotate * scale * translate, normal = inverse scale * rotate, as TransformComponent
+void composeScalar(const TransformsSoA& t, uint32_t begin, uint32_t end, InstanceData* out){
+    for (uint32_t i = begin; i < end; i++){
+        const float x = t.orientationX[i], y = t.orientationY[i], z = t.orientationZ[i], w = t.orientationW[i];
+        const float xx = x * x, yy = y * y, zz = z * z;
+        const float xy = x * y, xz = x * z, yz = y * z;
+        const float wx = w * x, wy = w * y, wz = w * z;
+
+        // columns of the rotation
+        const float r[3][3] = {
+            {1.f - 2.f * (yy + zz), 2.f * (xy + wz), 2.f * (xz - wy)},
+            {2.f * (xy - wz), 1.f - 2.f * (xx + zz), 2.f * (yz + wx)},
+            {2.f * (xz + wy), 2.f * (yz - wx), 1.f - 2.f * (xx + yy)}};
+        const float s[3] = {t.scaleX[i], t.scaleY[i], t.scaleZ[i]};
+        const float translation[3] = {t.translationX[i], t.translationY[i], t.translationZ[i]};
+        const float inverseScale[3] = {1.f / s[0], 1.f / s[1], 1.f / s[2]};
+
+        glm::mat4& model = out[i].modelMatrix;
+        glm::mat4& normal = out[i].normalMatrix;
+        model[3] = glm::vec4{0.f, 0.f, 0.f, 1.f};
+        for (int c = 0; c < 3; c++){
+            model[c] = glm::vec4{r[c][0] * s[c], r[c][1] * s[c], r[c][2] * s[c], 0.f};
+            model[3] += glm::vec4{glm::vec3(model[c]) * translation[c], 0.f};
+            normal[c] = glm::vec4{r[c][0] * inverseScale[0], r[c][1] * inverseScale[1], r[c][2] * inverseScale[2], 0.f};
+        }
+        normal[3] = glm::vec4{0.f, 0.f, 0.f, 1.f};
+    }
+}
+
+#ifdef HYD_TRANSFORM_X86
+
+// SSE2 is always available on x86-64, 4 transforms per iteration
+void composeSse(const TransformsSoA& t, uint32_t begin, uint32_t end, InstanceData* out){
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.f);
+
+    uint32_t i = begin;
+    for (; i + 4 <= end; i += 4){
+        const __m128 x = _mm_loadu_ps(t.orientationX.data() + i);
+        const __m128 y = _mm_loadu_ps(t.orientationY.data() + i);
+        const __m128 z = _mm_loadu_ps(t.orientationZ.data() + i);
+        const __m128 w = _mm_loadu_ps(t.orientationW.data() + i);
+        const __m128 sx = _mm_loadu_ps(t.scaleX.data() + i);
+        const __m128 sy = _mm_loadu_ps(t.scaleY.data() + i);
+        const __m128 sz = _mm_loadu_ps(t.scaleZ.data() + i);
+        const __m128 tx = _mm_loadu_ps(t.translationX.data() + i);
+        const __m128 ty = _mm_loadu_ps(t.translationY.data() + i);
+        const __m128 tz = _mm_loadu_ps(t.translationZ.data() + i);
+
+        // the products are doubled once, r = 1 - (2yy + 2zz) and so on
+        const __m128 x2 = _mm_add_ps(x, x), y2 = _mm_add_ps(y, y), z2 = _mm_add_ps(z, z);
+        const __m128 xx = _mm_mul_ps(x, x2), yy = _mm_mul_ps(y, y2), zz = _mm_mul_ps(z, z2);
+        const __m128 xy = _mm_mul_ps(x, y2), xz = _mm_mul_ps(x, z2), yz = _mm_mul_ps(y, z2);
+        const __m128 wx = _mm_mul_ps(w, x2), wy = _mm_mul_ps(w, y2), wz = _mm_mul_ps(w, z2);
+
+        const __m128 r00 = _mm_sub_ps(one, _mm_add_ps(yy, zz)), r01 = _mm_add_ps(xy, wz), r02 = _mm_sub_ps(xz, wy);
+        const __m128 r10 = _mm_sub_ps(xy, wz), r11 = _mm_sub_ps(one, _mm_add_ps(xx, zz)), r12 = _mm_add_ps(yz, wx);
+        const __m128 r20 = _mm_add_ps(xz, wy), r21 = _mm_sub_ps(yz, wx), r22 = _mm_sub_ps(one, _mm_add_ps(xx, yy));
+
+        const __m128 m00 = _mm_mul_ps(r00, sx), m01 = _mm_mul_ps(r01, sx), m02 = _mm_mul_ps(r02, sx);
+        const __m128 m10 = _mm_mul_ps(r10, sy), m11 = _mm_mul_ps(r11, sy), m12 = _mm_mul_ps(r12, sy);
+        const __m128 m20 = _mm_mul_ps(r20, sz), m21 = _mm_mul_ps(r21, sz), m22 = _mm_mul_ps(r22, sz);
+        const __m128 m30 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m00, tx), _mm_mul_ps(m10, ty)), _mm_mul_ps(m20, tz));
+        const __m128 m31 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m01, tx), _mm_mul_ps(m11, ty)), _mm_mul_ps(m21, tz));
+        const __m128 m32 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m02, tx), _mm_mul_ps(m12, ty)), _mm_mul_ps(m22, tz));
+
+        const __m128 ix = _mm_div_ps(one, sx), iy = _mm_div_ps(one, sy), iz = _mm_div_ps(one, sz);
+
+        // the 8 columns of the 4 instances, one float per lane
+        __m128 columns[8][4] = {
+            {m00, m01, m02, zero}, {m10, m11, m12, zero}, {m20, m21, m22, zero}, {m30, m31, m32, one},
+            {_mm_mul_ps(r00, ix), _mm_mul_ps(r01, iy), _mm_mul_ps(r02, iz), zero},
+            {_mm_mul_ps(r10, ix), _mm_mul_ps(r11, iy), _mm_mul_ps(r12, iz), zero},
+            {_mm_mul_ps(r20, ix), _mm_mul_ps(r21, iy), _mm_mul_ps(r22, iz), zero},
+            {zero, zero, zero, one}};
+
+        float* dst = reinterpret_cast<float*>(out + i);
+        for (int c = 0; c < 8; c++){
+            _MM_TRANSPOSE4_PS(columns[c][0], columns[c][1], columns[c][2], columns[c][3]);
+            for (int lane = 0; lane < 4; lane++)
+                _mm_storeu_ps(dst + lane * 32 + c * 4, columns[c][lane]);
+        }
+    }
+    composeScalar(t, i, end, out);
+}
+
+// rows[k] holds the float k of 8 instances, afterwards rows[k] holds the 8 floats of the instance k
+__attribute__((target("avx2,fma")))
+inline void transpose8(__m256 rows[8]){
+    const __m256 t0 = _mm256_unpacklo_ps(rows[0], rows[1]), t1 = _mm256_unpackhi_ps(rows[0], rows[1]);
+    const __m256 t2 = _mm256_unpacklo_ps(rows[2], rows[3]), t3 = _mm256_unpackhi_ps(rows[2], rows[3]);
+    const __m256 t4 = _mm256_unpacklo_ps(rows[4], rows[5]), t5 = _mm256_unpackhi_ps(rows[4], rows[5]);
+    const __m256 t6 = _mm256_unpacklo_ps(rows[6], rows[7]), t7 = _mm256_unpackhi_ps(rows[6], rows[7]);
+
+    const __m256 s0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0)), s1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+    const __m256 s2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0)), s3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+    const __m256 s4 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(1, 0, 1, 0)), s5 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(3, 2, 3, 2));
+    const __m256 s6 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(1, 0, 1, 0)), s7 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(3, 2, 3, 2));
+
+    rows[0] = _mm256_permute2f128_ps(s0, s4, 0x20);
+    rows[1] = _mm256_permute2f128_ps(s1, s5, 0x20);
+    rows[2] = _mm256_permute2f128_ps(s2, s6, 0x20);
+    rows[3] = _mm256_permute2f128_ps(s3, s7, 0x20);
+    rows[4] = _mm256_permute2f128_ps(s0, s4, 0x31);
+    rows[5] = _mm256_permute2f128_ps(s1, s5, 0x31);
+    rows[6] = _mm256_permute2f128_ps(s2, s6, 0x31);
+    rows[7] = _mm256_permute2f128_ps(s3, s7, 0x31);
+}
+
+__attribute__((target("avx2,fma")))
+void composeAvx2(const TransformsSoA& t, uint32_t begin, uint32_t end, InstanceData* out){
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 one = _mm256_set1_ps(1.f);
+
+    uint32_t i = begin;
+    for (; i + 8 <= end; i += 8){
+        const __m256 x = _mm256_loadu_ps(t.orientationX.data() + i);
+        const __m256 y = _mm256_loadu_ps(t.orientationY.data() + i);
+        const __m256 z = _mm256_loadu_ps(t.orientationZ.data() + i);
+        const __m256 w = _mm256_loadu_ps(t.orientationW.data() + i);
+        const __m256 sx = _mm256_loadu_ps(t.scaleX.data() + i);
+        const __m256 sy = _mm256_loadu_ps(t.scaleY.data() + i);
+        const __m256 sz = _mm256_loadu_ps(t.scaleZ.data() + i);
+        const __m256 tx = _mm256_loadu_ps(t.translationX.data() + i);
+        const __m256 ty = _mm256_loadu_ps(t.translationY.data() + i);
+        const __m256 tz = _mm256_loadu_ps(t.translationZ.data() + i);
+
+        const __m256 x2 = _mm256_add_ps(x, x), y2 = _mm256_add_ps(y, y), z2 = _mm256_add_ps(z, z);
+        const __m256 xx = _mm256_mul_ps(x, x2), yy = _mm256_mul_ps(y, y2), zz = _mm256_mul_ps(z, z2);
+        const __m256 xy = _mm256_mul_ps(x, y2), xz = _mm256_mul_ps(x, z2), yz = _mm256_mul_ps(y, z2);
+        const __m256 wx = _mm256_mul_ps(w, x2), wy = _mm256_mul_ps(w, y2), wz = _mm256_mul_ps(w, z2);
+
+        const __m256 r00 = _mm256_sub_ps(one, _mm256_add_ps(yy, zz)), r01 = _mm256_add_ps(xy, wz), r02 = _mm256_sub_ps(xz, wy);
+        const __m256 r10 = _mm256_sub_ps(xy, wz), r11 = _mm256_sub_ps(one, _mm256_add_ps(xx, zz)), r12 = _mm256_add_ps(yz, wx);
+        const __m256 r20 = _mm256_add_ps(xz, wy), r21 = _mm256_sub_ps(yz, wx), r22 = _mm256_sub_ps(one, _mm256_add_ps(xx, yy));
+
+        const __m256 m00 = _mm256_mul_ps(r00, sx), m01 = _mm256_mul_ps(r01, sx), m02 = _mm256_mul_ps(r02, sx);
+        const __m256 m10 = _mm256_mul_ps(r10, sy), m11 = _mm256_mul_ps(r11, sy), m12 = _mm256_mul_ps(r12, sy);
+        const __m256 m20 = _mm256_mul_ps(r20, sz), m21 = _mm256_mul_ps(r21, sz), m22 = _mm256_mul_ps(r22, sz);
+        const __m256 m30 = _mm256_fmadd_ps(m00, tx, _mm256_fmadd_ps(m10, ty, _mm256_mul_ps(m20, tz)));
+        const __m256 m31 = _mm256_fmadd_ps(m01, tx, _mm256_fmadd_ps(m11, ty, _mm256_mul_ps(m21, tz)));
+        const __m256 m32 = _mm256_fmadd_ps(m02, tx, _mm256_fmadd_ps(m12, ty, _mm256_mul_ps(m22, tz)));
+
+        const __m256 ix = _mm256_div_ps(one, sx), iy = _mm256_div_ps(one, sy), iz = _mm256_div_ps(one, sz);
+
+        // the 32 floats of the 8 instances in 4 blocks of 8, two columns per block
+        __m256 blocks[4][8] = {
+            {m00, m01, m02, zero, m10, m11, m12, zero},
+            {m20, m21, m22, zero, m30, m31, m32, one},
+            {_mm256_mul_ps(r00, ix), _mm256_mul_ps(r01, iy), _mm256_mul_ps(r02, iz), zero,
+             _mm256_mul_ps(r10, ix), _mm256_mul_ps(r11, iy), _mm256_mul_ps(r12, iz), zero},
+            {_mm256_mul_ps(r20, ix), _mm256_mul_ps(r21, iy), _mm256_mul_ps(r22, iz), zero,
+             zero, zero, zero, one}};
+
+        float* dst = reinterpret_cast<float*>(out + i);
+        for (int b = 0; b < 4; b++){
+            transpose8(blocks[b]);
+            for (int lane = 0; lane < 8; lane++)
+                _mm256_storeu_ps(dst + lane * 32 + b * 8, blocks[b][lane]);
+        }
+    }
+    composeScalar(t, i, end, out);
+}
+
+#endif
+
+ComposeKernel selectKernel(){
+#ifdef HYD_TRANSFORM_X86
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+        return composeAvx2;
+    return composeSse;
+#else
+    return composeScalar;
+#endif
+}
+
+} // namespace
+
+void composeInstances(const TransformsSoA& transforms, uint32_t begin, uint32_t end, InstanceData* out){
+    static const ComposeKernel kernel = selectKernel();
+    kernel(transforms, begin, end, out);
+}
+
+} // namespace hyd
@@ -0,0 +1,53 @@
+/*
+Composes the instance matrices of many transforms at once. The translations,
+orientations and scales are read from a packed side table in SoA form, and 8
+transforms per iteration are turned into their model and normal matrices with
+AVX2 (4 with SSE, one by one elsewhere), then transposed and written in the
+InstanceData layout, for the transform system to store in the world transforms.
+The math is the one of TransformComponent::mat4 and normalMatrix.
+*/
+#pragma once
+
+#include "Components/Transform.hpp"
+
+//libs
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+// std
+#include <cstdint>
+#include <vector>
+
+namespace hyd
+{
+
+// matches the InstanceData struct of the shaders (std430)
+struct InstanceData
+{
+    glm::mat4 modelMatrix{1.f};
+    glm::mat4 normalMatrix{1.f};
+};
+
+static_assert(sizeof(InstanceData) == 32 * sizeof(float), "the kernels write InstanceData as 32 packed floats");
+
+// local transforms, one array per component
+struct TransformsSoA
+{
+    std::vector<float> translationX, translationY, translationZ;
+    std::vector<float> orientationX, orientationY, orientationZ, orientationW;
+    std::vector<float> scaleX, scaleY, scaleZ;
+
+    void resize(uint32_t count);
+    uint32_t size() const { return static_cast<uint32_t>(translationX.size()); }
+
+    void set(uint32_t index, const glm::vec3& translation, const glm::quat& orientation, const glm::vec3& scale);
+    void set(uint32_t index, const TransformComponent& transform) {
+        set(index, transform.translation, transform.orientation, transform.scale);
+    }
+};
+
+// writes the matrices of the transforms [begin, end) in out[begin, end)
+void composeInstances(const TransformsSoA& transforms, uint32_t begin, uint32_t end, InstanceData* out);
+
+} // namespace hyd
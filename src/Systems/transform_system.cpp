@@ -0,0 +1,191 @@
+#include "transform_system.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+
+namespace hyd
+{
+
+void TransformSystem::update(entt::registry& registry){
+    m_version++;
+
+    // the entities created since the last update get their world matrices
+    m_created.clear();
+    for (auto entity : registry.view<TransformComponent>(entt::exclude<WorldTransformComponent>))
+        m_created.push_back(entity);
+    for (auto entity : m_created)
+        registry.emplace<WorldTransformComponent>(entity);
+
+    // entities outside any hierarchy, their world matrix is their local one
+    m_dirtyRoots.clear();
+    auto root_view = registry.view<TransformComponent, WorldTransformComponent>(entt::exclude<HierarchyComponent>);
+    for (auto entity : root_view){
+        const auto& transform = root_view.get<TransformComponent>(entity);
+        auto& world = root_view.get<WorldTransformComponent>(entity);
+        if (localChanged(transform, world))
+            m_dirtyRoots.push_back({&transform, &world});
+    }
+    composeRoots();
+
+    // hierarchies, a parent is always updated before its children
+    auto hierarchy_view = registry.view<HierarchyComponent>();
+    if (m_orderDirty || m_order.size() != hierarchy_view.size())
+        sortHierarchy(registry);
+
+    auto transform_view = registry.view<TransformComponent, WorldTransformComponent>();
+    for (auto entity : m_order){
+        if (!transform_view.contains(entity))
+            continue;
+        const entt::entity parent = hierarchy_view.get<HierarchyComponent>(entity).parent;
+        const WorldTransformComponent* parentWorld = parent != entt::null && transform_view.contains(parent) ?
+            &transform_view.get<WorldTransformComponent>(parent) : nullptr;
+        updateWorld(transform_view.get<TransformComponent>(entity), transform_view.get<WorldTransformComponent>(entity), parentWorld);
+    }
+}
+
+bool TransformSystem::localChanged(const TransformComponent& transform, const WorldTransformComponent& world){
+    return !world.m_valid ||
+        world.m_translation != transform.translation || world.m_scale != transform.scale || world.m_orientation != transform.orientation;
+}
+
+void TransformSystem::markComputed(const TransformComponent& transform, WorldTransformComponent& world) const {
+    world.version = m_version;
+    world.m_valid = true;
+    world.m_translation = transform.translation;
+    world.m_scale = transform.scale;
+    world.m_orientation = transform.orientation;
+}
+
+void TransformSystem::composeRoots(){
+    const uint32_t count = static_cast<uint32_t>(m_dirtyRoots.size());
+    if (count == 0)
+        return;
+
+    m_rootTransforms.resize(count);
+    for (uint32_t i = 0; i < count; i++)
+        m_rootTransforms.set(i, *m_dirtyRoots[i].first);
+    m_rootMatrices.resize(count);
+    composeInstances(m_rootTransforms, 0, count, m_rootMatrices.data());
+
+    for (uint32_t i = 0; i < count; i++){
+        auto& [transform, world] = m_dirtyRoots[i];
+        world->matrix = m_rootMatrices[i].modelMatrix;
+        world->normalMatrix = m_rootMatrices[i].normalMatrix;
+        markComputed(*transform, *world);
+    }
+}
+
+void TransformSystem::updateWorld(const TransformComponent& transform, WorldTransformComponent& world, const WorldTransformComponent* parent){
+    // the parent was computed again in this update
+    const bool parentChanged = parent != nullptr && parent->version == m_version;
+    if (!localChanged(transform, world) && !parentChanged)
+        return;
+
+    world.matrix = transform.mat4();
+    world.normalMatrix = glm::mat4(transform.normalMatrix());
+    if (parent != nullptr){
+        world.matrix = parent->matrix * world.matrix;
+        // the inverse transpose of a product is the product of the inverse transposes
+        world.normalMatrix = parent->normalMatrix * world.normalMatrix;
+    }
+    markComputed(transform, world);
+}
+
+void TransformSystem::setParent(entt::registry& registry, entt::entity child, entt::entity parent){
+    assert(child != parent && "an entity can't be its own parent");
+
+    // emplaced before any reference is taken, the pool may grow
+    if (parent != entt::null)
+        registry.get_or_emplace<HierarchyComponent>(parent);
+    registry.get_or_emplace<HierarchyComponent>(child);
+
+    if (registry.get<HierarchyComponent>(child).parent == parent)
+        return;
+
+#ifndef NDEBUG
+    for (entt::entity ancestor = parent; ancestor != entt::null; ancestor = registry.get<HierarchyComponent>(ancestor).parent)
+        assert(ancestor != child && "an entity can't be attached to one of its descendants");
+#endif
+
+    detach(registry, child);
+
+    // the child becomes the first child of the parent
+    if (parent != entt::null){
+        auto& parentNode = registry.get<HierarchyComponent>(parent);
+        auto& node = registry.get<HierarchyComponent>(child);
+        node.parent = parent;
+        node.nextSibling = parentNode.firstChild;
+        if (parentNode.firstChild != entt::null)
+            registry.get<HierarchyComponent>(parentNode.firstChild).previousSibling = child;
+        parentNode.firstChild = child;
+    }
+
+    updateDepths(registry, child);
+
+    // computed again relative to the new parent
+    if (auto* world = registry.try_get<WorldTransformComponent>(child))
+        world->m_valid = false;
+    m_orderDirty = true;
+}
+
+void TransformSystem::destroy(entt::registry& registry, entt::entity entity){
+    if (registry.try_get<HierarchyComponent>(entity) != nullptr){
+        detach(registry, entity);
+
+        // gather the whole subtree before destroying any of it
+        m_stack.clear();
+        m_stack.push_back(entity);
+        for (size_t i = 0; i < m_stack.size(); i++){
+            for (entt::entity child = registry.get<HierarchyComponent>(m_stack[i]).firstChild; child != entt::null;
+                child = registry.get<HierarchyComponent>(child).nextSibling)
+                m_stack.push_back(child);
+        }
+        registry.destroy(m_stack.begin(), m_stack.end());
+        m_orderDirty = true;
+        return;
+    }
+    registry.destroy(entity);
+}
+
+void TransformSystem::detach(entt::registry& registry, entt::entity entity){
+    auto& node = registry.get<HierarchyComponent>(entity);
+    if (node.parent == entt::null)
+        return;
+
+    if (node.previousSibling != entt::null)
+        registry.get<HierarchyComponent>(node.previousSibling).nextSibling = node.nextSibling;
+    else
+        registry.get<HierarchyComponent>(node.parent).firstChild = node.nextSibling;
+    if (node.nextSibling != entt::null)
+        registry.get<HierarchyComponent>(node.nextSibling).previousSibling = node.previousSibling;
+
+    node.parent = entt::null;
+    node.previousSibling = entt::null;
+    node.nextSibling = entt::null;
+}
+
+void TransformSystem::updateDepths(entt::registry& registry, entt::entity entity){
+    m_stack.clear();
+    m_stack.push_back(entity);
+    while (!m_stack.empty()){
+        const entt::entity current = m_stack.back();
+        m_stack.pop_back();
+
+        auto& node = registry.get<HierarchyComponent>(current);
+        node.depth = node.parent != entt::null ? registry.get<HierarchyComponent>(node.parent).depth + 1 : 0;
+        for (entt::entity child = node.firstChild; child != entt::null; child = registry.get<HierarchyComponent>(child).nextSibling)
+            m_stack.push_back(child);
+    }
+}
+
+void TransformSystem::sortHierarchy(entt::registry& registry){
+    auto hierarchy_view = registry.view<HierarchyComponent>();
+    m_order.assign(hierarchy_view.begin(), hierarchy_view.end());
+    std::stable_sort(m_order.begin(), m_order.end(), [&hierarchy_view](entt::entity a, entt::entity b){
+        return hierarchy_view.get<HierarchyComponent>(a).depth < hierarchy_view.get<HierarchyComponent>(b).depth;
+    });
+    m_orderDirty = false;
+}
+
+} // namespace hyd
@@ -0,0 +1,73 @@
+/*
+The transform system computes the world matrices of the entities once per
+frame, in their WorldTransformComponent, before the render systems read them.
+A world matrix is computed again only when it is dirty: the local transform
+changed since it was computed, or the parent's world matrix was computed again
+in the same update. The entities of the hierarchies are updated in depth order,
+the parents first, so the changes reach the whole subtree in a single pass and
+the untouched subtrees cost one comparison per entity. The dirty entities
+outside any hierarchy are gathered first and composed together by the SIMD
+kernel of transform_kernel.hpp.
+*/
+#pragma once
+
+#include "Components/Transform.hpp"
+#include "Components/Hierarchy.hpp"
+#include "transform_kernel.hpp"
+
+//libs
+#include <entt/entt.hpp>
+
+// std
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace hyd
+{
+
+class TransformSystem
+{
+public:
+    TransformSystem() = default;
+    ~TransformSystem() = default;
+
+    TransformSystem(const TransformSystem&) = delete;
+    TransformSystem &operator=(const TransformSystem&) = delete;
+
+    // to call once per frame after the transforms are edited, before the rendering
+    void update(entt::registry& registry);
+
+    // attaches child to parent, or makes it a root for entt::null; its transform becomes relative to the parent
+    void setParent(entt::registry& registry, entt::entity child, entt::entity parent);
+    // destroys the entity and all its descendants
+    void destroy(entt::registry& registry, entt::entity entity);
+
+private:
+    // recomputes world when dirty, parent is null for the roots
+    void updateWorld(const TransformComponent& transform, WorldTransformComponent& world, const WorldTransformComponent* parent);
+    // composes the matrices of the dirty entities outside any hierarchy
+    void composeRoots();
+    static bool localChanged(const TransformComponent& transform, const WorldTransformComponent& world);
+    // stamps the world matrices just computed with the update's version and the local transform
+    void markComputed(const TransformComponent& transform, WorldTransformComponent& world) const;
+    void detach(entt::registry& registry, entt::entity entity);
+    void updateDepths(entt::registry& registry, entt::entity entity);
+    void sortHierarchy(entt::registry& registry);
+
+    /* data */
+    uint64_t m_version{0};
+
+    // entities of the hierarchies by increasing depth
+    std::vector<entt::entity> m_order;
+    bool m_orderDirty{true};
+
+    // scratch memory kept between frames to avoid reallocations
+    std::vector<entt::entity> m_created;
+    std::vector<entt::entity> m_stack;
+    std::vector<std::pair<const TransformComponent*, WorldTransformComponent*>> m_dirtyRoots;
+    TransformsSoA m_rootTransforms;
+    std::vector<InstanceData> m_rootMatrices;
+};
+
+} // namespace hyd
@@ -8,6 +8,9 @@
 
 #include "Systems/render_system.hpp"
 #include "Systems/viewer_controller.hpp"
+#include "Systems/transform_system.hpp"
+
+#include "Renderer/UploadContext.hpp"
 
 //libs
 #define GLM_FORCE_RADIANS
@@ -40,9 +43,10 @@ App::~App(){}
 
 void App::run(){
 
-    RenderSystem renderSystem{m_device, m_renderer};
+    RenderSystem renderSystem{m_device, m_renderer, m_threadPool, m_geometryPool};
 
     ViewerControllerSystem viewerControllerSystem{};
+    TransformSystem transformSystem{};
 
     auto currentTime = std::chrono::high_resolution_clock::now();
 
@@ -55,6 +59,12 @@ void App::run(){
         frameTime = std::min(frameTime, 0.5f);
         
         viewerControllerSystem.moveInPlaneXZ(frameTime, m_registry);
+        // world matrices of the moved entities and their children, read by the render systems
+        transformSystem.update(m_registry);
+
+        // models and textures loaded in the background are uploaded with the next frame's submit
+        m_meshManager.update();
+        m_materialManager.updateTextures(m_textureManager.update());
 
         renderSystem.renderEntities(frameTime, m_registry);
         
@@ -85,16 +95,15 @@ bool App::OnWindowResize(WindowResizeEvent& e){
 
 void App::loadEntities(){
 
-    { // load textures
-        m_textureManager.loadRessource("../textures/dirt.jpg");
+    { // load textures, decoded on the thread pool, the materials use the placeholder until then
+        m_textureManager.loadRessourceAsync("../textures/dirt.jpg");
     }
     { // load materials
         m_materialManager.loadRessource("../textures/dirt.jpg");
     }
-    { // load meshs
-        m_meshManager.loadRessource("../models/cube.gltf");
-        // m_meshManager.loadRessource("../models/cube.obj");
-    }
+    // load meshs, parsed on the thread pool while the scene is built
+    std::shared_ptr<Model> cubeModel = m_meshManager.loadRessourceAsync("../models/cube.gltf");
+    // m_meshManager.loadRessourceAsync("../models/cube.obj");
 
     // {    
     //     std::shared_ptr<Model> model = Model::createModelFromFile(m_device, "../models/cube.obj");
@@ -119,11 +128,15 @@ void App::loadEntities(){
                 pos.translation = glm::vec3{j*1.f, i*1.f, 0.f};
                 auto& renderable = m_registry.emplace<RenderableComponent>(entity);
                 renderable.material = m_materialManager.getRessource("../textures/dirt.jpg");
-                renderable.model = m_meshManager.getRessource("../models/cube.gltf");
+                renderable.model = cubeModel;
+                m_registry.emplace<StaticComponent>(entity);
             }
         }
     }
 
+    // every copy of the scene load in one submit
+    m_device.uploadContext().submit();
+
 
 
 
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Core/Window.hpp" 
+#include "Core/ThreadPool.hpp"
 #include "Events/Event.hpp"
 #include "Events/ApplicationEvent.hpp"
 
@@ -51,15 +52,21 @@ private:
     bool m_shouldEnd{false};
     static App* s_Instance;
 
+    ThreadPool m_threadPool{};
+
     Device m_device{m_window};
     Renderer m_renderer{m_window, m_device};
 
+    // shared vertex and index buffers of the models, outlives the managers and systems using it
+    // with the position stream of the shadow pass
+    GeometryPool m_geometryPool{m_device, Model::getVertexFormat().getStride(), Model::getPositionFormat().getStride()};
+
     DescriptorLayoutCache m_cache{m_device};
     DescriptorAllocator m_alloc{m_device};
 
-    TextureManager m_textureManager{m_device};
+    TextureManager m_textureManager{m_device, m_threadPool};
     MaterialManager m_materialManager{m_device, m_cache, m_alloc, m_textureManager};
-    MeshManager m_meshManager{m_device};
+    MeshManager m_meshManager{m_device, m_geometryPool, m_threadPool};
 
     entt::registry m_registry;
 };
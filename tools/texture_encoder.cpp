@@ -0,0 +1,109 @@
+/*
+Offline converter of the PNG/JPEG textures to block compressed KTX2 files.
+The mip chain is generated on the CPU and every level is encoded, the output
+is written next to the input by default so TextureManager picks it up.
+
+usage: texture_encoder <image> [output.ktx2] [--format bc1|bc3|bc5|bc7] [--linear]
+    bc1: opaque color, 8 bytes per 4x4 block
+    bc3: color and alpha, 16 bytes per block
+    bc5: two channels (normal maps), always linear
+    bc7: color and alpha, better quality than bc3 (default)
+    --linear: the color is not srgb encoded
+*/
+#include "Core/ThreadPool.hpp"
+#include "Ressources/BlockCompression.hpp"
+#include "Ressources/Image.hpp"
+#include "Ressources/Ktx2.hpp"
+#include "Ressources/Mipmaps.hpp"
+
+// std
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+using namespace hyd;
+
+static VkFormat vulkanFormat(BlockFormat format, bool srgb){
+    switch (format){
+    case BlockFormat::BC1: return srgb ? VK_FORMAT_BC1_RGB_SRGB_BLOCK : VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+    case BlockFormat::BC3: return srgb ? VK_FORMAT_BC3_SRGB_BLOCK : VK_FORMAT_BC3_UNORM_BLOCK;
+    case BlockFormat::BC5: return VK_FORMAT_BC5_UNORM_BLOCK;
+    case BlockFormat::BC7: return srgb ? VK_FORMAT_BC7_SRGB_BLOCK : VK_FORMAT_BC7_UNORM_BLOCK;
+    }
+    return VK_FORMAT_UNDEFINED;
+}
+
+static bool parseFormat(const char* name, BlockFormat& format){
+    if (std::strcmp(name, "bc1") == 0) format = BlockFormat::BC1;
+    else if (std::strcmp(name, "bc3") == 0) format = BlockFormat::BC3;
+    else if (std::strcmp(name, "bc5") == 0) format = BlockFormat::BC5;
+    else if (std::strcmp(name, "bc7") == 0) format = BlockFormat::BC7;
+    else return false;
+    return true;
+}
+
+int main(int argc, char** argv){
+    std::string input;
+    std::string output;
+    BlockFormat format = BlockFormat::BC7;
+    bool srgb = true;
+
+    for (int i = 1; i < argc; i++){
+        if (std::strcmp(argv[i], "--format") == 0 && i + 1 < argc){
+            if (!parseFormat(argv[++i], format)){
+                std::fprintf(stderr, "unknown format %s\n", argv[i]);
+                return 1;
+            }
+        } else if (std::strcmp(argv[i], "--linear") == 0){
+            srgb = false;
+        } else if (input.empty()){
+            input = argv[i];
+        } else {
+            output = argv[i];
+        }
+    }
+    if (input.empty()){
+        std::fprintf(stderr, "usage: texture_encoder <image> [output.ktx2] [--format bc1|bc3|bc5|bc7] [--linear]\n");
+        return 1;
+    }
+    if (output.empty())
+        output = std::filesystem::path{input}.replace_extension(".ktx2").string();
+    if (format == BlockFormat::BC5)
+        srgb = false;
+
+    try {
+        auto start = std::chrono::high_resolution_clock::now();
+
+        Image image{input};
+        const uint32_t width = static_cast<uint32_t>(image.getWidth());
+        const uint32_t height = static_cast<uint32_t>(image.getHeight());
+
+        std::vector<unsigned char> chain;
+        std::vector<MipLevel> mipLevels = generateMipChain(
+            image.getData(), width, height, 1, mipLevelCount(width, height), srgb, chain);
+
+        ThreadPool threadPool{};
+        std::vector<std::vector<unsigned char>> levels;
+        size_t compressedBytes = 0;
+        for (const auto& level : mipLevels){
+            levels.push_back(compressImage(format, chain.data() + level.offset, level.width, level.height, &threadPool));
+            compressedBytes += levels.back().size();
+        }
+
+        Ktx2Image::write(output, vulkanFormat(format, srgb), width, height, levels);
+
+        float seconds = std::chrono::duration<float, std::chrono::seconds::period>(
+            std::chrono::high_resolution_clock::now() - start).count();
+        std::printf("%s: %ux%u, %zu levels, %zu -> %zu bytes (%.1fx) in %.2f s\n",
+            output.c_str(), width, height, levels.size(), chain.size(), compressedBytes,
+            double(chain.size()) / double(compressedBytes), seconds);
+    } catch (const std::exception& e) {
+        std::fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+    return 0;
+}